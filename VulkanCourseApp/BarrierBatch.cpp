@@ -0,0 +1,345 @@
+#include "BarrierBatch.h"
+
+#include <stdexcept>
+#include <cstdint>
+
+// Accesses that write memory, any other being a read
+static const VkAccessFlags2 WRITE_ACCESS_MASK = VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+	VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+void BarrierBatch::setSynchronization2(bool enabled)
+{
+	synchronization2 = enabled;
+}
+
+void BarrierBatch::trackImage(VkImage image, VkImageAspectFlags aspectMask, VkImageLayout layout)
+{
+	ResourceState state = {};
+	state.access.layout = layout;
+	state.aspectMask = aspectMask;
+	state.pendingBarrier = SIZE_MAX;
+
+	images[image] = state;
+}
+
+void BarrierBatch::trackBuffer(VkBuffer buffer)
+{
+	ResourceState state = {};
+	state.pendingBarrier = SIZE_MAX;
+
+	buffers[buffer] = state;
+}
+
+void BarrierBatch::forgetImage(VkImage image)
+{
+	images.erase(image);
+}
+
+void BarrierBatch::forgetBuffer(VkBuffer buffer)
+{
+	buffers.erase(buffer);
+}
+
+bool BarrierBatch::isTracked(VkImage image)
+{
+	return images.count(image) != 0;
+}
+
+bool BarrierBatch::isTracked(VkBuffer buffer)
+{
+	return buffers.count(buffer) != 0;
+}
+
+bool BarrierBatch::accessResource(AccessState& state, bool image, VkPipelineStageFlags2 stageMask, VkAccessFlags2 accessMask, VkImageLayout layout,
+	VkPipelineStageFlags2& waitStages, VkAccessFlags2& waitAccess)
+{
+	VkAccessFlags2 readAccess = accessMask & ~WRITE_ACCESS_MASK;
+	bool transition = image && layout != state.layout;
+	bool writesMemory = isWrite(accessMask);
+	bool write = writesMemory || transition;
+
+	waitStages = 0;
+	waitAccess = 0;
+
+	// Read after write, unless an earlier read in the same stages already made the write visible
+	if (readAccess != 0 && state.writeStages != 0 && ((stageMask & ~state.readStages) != 0 || (readAccess & ~state.readAccess) != 0))
+	{
+		waitStages |= state.writeStages;
+		waitAccess |= state.writeAccess;
+	}
+
+	// Write after write, or after reads (which only have to have finished)
+	if (write)
+	{
+		waitStages |= state.writeStages | state.readStages;
+		waitAccess |= state.writeAccess;
+	}
+
+	// Writes (a layout transition being one) start a new state, reads add to it
+	// A transition makes itself visible to the reads it was for, but not the accesses' own writes, which come after it
+	if (write)
+	{
+		state.writeStages = stageMask;
+		state.writeAccess = accessMask & WRITE_ACCESS_MASK;
+		state.readStages = writesMemory ? 0 : stageMask;
+		state.readAccess = writesMemory ? 0 : readAccess;
+	}
+	else
+	{
+		state.readStages |= stageMask;
+		state.readAccess |= readAccess;
+	}
+
+	state.layout = layout;
+
+	return transition || waitStages != 0;
+}
+
+void BarrierBatch::imageBarrier(VkImage image, VkPipelineStageFlags2 stageMask, VkAccessFlags2 accessMask, VkImageLayout layout)
+{
+	auto found = images.find(image);
+
+	if (found == images.end())
+	{
+		throw std::runtime_error("Failed to add a barrier for an image that isn't tracked!");
+	}
+
+	ResourceState& state = found->second;
+
+	// Nothing runs between two barriers in one batch, so the one already queued is redone to take the image straight from its
+	// state at the last flush to this access (along with the one queued before, if in the same layout)
+	if (state.pendingBarrier != SIZE_MAX)
+	{
+		const VkImageMemoryBarrier2& pendingBarrier = pendingImageBarriers[state.pendingBarrier];
+
+		if (pendingBarrier.newLayout == layout)
+		{
+			stageMask |= pendingBarrier.dstStageMask;
+			accessMask |= pendingBarrier.dstAccessMask;
+		}
+
+		state.access = state.flushedAccess;
+	}
+	else
+	{
+		state.flushedAccess = state.access;
+	}
+
+	VkImageLayout oldLayout = state.access.layout;
+
+	VkPipelineStageFlags2 waitStages;
+	VkAccessFlags2 waitAccess;
+	bool needed = accessResource(state.access, true, stageMask, accessMask, layout, waitStages, waitAccess);
+
+	if (!needed && state.pendingBarrier == SIZE_MAX)
+	{
+		return;
+	}
+
+	VkImageMemoryBarrier2 barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+	barrier.srcStageMask = waitStages;																// Stages and accesses the barrier waits for
+	barrier.srcAccessMask = waitAccess;
+	barrier.dstStageMask = stageMask;																// Stages and accesses waiting on it
+	barrier.dstAccessMask = accessMask;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = layout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = state.aspectMask;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+	if (state.pendingBarrier != SIZE_MAX)
+	{
+		pendingImageBarriers[state.pendingBarrier] = barrier;
+		return;
+	}
+
+	state.pendingBarrier = pendingImageBarriers.size();
+	pendingImageBarriers.push_back(barrier);
+}
+
+void BarrierBatch::bufferBarrier(VkBuffer buffer, VkPipelineStageFlags2 stageMask, VkAccessFlags2 accessMask)
+{
+	auto found = buffers.find(buffer);
+
+	if (found == buffers.end())
+	{
+		throw std::runtime_error("Failed to add a barrier for a buffer that isn't tracked!");
+	}
+
+	ResourceState& state = found->second;
+
+	// As for images, one already queued is redone to cover both accesses
+	if (state.pendingBarrier != SIZE_MAX)
+	{
+		stageMask |= pendingBufferBarriers[state.pendingBarrier].dstStageMask;
+		accessMask |= pendingBufferBarriers[state.pendingBarrier].dstAccessMask;
+		state.access = state.flushedAccess;
+	}
+	else
+	{
+		state.flushedAccess = state.access;
+	}
+
+	VkPipelineStageFlags2 waitStages;
+	VkAccessFlags2 waitAccess;
+	bool needed = accessResource(state.access, false, stageMask, accessMask, VK_IMAGE_LAYOUT_UNDEFINED, waitStages, waitAccess);
+
+	if (!needed && state.pendingBarrier == SIZE_MAX)
+	{
+		return;
+	}
+
+	VkBufferMemoryBarrier2 barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+	barrier.srcStageMask = waitStages;
+	barrier.srcAccessMask = waitAccess;
+	barrier.dstStageMask = stageMask;
+	barrier.dstAccessMask = accessMask;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = buffer;
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+
+	if (state.pendingBarrier != SIZE_MAX)
+	{
+		pendingBufferBarriers[state.pendingBarrier] = barrier;
+		return;
+	}
+
+	state.pendingBarrier = pendingBufferBarriers.size();
+	pendingBufferBarriers.push_back(barrier);
+}
+
+void BarrierBatch::flush(VkCommandBuffer commandBuffer)
+{
+	if (pendingImageBarriers.empty() && pendingBufferBarriers.empty())
+	{
+		return;
+	}
+
+	if (synchronization2)
+	{
+		VkDependencyInfo dependencyInfo = {};
+		dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+		dependencyInfo.bufferMemoryBarrierCount = static_cast<uint32_t>(pendingBufferBarriers.size());
+		dependencyInfo.pBufferMemoryBarriers = pendingBufferBarriers.data();
+		dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(pendingImageBarriers.size());
+		dependencyInfo.pImageMemoryBarriers = pendingImageBarriers.data();
+
+		vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+	}
+	else
+	{
+		// One call has one pair of stage masks, so it waits on every barrier's stages before any of theirs continue
+		// (the Vulkan 1.0 stages and accesses keep their bit positions, the later ones beyond 32 bits having no equivalent)
+		VkPipelineStageFlags srcStageMask = 0;
+		VkPipelineStageFlags dstStageMask = 0;
+
+		std::vector<VkImageMemoryBarrier> imageBarriers(pendingImageBarriers.size());
+		std::vector<VkBufferMemoryBarrier> bufferBarriers(pendingBufferBarriers.size());
+
+		for (size_t i = 0; i < pendingImageBarriers.size(); i++)
+		{
+			const VkImageMemoryBarrier2& pendingBarrier = pendingImageBarriers[i];
+			srcStageMask |= static_cast<VkPipelineStageFlags>(pendingBarrier.srcStageMask);
+			dstStageMask |= static_cast<VkPipelineStageFlags>(pendingBarrier.dstStageMask);
+
+			imageBarriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageBarriers[i].srcAccessMask = static_cast<VkAccessFlags>(pendingBarrier.srcAccessMask);
+			imageBarriers[i].dstAccessMask = static_cast<VkAccessFlags>(pendingBarrier.dstAccessMask);
+			imageBarriers[i].oldLayout = pendingBarrier.oldLayout;
+			imageBarriers[i].newLayout = pendingBarrier.newLayout;
+			imageBarriers[i].srcQueueFamilyIndex = pendingBarrier.srcQueueFamilyIndex;
+			imageBarriers[i].dstQueueFamilyIndex = pendingBarrier.dstQueueFamilyIndex;
+			imageBarriers[i].image = pendingBarrier.image;
+			imageBarriers[i].subresourceRange = pendingBarrier.subresourceRange;
+		}
+
+		for (size_t i = 0; i < pendingBufferBarriers.size(); i++)
+		{
+			const VkBufferMemoryBarrier2& pendingBarrier = pendingBufferBarriers[i];
+			srcStageMask |= static_cast<VkPipelineStageFlags>(pendingBarrier.srcStageMask);
+			dstStageMask |= static_cast<VkPipelineStageFlags>(pendingBarrier.dstStageMask);
+
+			bufferBarriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			bufferBarriers[i].srcAccessMask = static_cast<VkAccessFlags>(pendingBarrier.srcAccessMask);
+			bufferBarriers[i].dstAccessMask = static_cast<VkAccessFlags>(pendingBarrier.dstAccessMask);
+			bufferBarriers[i].srcQueueFamilyIndex = pendingBarrier.srcQueueFamilyIndex;
+			bufferBarriers[i].dstQueueFamilyIndex = pendingBarrier.dstQueueFamilyIndex;
+			bufferBarriers[i].buffer = pendingBarrier.buffer;
+			bufferBarriers[i].offset = pendingBarrier.offset;
+			bufferBarriers[i].size = pendingBarrier.size;
+		}
+
+		// Without synchronization2 an empty mask isn't allowed, so nothing to wait for is the top of the pipe and nothing waiting the bottom
+		vkCmdPipelineBarrier(commandBuffer,
+							 srcStageMask != 0 ? srcStageMask : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStageMask != 0 ? dstStageMask : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+							 0, 0, nullptr,
+							 static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+							 static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+	}
+
+	// Later barriers start new ones
+	for (const VkImageMemoryBarrier2& pendingBarrier : pendingImageBarriers)
+	{
+		auto found = images.find(pendingBarrier.image);
+
+		if (found != images.end())
+		{
+			found->second.pendingBarrier = SIZE_MAX;
+		}
+	}
+
+	for (const VkBufferMemoryBarrier2& pendingBarrier : pendingBufferBarriers)
+	{
+		auto found = buffers.find(pendingBarrier.buffer);
+
+		if (found != buffers.end())
+		{
+			found->second.pendingBarrier = SIZE_MAX;
+		}
+	}
+
+	pendingImageBarriers.clear();
+	pendingBufferBarriers.clear();
+}
+
+void BarrierBatch::setImageLayout(VkImage image, VkImageLayout layout)
+{
+	auto found = images.find(image);
+
+	if (found == images.end())
+	{
+		throw std::runtime_error("Failed to set the layout of an image that isn't tracked!");
+	}
+
+	AccessState& state = found->second.access;
+
+	if (layout == state.layout)
+	{
+		return;
+	}
+
+	state.writeStages |= state.readStages;
+	state.readStages = 0;
+	state.readAccess = 0;
+	state.layout = layout;
+}
+
+VkImageLayout BarrierBatch::getLayout(VkImage image)
+{
+	auto found = images.find(image);
+	return found != images.end() ? found->second.access.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+}
+
+bool BarrierBatch::isWrite(VkAccessFlags2 accessMask)
+{
+	return (accessMask & WRITE_ACCESS_MASK) != 0;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <unordered_map>
+#include <cstddef>
+
+// Collects the barriers a command buffer needs before its next commands, recording them all at once as one vkCmdPipelineBarrier2
+// (or one vkCmdPipelineBarrier where synchronization2 isn't enabled, the masks then limited to the stages and accesses Vulkan 1.0 has)
+// Each tracked image's layout and each resource's accesses since it was last written are remembered, so a barrier only names the access
+// coming next: what to wait for and which layout to leave follow from the tracked state, and barriers nothing needs are dropped
+
+class BarrierBatch
+{
+public:
+
+	void setSynchronization2(bool enabled);
+
+	// Start tracking a resource (an image as left in layout, UNDEFINED for a new one), or stop once it is destroyed
+	void trackImage(VkImage image, VkImageAspectFlags aspectMask, VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED);
+	void trackBuffer(VkBuffer buffer);
+	void forgetImage(VkImage image);
+	void forgetBuffer(VkBuffer buffer);
+	bool isTracked(VkImage image);
+	bool isTracked(VkBuffer buffer);
+
+	// Make a resource ready for the next commands to access it in stageMask with accessMask (and an image, in layout)
+	// Dropped if those accesses are reads already visible to those stages in that layout, and merged with any barrier of its own not yet flushed
+	void imageBarrier(VkImage image, VkPipelineStageFlags2 stageMask, VkAccessFlags2 accessMask, VkImageLayout layout);
+	void bufferBarrier(VkBuffer buffer, VkPipelineStageFlags2 stageMask, VkAccessFlags2 accessMask);
+
+	// Record every barrier queued since the last flush as one call (none if nothing is queued)
+	void flush(VkCommandBuffer commandBuffer);
+
+	// Commands recorded since the last flush left the image in layout by themselves (a render pass with its own final layout)
+	// The change counts as a write by the stages of the image's last barrier, which the next access waits for
+	void setImageLayout(VkImage image, VkImageLayout layout);
+
+	VkImageLayout getLayout(VkImage image);
+
+	// Whether accessMask has any access writing memory, every other being a read
+	static bool isWrite(VkAccessFlags2 accessMask);
+
+private:
+	// Accesses since the last write (or layout transition), which the next access may have to wait for
+	struct AccessState
+	{
+		VkPipelineStageFlags2 writeStages;
+		VkAccessFlags2 writeAccess;
+		VkPipelineStageFlags2 readStages;															// Reads since the write, made visible to these already
+		VkAccessFlags2 readAccess;
+		VkImageLayout layout;
+	};
+
+	struct ResourceState
+	{
+		AccessState access;																			// After the barriers queued so far
+		AccessState flushedAccess;																	// Before them, what a merged barrier is worked out from
+		VkImageAspectFlags aspectMask;
+		size_t pendingBarrier;																		// Index of its barrier queued for the next flush (SIZE_MAX if none)
+	};
+
+	bool synchronization2 = false;
+	std::unordered_map<VkImage, ResourceState> images;
+	std::unordered_map<VkBuffer, ResourceState> buffers;
+	std::vector<VkImageMemoryBarrier2> pendingImageBarriers;
+	std::vector<VkBufferMemoryBarrier2> pendingBufferBarriers;
+
+	// Work out what an access has to wait for and update state to follow it, returning whether it needs a barrier at all
+	static bool accessResource(AccessState& state, bool image, VkPipelineStageFlags2 stageMask, VkAccessFlags2 accessMask, VkImageLayout layout,
+		VkPipelineStageFlags2& waitStages, VkAccessFlags2& waitAccess);
+
+};
@@ -0,0 +1,194 @@
+#include "Benchmark.h"
+#include "ImageProcessing.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Best of several runs, in milliseconds
+static double timeBestOf(int runs, const std::function<void()>& work)
+{
+	double best = 1e30;
+
+	for (int i = 0; i < runs; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		work();
+		auto end = std::chrono::steady_clock::now();
+
+		best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+
+	return best;
+}
+
+static const char* getSimdLevelName(SimdLevel level)
+{
+	switch (level)
+	{
+	case SimdLevel::AVX2:
+		return "AVX2";
+	case SimdLevel::SSE2:
+		return "SSE2";
+	default:
+		return "Scalar";
+	}
+}
+
+// Run one kernel at each level up to the supported one, reporting time and speedup over scalar
+static void benchmarkKernel(const char* name, const std::function<void()>& work)
+{
+	const int runs = 10;
+	SimdLevel supportedLevel = getSupportedSimdLevel();
+	double scalarTime = 0.0;
+
+	for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2 })
+	{
+		if (level > supportedLevel)
+		{
+			break;
+		}
+
+		setImageProcessingSimdLevel(level);
+		double time = timeBestOf(runs, work);
+
+		if (level == SimdLevel::Scalar)
+		{
+			scalarTime = time;
+		}
+
+		printf("  %-24s %-7s %8.3f ms  %5.2fx\n", name, getSimdLevelName(level), time, scalarTime / time);
+	}
+
+	setImageProcessingSimdLevel(supportedLevel);
+}
+
+void runImageProcessingBenchmark()
+{
+	// One 2048x2048 texture, the size of the largest model textures
+	const uint32_t size = 2048;
+	const size_t pixelCount = (size_t)size * size;
+
+	std::mt19937 random(42);
+	std::vector<uint8_t> rgb(pixelCount * 3);
+	std::vector<uint8_t> rgba(pixelCount * 4);
+	std::vector<uint8_t> output(pixelCount * 4);
+	std::vector<float> linear(pixelCount * 4);
+
+	for (auto& value : rgb)
+	{
+		value = (uint8_t)random();
+	}
+
+	for (auto& value : rgba)
+	{
+		value = (uint8_t)random();
+	}
+
+	// Grey, opaque image, the worst case for channel counting as it has to scan every texel
+	std::vector<uint8_t> greyRGBA(pixelCount * 4);
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		uint8_t grey = (uint8_t)random();
+
+		greyRGBA[i * 4 + 0] = grey;
+		greyRGBA[i * 4 + 1] = grey;
+		greyRGBA[i * 4 + 2] = grey;
+		greyRGBA[i * 4 + 3] = 255;
+	}
+
+	printf("Image processing (%ux%u RGBA8, best of 10, supported level %s)\n", size, size, getSimdLevelName(getSupportedSimdLevel()));
+
+	benchmarkKernel("Expand RGB to RGBA", [&]() { expandRGBToRGBA(rgb.data(), output.data(), pixelCount); });
+	benchmarkKernel("sRGB to linear", [&]() { convertSRGBToLinear(rgba.data(), linear.data(), pixelCount); });
+	benchmarkKernel("Linear to sRGB", [&]() { convertLinearToSRGB(linear.data(), output.data(), pixelCount); });
+	benchmarkKernel("Count used channels", [&]() { countUsedChannels(greyRGBA.data(), pixelCount); });
+	benchmarkKernel("Box downsample 2x2", [&]() { downsampleBox2x2(rgba.data(), size, size, output.data()); });
+}
+
+// Stand-in for a job's work, a dependent chain of arithmetic no thread can shortcut
+static float runSyntheticJob(uint32_t seed, uint32_t iterations)
+{
+	float value = (float)seed;
+
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		value = value * 0.999f + 1.0f;
+	}
+
+	return value;
+}
+
+void runJobSystemBenchmark()
+{
+	// Many small jobs (as culling batches and mesh processing queue), then fewer jobs depending on all of them that reduce their results
+	const uint32_t jobCount = 2048;
+	const uint32_t reduceJobCount = 32;
+	const uint32_t iterations = 20000;
+	const int runs = 5;
+
+	std::vector<float> results(jobCount);
+	std::vector<float> sums(reduceJobCount);
+	unsigned int maxThreadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	printf("Job system (%u jobs of %u iterations, then %u jobs reducing them, best of %d)\n", jobCount, iterations, reduceJobCount, runs);
+
+	double singleThreadTime = 0.0;
+
+	for (unsigned int threadCount = 1; threadCount <= maxThreadCount; threadCount++)
+	{
+		double time;
+
+		// One thread is the work run in a loop, more are workers plus the main thread joining in as it waits
+		if (threadCount == 1)
+		{
+			time = timeBestOf(runs, [&]()
+			{
+				for (uint32_t i = 0; i < jobCount; i++)
+				{
+					results[i] = runSyntheticJob(i, iterations);
+				}
+
+				for (uint32_t i = 0; i < reduceJobCount; i++)
+				{
+					sums[i] = std::accumulate(results.begin() + i * (jobCount / reduceJobCount), results.begin() + (i + 1) * (jobCount / reduceJobCount), 0.0f);
+				}
+			});
+
+			singleThreadTime = time;
+		}
+		else
+		{
+			ThreadPool threadPool(threadCount - 1);
+
+			time = timeBestOf(runs, [&]()
+			{
+				JobCounter jobs;
+				JobCounter reduceJobs;
+
+				for (uint32_t i = 0; i < jobCount; i++)
+				{
+					threadPool.run([&results, i, iterations]() { results[i] = runSyntheticJob(i, iterations); }, &jobs);
+				}
+
+				for (uint32_t i = 0; i < reduceJobCount; i++)
+				{
+					threadPool.run([&results, &sums, i, jobCount, reduceJobCount]()
+					{
+						sums[i] = std::accumulate(results.begin() + i * (jobCount / reduceJobCount), results.begin() + (i + 1) * (jobCount / reduceJobCount), 0.0f);
+					}, &reduceJobs, &jobs);
+				}
+
+				threadPool.wait(reduceJobs);
+			});
+		}
+
+		printf("  %2u threads %8.3f ms  %5.2fx\n", threadCount, time, singleThreadTime / time);
+	}
+}
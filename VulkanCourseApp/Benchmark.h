@@ -0,0 +1,10 @@
+#pragma once
+
+// Micro-benchmarks run from the command line (VulkanCourseApp.exe --benchmark) instead of opening the renderer
+// Results are printed to stdout
+
+// Time each image kernel at every supported SIMD level against its scalar path
+void runImageProcessingBenchmark();
+
+// Time a fixed synthetic workload on the job system with 1 to N threads, reporting the speedup over one
+void runJobSystemBenchmark();
\ No newline at end of file
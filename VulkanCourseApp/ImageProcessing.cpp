@@ -0,0 +1,469 @@
+#include "ImageProcessing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include <immintrin.h>
+
+// MSVC compiles any intrinsic as is, GCC and Clang need the instruction set enabled per function
+#if defined(_MSC_VER)
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+// -- Dispatch --
+
+static SimdLevel detectSimdLevel()
+{
+#if defined(_MSC_VER)
+	int cpuInfo[4];
+	__cpuid(cpuInfo, 0);
+	int maxLeaf = cpuInfo[0];
+
+	__cpuid(cpuInfo, 1);
+	bool sse2 = (cpuInfo[3] & (1 << 26)) != 0;
+	bool osSavesYmm = (cpuInfo[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;			// OS saves YMM registers on context switch
+
+	bool avx2 = false;
+	if (maxLeaf >= 7 && osSavesYmm)
+	{
+		__cpuidex(cpuInfo, 7, 0);
+		avx2 = (cpuInfo[1] & (1 << 5)) != 0;
+	}
+#else
+	__builtin_cpu_init();
+	bool sse2 = __builtin_cpu_supports("sse2");
+	bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+	if (avx2)
+	{
+		return SimdLevel::AVX2;
+	}
+
+	return sse2 ? SimdLevel::SSE2 : SimdLevel::Scalar;
+}
+
+static SimdLevel activeSimdLevel = getSupportedSimdLevel();
+
+SimdLevel getSupportedSimdLevel()
+{
+	static const SimdLevel supportedLevel = detectSimdLevel();
+	return supportedLevel;
+}
+
+SimdLevel getImageProcessingSimdLevel()
+{
+	return activeSimdLevel;
+}
+
+void setImageProcessingSimdLevel(SimdLevel level)
+{
+	activeSimdLevel = std::min(level, getSupportedSimdLevel());
+}
+
+// -- Lookup Tables --
+
+const int LINEAR_TO_SRGB_STEPS = 4096;																// Linear values are quantized to 12 bits before encoding
+
+// 256 sRGB colour decodes followed by 256 alpha rescales, so one gather index covers a whole RGBA pixel
+static const float* getSRGBToLinearTable()
+{
+	static float table[512];
+	static bool initialized = [] ()
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			float value = i / 255.0f;
+			table[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+			table[256 + i] = value;
+		}
+
+		return true;
+	}();
+
+	(void)initialized;
+	return table;
+}
+
+static const int32_t* getLinearToSRGBTable()
+{
+	static int32_t table[LINEAR_TO_SRGB_STEPS];
+	static bool initialized = [] ()
+	{
+		for (int i = 0; i < LINEAR_TO_SRGB_STEPS; i++)
+		{
+			float value = (float)i / (LINEAR_TO_SRGB_STEPS - 1);
+			float encoded = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+			table[i] = (int32_t)(encoded * 255.0f + 0.5f);
+		}
+
+		return true;
+	}();
+
+	(void)initialized;
+	return table;
+}
+
+// Table index for colour channels, or the final value for alpha
+static int32_t quantizeLinear(float value, bool alpha)
+{
+	float scale = alpha ? 255.0f : (float)(LINEAR_TO_SRGB_STEPS - 1);
+	return (int32_t)(std::min(std::max(value, 0.0f), 1.0f) * scale + 0.5f);
+}
+
+// -- Expand RGB to RGBA --
+
+static void expandRGBToRGBAScalar(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		destination[i * 4 + 0] = source[i * 3 + 0];
+		destination[i * 4 + 1] = source[i * 3 + 1];
+		destination[i * 4 + 2] = source[i * 3 + 2];
+		destination[i * 4 + 3] = 255;
+	}
+}
+
+TARGET_AVX2 static void expandRGBToRGBAAVX2(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+	// Spread 4 RGB pixels per 128-bit lane out to 4 RGBA pixels, filling alpha afterwards
+	const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+											 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+
+	size_t i = 0;
+
+	// Each step reads 28 bytes for 8 pixels, so stop while a full read still stays inside the source
+	for (; i + 10 <= pixelCount; i += 8)
+	{
+		__m128i low = _mm_loadu_si128((const __m128i*)(source + i * 3));
+		__m128i high = _mm_loadu_si128((const __m128i*)(source + i * 3 + 12));
+		__m256i pixels = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+
+		pixels = _mm256_or_si256(_mm256_shuffle_epi8(pixels, shuffle), alpha);
+		_mm256_storeu_si256((__m256i*)(destination + i * 4), pixels);
+	}
+
+	expandRGBToRGBAScalar(source + i * 3, destination + i * 4, pixelCount - i);
+}
+
+void expandRGBToRGBA(const uint8_t* source, uint8_t* destination, size_t pixelCount)
+{
+	// SSE2 has no byte shuffle, so it shares the scalar path
+	if (activeSimdLevel == SimdLevel::AVX2)
+	{
+		expandRGBToRGBAAVX2(source, destination, pixelCount);
+	}
+
+	else
+	{
+		expandRGBToRGBAScalar(source, destination, pixelCount);
+	}
+}
+
+// -- sRGB to Linear --
+
+static void convertSRGBToLinearScalar(const uint8_t* source, float* destination, size_t pixelCount)
+{
+	const float* table = getSRGBToLinearTable();
+
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		destination[i * 4 + 0] = table[source[i * 4 + 0]];
+		destination[i * 4 + 1] = table[source[i * 4 + 1]];
+		destination[i * 4 + 2] = table[source[i * 4 + 2]];
+		destination[i * 4 + 3] = table[256 + source[i * 4 + 3]];
+	}
+}
+
+TARGET_AVX2 static void convertSRGBToLinearAVX2(const uint8_t* source, float* destination, size_t pixelCount)
+{
+	const float* table = getSRGBToLinearTable();
+	const __m256i alphaOffset = _mm256_setr_epi32(0, 0, 0, 256, 0, 0, 0, 256);							// Alpha lanes read the second half of the table
+
+	size_t i = 0;
+
+	// 2 pixels per step, one gather per 8 channels
+	for (; i + 2 <= pixelCount; i += 2)
+	{
+		__m256i indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(source + i * 4)));
+		__m256 values = _mm256_i32gather_ps(table, _mm256_add_epi32(indices, alphaOffset), 4);
+
+		_mm256_storeu_ps(destination + i * 4, values);
+	}
+
+	convertSRGBToLinearScalar(source + i * 4, destination + i * 4, pixelCount - i);
+}
+
+void convertSRGBToLinear(const uint8_t* source, float* destination, size_t pixelCount)
+{
+	// Lookups need a gather, which SSE2 lacks
+	if (activeSimdLevel == SimdLevel::AVX2)
+	{
+		convertSRGBToLinearAVX2(source, destination, pixelCount);
+	}
+
+	else
+	{
+		convertSRGBToLinearScalar(source, destination, pixelCount);
+	}
+}
+
+// -- Linear to sRGB --
+
+static void convertLinearToSRGBScalar(const float* source, uint8_t* destination, size_t pixelCount)
+{
+	const int32_t* table = getLinearToSRGBTable();
+
+	for (size_t i = 0; i < pixelCount * 4; i++)
+	{
+		bool alpha = (i & 3) == 3;
+		int32_t quantized = quantizeLinear(source[i], alpha);
+
+		destination[i] = (uint8_t)(alpha ? quantized : table[quantized]);
+	}
+}
+
+static void convertLinearToSRGBSSE2(const float* source, uint8_t* destination, size_t pixelCount)
+{
+	const int32_t* table = getLinearToSRGBTable();
+	const __m128 scale = _mm_setr_ps(LINEAR_TO_SRGB_STEPS - 1, LINEAR_TO_SRGB_STEPS - 1, LINEAR_TO_SRGB_STEPS - 1, 255.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+
+	// Clamp, scale and round one pixel at a time in SIMD, then look colour up in the table
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		__m128 values = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(source + i * 4), _mm_setzero_ps()), _mm_set1_ps(1.0f));
+		__m128i quantized = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(values, scale), half));
+
+		alignas(16) int32_t indices[4];
+		_mm_store_si128((__m128i*)indices, quantized);
+
+		destination[i * 4 + 0] = (uint8_t)table[indices[0]];
+		destination[i * 4 + 1] = (uint8_t)table[indices[1]];
+		destination[i * 4 + 2] = (uint8_t)table[indices[2]];
+		destination[i * 4 + 3] = (uint8_t)indices[3];
+	}
+}
+
+TARGET_AVX2 static void convertLinearToSRGBAVX2(const float* source, uint8_t* destination, size_t pixelCount)
+{
+	const int32_t* table = getLinearToSRGBTable();
+	const __m256 scale = _mm256_setr_ps(LINEAR_TO_SRGB_STEPS - 1, LINEAR_TO_SRGB_STEPS - 1, LINEAR_TO_SRGB_STEPS - 1, 255.0f,
+										LINEAR_TO_SRGB_STEPS - 1, LINEAR_TO_SRGB_STEPS - 1, LINEAR_TO_SRGB_STEPS - 1, 255.0f);
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256i alphaLanes = _mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1);
+
+	size_t i = 0;
+
+	// 2 pixels per step, gathering colour from the table and keeping alpha as computed
+	for (; i + 2 <= pixelCount; i += 2)
+	{
+		__m256 values = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(source + i * 4), _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+		__m256i quantized = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(values, scale), half));
+		__m256i encoded = _mm256_blendv_epi8(_mm256_i32gather_epi32((const int*)table, quantized, 4), quantized, alphaLanes);
+
+		// Narrow 8 x 32-bit down to 8 bytes (packs work per 128-bit lane, so join the two lanes at the end)
+		__m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(encoded, encoded), _mm256_setzero_si256());
+		__m128i bytes = _mm_unpacklo_epi32(_mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1));
+
+		_mm_storel_epi64((__m128i*)(destination + i * 4), bytes);
+	}
+
+	convertLinearToSRGBScalar(source + i * 4, destination + i * 4, pixelCount - i);
+}
+
+void convertLinearToSRGB(const float* source, uint8_t* destination, size_t pixelCount)
+{
+	switch (activeSimdLevel)
+	{
+	case SimdLevel::AVX2:
+		convertLinearToSRGBAVX2(source, destination, pixelCount);
+		break;
+	case SimdLevel::SSE2:
+		convertLinearToSRGBSSE2(source, destination, pixelCount);
+		break;
+	default:
+		convertLinearToSRGBScalar(source, destination, pixelCount);
+		break;
+	}
+}
+
+// -- Channel Reduction --
+
+// Channel usage of a 32-bit RGBA texel: bits 0-15 are non-zero when colour is not grey, top byte is 0xFF when opaque
+const uint32_t GREY_DIFFERENCE_MASK = 0x0000FFFF;
+const uint32_t ALPHA_MASK = 0xFF000000;
+
+static uint32_t getChannelCount(bool grey, bool opaque)
+{
+	if (!grey)
+	{
+		return 4;
+	}
+
+	return opaque ? 1 : 2;
+}
+
+static void accumulateChannelUsageScalar(const uint8_t* pixels, size_t pixelCount, uint32_t& greyDifference, uint32_t& alpha)
+{
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		uint32_t texel;
+		memcpy(&texel, pixels + i * 4, 4);
+
+		// Red ^ green in byte 0 and green ^ blue in byte 1
+		greyDifference |= (texel ^ (texel >> 8)) & GREY_DIFFERENCE_MASK;
+		alpha &= texel;
+	}
+}
+
+static uint32_t countUsedChannelsScalar(const uint8_t* pixels, size_t pixelCount)
+{
+	uint32_t greyDifference = 0;
+	uint32_t alpha = ALPHA_MASK;
+
+	accumulateChannelUsageScalar(pixels, pixelCount, greyDifference, alpha);
+
+	return getChannelCount(greyDifference == 0, (alpha & ALPHA_MASK) == ALPHA_MASK);
+}
+
+static uint32_t countUsedChannelsSSE2(const uint8_t* pixels, size_t pixelCount)
+{
+	__m128i greyDifference = _mm_setzero_si128();
+	__m128i alpha = _mm_set1_epi32((int)ALPHA_MASK);
+	const __m128i greyMask = _mm_set1_epi32((int)GREY_DIFFERENCE_MASK);
+
+	size_t i = 0;
+
+	for (; i + 4 <= pixelCount; i += 4)
+	{
+		__m128i texels = _mm_loadu_si128((const __m128i*)(pixels + i * 4));
+
+		greyDifference = _mm_or_si128(greyDifference, _mm_and_si128(_mm_xor_si128(texels, _mm_srli_epi32(texels, 8)), greyMask));
+		alpha = _mm_and_si128(alpha, texels);
+	}
+
+	// Fold lanes together and finish the tail
+	alignas(16) uint32_t greyLanes[4];
+	alignas(16) uint32_t alphaLanes[4];
+	_mm_store_si128((__m128i*)greyLanes, greyDifference);
+	_mm_store_si128((__m128i*)alphaLanes, alpha);
+
+	uint32_t greyTotal = greyLanes[0] | greyLanes[1] | greyLanes[2] | greyLanes[3];
+	uint32_t alphaTotal = alphaLanes[0] & alphaLanes[1] & alphaLanes[2] & alphaLanes[3];
+	accumulateChannelUsageScalar(pixels + i * 4, pixelCount - i, greyTotal, alphaTotal);
+
+	return getChannelCount(greyTotal == 0, (alphaTotal & ALPHA_MASK) == ALPHA_MASK);
+}
+
+TARGET_AVX2 static uint32_t countUsedChannelsAVX2(const uint8_t* pixels, size_t pixelCount)
+{
+	__m256i greyDifference = _mm256_setzero_si256();
+	__m256i alpha = _mm256_set1_epi32((int)ALPHA_MASK);
+	const __m256i greyMask = _mm256_set1_epi32((int)GREY_DIFFERENCE_MASK);
+
+	size_t i = 0;
+
+	for (; i + 8 <= pixelCount; i += 8)
+	{
+		__m256i texels = _mm256_loadu_si256((const __m256i*)(pixels + i * 4));
+
+		greyDifference = _mm256_or_si256(greyDifference, _mm256_and_si256(_mm256_xor_si256(texels, _mm256_srli_epi32(texels, 8)), greyMask));
+		alpha = _mm256_and_si256(alpha, texels);
+	}
+
+	// Fold lanes together and finish the tail
+	alignas(32) uint32_t greyLanes[8];
+	alignas(32) uint32_t alphaLanes[8];
+	_mm256_store_si256((__m256i*)greyLanes, greyDifference);
+	_mm256_store_si256((__m256i*)alphaLanes, alpha);
+
+	uint32_t greyTotal = 0;
+	uint32_t alphaTotal = ALPHA_MASK;
+
+	for (int lane = 0; lane < 8; lane++)
+	{
+		greyTotal |= greyLanes[lane];
+		alphaTotal &= alphaLanes[lane];
+	}
+
+	accumulateChannelUsageScalar(pixels + i * 4, pixelCount - i, greyTotal, alphaTotal);
+
+	return getChannelCount(greyTotal == 0, (alphaTotal & ALPHA_MASK) == ALPHA_MASK);
+}
+
+uint32_t countUsedChannels(const uint8_t* pixels, size_t pixelCount)
+{
+	switch (activeSimdLevel)
+	{
+	case SimdLevel::AVX2:
+		return countUsedChannelsAVX2(pixels, pixelCount);
+	case SimdLevel::SSE2:
+		return countUsedChannelsSSE2(pixels, pixelCount);
+	default:
+		return countUsedChannelsScalar(pixels, pixelCount);
+	}
+}
+
+void reduceChannels(const uint8_t* source, size_t pixelCount, uint32_t channels, uint8_t* destination)
+{
+	// Runs once per texture on level 0 only, so a plain loop is enough
+	if (channels == 4)
+	{
+		memcpy(destination, source, pixelCount * 4);
+		return;
+	}
+
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		destination[i * channels] = source[i * 4];
+
+		if (channels == 2)
+		{
+			destination[i * 2 + 1] = source[i * 4 + 3];
+		}
+	}
+}
+
+// -- 2x2 Box Downsample --
+
+void downsampleBox2x2(const uint8_t* source, uint32_t sourceWidth, uint32_t sourceHeight, uint8_t* destination)
+{
+	uint32_t destinationWidth = std::max(1u, sourceWidth / 2);
+	uint32_t destinationHeight = std::max(1u, sourceHeight / 2);
+
+	// One destination row at a time, so only two source rows are ever held as linear floats (the conversions carry the SIMD paths)
+	std::vector<float> row0((size_t)sourceWidth * 4);
+	std::vector<float> row1((size_t)sourceWidth * 4);
+	std::vector<float> average((size_t)destinationWidth * 4);
+
+	for (uint32_t y = 0; y < destinationHeight; y++)
+	{
+		// Clamp second row so 1-texel-high sources reuse the same row
+		convertSRGBToLinear(source + (size_t)std::min(y * 2, sourceHeight - 1) * sourceWidth * 4, row0.data(), sourceWidth);
+		convertSRGBToLinear(source + (size_t)std::min(y * 2 + 1, sourceHeight - 1) * sourceWidth * 4, row1.data(), sourceWidth);
+
+		for (uint32_t x = 0; x < destinationWidth; x++)
+		{
+			// Clamp second column so 1-texel-wide sources reuse the same texel
+			size_t x0 = (size_t)std::min(x * 2, sourceWidth - 1) * 4;
+			size_t x1 = (size_t)std::min(x * 2 + 1, sourceWidth - 1) * 4;
+
+			for (size_t c = 0; c < 4; c++)
+			{
+				average[(size_t)x * 4 + c] = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]) * 0.25f;
+			}
+		}
+
+		convertLinearToSRGB(average.data(), destination + (size_t)y * destinationWidth * 4, destinationWidth);
+	}
+}
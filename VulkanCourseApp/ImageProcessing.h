@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// CPU-side image kernels used while loading textures
+// All images are tightly packed RGBA8 unless stated otherwise
+// Kernels have SSE2 and AVX2 paths wherever they pay off, producing results identical to the scalar path, picked at runtime from what the CPU supports
+
+enum class SimdLevel
+{
+	Scalar,
+	SSE2,
+	AVX2
+};
+
+// Best instruction set available on this CPU
+SimdLevel getSupportedSimdLevel();
+
+// Level the kernels currently use, lowered by the benchmark to time the slower paths (clamped to what is supported)
+SimdLevel getImageProcessingSimdLevel();
+void setImageProcessingSimdLevel(SimdLevel level);
+
+// Add an opaque alpha channel to tightly packed RGB8 pixels
+void expandRGBToRGBA(const uint8_t* source, uint8_t* destination, size_t pixelCount);
+
+// Decode sRGB colour channels to linear floats in [0, 1] (alpha is already linear and is only rescaled)
+void convertSRGBToLinear(const uint8_t* source, float* destination, size_t pixelCount);
+
+// Encode linear RGBA floats back to sRGB8, clamping to [0, 1]
+void convertLinearToSRGB(const float* source, uint8_t* destination, size_t pixelCount);
+
+// Number of channels the image really needs: 1 (grey, opaque), 2 (grey with alpha) or 4
+uint32_t countUsedChannels(const uint8_t* pixels, size_t pixelCount);
+
+// Pack RGBA8 down to 1 (R) or 2 (R, A) channels per texel, or copy as is for 4
+void reduceChannels(const uint8_t* source, size_t pixelCount, uint32_t channels, uint8_t* destination);
+
+// Halve an sRGB image in each dimension (never below 1 texel) by averaging 2x2 blocks in linear space, so coarser levels keep its brightness
+// Destination must hold max(1, width / 2) * max(1, height / 2) texels
+void downsampleBox2x2(const uint8_t* source, uint32_t sourceWidth, uint32_t sourceHeight, uint8_t* destination);
\ No newline at end of file
@@ -0,0 +1,236 @@
+#include "InstanceBvh.h"
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+#ifdef TRANSFORM_MATH_SSE
+#include <emmintrin.h>
+#endif
+
+void prepareCullingFrustum(const glm::vec4 planes[6], CullingFrustum& frustum)
+{
+	for (size_t i = 0; i < 8; i++)
+	{
+		// Padding repeats the last plane, so it never changes the result
+		const glm::vec4& plane = planes[std::min<size_t>(i, 5)];
+
+		frustum.normalX[i] = plane.x;
+		frustum.normalY[i] = plane.y;
+		frustum.normalZ[i] = plane.z;
+		frustum.distance[i] = plane.w;
+	}
+}
+
+BoxVisibility classifyBox(const CullingFrustum& frustum, glm::vec3 boundsMin, glm::vec3 boundsMax)
+{
+	// Against each plane, the box's center distance plus or minus its extent projected onto the plane's normal
+	// gives the distances of its nearest and farthest corners (outside if the farthest is behind any plane)
+	glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+	glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+
+#ifdef TRANSFORM_MATH_SSE
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	__m128 centerX = _mm_set1_ps(center.x), centerY = _mm_set1_ps(center.y), centerZ = _mm_set1_ps(center.z);
+	__m128 extentX = _mm_set1_ps(extent.x), extentY = _mm_set1_ps(extent.y), extentZ = _mm_set1_ps(extent.z);
+	__m128 outside = _mm_setzero_ps();
+	__m128 intersecting = _mm_setzero_ps();
+
+	for (size_t i = 0; i < 8; i += 4)
+	{
+		__m128 normalX = _mm_load_ps(frustum.normalX + i);
+		__m128 normalY = _mm_load_ps(frustum.normalY + i);
+		__m128 normalZ = _mm_load_ps(frustum.normalZ + i);
+
+		__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX, centerX), _mm_mul_ps(normalY, centerY)), _mm_add_ps(_mm_mul_ps(normalZ, centerZ), _mm_load_ps(frustum.distance + i)));
+		__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, normalX), extentX), _mm_mul_ps(_mm_andnot_ps(signMask, normalY), extentY)), _mm_mul_ps(_mm_andnot_ps(signMask, normalZ), extentZ));
+
+		outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+		intersecting = _mm_or_ps(intersecting, _mm_cmplt_ps(_mm_sub_ps(distance, radius), _mm_setzero_ps()));
+	}
+
+	if (_mm_movemask_ps(outside))
+	{
+		return BoxVisibility::Outside;
+	}
+
+	return _mm_movemask_ps(intersecting) ? BoxVisibility::Intersecting : BoxVisibility::Inside;
+#else
+	BoxVisibility visibility = BoxVisibility::Inside;
+
+	for (size_t i = 0; i < 6; i++)
+	{
+		float distance = frustum.normalX[i] * center.x + frustum.normalY[i] * center.y + frustum.normalZ[i] * center.z + frustum.distance[i];
+		float radius = std::abs(frustum.normalX[i]) * extent.x + std::abs(frustum.normalY[i]) * extent.y + std::abs(frustum.normalZ[i]) * extent.z;
+
+		if (distance + radius < 0.0f)
+		{
+			return BoxVisibility::Outside;
+		}
+
+		if (distance - radius < 0.0f)
+		{
+			visibility = BoxVisibility::Intersecting;
+		}
+	}
+
+	return visibility;
+#endif
+}
+
+void transformBoundingBox(const glm::mat4& transform, glm::vec3 boundsMin, glm::vec3 boundsMax, glm::vec3& transformedMin, glm::vec3& transformedMax)
+{
+	// The new extent along each axis sums the old extents scaled by the absolute matrix (Arvo's method)
+	glm::vec3 center = glm::vec3(transform * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+	glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+	glm::vec3 transformedExtent = glm::abs(glm::vec3(transform[0])) * extent.x + glm::abs(glm::vec3(transform[1])) * extent.y + glm::abs(glm::vec3(transform[2])) * extent.z;
+
+	transformedMin = center - transformedExtent;
+	transformedMax = center + transformedExtent;
+}
+
+void InstanceBvh::build(const glm::vec3* boundsMin, const glm::vec3* boundsMax, size_t instanceCount)
+{
+	nodes.clear();
+	instanceOrder.resize(instanceCount);
+
+	for (size_t i = 0; i < instanceCount; i++)
+	{
+		instanceOrder[i] = static_cast<uint32_t>(i);
+	}
+
+	if (instanceCount == 0)
+	{
+		return;
+	}
+
+	nodes.reserve(instanceCount * 2);
+	nodes.push_back({ glm::vec3(0.0f), 0, glm::vec3(0.0f), static_cast<uint32_t>(instanceCount), 0 });
+
+	// Split nodes in creation order, so every node is created (and stored) before its children
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		uint32_t first = nodes[i].firstInstance;
+		uint32_t count = nodes[i].instanceCount;
+
+		if (count <= INSTANCE_BVH_LEAF_SIZE)
+		{
+			continue;
+		}
+
+		// Median split along the longest axis of the instances' centers
+		glm::vec3 centerMin(std::numeric_limits<float>::max());
+		glm::vec3 centerMax(-std::numeric_limits<float>::max());
+
+		for (uint32_t j = first; j < first + count; j++)
+		{
+			glm::vec3 center = boundsMin[instanceOrder[j]] + boundsMax[instanceOrder[j]];
+			centerMin = glm::min(centerMin, center);
+			centerMax = glm::max(centerMax, center);
+		}
+
+		glm::vec3 size = centerMax - centerMin;
+		int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+		uint32_t half = count / 2;
+
+		std::nth_element(instanceOrder.begin() + first, instanceOrder.begin() + first + half, instanceOrder.begin() + first + count, [&](uint32_t a, uint32_t b)
+		{
+			return boundsMin[a][axis] + boundsMax[a][axis] < boundsMin[b][axis] + boundsMax[b][axis];
+		});
+
+		nodes[i].firstChild = static_cast<uint32_t>(nodes.size());
+		nodes.push_back({ glm::vec3(0.0f), first, glm::vec3(0.0f), half, 0 });
+		nodes.push_back({ glm::vec3(0.0f), first + half, glm::vec3(0.0f), count - half, 0 });
+	}
+
+	refit(boundsMin, boundsMax);
+}
+
+void InstanceBvh::refit(const glm::vec3* boundsMin, const glm::vec3* boundsMax)
+{
+	// Children come after their parents, so a backward pass sees every child before its parent
+	for (size_t i = nodes.size(); i-- > 0; )
+	{
+		Node& node = nodes[i];
+
+		if (node.firstChild != 0)
+		{
+			node.boundsMin = glm::min(nodes[node.firstChild].boundsMin, nodes[node.firstChild + 1].boundsMin);
+			node.boundsMax = glm::max(nodes[node.firstChild].boundsMax, nodes[node.firstChild + 1].boundsMax);
+			continue;
+		}
+
+		node.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+		node.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+
+		for (uint32_t j = node.firstInstance; j < node.firstInstance + node.instanceCount; j++)
+		{
+			node.boundsMin = glm::min(node.boundsMin, boundsMin[instanceOrder[j]]);
+			node.boundsMax = glm::max(node.boundsMax, boundsMax[instanceOrder[j]]);
+		}
+	}
+}
+
+size_t InstanceBvh::cull(const CullingFrustum& frustum, const glm::vec3* boundsMin, const glm::vec3* boundsMax, std::vector<uint8_t>& visibility) const
+{
+	visibility.assign(instanceOrder.size(), 0);
+
+	if (nodes.empty())
+	{
+		return 0;
+	}
+
+	size_t visibleCount = 0;
+	uint32_t stack[64];
+	size_t stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		const Node& node = nodes[stack[--stackSize]];
+		BoxVisibility nodeVisibility = classifyBox(frustum, node.boundsMin, node.boundsMax);
+
+		if (nodeVisibility == BoxVisibility::Outside)
+		{
+			continue;
+		}
+
+		// Wholly inside, everything beneath is visible
+		if (nodeVisibility == BoxVisibility::Inside)
+		{
+			for (uint32_t j = node.firstInstance; j < node.firstInstance + node.instanceCount; j++)
+			{
+				visibility[instanceOrder[j]] = 1;
+			}
+
+			visibleCount += node.instanceCount;
+			continue;
+		}
+
+		if (node.firstChild != 0)
+		{
+			stack[stackSize++] = node.firstChild + 1;
+			stack[stackSize++] = node.firstChild;
+			continue;
+		}
+
+		// Leaf straddling the frustum, test its instances one by one
+		for (uint32_t j = node.firstInstance; j < node.firstInstance + node.instanceCount; j++)
+		{
+			uint32_t instance = instanceOrder[j];
+
+			if (classifyBox(frustum, boundsMin[instance], boundsMax[instance]) != BoxVisibility::Outside)
+			{
+				visibility[instance] = 1;
+				visibleCount++;
+			}
+		}
+	}
+
+	return visibleCount;
+}
+
+size_t InstanceBvh::getInstanceCount() const
+{
+	return instanceOrder.size();
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "TransformMath.h"
+
+// Bounding volume hierarchy over the world space boxes of every drawn instance, culled against the view frustum each frame
+// The tree is built once over the instances, then refit (its boxes recomputed bottom up, keeping its shape) whenever they move
+// Every node covers a contiguous run of the instance order, so a node wholly inside the frustum is accepted without visiting its children
+
+const uint32_t INSTANCE_BVH_LEAF_SIZE = 4;															// Most instances a leaf holds
+
+// Where a box lies relative to a frustum
+enum class BoxVisibility
+{
+	Outside,
+	Intersecting,
+	Inside
+};
+
+// Frustum planes with each component in its own array, padded to eight planes so they test four at a time
+struct CullingFrustum
+{
+	alignas(16) float normalX[8];
+	alignas(16) float normalY[8];
+	alignas(16) float normalZ[8];
+	alignas(16) float distance[8];
+};
+
+// Planes as given by calculateFrustumPlanes
+void prepareCullingFrustum(const glm::vec4 planes[6], CullingFrustum& frustum);
+BoxVisibility classifyBox(const CullingFrustum& frustum, glm::vec3 boundsMin, glm::vec3 boundsMax);
+
+// Box around a box transformed by an affine matrix
+void transformBoundingBox(const glm::mat4& transform, glm::vec3 boundsMin, glm::vec3 boundsMax, glm::vec3& transformedMin, glm::vec3& transformedMax);
+
+class InstanceBvh
+{
+public:
+
+	// Build the tree over instanceCount boxes, splitting each node at the median of its longest axis
+	void build(const glm::vec3* boundsMin, const glm::vec3* boundsMax, size_t instanceCount);
+
+	// Recompute the tree's boxes from the instances' new boxes (same instances as the last build)
+	void refit(const glm::vec3* boundsMin, const glm::vec3* boundsMax);
+
+	// Flag each instance visible (1) or not (0) and return how many are visible
+	size_t cull(const CullingFrustum& frustum, const glm::vec3* boundsMin, const glm::vec3* boundsMax, std::vector<uint8_t>& visibility) const;
+
+	size_t getInstanceCount() const;
+
+private:
+	struct Node
+	{
+		glm::vec3 boundsMin;
+		uint32_t firstInstance;																		// Within instanceOrder
+		glm::vec3 boundsMax;
+		uint32_t instanceCount;
+		uint32_t firstChild;																		// Children are firstChild and firstChild + 1 (0 for a leaf, as the root is no one's child)
+	};
+
+	std::vector<Node> nodes;																		// Parents before their children
+	std::vector<uint32_t> instanceOrder;															// Instances grouped by node
+
+};
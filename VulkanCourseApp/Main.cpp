@@ -7,10 +7,12 @@
 
 #include <glm/glm.hpp>
 #include <glm/mat4x4.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 #include <iostream>
 
 #include "VulkanRenderer.h"
+#include "Benchmark.h"
 
 #include "CommonValues.h"
 
@@ -29,11 +31,25 @@ void initWindow(std::string windowName = "Test Window")
 	mainWindow = glfwCreateWindow(WIDTH, HEIGHT, windowName.c_str(), nullptr, nullptr);
 }
 
-int main()
+int main(int argc, char** argv)
 {
+	// Run micro-benchmarks instead of the renderer when asked
+	if (argc > 1 && std::string(argv[1]) == "--benchmark")
+	{
+		runImageProcessingBenchmark();
+		runJobSystemBenchmark();
+		return 0;
+	}
+
 	// Create Window
 	initWindow("Test Window");
 
+	// Skip draws hidden behind others, tested on the GPU against last frame's visible geometry
+	vulkanRenderer.setOcclusionCulling(true);
+
+	// Also skip meshes hidden behind the largest ones on screen, tested on the CPU before any draws are written
+	vulkanRenderer.setSoftwareOcclusionCulling(true);
+
 	// Create Vulkan Renderer Instance
 	if (vulkanRenderer.init(mainWindow) == EXIT_FAILURE)
 	{
@@ -43,8 +59,10 @@ int main()
 	float angle = 0.0f;
 	float deltaTime = 0.0f;
 	float lastTime = 0.0f;
+	float lastStatsTime = 0.0f;
+	bool mouseWasPressed = false;
 
-	int helicopter = vulkanRenderer.createModel("Models/uh60.obj");
+	int helicopter = vulkanRenderer.createModel("Models/uh60.obj", true, true);
 
 	// Loop until closed
 	while (!glfwWindowShouldClose(mainWindow))
@@ -61,11 +79,40 @@ int main()
 			angle -= 360.0f;
 		}
 
-		glm::mat4 testMatrix = glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
-		testMatrix = glm::rotate(testMatrix, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-		vulkanRenderer.updateModel(helicopter, testMatrix);
+		glm::quat testRotation = glm::angleAxis(glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
+		testRotation = testRotation * glm::angleAxis(glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+		vulkanRenderer.updateModel(helicopter, glm::vec3(0.0f), testRotation, glm::vec3(1.0f));
 
 		vulkanRenderer.draw();
+
+		// Report the mesh under the cursor when the left button is clicked
+		bool mousePressed = glfwGetMouseButton(mainWindow, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+
+		if (mousePressed && !mouseWasPressed)
+		{
+			double cursorX, cursorY;
+			glfwGetCursorPos(mainWindow, &cursorX, &cursorY);
+
+			RaycastHit hit;
+
+			if (vulkanRenderer.pick(static_cast<float>(cursorX), static_cast<float>(cursorY), hit))
+			{
+				std::cout << "Picked model " << hit.modelId << ", mesh " << hit.mesh << ", triangle " << hit.triangle << std::endl;
+			}
+		}
+
+		mouseWasPressed = mousePressed;
+
+		// Show how many meshes culling skipped, once a second
+		if (now - lastStatsTime >= 1.0f)
+		{
+			CullingStats cullingStats = vulkanRenderer.getCullingStats();
+			std::string title = "Test Window - " + std::to_string(cullingStats.frustumCulledCount) + " of " + std::to_string(cullingStats.meshCount) + " meshes frustum culled, "
+				+ std::to_string(cullingStats.occlusionCulledCount) + " occluded by " + std::to_string(cullingStats.occluderCount)
+				+ " (" + std::to_string(cullingStats.occluderMilliseconds) + " + " + std::to_string(cullingStats.occludeeMilliseconds) + " ms)";
+			glfwSetWindowTitle(mainWindow, title.c_str());
+			lastStatsTime = now;
+		}
 	}
 
 	vulkanRenderer.cleanup();
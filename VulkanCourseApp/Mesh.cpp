@@ -1,28 +1,65 @@
 #include "Mesh.h"
 
+#include <algorithm>
+
 Mesh::Mesh()
 {
 
 }
 
 Mesh::Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newLogicalDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<Vertex>* vertices, std::vector<uint32_t>* indices, int newTextureID)
+	: Mesh(newPhysicalDevice, newLogicalDevice, transferQueue, transferCommandPool, vertices->data(), vertices->size(), indices->data(), indices->size(), newTextureID, false)
+{
+
+}
+
+Mesh::Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newLogicalDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, const Vertex* vertices, size_t newVertexCount, const uint32_t* indices, size_t newIndexCount, int newTextureID, bool indexTypeUint8)
+{
+	physicalDevice = newPhysicalDevice;
+	logicalDevice = newLogicalDevice;
+	vertexCount = static_cast<int>(newVertexCount);
+	indexCount = static_cast<int>(newIndexCount);
+	node = 0;
+	textureID = newTextureID;
+	textureScale = 1.0f;
+	boundingSphere = glm::vec4(0.0f);
+	boundsMin = glm::vec3(0.0f);
+	boundsMax = glm::vec3(0.0f);
+	lods[0] = { 0, static_cast<uint32_t>(newIndexCount), 0.0f };
+	lodCount = 1;
+	currentLod = 0;
+
+	createVertexBuffer(transferQueue, transferCommandPool, vertices, sizeof(Vertex));
+	createIndexBuffer(transferQueue, transferCommandPool, indices, indexTypeUint8);
+
+}
+
+Mesh::Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newLogicalDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, const CompactVertex* vertices, size_t newVertexCount, const uint32_t* indices, size_t newIndexCount, int newTextureID, const VertexQuantization& newVertexQuantization, bool indexTypeUint8)
 {
 	physicalDevice = newPhysicalDevice;
 	logicalDevice = newLogicalDevice;
-	vertexCount = vertices->size();
-	indexCount = indices->size();
-	model.model = glm::mat4(1.0f);
+	vertexCount = static_cast<int>(newVertexCount);
+	indexCount = static_cast<int>(newIndexCount);
+	node = 0;
 	textureID = newTextureID;
+	textureScale = 1.0f;
+	boundingSphere = glm::vec4(0.0f);
+	boundsMin = glm::vec3(0.0f);
+	boundsMax = glm::vec3(0.0f);
+	lods[0] = { 0, static_cast<uint32_t>(newIndexCount), 0.0f };
+	lodCount = 1;
+	currentLod = 0;
+	vertexQuantization = newVertexQuantization;
 
-	createVertexBuffer(transferQueue, transferCommandPool, vertices);
-	createIndexBuffer(transferQueue, transferCommandPool, indices);
+	createVertexBuffer(transferQueue, transferCommandPool, vertices, sizeof(CompactVertex));
+	createIndexBuffer(transferQueue, transferCommandPool, indices, indexTypeUint8);
 
 }
 
-void Mesh::createVertexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<Vertex>* vertices)
+void Mesh::createVertexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, const void* vertices, VkDeviceSize vertexSize)
 {
 	// Get size of buffer needed for vertices
-	VkDeviceSize bufferSize = sizeof(Vertex) * vertices->size();
+	VkDeviceSize bufferSize = vertexSize * vertexCount;
 
 	// Temporary buffer to stage vertex data before transferring to GPU
 	VkBuffer stagingBuffer;
@@ -36,7 +73,7 @@ void Mesh::createVertexBuffer(VkQueue transferQueue, VkCommandPool transferComma
 	// Map memory to vertex buffer
 	void* data;																						// Create pointer to a point in normal memory
 	vkMapMemory(logicalDevice, stagingBufferMemory, 0, bufferSize, 0, &data);						// Map the vertex buffer memory to the data pointer
-	memcpy(data, vertices->data(), (size_t)bufferSize);												// Copy memory from vertices vector to the data pointer
+	memcpy(data, vertices, (size_t)bufferSize);														// Copy memory from vertices to the data pointer
 	vkUnmapMemory(logicalDevice, stagingBufferMemory);												// Unmap the vertex buffer memory
 
 	// Create buffer with TRANSFER_DST_BIT to mark as recipient of transfer data
@@ -53,9 +90,27 @@ void Mesh::createVertexBuffer(VkQueue transferQueue, VkCommandPool transferComma
 	vkFreeMemory(logicalDevice, stagingBufferMemory, nullptr);
 }
 
-void Mesh::createIndexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<uint32_t>* indices)
+void Mesh::createIndexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, const uint32_t* indices, bool indexTypeUint8)
 {
-	VkDeviceSize bufferSize = sizeof(uint32_t) * indices->size();
+	// Use the smallest index type that can address every vertex (UINT8 only where VK_EXT_index_type_uint8 is enabled)
+	VkDeviceSize indexSize;
+	if (indexTypeUint8 && vertexCount <= 256)
+	{
+		indexType = VK_INDEX_TYPE_UINT8_EXT;
+		indexSize = sizeof(uint8_t);
+	}
+	else if (vertexCount <= 65536)
+	{
+		indexType = VK_INDEX_TYPE_UINT16;
+		indexSize = sizeof(uint16_t);
+	}
+	else
+	{
+		indexType = VK_INDEX_TYPE_UINT32;
+		indexSize = sizeof(uint32_t);
+	}
+
+	VkDeviceSize bufferSize = indexSize * indexCount;
 
 	// Temporary buffer to stage index data before transferring to GPU
 	VkBuffer stagingBuffer;
@@ -69,7 +124,26 @@ void Mesh::createIndexBuffer(VkQueue transferQueue, VkCommandPool transferComman
 	// Map memory to index buffer
 	void* data;																						// Create pointer to a point in normal memory
 	vkMapMemory(logicalDevice, stagingBufferMemory, 0, bufferSize, 0, &data);						// Map the index buffer memory to the data pointer
-	memcpy(data, indices->data(), (size_t)bufferSize);												// Copy memory from indices vector to the data pointer
+	if (indexType == VK_INDEX_TYPE_UINT32)
+	{
+		memcpy(data, indices, (size_t)bufferSize);													// Copy memory from indices to the data pointer
+	}
+	else if (indexType == VK_INDEX_TYPE_UINT16)
+	{
+		uint16_t* narrowIndices = static_cast<uint16_t*>(data);										// Narrow each index while copying
+		for (int i = 0; i < indexCount; i++)
+		{
+			narrowIndices[i] = static_cast<uint16_t>(indices[i]);
+		}
+	}
+	else
+	{
+		uint8_t* narrowIndices = static_cast<uint8_t*>(data);
+		for (int i = 0; i < indexCount; i++)
+		{
+			narrowIndices[i] = static_cast<uint8_t>(indices[i]);
+		}
+	}
 	vkUnmapMemory(logicalDevice, stagingBufferMemory);												// Unmap the index buffer memory
 
 	// Create buffer with TRANSFER_DST_BIT to mark as recipient of transfer data
@@ -112,20 +186,25 @@ VkBuffer Mesh::getIndexBuffer()
 	return indexBuffer;
 }
 
+VkIndexType Mesh::getIndexType()
+{
+	return indexType;
+}
+
 void Mesh::destroyIndexBuffer()
 {
 	vkDestroyBuffer(logicalDevice, indexBuffer, nullptr);
 	vkFreeMemory(logicalDevice, indexBufferMemory, nullptr);
 }
 
-void Mesh::setModel(glm::mat4 newModel)
+void Mesh::setNode(uint32_t newNode)
 {
-	model.model = newModel;
+	node = newNode;
 }
 
-ModelTransformationMatrix Mesh::getModel()
+uint32_t Mesh::getNode()
 {
-	return model;
+	return node;
 }
 
 void Mesh::setTextureID(int newTextureID)
@@ -138,6 +217,145 @@ int Mesh::getTextureID()
 	return textureID;
 }
 
+void Mesh::setTextureScale(float newTextureScale)
+{
+	textureScale = newTextureScale;
+}
+
+float Mesh::getTextureScale()
+{
+	return textureScale;
+}
+
+void Mesh::setBoundingSphere(glm::vec4 newBoundingSphere)
+{
+	boundingSphere = newBoundingSphere;
+}
+
+glm::vec4 Mesh::getBoundingSphere()
+{
+	return boundingSphere;
+}
+
+void Mesh::setBoundingBox(glm::vec3 newBoundsMin, glm::vec3 newBoundsMax)
+{
+	boundsMin = newBoundsMin;
+	boundsMax = newBoundsMax;
+}
+
+glm::vec3 Mesh::getBoundsMin()
+{
+	return boundsMin;
+}
+
+glm::vec3 Mesh::getBoundsMax()
+{
+	return boundsMax;
+}
+
+VertexQuantization Mesh::getVertexQuantization()
+{
+	return vertexQuantization;
+}
+
+void Mesh::setLods(const MeshLod* newLods, uint32_t newLodCount)
+{
+	lodCount = std::min(newLodCount, MAX_MESH_LODS);
+	std::copy(newLods, newLods + lodCount, lods);
+	currentLod = 0;
+}
+
+uint32_t Mesh::getLodCount()
+{
+	return lodCount;
+}
+
+MeshLod Mesh::getLod(uint32_t lod)
+{
+	return lods[lod];
+}
+
+uint32_t Mesh::selectLod(float screenRadius)
+{
+	// Coarsest level whose error stays within MESH_LOD_PIXEL_ERROR on screen
+	uint32_t lod = 0;
+	while (lod + 1 < lodCount && lods[lod + 1].error * screenRadius <= MESH_LOD_PIXEL_ERROR)
+	{
+		lod++;
+	}
+
+	// Only coarsen once the error is clearly within the limit, so sizes near a level boundary don't flicker between levels
+	while (lod > currentLod && lods[lod].error * screenRadius > MESH_LOD_PIXEL_ERROR * (1.0f - MESH_LOD_HYSTERESIS))
+	{
+		lod--;
+	}
+
+	currentLod = lod;
+	return currentLod;
+}
+
+uint32_t Mesh::getCurrentLod()
+{
+	return currentLod;
+}
+
+void Mesh::setMeshlets(const Meshlet* newMeshlets, size_t newMeshletCount)
+{
+	meshlets.assign(newMeshlets, newMeshlets + newMeshletCount);
+}
+
+size_t Mesh::getMeshletCount()
+{
+	return meshlets.size();
+}
+
+const Meshlet* Mesh::getMeshlet(size_t index)
+{
+	return &meshlets[index];
+}
+
+void Mesh::setOccluder(const Vertex* vertices, const uint32_t* indices, size_t newIndexCount)
+{
+	// Renumber the vertices the triangles use, in the order they're first used
+	std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+
+	occluderPositions.clear();
+	occluderIndices.resize(newIndexCount);
+
+	for (size_t i = 0; i < newIndexCount; i++)
+	{
+		uint32_t& newIndex = remap[indices[i]];
+
+		if (newIndex == UINT32_MAX)
+		{
+			newIndex = static_cast<uint32_t>(occluderPositions.size());
+			occluderPositions.push_back(vertices[indices[i]].position);
+		}
+
+		occluderIndices[i] = newIndex;
+	}
+}
+
+const std::vector<glm::vec3>& Mesh::getOccluderPositions()
+{
+	return occluderPositions;
+}
+
+const std::vector<uint32_t>& Mesh::getOccluderIndices()
+{
+	return occluderIndices;
+}
+
+void Mesh::buildTriangleBvh(const Vertex* vertices, const uint32_t* indices, size_t newIndexCount)
+{
+	triangleBvh.build(&vertices[0].position, sizeof(Vertex), indices, newIndexCount);
+}
+
+const TriangleBvh& Mesh::getTriangleBvh()
+{
+	return triangleBvh;
+}
+
 Mesh::~Mesh() 
 {
 
@@ -6,9 +6,26 @@
 #include <vector>
 
 #include "Utilities.h"
+#include "VertexQuantization.h"
+#include "Meshlet.h"
+#include "TriangleBvh.h"
+
+// Per-draw push constant block (matches PushModel in shader.vert/shader.frag)
+struct PushModel {
+	glm::vec4 positionOffset;																		// Offset (xyz) and scale (xyz) decoding the mesh's positions
+	glm::vec4 positionScale;
+	glm::vec4 textureTransform;																		// Offset (xy) and scale (zw) decoding the mesh's UVs
+	uint32_t worldTransformIndex;																	// Scene node whose world matrix places the mesh
+	uint32_t textureID;																				// Index into the bindless texture array
+};
 
-struct ModelTransformationMatrix {
-	glm::mat4 model;
+// Level of detail, as a range of its mesh's index buffer (every level draws from the same vertices)
+struct MeshLod {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;																					// Simplification error relative to the bounding sphere's radius
+	uint32_t firstMeshlet;																			// Range of the mesh's meshlets covering this level (none if not clustered)
+	uint32_t meshletCount;
 };
 
 class Mesh
@@ -16,6 +33,12 @@ class Mesh
 public:
 	Mesh();
 	Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newLogicalDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<Vertex>* vertices, std::vector<uint32_t>* indices, int newTextureID);
+	Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newLogicalDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, const Vertex* vertices, size_t newVertexCount, const uint32_t* indices, size_t newIndexCount, int newTextureID, bool indexTypeUint8);
+	Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newLogicalDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, const CompactVertex* vertices, size_t newVertexCount, const uint32_t* indices, size_t newIndexCount, int newTextureID, const VertexQuantization& newVertexQuantization, bool indexTypeUint8);
+	Mesh(const Mesh&) = default;
+	Mesh(Mesh&&) = default;																			// Meshes are moved into their model (the buffers are handles, owned until destroyed explicitly)
+	Mesh& operator=(const Mesh&) = default;
+	Mesh& operator=(Mesh&&) = default;
 
 	int getVertexCount();
 	VkBuffer getVertexBuffer();
@@ -23,14 +46,50 @@ public:
 
 	int getIndexCount();
 	VkBuffer getIndexBuffer();
+	VkIndexType getIndexType();
 	void destroyIndexBuffer();
 
-	void setModel(glm::mat4 newModel);
-	ModelTransformationMatrix getModel();
+	// Scene node whose world matrix places the mesh
+	void setNode(uint32_t newNode);
+	uint32_t getNode();
 
 	void setTextureID(int newTextureID);
 	int getTextureID();
 
+	// Share of its texture's width or height (the larger) the mesh's UVs are mapped into, less than one for an atlas tile
+	void setTextureScale(float newTextureScale);
+	float getTextureScale();
+
+	void setBoundingSphere(glm::vec4 newBoundingSphere);
+	glm::vec4 getBoundingSphere();
+
+	void setBoundingBox(glm::vec3 newBoundsMin, glm::vec3 newBoundsMax);
+	glm::vec3 getBoundsMin();
+	glm::vec3 getBoundsMax();
+
+	VertexQuantization getVertexQuantization();
+
+	void setLods(const MeshLod* newLods, uint32_t newLodCount);
+	uint32_t getLodCount();
+	MeshLod getLod(uint32_t lod);
+
+	// Choose the level drawn from now on for a bounding sphere spanning screenRadius pixels, and return it
+	uint32_t selectLod(float screenRadius);
+	uint32_t getCurrentLod();
+
+	void setMeshlets(const Meshlet* newMeshlets, size_t newMeshletCount);
+	size_t getMeshletCount();
+	const Meshlet* getMeshlet(size_t index);
+
+	// Copy of a triangle list over the vertices kept on the CPU (only the positions it uses), drawn into the software occlusion buffer
+	void setOccluder(const Vertex* vertices, const uint32_t* indices, size_t newIndexCount);
+	const std::vector<glm::vec3>& getOccluderPositions();
+	const std::vector<uint32_t>& getOccluderIndices();
+
+	// Tree over a triangle list's positions for ray casts, built from the CPU copy of the vertices (triangle t of a hit is indices 3t to 3t + 2)
+	void buildTriangleBvh(const Vertex* vertices, const uint32_t* indices, size_t newIndexCount);
+	const TriangleBvh& getTriangleBvh();
+
 	~Mesh();
 
 private:
@@ -41,15 +100,32 @@ private:
 	int vertexCount;
 	VkBuffer vertexBuffer;
 	VkDeviceMemory vertexBufferMemory;
-	void createVertexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<Vertex>* vertices);
+	void createVertexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, const void* vertices, VkDeviceSize vertexSize);
 
 	int indexCount;
 	VkBuffer indexBuffer;
 	VkDeviceMemory indexBufferMemory;
-	void createIndexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, std::vector<uint32_t>* indices);
+	VkIndexType indexType;																			// Smallest type that can address every vertex
+	void createIndexBuffer(VkQueue transferQueue, VkCommandPool transferCommandPool, const uint32_t* indices, bool indexTypeUint8);
 
-	ModelTransformationMatrix model;
+	uint32_t node;
 	int textureID;
+	float textureScale;
+	glm::vec4 boundingSphere;																		// Center (xyz) and radius (w) in mesh space
+	glm::vec3 boundsMin;																			// Box around the mesh in mesh space
+	glm::vec3 boundsMax;
+	VertexQuantization vertexQuantization;															// Identity unless the vertices are compact
+
+	MeshLod lods[MAX_MESH_LODS];																	// Finest first, the first always being the whole mesh
+	uint32_t lodCount;
+	uint32_t currentLod;
+
+	std::vector<Meshlet> meshlets;																	// Every level's, each level's range given by its MeshLod
+
+	std::vector<glm::vec3> occluderPositions;
+	std::vector<uint32_t> occluderIndices;
+
+	TriangleBvh triangleBvh;
 
 };
 
@@ -0,0 +1,330 @@
+#include "MeshCache.h"
+
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <sys/stat.h>
+
+namespace
+{
+	const uint32_t MESH_CACHE_MAGIC = 0x4853454D;														// "MESH" in a little endian file
+	const uint64_t MESH_CACHE_BLOB_ALIGNMENT = 16;
+
+	struct MeshCacheHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vertexSize;																		// sizeof(Vertex) when written, catching layout changes
+		uint32_t importFlags;
+		uint32_t processing;																		// MESH_PROCESSING_ flags applied
+		uint32_t padding;
+		uint64_t sourceSize;
+		int64_t sourceModifiedTime;
+		uint32_t materialCount;
+		uint32_t meshCount;
+		uint32_t nodeCount;
+		uint32_t headerPadding;
+		uint64_t vertexCount;
+		uint64_t indexCount;
+		uint64_t meshletCount;
+		uint64_t materialsOffset;
+		uint64_t nodesOffset;
+		uint64_t meshesOffset;
+		uint64_t stringsOffset;
+		uint64_t stringsSize;
+		uint64_t verticesOffset;
+		uint64_t indicesOffset;
+		uint64_t meshletsOffset;
+	};
+
+	struct MeshCacheMaterial
+	{
+		uint32_t nameOffset;																		// Relative to the start of the strings
+		uint32_t nameLength;
+		uint32_t uvsInRange;
+		uint32_t padding;
+	};
+
+	struct MeshCacheNode
+	{
+		uint32_t parent;																			// Earlier node, or SCENE_NO_PARENT
+		float transform[16];																		// Column major, relative to the parent
+	};
+
+	struct MeshCacheMesh
+	{
+		uint32_t node;
+		uint32_t materialIndex;
+		uint32_t firstVertex;
+		uint32_t vertexCount;
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		float boundingSphere[4];
+		float boundsMin[3];
+		float boundsMax[3];
+		uint32_t lodCount;
+		MeshLod lods[MAX_MESH_LODS];
+		uint32_t firstMeshlet;
+		uint32_t meshletCount;
+	};
+
+	uint64_t alignOffset(uint64_t offset)
+	{
+		return (offset + MESH_CACHE_BLOB_ALIGNMENT - 1) & ~(MESH_CACHE_BLOB_ALIGNMENT - 1);
+	}
+
+	// Size and modification time of the source file, which a cache must match to be used
+	bool getSourceStamp(const std::string& sourceFile, uint64_t& size, int64_t& modifiedTime)
+	{
+#ifdef _WIN32
+		struct _stat64 fileStatus;
+		if (_stat64(sourceFile.c_str(), &fileStatus) != 0)
+		{
+			return false;
+		}
+#else
+		struct stat fileStatus;
+		if (stat(sourceFile.c_str(), &fileStatus) != 0)
+		{
+			return false;
+		}
+#endif
+
+		size = static_cast<uint64_t>(fileStatus.st_size);
+		modifiedTime = static_cast<int64_t>(fileStatus.st_mtime);
+		return true;
+	}
+
+	// Whether [offset, offset + size) lies within a file of fileSize bytes
+	bool isRangeInFile(uint64_t offset, uint64_t size, uint64_t fileSize)
+	{
+		return offset <= fileSize && size <= fileSize - offset;
+	}
+}
+
+bool readMeshCache(const std::string& cacheFile, const std::string& sourceFile, uint32_t processing, ModelData& modelData)
+{
+	uint64_t sourceSize;
+	int64_t sourceModifiedTime;
+
+	if (!getSourceStamp(sourceFile, sourceSize, sourceModifiedTime) || !modelData.cacheFile.open(cacheFile))
+	{
+		return false;
+	}
+
+	const uint8_t* data = modelData.cacheFile.getData();
+	uint64_t fileSize = modelData.cacheFile.getSize();
+
+	MeshCacheHeader header;
+	bool valid = fileSize >= sizeof(header);
+
+	if (valid)
+	{
+		memcpy(&header, data, sizeof(header));
+
+		valid = header.magic == MESH_CACHE_MAGIC && header.version == MESH_CACHE_VERSION && header.vertexSize == sizeof(Vertex)
+			&& header.importFlags == MODEL_IMPORT_FLAGS && header.processing == processing && header.sourceSize == sourceSize && header.sourceModifiedTime == sourceModifiedTime
+			&& header.verticesOffset % MESH_CACHE_BLOB_ALIGNMENT == 0 && header.indicesOffset % MESH_CACHE_BLOB_ALIGNMENT == 0 && header.meshletsOffset % MESH_CACHE_BLOB_ALIGNMENT == 0
+			&& isRangeInFile(header.materialsOffset, (uint64_t)header.materialCount * sizeof(MeshCacheMaterial), fileSize)
+			&& isRangeInFile(header.nodesOffset, (uint64_t)header.nodeCount * sizeof(MeshCacheNode), fileSize)
+			&& isRangeInFile(header.meshesOffset, (uint64_t)header.meshCount * sizeof(MeshCacheMesh), fileSize)
+			&& isRangeInFile(header.stringsOffset, header.stringsSize, fileSize)
+			&& header.vertexCount <= fileSize / sizeof(Vertex) && isRangeInFile(header.verticesOffset, header.vertexCount * sizeof(Vertex), fileSize)
+			&& header.indexCount <= fileSize / sizeof(uint32_t) && isRangeInFile(header.indicesOffset, header.indexCount * sizeof(uint32_t), fileSize)
+			&& header.meshletCount <= fileSize / sizeof(Meshlet) && isRangeInFile(header.meshletsOffset, header.meshletCount * sizeof(Meshlet), fileSize);
+	}
+
+	if (valid)
+	{
+		// Materials
+		modelData.textureNames.resize(header.materialCount);
+		modelData.materialUVsInRange.resize(header.materialCount);
+
+		for (uint32_t i = 0; i < header.materialCount && valid; i++)
+		{
+			MeshCacheMaterial material;
+			memcpy(&material, data + header.materialsOffset + i * sizeof(MeshCacheMaterial), sizeof(material));
+
+			valid = isRangeInFile(material.nameOffset, material.nameLength, header.stringsSize);
+
+			if (valid)
+			{
+				modelData.textureNames[i].assign(reinterpret_cast<const char*>(data + header.stringsOffset + material.nameOffset), material.nameLength);
+				modelData.materialUVsInRange[i] = material.uvsInRange != 0;
+			}
+		}
+
+		// Nodes, each of which must come after its parent
+		modelData.nodes.resize(header.nodeCount);
+
+		for (uint32_t i = 0; i < header.nodeCount && valid; i++)
+		{
+			MeshCacheNode node;
+			memcpy(&node, data + header.nodesOffset + i * sizeof(MeshCacheNode), sizeof(node));
+
+			valid = node.parent == SCENE_NO_PARENT || node.parent < i;
+
+			modelData.nodes[i].parent = node.parent;
+			memcpy(&modelData.nodes[i].transform[0][0], node.transform, sizeof(node.transform));
+		}
+
+		// Meshes, each of which must stay within the blobs and refer to a real node and material
+		modelData.meshes.resize(header.meshCount);
+
+		for (uint32_t i = 0; i < header.meshCount && valid; i++)
+		{
+			MeshCacheMesh mesh;
+			memcpy(&mesh, data + header.meshesOffset + i * sizeof(MeshCacheMesh), sizeof(mesh));
+
+			valid = mesh.node < header.nodeCount && mesh.materialIndex < header.materialCount
+				&& isRangeInFile(mesh.firstVertex, mesh.vertexCount, header.vertexCount)
+				&& isRangeInFile(mesh.firstIndex, mesh.indexCount, header.indexCount)
+				&& isRangeInFile(mesh.firstMeshlet, mesh.meshletCount, header.meshletCount)
+				&& mesh.lodCount >= 1 && mesh.lodCount <= MAX_MESH_LODS;
+
+			for (uint32_t lod = 0; lod < mesh.lodCount && valid; lod++)
+			{
+				valid = isRangeInFile(mesh.lods[lod].firstIndex, mesh.lods[lod].indexCount, mesh.indexCount)
+					&& isRangeInFile(mesh.lods[lod].firstMeshlet, mesh.lods[lod].meshletCount, mesh.meshletCount);
+			}
+
+			// Meshlets are drawn straight from the mapping, so each must stay within its mesh's indices
+			for (uint32_t meshlet = 0; meshlet < mesh.meshletCount && valid; meshlet++)
+			{
+				Meshlet cachedMeshlet;
+				memcpy(&cachedMeshlet, data + header.meshletsOffset + ((uint64_t)mesh.firstMeshlet + meshlet) * sizeof(Meshlet), sizeof(cachedMeshlet));
+				valid = isRangeInFile(cachedMeshlet.firstIndex, cachedMeshlet.indexCount, mesh.indexCount);
+			}
+
+			MeshData& meshData = modelData.meshes[i];
+			meshData.node = mesh.node;
+			meshData.materialIndex = mesh.materialIndex;
+			meshData.firstVertex = mesh.firstVertex;
+			meshData.vertexCount = mesh.vertexCount;
+			meshData.firstIndex = mesh.firstIndex;
+			meshData.indexCount = mesh.indexCount;
+			meshData.boundingSphere = glm::vec4(mesh.boundingSphere[0], mesh.boundingSphere[1], mesh.boundingSphere[2], mesh.boundingSphere[3]);
+			meshData.boundsMin = glm::vec3(mesh.boundsMin[0], mesh.boundsMin[1], mesh.boundsMin[2]);
+			meshData.boundsMax = glm::vec3(mesh.boundsMax[0], mesh.boundsMax[1], mesh.boundsMax[2]);
+			meshData.lodCount = mesh.lodCount;
+			memcpy(meshData.lods, mesh.lods, sizeof(meshData.lods));
+			meshData.firstMeshlet = mesh.firstMeshlet;
+			meshData.meshletCount = mesh.meshletCount;
+		}
+	}
+
+	if (!valid)
+	{
+		modelData.cacheFile.close();
+		modelData.textureNames.clear();
+		modelData.materialUVsInRange.clear();
+		modelData.nodes.clear();
+		modelData.meshes.clear();
+		return false;
+	}
+
+	// Vertices, indices and meshlets are used straight from the mapping
+	modelData.vertexStorage.clear();
+	modelData.indexStorage.clear();
+	modelData.meshletStorage.clear();
+	modelData.vertices = reinterpret_cast<const Vertex*>(data + header.verticesOffset);
+	modelData.indices = reinterpret_cast<const uint32_t*>(data + header.indicesOffset);
+	modelData.meshlets = header.meshletCount > 0 ? reinterpret_cast<const Meshlet*>(data + header.meshletsOffset) : nullptr;
+
+	return true;
+}
+
+void writeMeshCache(const std::string& cacheFile, const std::string& sourceFile, uint32_t processing, const ModelData& modelData)
+{
+	MeshCacheHeader header = {};
+	header.magic = MESH_CACHE_MAGIC;
+	header.version = MESH_CACHE_VERSION;
+	header.vertexSize = sizeof(Vertex);
+	header.importFlags = MODEL_IMPORT_FLAGS;
+	header.processing = processing;
+
+	if (!getSourceStamp(sourceFile, header.sourceSize, header.sourceModifiedTime))
+	{
+		return;
+	}
+
+	// Build the material records and their names
+	std::vector<MeshCacheMaterial> materials(modelData.textureNames.size());
+	std::string strings;
+
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		materials[i].nameOffset = static_cast<uint32_t>(strings.size());
+		materials[i].nameLength = static_cast<uint32_t>(modelData.textureNames[i].size());
+		materials[i].uvsInRange = modelData.materialUVsInRange[i] ? 1 : 0;
+		materials[i].padding = 0;
+
+		strings += modelData.textureNames[i];
+	}
+
+	// Build the node records
+	std::vector<MeshCacheNode> nodes(modelData.nodes.size());
+
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		nodes[i].parent = modelData.nodes[i].parent;
+		memcpy(nodes[i].transform, &modelData.nodes[i].transform[0][0], sizeof(nodes[i].transform));
+	}
+
+	// Build the mesh records, finding how many vertices and indices the blobs hold
+	std::vector<MeshCacheMesh> meshes(modelData.meshes.size());
+
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		const MeshData& meshData = modelData.meshes[i];
+
+		meshes[i].node = meshData.node;
+		meshes[i].materialIndex = meshData.materialIndex;
+		meshes[i].firstVertex = meshData.firstVertex;
+		meshes[i].vertexCount = meshData.vertexCount;
+		meshes[i].firstIndex = meshData.firstIndex;
+		meshes[i].indexCount = meshData.indexCount;
+		memcpy(meshes[i].boundingSphere, &meshData.boundingSphere[0], sizeof(meshes[i].boundingSphere));
+		memcpy(meshes[i].boundsMin, &meshData.boundsMin[0], sizeof(meshes[i].boundsMin));
+		memcpy(meshes[i].boundsMax, &meshData.boundsMax[0], sizeof(meshes[i].boundsMax));
+		meshes[i].lodCount = meshData.lodCount;
+		memset(meshes[i].lods, 0, sizeof(meshes[i].lods));
+		memcpy(meshes[i].lods, meshData.lods, meshData.lodCount * sizeof(MeshLod));
+		meshes[i].firstMeshlet = meshData.firstMeshlet;
+		meshes[i].meshletCount = meshData.meshletCount;
+
+		header.vertexCount = std::max<uint64_t>(header.vertexCount, (uint64_t)meshData.firstVertex + meshData.vertexCount);
+		header.indexCount = std::max<uint64_t>(header.indexCount, (uint64_t)meshData.firstIndex + meshData.indexCount);
+		header.meshletCount = std::max<uint64_t>(header.meshletCount, (uint64_t)meshData.firstMeshlet + meshData.meshletCount);
+	}
+
+	// Lay out the sections
+	header.materialCount = static_cast<uint32_t>(materials.size());
+	header.meshCount = static_cast<uint32_t>(meshes.size());
+	header.nodeCount = static_cast<uint32_t>(nodes.size());
+	header.materialsOffset = sizeof(MeshCacheHeader);
+	header.nodesOffset = header.materialsOffset + materials.size() * sizeof(MeshCacheMaterial);
+	header.meshesOffset = header.nodesOffset + nodes.size() * sizeof(MeshCacheNode);
+	header.stringsOffset = header.meshesOffset + meshes.size() * sizeof(MeshCacheMesh);
+	header.stringsSize = strings.size();
+	header.verticesOffset = alignOffset(header.stringsOffset + header.stringsSize);
+	header.indicesOffset = alignOffset(header.verticesOffset + header.vertexCount * sizeof(Vertex));
+	header.meshletsOffset = alignOffset(header.indicesOffset + header.indexCount * sizeof(uint32_t));
+
+	writeFileAtomically(cacheFile, [&](std::ofstream& file)
+	{
+		const char padding[MESH_CACHE_BLOB_ALIGNMENT] = {};
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(materials.data()), materials.size() * sizeof(MeshCacheMaterial));
+		file.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(MeshCacheNode));
+		file.write(reinterpret_cast<const char*>(meshes.data()), meshes.size() * sizeof(MeshCacheMesh));
+		file.write(strings.data(), strings.size());
+		file.write(padding, header.verticesOffset - (header.stringsOffset + header.stringsSize));
+		file.write(reinterpret_cast<const char*>(modelData.vertices), header.vertexCount * sizeof(Vertex));
+		file.write(padding, header.indicesOffset - (header.verticesOffset + header.vertexCount * sizeof(Vertex)));
+		file.write(reinterpret_cast<const char*>(modelData.indices), header.indexCount * sizeof(uint32_t));
+		file.write(padding, header.meshletsOffset - (header.indicesOffset + header.indexCount * sizeof(uint32_t)));
+		file.write(reinterpret_cast<const char*>(modelData.meshlets), header.meshletCount * sizeof(Meshlet));
+	});
+}
\ No newline at end of file
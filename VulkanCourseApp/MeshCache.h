@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+
+#include "Model.h"
+
+// Binary cache of a processed model, written beside the model file so later loads skip importing entirely
+// The file is memory mapped and its vertex and index blobs used in place, so loading is just header checks
+// Layout: header, material records, node records, mesh records, texture name strings, vertex blob, index blob, meshlet blob (blobs 16 byte aligned)
+// A cache is only used if it was written by this version, for this vertex layout, import flags and processing, and the source file is unchanged
+
+const std::string MESH_CACHE_EXTENSION = ".meshcache";
+const uint32_t MESH_CACHE_VERSION = 6;																// Increase whenever the layout or the processing stored changes
+
+// Optional processing applied to a model before it is cached, recorded so caches made with other settings are not used
+const uint32_t MESH_PROCESSING_OPTIMIZE = 1 << 0;													// Vertex cache, overdraw and vertex fetch ordering
+const uint32_t MESH_PROCESSING_LODS = 1 << 1;														// Simplified levels of detail
+const uint32_t MESH_PROCESSING_MESHLETS = 1 << 2;													// Meshlet clustering
+const uint32_t MESH_PROCESSING_STATIC_BATCH = 1 << 3;												// Meshes sharing a texture merged into one
+
+// Map a model's cache into modelData, returning false if it is missing, stale or damaged
+bool readMeshCache(const std::string& cacheFile, const std::string& sourceFile, uint32_t processing, ModelData& modelData);
+
+// Write modelData out as sourceFile's cache (failing silently, since the cache is only an optimisation)
+void writeMeshCache(const std::string& cacheFile, const std::string& sourceFile, uint32_t processing, const ModelData& modelData);
\ No newline at end of file
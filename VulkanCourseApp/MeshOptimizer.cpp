@@ -0,0 +1,383 @@
+#include "MeshOptimizer.h"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const uint32_t FORSYTH_CACHE_SIZE = 32;																// Modelled LRU cache size when scoring vertices
+	const uint32_t NO_TRIANGLE = 0xFFFFFFFF;
+
+	// Forsyth's vertex score: favour vertices recently used (but not by the last triangle) and vertices with few triangles left
+	float calculateVertexScore(int cachePosition, uint32_t remainingTriangles)
+	{
+		if (remainingTriangles == 0)
+		{
+			return -1.0f;
+		}
+
+		float score = 0.0f;
+
+		if (cachePosition >= 0)
+		{
+			// Vertices of the triangle just added get a fixed score, so their neighbours are not always preferred
+			if (cachePosition < 3)
+			{
+				score = 0.75f;
+			}
+
+			else
+			{
+				score = std::pow(1.0f - (float)(cachePosition - 3) / (FORSYTH_CACHE_SIZE - 3), 1.5f);
+			}
+		}
+
+		return score + 2.0f / std::sqrt((float)remainingTriangles);
+	}
+
+	// FIFO cache simulated with timestamps: a vertex is cached if loaded within the last cacheSize misses
+	class FifoCache
+	{
+	public:
+
+		FifoCache(size_t vertexCount) : loadTimes(vertexCount, 0), time(MESH_OPTIMIZER_CACHE_SIZE + 1)
+		{
+		}
+
+		// Returns 1 if the vertex had to be loaded
+		uint32_t access(uint32_t vertex)
+		{
+			if (time - loadTimes[vertex] > MESH_OPTIMIZER_CACHE_SIZE)
+			{
+				loadTimes[vertex] = time++;
+				return 1;
+			}
+
+			return 0;
+		}
+
+		void clear()
+		{
+			time += MESH_OPTIMIZER_CACHE_SIZE + 1;
+		}
+
+	private:
+		std::vector<uint32_t> loadTimes;
+		uint32_t time;
+	};
+}
+
+VertexCacheStatistics analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+	VertexCacheStatistics statistics;
+	statistics.triangleCount = indexCount / 3;
+	statistics.vertexCount = vertexCount;
+
+	FifoCache cache(vertexCount);
+
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		statistics.missCount += cache.access(indices[i]);
+	}
+
+	return statistics;
+}
+
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+	size_t triangleCount = indexCount / 3;
+
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// Triangles using each vertex, as ranges of one list, with the still unadded ones kept at the front of each range
+	std::vector<uint32_t> triangleOffsets(vertexCount + 1, 0);
+	std::vector<uint32_t> remainingTriangles(vertexCount, 0);
+
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		remainingTriangles[indices[i]]++;
+	}
+
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		triangleOffsets[i + 1] = triangleOffsets[i] + remainingTriangles[i];
+	}
+
+	std::vector<uint32_t> vertexTriangles(triangleCount * 3);
+	std::vector<uint32_t> fillOffsets(triangleOffsets.begin(), triangleOffsets.end() - 1);
+
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		vertexTriangles[fillOffsets[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	// Initial scores
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		vertexScores[i] = calculateVertexScore(-1, remainingTriangles[i]);
+	}
+
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<bool> triangleAdded(triangleCount, false);
+	uint32_t bestTriangle = 0;
+
+	for (size_t i = 0; i < triangleCount; i++)
+	{
+		triangleScores[i] = vertexScores[indices[i * 3]] + vertexScores[indices[i * 3 + 1]] + vertexScores[indices[i * 3 + 2]];
+
+		if (triangleScores[i] > triangleScores[bestTriangle])
+		{
+			bestTriangle = static_cast<uint32_t>(i);
+		}
+	}
+
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+
+	// LRU cache, with room for the three vertices pushed in before the oldest fall out
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> newCache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+	size_t scanPosition = 0;
+
+	for (size_t added = 0; added < triangleCount; added++)
+	{
+		// Nothing left next to the cache, so carry on from the next unadded triangle
+		if (bestTriangle == NO_TRIANGLE)
+		{
+			while (triangleAdded[scanPosition])
+			{
+				scanPosition++;
+			}
+
+			bestTriangle = static_cast<uint32_t>(scanPosition);
+		}
+
+		const uint32_t* triangle = indices + bestTriangle * 3;
+		triangleAdded[bestTriangle] = true;
+		output.insert(output.end(), triangle, triangle + 3);
+
+		// Remove the triangle from its vertices' remaining triangles
+		for (size_t i = 0; i < 3; i++)
+		{
+			uint32_t vertex = triangle[i];
+			uint32_t* begin = vertexTriangles.data() + triangleOffsets[vertex];
+			uint32_t* end = begin + remainingTriangles[vertex];
+
+			std::swap(*std::find(begin, end, bestTriangle), *(end - 1));
+			remainingTriangles[vertex]--;
+		}
+
+		// Move the triangle's vertices to the front of the cache
+		newCache.assign(triangle, triangle + 3);
+
+		for (uint32_t vertex : cache)
+		{
+			if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+			{
+				newCache.push_back(vertex);
+			}
+		}
+
+		// Rescore the vertices that moved (including any pushed out), then every triangle still using them
+		for (size_t i = 0; i < newCache.size(); i++)
+		{
+			uint32_t vertex = newCache[i];
+			cachePositions[vertex] = i < FORSYTH_CACHE_SIZE ? (int)i : -1;
+			vertexScores[vertex] = calculateVertexScore(cachePositions[vertex], remainingTriangles[vertex]);
+		}
+
+		bestTriangle = NO_TRIANGLE;
+		float bestScore = -1.0f;
+
+		for (uint32_t vertex : newCache)
+		{
+			for (uint32_t j = 0; j < remainingTriangles[vertex]; j++)
+			{
+				uint32_t candidate = vertexTriangles[triangleOffsets[vertex] + j];
+				const uint32_t* candidateVertices = indices + candidate * 3;
+
+				triangleScores[candidate] = vertexScores[candidateVertices[0]] + vertexScores[candidateVertices[1]] + vertexScores[candidateVertices[2]];
+
+				if (triangleScores[candidate] > bestScore)
+				{
+					bestScore = triangleScores[candidate];
+					bestTriangle = candidate;
+				}
+			}
+		}
+
+		newCache.resize(std::min<size_t>(newCache.size(), FORSYTH_CACHE_SIZE));
+		cache.swap(newCache);
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, float threshold)
+{
+	size_t triangleCount = indexCount / 3;
+
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// Hard boundaries: triangles loading all three vertices, which the cache order only does where it starts a new region
+	std::vector<size_t> hardClusters;
+	std::vector<uint32_t> triangleMisses(triangleCount);
+	FifoCache cache(vertexCount);
+
+	for (size_t i = 0; i < triangleCount; i++)
+	{
+		triangleMisses[i] = cache.access(indices[i * 3]) + cache.access(indices[i * 3 + 1]) + cache.access(indices[i * 3 + 2]);
+
+		if (triangleMisses[i] == 3)
+		{
+			hardClusters.push_back(i);
+		}
+	}
+
+	hardClusters.push_back(triangleCount);
+
+	// Soft boundaries: split each region, starting with a cold cache, wherever the running ACMR is back within threshold of the region's
+	std::vector<size_t> clusters;
+
+	for (size_t i = 0; i + 1 < hardClusters.size(); i++)
+	{
+		size_t regionStart = hardClusters[i];
+		size_t regionEnd = hardClusters[i + 1];
+
+		uint32_t regionMisses = 0;
+		for (size_t j = regionStart; j < regionEnd; j++)
+		{
+			regionMisses += triangleMisses[j];
+		}
+
+		float regionThreshold = threshold * regionMisses / (regionEnd - regionStart);
+
+		size_t clusterStart = regionStart;
+		uint32_t clusterMisses = 0;
+		cache.clear();
+
+		for (size_t j = regionStart; j < regionEnd; j++)
+		{
+			clusterMisses += cache.access(indices[j * 3]) + cache.access(indices[j * 3 + 1]) + cache.access(indices[j * 3 + 2]);
+
+			if ((float)clusterMisses / (j - clusterStart + 1) <= regionThreshold)
+			{
+				clusters.push_back(clusterStart);
+				clusterStart = j + 1;
+				clusterMisses = 0;
+				cache.clear();
+			}
+		}
+
+		if (clusterStart < regionEnd)
+		{
+			clusters.push_back(clusterStart);
+		}
+	}
+
+	clusters.push_back(triangleCount);
+
+	// Each cluster's area weighted centroid and normal, and the mesh's centroid
+	size_t clusterCount = clusters.size() - 1;
+	std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3(0.0f));
+	std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.0f));
+	glm::vec3 meshCentroid = glm::vec3(0.0f);
+	float meshArea = 0.0f;
+
+	for (size_t i = 0; i < clusterCount; i++)
+	{
+		float clusterArea = 0.0f;
+
+		for (size_t j = clusters[i]; j < clusters[i + 1]; j++)
+		{
+			const glm::vec3& a = vertices[indices[j * 3]].position;
+			const glm::vec3& b = vertices[indices[j * 3 + 1]].position;
+			const glm::vec3& c = vertices[indices[j * 3 + 2]].position;
+
+			glm::vec3 normal = glm::cross(b - a, c - a);
+			float area = glm::length(normal);
+
+			clusterCentroids[i] += (a + b + c) * (area / 3.0f);
+			clusterNormals[i] += normal;
+			clusterArea += area;
+		}
+
+		meshCentroid += clusterCentroids[i];
+		meshArea += clusterArea;
+		clusterCentroids[i] = clusterArea > 0.0f ? clusterCentroids[i] / clusterArea : glm::vec3(0.0f);
+	}
+
+	meshCentroid = meshArea > 0.0f ? meshCentroid / meshArea : glm::vec3(0.0f);
+
+	// Clusters facing furthest out from the centre are the most likely to hide others, so draw them first
+	std::vector<float> clusterSortKeys(clusterCount);
+	std::vector<size_t> clusterOrder(clusterCount);
+
+	for (size_t i = 0; i < clusterCount; i++)
+	{
+		float normalLength = glm::length(clusterNormals[i]);
+
+		clusterSortKeys[i] = normalLength > 0.0f ? glm::dot(clusterCentroids[i] - meshCentroid, clusterNormals[i] / normalLength) : 0.0f;
+		clusterOrder[i] = i;
+	}
+
+	std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&clusterSortKeys](size_t a, size_t b) { return clusterSortKeys[a] > clusterSortKeys[b]; });
+
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+
+	for (size_t cluster : clusterOrder)
+	{
+		output.insert(output.end(), indices + clusters[cluster] * 3, indices + clusters[cluster + 1] * 3);
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void optimizeVertexFetch(Vertex* vertices, size_t vertexCount, uint32_t* indices, size_t indexCount)
+{
+	const uint32_t unused = 0xFFFFFFFF;
+
+	std::vector<uint32_t> remap(vertexCount, unused);
+	uint32_t nextVertex = 0;
+
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		if (remap[indices[i]] == unused)
+		{
+			remap[indices[i]] = nextVertex++;
+		}
+
+		indices[i] = remap[indices[i]];
+	}
+
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		if (remap[i] == unused)
+		{
+			remap[i] = nextVertex++;
+		}
+	}
+
+	std::vector<Vertex> reordered(vertexCount);
+
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		reordered[remap[i]] = vertices[i];
+	}
+
+	std::copy(reordered.begin(), reordered.end(), vertices);
+}
\ No newline at end of file
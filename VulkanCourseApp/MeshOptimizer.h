@@ -0,0 +1,55 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "Utilities.h"
+
+// Load time reordering of indexed triangle lists for the GPU
+// Triangles are ordered for the post-transform vertex cache, then regrouped to draw outward facing clusters first (less overdraw),
+// and finally vertices are renumbered in first use order so vertex fetches walk memory forwards
+
+const uint32_t MESH_OPTIMIZER_CACHE_SIZE = 16;																// FIFO cache size used to measure ACMR/ATVR
+const float MESH_OPTIMIZER_OVERDRAW_THRESHOLD = 1.05f;														// ACMR increase allowed to cut clusters for overdraw
+
+// Vertex cache behaviour of an index buffer, from simulating a FIFO cache of MESH_OPTIMIZER_CACHE_SIZE vertices
+struct VertexCacheStatistics
+{
+	size_t triangleCount = 0;
+	size_t vertexCount = 0;
+	size_t missCount = 0;																			// Vertices transformed
+
+	// Average cache miss ratio: vertices transformed per triangle (0.5 at best, 3 at worst)
+	float getACMR() const
+	{
+		return triangleCount ? (float)missCount / triangleCount : 0.0f;
+	}
+
+	// Average transform to vertex ratio: times each vertex is transformed (1 at best)
+	float getATVR() const
+	{
+		return vertexCount ? (float)missCount / vertexCount : 0.0f;
+	}
+
+	void add(const VertexCacheStatistics& other)
+	{
+		triangleCount += other.triangleCount;
+		vertexCount += other.vertexCount;
+		missCount += other.missCount;
+	}
+};
+
+VertexCacheStatistics analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+// Reorder triangles for vertex cache reuse (Forsyth's linear-speed vertex cache optimisation)
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+// Reorder clusters of an already cache optimised triangle list so outward facing ones are drawn first (Sander, Nehab and Barczak's method)
+// Clusters are cut wherever that keeps the ACMR within threshold times the cache optimised one
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, float threshold);
+
+// Renumber vertices in order of first use, so the vertex buffer is read front to back (unused vertices move to the end)
+void optimizeVertexFetch(Vertex* vertices, size_t vertexCount, uint32_t* indices, size_t indexCount);
\ No newline at end of file
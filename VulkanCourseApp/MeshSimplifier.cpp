@@ -0,0 +1,639 @@
+#include "MeshSimplifier.h"
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <cmath>
+
+namespace
+{
+	const uint32_t NO_VERTEX = 0xFFFFFFFF;
+	const double BORDER_WEIGHT = 10.0;																	// Weight of the planes holding open borders in place
+	const double SEAM_WEIGHT = 1.0;																		// Weight of the planes holding UV seams in place
+	const double PASS_ERROR_MARGIN = 1.5 * 1.5;															// Squared margin over each pass's goal error
+	const float FLIP_THRESHOLD = 0.25f;																	// Smallest cosine allowed between a triangle's normals before and after a collapse
+
+	// How a position may move: freely, only along its open border or UV seam, or not at all
+	enum class VertexKind
+	{
+		Manifold,
+		Border,
+		Seam,
+		Locked
+	};
+
+	// Sum of squared distances to a set of weighted planes
+	struct Quadric
+	{
+		double a00 = 0.0, a11 = 0.0, a22 = 0.0, a01 = 0.0, a02 = 0.0, a12 = 0.0;
+		double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+		double c = 0.0;
+		double area = 0.0;																			// Area of the triangles the error is averaged over
+
+		// Add the plane dot(normal, x) + distance = 0, normal being unit length
+		void addPlane(glm::dvec3 normal, double distance, double planeWeight)
+		{
+			a00 += planeWeight * normal.x * normal.x;
+			a11 += planeWeight * normal.y * normal.y;
+			a22 += planeWeight * normal.z * normal.z;
+			a01 += planeWeight * normal.x * normal.y;
+			a02 += planeWeight * normal.x * normal.z;
+			a12 += planeWeight * normal.y * normal.z;
+			b0 += planeWeight * normal.x * distance;
+			b1 += planeWeight * normal.y * distance;
+			b2 += planeWeight * normal.z * distance;
+			c += planeWeight * distance * distance;
+		}
+
+		void add(const Quadric& other)
+		{
+			a00 += other.a00;
+			a11 += other.a11;
+			a22 += other.a22;
+			a01 += other.a01;
+			a02 += other.a02;
+			a12 += other.a12;
+			b0 += other.b0;
+			b1 += other.b1;
+			b2 += other.b2;
+			c += other.c;
+			area += other.area;
+		}
+
+		// Squared distance from the planes to a point, averaged over the triangles' area
+		double evaluate(glm::vec3 point) const
+		{
+			double x = point.x;
+			double y = point.y;
+			double z = point.z;
+
+			double error = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+						+ 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+
+			return area > 0.0 ? std::max(error, 0.0) / area : 0.0;
+		}
+	};
+
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		double error;
+	};
+
+	// Triangles around each vertex, stored as the vertex's next and previous corner in each one
+	struct Adjacency
+	{
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> next;
+		std::vector<uint32_t> previous;
+
+		void build(const uint32_t* indices, size_t indexCount, size_t vertexCount)
+		{
+			offsets.assign(vertexCount + 1, 0);
+
+			for (size_t i = 0; i < indexCount; i++)
+			{
+				offsets[indices[i] + 1]++;
+			}
+
+			for (size_t i = 0; i < vertexCount; i++)
+			{
+				offsets[i + 1] += offsets[i];
+			}
+
+			next.resize(indexCount);
+			previous.resize(indexCount);
+			std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+
+			for (size_t i = 0; i < indexCount; i += 3)
+			{
+				for (size_t k = 0; k < 3; k++)
+				{
+					uint32_t slot = fill[indices[i + k]]++;
+					next[slot] = indices[i + (k + 1) % 3];
+					previous[slot] = indices[i + (k + 2) % 3];
+				}
+			}
+		}
+
+		bool hasTriangles(uint32_t vertex) const
+		{
+			return offsets[vertex] != offsets[vertex + 1];
+		}
+
+		// Whether any triangle has the directed edge a -> b
+		bool hasEdge(uint32_t a, uint32_t b) const
+		{
+			for (uint32_t i = offsets[a]; i < offsets[a + 1]; i++)
+			{
+				if (next[i] == b)
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+	};
+
+	// Vertices sharing a position (split by UV seams) are linked into a circular list of wedges, and mapped to the first of them
+	struct Wedges
+	{
+		std::vector<uint32_t> positionRemap;
+		std::vector<uint32_t> next;
+
+		void build(const Vertex* vertices, size_t vertexCount)
+		{
+			std::vector<uint32_t> order(vertexCount);
+			std::iota(order.begin(), order.end(), 0);
+
+			std::sort(order.begin(), order.end(), [vertices](uint32_t a, uint32_t b)
+			{
+				const glm::vec3& positionA = vertices[a].position;
+				const glm::vec3& positionB = vertices[b].position;
+
+				if (positionA.x != positionB.x) return positionA.x < positionB.x;
+				if (positionA.y != positionB.y) return positionA.y < positionB.y;
+				if (positionA.z != positionB.z) return positionA.z < positionB.z;
+				return a < b;
+			});
+
+			positionRemap.resize(vertexCount);
+			next.resize(vertexCount);
+
+			for (size_t i = 0; i < vertexCount;)
+			{
+				size_t end = i + 1;
+				while (end < vertexCount && vertices[order[end]].position == vertices[order[i]].position)
+				{
+					end++;
+				}
+
+				for (size_t j = i; j < end; j++)
+				{
+					positionRemap[order[j]] = order[i];
+					next[order[j]] = order[j + 1 < end ? j + 1 : i];
+				}
+
+				i = end;
+			}
+		}
+
+		// Whether any triangle runs from a's position to b's, whichever wedges it uses
+		bool hasPositionEdge(const Adjacency& adjacency, uint32_t a, uint32_t b) const
+		{
+			uint32_t wedgeA = a;
+			do
+			{
+				uint32_t wedgeB = b;
+				do
+				{
+					if (adjacency.hasEdge(wedgeA, wedgeB))
+					{
+						return true;
+					}
+					wedgeB = next[wedgeB];
+				} while (wedgeB != b);
+
+				wedgeA = next[wedgeA];
+			} while (wedgeA != a);
+
+			return false;
+		}
+	};
+
+	// Per position kinds (at the position's first wedge), with the neighbours along its border or, per wedge, along its seam
+	struct Topology
+	{
+		std::vector<VertexKind> kinds;
+		std::vector<uint32_t> borderNext;
+		std::vector<uint32_t> borderPrevious;
+		std::vector<uint32_t> seamNext;
+		std::vector<uint32_t> seamPrevious;
+
+		void classify(const Adjacency& adjacency, const Wedges& wedges, size_t vertexCount)
+		{
+			kinds.assign(vertexCount, VertexKind::Locked);
+			borderNext.assign(vertexCount, NO_VERTEX);
+			borderPrevious.assign(vertexCount, NO_VERTEX);
+			seamNext.assign(vertexCount, NO_VERTEX);
+			seamPrevious.assign(vertexCount, NO_VERTEX);
+
+			for (uint32_t v = 0; v < vertexCount; v++)
+			{
+				if (wedges.positionRemap[v] != v)
+				{
+					continue;
+				}
+
+				uint32_t wedgeCount = 0;
+				uint32_t borderOutCount = 0;
+				uint32_t borderInCount = 0;
+				uint32_t seamWedgeCount = 0;																// Wedges with exactly one seam edge each way
+				bool hasSeam = false;
+
+				uint32_t wedge = v;
+				do
+				{
+					// Wedges left without triangles by earlier collapses no longer count
+					if (adjacency.hasTriangles(wedge))
+					{
+						wedgeCount++;
+					}
+
+					uint32_t seamOutCount = 0;
+					uint32_t seamInCount = 0;
+
+					for (uint32_t i = adjacency.offsets[wedge]; i < adjacency.offsets[wedge + 1]; i++)
+					{
+						uint32_t nextVertex = adjacency.next[i];
+						uint32_t previousVertex = adjacency.previous[i];
+
+						// An edge with no triangle running back along it is an open border, or a seam if the way back uses other wedges
+						if (!wedges.hasPositionEdge(adjacency, nextVertex, wedge))
+						{
+							borderOutCount++;
+							borderNext[v] = wedges.positionRemap[nextVertex];
+						}
+						else if (!adjacency.hasEdge(nextVertex, wedge))
+						{
+							seamOutCount++;
+							seamNext[wedge] = nextVertex;
+						}
+
+						if (!wedges.hasPositionEdge(adjacency, wedge, previousVertex))
+						{
+							borderInCount++;
+							borderPrevious[v] = wedges.positionRemap[previousVertex];
+						}
+						else if (!adjacency.hasEdge(wedge, previousVertex))
+						{
+							seamInCount++;
+							seamPrevious[wedge] = previousVertex;
+						}
+					}
+
+					hasSeam = hasSeam || seamOutCount > 0 || seamInCount > 0;
+					seamWedgeCount += seamOutCount == 1 && seamInCount == 1;
+
+					wedge = wedges.next[wedge];
+				} while (wedge != v);
+
+				bool hasBorder = borderOutCount > 0 || borderInCount > 0;
+
+				if (wedgeCount == 1 && !hasBorder && !hasSeam)
+				{
+					kinds[v] = VertexKind::Manifold;
+				}
+				else if (wedgeCount == 1 && borderOutCount == 1 && borderInCount == 1 && !hasSeam)
+				{
+					kinds[v] = VertexKind::Border;
+				}
+				else if (wedgeCount == 2 && !hasBorder && seamWedgeCount == 2)
+				{
+					kinds[v] = VertexKind::Seam;
+				}
+			}
+		}
+
+		VertexKind getKind(const Wedges& wedges, uint32_t vertex) const
+		{
+			return kinds[wedges.positionRemap[vertex]];
+		}
+
+		// Wedge of the target position that a wedge of a seam or border collapsing towards it lands on
+		uint32_t getCollapseTarget(const Wedges& wedges, uint32_t wedge, uint32_t to) const
+		{
+			uint32_t fromPosition = wedges.positionRemap[wedge];
+			uint32_t toPosition = wedges.positionRemap[to];
+
+			if (kinds[fromPosition] != VertexKind::Seam)
+			{
+				return to;
+			}
+
+			if (seamNext[wedge] != NO_VERTEX && wedges.positionRemap[seamNext[wedge]] == toPosition)
+			{
+				return seamNext[wedge];
+			}
+
+			if (seamPrevious[wedge] != NO_VERTEX && wedges.positionRemap[seamPrevious[wedge]] == toPosition)
+			{
+				return seamPrevious[wedge];
+			}
+
+			return NO_VERTEX;
+		}
+
+		bool canCollapse(const Wedges& wedges, uint32_t from, uint32_t to) const
+		{
+			uint32_t fromPosition = wedges.positionRemap[from];
+			uint32_t toPosition = wedges.positionRemap[to];
+			VertexKind toKind = kinds[toPosition];
+
+			switch (kinds[fromPosition])
+			{
+			case VertexKind::Manifold:
+				return true;
+
+			case VertexKind::Border:
+				return (borderNext[fromPosition] == toPosition || borderPrevious[fromPosition] == toPosition)
+					&& (toKind == VertexKind::Border || toKind == VertexKind::Locked);
+
+			case VertexKind::Seam:
+				return getCollapseTarget(wedges, from, to) != NO_VERTEX
+					&& (toKind == VertexKind::Seam || toKind == VertexKind::Locked);
+
+			default:
+				return false;
+			}
+		}
+	};
+
+	// Largest distance moving from's position onto to's takes it from the planes of the triangles around it, or infinity if that
+	// would flip (or squash) any of the triangles surviving the collapse
+	// Bounds what averaging hides in the quadric, such as a small face next to large ones being folded away
+	float getCollapseDistance(const Adjacency& adjacency, const Wedges& wedges, const Vertex* vertices, uint32_t from, uint32_t to)
+	{
+		glm::vec3 fromPosition = vertices[from].position;
+		glm::vec3 toPosition = vertices[to].position;
+		uint32_t toRemap = wedges.positionRemap[to];
+		float maxDistance = 0.0f;
+
+		uint32_t wedge = from;
+		do
+		{
+			for (uint32_t i = adjacency.offsets[wedge]; i < adjacency.offsets[wedge + 1]; i++)
+			{
+				glm::vec3 nextPosition = vertices[adjacency.next[i]].position;
+				glm::vec3 previousPosition = vertices[adjacency.previous[i]].position;
+
+				glm::vec3 oldNormal = glm::cross(nextPosition - fromPosition, previousPosition - fromPosition);
+				float oldLength = glm::length(oldNormal);
+
+				if (oldLength > 0.0f)
+				{
+					maxDistance = std::max(maxDistance, std::abs(glm::dot(oldNormal, toPosition - fromPosition)) / oldLength);
+				}
+
+				// Triangles on the collapsed edge disappear
+				if (wedges.positionRemap[adjacency.next[i]] == toRemap || wedges.positionRemap[adjacency.previous[i]] == toRemap)
+				{
+					continue;
+				}
+
+				glm::vec3 newNormal = glm::cross(nextPosition - toPosition, previousPosition - toPosition);
+
+				if (glm::dot(oldNormal, newNormal) <= FLIP_THRESHOLD * oldLength * glm::length(newNormal))
+				{
+					return std::numeric_limits<float>::max();
+				}
+			}
+
+			wedge = wedges.next[wedge];
+		} while (wedge != from);
+
+		return maxDistance;
+	}
+
+	// Quadric of each position: the planes of its triangles weighted by area, plus planes through open borders and seams holding them in place
+	std::vector<Quadric> calculateQuadrics(const uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, const Adjacency& adjacency, const Wedges& wedges)
+	{
+		std::vector<Quadric> quadrics(vertexCount);
+
+		for (size_t i = 0; i < indexCount; i += 3)
+		{
+			glm::dvec3 positions[3];
+			for (size_t k = 0; k < 3; k++)
+			{
+				positions[k] = glm::dvec3(vertices[indices[i + k]].position);
+			}
+
+			glm::dvec3 normal = glm::cross(positions[1] - positions[0], positions[2] - positions[0]);
+			double length = glm::length(normal);
+
+			if (length == 0.0)
+			{
+				continue;
+			}
+
+			normal /= length;
+			double distance = -glm::dot(normal, positions[0]);
+
+			for (size_t k = 0; k < 3; k++)
+			{
+				Quadric& quadric = quadrics[wedges.positionRemap[indices[i + k]]];
+				quadric.addPlane(normal, distance, length * 0.5);
+				quadric.area += length * 0.5;
+			}
+
+			for (size_t k = 0; k < 3; k++)
+			{
+				uint32_t a = indices[i + k];
+				uint32_t b = indices[i + (k + 1) % 3];
+
+				bool border = !wedges.hasPositionEdge(adjacency, b, a);
+				bool seam = !border && !adjacency.hasEdge(b, a);
+
+				if (!border && !seam)
+				{
+					continue;
+				}
+
+				// Plane through the edge, perpendicular to its triangle
+				glm::dvec3 edge = positions[(k + 1) % 3] - positions[k];
+				glm::dvec3 edgeNormal = glm::cross(edge, normal);
+				double edgeLength = glm::length(edgeNormal);
+
+				if (edgeLength == 0.0)
+				{
+					continue;
+				}
+
+				edgeNormal /= edgeLength;
+				double edgeDistance = -glm::dot(edgeNormal, positions[k]);
+				double edgeWeight = (border ? BORDER_WEIGHT : SEAM_WEIGHT) * glm::dot(edge, edge);
+
+				quadrics[wedges.positionRemap[a]].addPlane(edgeNormal, edgeDistance, edgeWeight);
+				quadrics[wedges.positionRemap[b]].addPlane(edgeNormal, edgeDistance, edgeWeight);
+			}
+		}
+
+		return quadrics;
+	}
+}
+
+size_t simplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, size_t targetIndexCount, float targetError, float* resultError)
+{
+	std::copy(indices, indices + indexCount, destination);
+
+	Wedges wedges;
+	wedges.build(vertices, vertexCount);
+
+	Adjacency adjacency;
+	adjacency.build(destination, indexCount, vertexCount);
+
+	std::vector<Quadric> quadrics = calculateQuadrics(destination, indexCount, vertices, vertexCount, adjacency, wedges);
+
+	double errorLimit = (double)targetError * targetError;
+	double maxError = 0.0;
+
+	Topology topology;
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> collapseRemap(vertexCount);
+	std::vector<bool> locked(vertexCount);
+	std::vector<uint32_t> wedgeTargets;
+
+	// Error of moving from's position onto to's, taking the larger of the quadric and local plane distances, or the largest double if not allowed
+	auto getCollapseError = [&](uint32_t from, uint32_t to)
+	{
+		if (!topology.canCollapse(wedges, from, to))
+		{
+			return std::numeric_limits<double>::max();
+		}
+
+		double distance = getCollapseDistance(adjacency, wedges, vertices, from, to);
+		return std::max(quadrics[wedges.positionRemap[from]].evaluate(vertices[to].position), distance * distance);
+	};
+
+	// Each pass collapses the cheapest edges it can without two collapses touching, then rebuilds the topology around them
+	while (indexCount > targetIndexCount)
+	{
+		adjacency.build(destination, indexCount, vertexCount);
+		topology.classify(adjacency, wedges, vertexCount);
+
+		// Cheapest valid direction of every edge
+		collapses.clear();
+
+		for (size_t i = 0; i < indexCount; i += 3)
+		{
+			for (size_t k = 0; k < 3; k++)
+			{
+				uint32_t a = destination[i + k];
+				uint32_t b = destination[i + (k + 1) % 3];
+
+				double errorAB = getCollapseError(a, b);
+				double errorBA = getCollapseError(b, a);
+
+				// Edges no collapse can stay within the error limit on are left alone
+				if (std::min(errorAB, errorBA) <= errorLimit)
+				{
+					collapses.push_back(errorAB <= errorBA ? Collapse{ a, b, errorAB } : Collapse{ b, a, errorBA });
+				}
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b)
+		{
+			return a.error < b.error;
+		});
+
+		// Each collapse removes about two triangles, so stop near the target rather than overshooting it
+		size_t triangleCount = indexCount / 3;
+		size_t targetTriangleCount = targetIndexCount / 3;
+		size_t collapseLimit = std::max<size_t>(1, (triangleCount - targetTriangleCount) / 2);
+		size_t collapseCount = 0;
+
+		// Many collapses get skipped for touching earlier ones, so allow some margin over the error of the last one needed,
+		// but no more, or skipped cheap collapses get replaced by costly ones instead of waiting for the next pass
+		double passErrorLimit = errorLimit;
+		if (collapseLimit < collapses.size())
+		{
+			passErrorLimit = std::min(errorLimit, PASS_ERROR_MARGIN * collapses[collapseLimit].error);
+		}
+
+		std::iota(collapseRemap.begin(), collapseRemap.end(), 0);
+		std::fill(locked.begin(), locked.end(), false);
+
+		for (const auto& collapse : collapses)
+		{
+			if (collapse.error > passErrorLimit || collapseCount >= collapseLimit)
+			{
+				break;
+			}
+
+			uint32_t fromPosition = wedges.positionRemap[collapse.from];
+			uint32_t toPosition = wedges.positionRemap[collapse.to];
+
+			if (locked[fromPosition] || locked[toPosition])
+			{
+				continue;
+			}
+
+			// Every wedge in use moves, seam wedges onto the wedge across the seam edge from them
+			wedgeTargets.clear();
+			bool mapped = true;
+
+			uint32_t wedge = collapse.from;
+			do
+			{
+				uint32_t target = adjacency.hasTriangles(wedge) ? topology.getCollapseTarget(wedges, wedge, collapse.to) : wedge;
+				mapped = mapped && target != NO_VERTEX;
+				wedgeTargets.push_back(target);
+				wedge = wedges.next[wedge];
+			} while (wedge != collapse.from);
+
+			if (!mapped)
+			{
+				continue;
+			}
+
+			size_t wedgeIndex = 0;
+			wedge = collapse.from;
+			do
+			{
+				collapseRemap[wedge] = wedgeTargets[wedgeIndex++];
+
+				// Neighbours' triangles change shape, so leave them until the next pass
+				for (uint32_t i = adjacency.offsets[wedge]; i < adjacency.offsets[wedge + 1]; i++)
+				{
+					locked[wedges.positionRemap[adjacency.next[i]]] = true;
+					locked[wedges.positionRemap[adjacency.previous[i]]] = true;
+				}
+
+				wedge = wedges.next[wedge];
+			} while (wedge != collapse.from);
+
+			locked[fromPosition] = true;
+			locked[toPosition] = true;
+
+			quadrics[toPosition].add(quadrics[fromPosition]);
+			maxError = std::max(maxError, collapse.error);
+			collapseCount++;
+		}
+
+		if (collapseCount == 0)
+		{
+			break;
+		}
+
+		// Apply the collapses, dropping triangles that now have two corners at one position
+		size_t writeCount = 0;
+
+		for (size_t i = 0; i < indexCount; i += 3)
+		{
+			uint32_t a = collapseRemap[destination[i + 0]];
+			uint32_t b = collapseRemap[destination[i + 1]];
+			uint32_t c = collapseRemap[destination[i + 2]];
+
+			uint32_t positionA = wedges.positionRemap[a];
+			uint32_t positionB = wedges.positionRemap[b];
+			uint32_t positionC = wedges.positionRemap[c];
+
+			if (positionA != positionB && positionB != positionC && positionA != positionC)
+			{
+				destination[writeCount + 0] = a;
+				destination[writeCount + 1] = b;
+				destination[writeCount + 2] = c;
+				writeCount += 3;
+			}
+		}
+
+		indexCount = writeCount;
+	}
+
+	*resultError = static_cast<float>(std::sqrt(maxError));
+	return indexCount;
+}
\ No newline at end of file
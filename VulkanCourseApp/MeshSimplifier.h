@@ -0,0 +1,18 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "Utilities.h"
+
+// Load time simplification of indexed triangle lists, used to build each mesh's levels of detail
+// Edges are collapsed cheapest first by Garland and Heckbert's quadric error metric, always moving a vertex onto a neighbour,
+// so every level keeps using the original vertex buffer and only needs indices of its own
+// Open borders and UV seams only collapse along themselves, and collapses that would flip a triangle are skipped
+
+// Simplify towards targetIndexCount indices, stopping early rather than moving the surface by more than targetError (in mesh units)
+// Writes to destination (room for indexCount indices) and returns the simplified index count, with the error reached in resultError
+size_t simplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, size_t targetIndexCount, float targetError, float* resultError);
\ No newline at end of file
@@ -0,0 +1,321 @@
+#include "Meshlet.h"
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+namespace
+{
+	const uint32_t NO_TRIANGLE = 0xFFFFFFFF;
+	const uint32_t NO_MESHLET = 0xFFFFFFFF;
+	const float MESHLET_CONE_WEIGHT = 2.0f;															// Cost of a neighbour facing the opposite way, in new vertices
+	const size_t MESHLET_SEED_SEARCH = 256;															// Triangles searched for the closest one once a meshlet runs out of neighbours
+
+	// Center and radius around the meshlet's vertices, and the cone holding its triangles' normals
+	void calculateMeshletBounds(Meshlet& meshlet, const uint32_t* indices, const Vertex* vertices, const std::vector<glm::vec3>& normals)
+	{
+		glm::vec3 minimum(std::numeric_limits<float>::max());
+		glm::vec3 maximum(-std::numeric_limits<float>::max());
+		glm::vec3 normalSum(0.0f);
+
+		for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i++)
+		{
+			minimum = glm::min(minimum, vertices[indices[i]].position);
+			maximum = glm::max(maximum, vertices[indices[i]].position);
+		}
+
+		glm::vec3 center = (minimum + maximum) * 0.5f;
+		float radius = 0.0f;
+
+		for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i++)
+		{
+			radius = std::max(radius, glm::length(vertices[indices[i]].position - center));
+		}
+
+		meshlet.boundingSphere = glm::vec4(center, radius);
+
+		for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i += 3)
+		{
+			normalSum += normals[i / 3];
+		}
+
+		// A cone wider than a hemisphere faces the camera from everywhere, so is never culled
+		float normalLength = glm::length(normalSum);
+		meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+		if (normalLength == 0.0f)
+		{
+			return;
+		}
+
+		glm::vec3 axis = normalSum / normalLength;
+		float minimumDot = 1.0f;
+
+		for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i += 3)
+		{
+			if (normals[i / 3] != glm::vec3(0.0f))
+			{
+				minimumDot = std::min(minimumDot, glm::dot(normals[i / 3], axis));
+			}
+		}
+
+		if (minimumDot > 0.0f)
+		{
+			meshlet.cone = glm::vec4(axis, std::sqrt(1.0f - minimumDot * minimumDot));
+		}
+	}
+}
+
+std::vector<Meshlet> buildMeshlets(uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount)
+{
+	size_t triangleCount = indexCount / 3;
+
+	// Triangles using each vertex
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	std::vector<uint32_t> vertexTriangles(triangleCount * 3);
+
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		offsets[indices[i] + 1]++;
+	}
+
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		offsets[i + 1] += offsets[i];
+	}
+
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		vertexTriangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	// Unit normal (zero if degenerate) and centroid of each triangle
+	std::vector<glm::vec3> normals(triangleCount);
+	std::vector<glm::vec3> centroids(triangleCount);
+
+	for (size_t i = 0; i < triangleCount; i++)
+	{
+		glm::vec3 a = vertices[indices[i * 3 + 0]].position;
+		glm::vec3 b = vertices[indices[i * 3 + 1]].position;
+		glm::vec3 c = vertices[indices[i * 3 + 2]].position;
+
+		glm::vec3 normal = glm::cross(b - a, c - a);
+		float length = glm::length(normal);
+
+		normals[i] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+		centroids[i] = (a + b + c) / 3.0f;
+	}
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> vertexMeshlet(vertexCount, NO_MESHLET);									// Meshlet each vertex was last added to
+	std::vector<uint32_t> meshletTriangles;															// Every triangle, grouped by meshlet
+	std::vector<uint32_t> candidates;																// Triangles sharing a vertex with the current meshlet
+	std::vector<Meshlet> meshlets;
+	size_t nextSeed = 0;
+
+	meshletTriangles.reserve(triangleCount);
+
+	while (true)
+	{
+		// Start each meshlet from the earliest triangle left, so meshlets follow the earlier triangle order
+		while (nextSeed < triangleCount && emitted[nextSeed])
+		{
+			nextSeed++;
+		}
+
+		if (nextSeed == triangleCount)
+		{
+			break;
+		}
+
+		uint32_t meshletIndex = static_cast<uint32_t>(meshlets.size());
+		size_t firstTriangle = meshletTriangles.size();
+		uint32_t meshletVertexCount = 0;
+		glm::vec3 normalSum(0.0f);
+		glm::vec3 centroidSum(0.0f);
+		candidates.clear();
+
+		auto countNewVertices = [&](uint32_t triangle)
+		{
+			uint32_t newVertices = 0;
+			for (size_t k = 0; k < 3; k++)
+			{
+				newVertices += vertexMeshlet[indices[triangle * 3 + k]] != meshletIndex;
+			}
+			return newVertices;
+		};
+
+		auto addTriangle = [&](uint32_t triangle)
+		{
+			emitted[triangle] = true;
+			meshletTriangles.push_back(triangle);
+			normalSum += normals[triangle];
+			centroidSum += centroids[triangle];
+
+			for (size_t k = 0; k < 3; k++)
+			{
+				uint32_t vertex = indices[triangle * 3 + k];
+
+				if (vertexMeshlet[vertex] == meshletIndex)
+				{
+					continue;
+				}
+
+				vertexMeshlet[vertex] = meshletIndex;
+				meshletVertexCount++;
+
+				for (uint32_t i = offsets[vertex]; i < offsets[vertex + 1]; i++)
+				{
+					if (!emitted[vertexTriangles[i]])
+					{
+						candidates.push_back(vertexTriangles[i]);
+					}
+				}
+			}
+		};
+
+		addTriangle(static_cast<uint32_t>(nextSeed));
+
+		while (meshletTriangles.size() - firstTriangle < MESHLET_MAX_TRIANGLES)
+		{
+			float axisLength = glm::length(normalSum);
+			glm::vec3 axis = axisLength > 0.0f ? normalSum / axisLength : glm::vec3(0.0f);
+
+			// Neighbour adding the fewest vertices while facing closest to the meshlet's mean normal (tightening its cone)
+			uint32_t best = NO_TRIANGLE;
+			float bestScore = std::numeric_limits<float>::max();
+			size_t candidateCount = 0;
+
+			for (size_t i = 0; i < candidates.size(); i++)
+			{
+				uint32_t triangle = candidates[i];
+
+				if (emitted[triangle])
+				{
+					continue;
+				}
+
+				candidates[candidateCount++] = triangle;
+				uint32_t newVertices = countNewVertices(triangle);
+
+				if (meshletVertexCount + newVertices > MESHLET_MAX_VERTICES)
+				{
+					continue;
+				}
+
+				float score = newVertices + MESHLET_CONE_WEIGHT * (1.0f - glm::dot(normals[triangle], axis));
+
+				if (score < bestScore)
+				{
+					bestScore = score;
+					best = triangle;
+				}
+			}
+
+			candidates.resize(candidateCount);
+
+			// Out of neighbours, continue with the closest of the next triangles left (as a disconnected part usually lies nearby)
+			if (best == NO_TRIANGLE && candidates.empty())
+			{
+				glm::vec3 centroid = centroidSum / static_cast<float>(meshletTriangles.size() - firstTriangle);
+				float bestDistance = std::numeric_limits<float>::max();
+
+				for (size_t i = nextSeed, searched = 0; i < triangleCount && searched < MESHLET_SEED_SEARCH; i++)
+				{
+					if (emitted[i])
+					{
+						continue;
+					}
+
+					searched++;
+					float distance = glm::length(centroids[i] - centroid);
+
+					if (distance < bestDistance && meshletVertexCount + countNewVertices(static_cast<uint32_t>(i)) <= MESHLET_MAX_VERTICES)
+					{
+						bestDistance = distance;
+						best = static_cast<uint32_t>(i);
+					}
+				}
+			}
+
+			if (best == NO_TRIANGLE)
+			{
+				break;
+			}
+
+			addTriangle(best);
+		}
+
+		// Keep the meshlet's triangles in their earlier order, so vertex cache optimisation mostly survives
+		std::sort(meshletTriangles.begin() + firstTriangle, meshletTriangles.end());
+
+		Meshlet meshlet = {};
+		meshlet.firstIndex = static_cast<uint32_t>(firstTriangle * 3);
+		meshlet.indexCount = static_cast<uint32_t>((meshletTriangles.size() - firstTriangle) * 3);
+		meshlets.push_back(meshlet);
+	}
+
+	// Write the triangles out grouped by meshlet, carrying their normals along for the bounds
+	std::vector<uint32_t> originalIndices(indices, indices + triangleCount * 3);
+	std::vector<glm::vec3> meshletNormals(triangleCount);
+
+	for (size_t i = 0; i < triangleCount; i++)
+	{
+		uint32_t triangle = meshletTriangles[i];
+		indices[i * 3 + 0] = originalIndices[triangle * 3 + 0];
+		indices[i * 3 + 1] = originalIndices[triangle * 3 + 1];
+		indices[i * 3 + 2] = originalIndices[triangle * 3 + 2];
+		meshletNormals[i] = normals[triangle];
+	}
+
+	for (auto& meshlet : meshlets)
+	{
+		calculateMeshletBounds(meshlet, indices, vertices, meshletNormals);
+	}
+
+	return meshlets;
+}
+
+void calculateFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+{
+	// Rows of the matrix (GLM stores columns), each clip space bound giving a plane (Gribb and Hartmann's method)
+	glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+	glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+	glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+	glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+	planes[0] = row3 + row0;																		// Left
+	planes[1] = row3 - row0;																		// Right
+	planes[2] = row3 + row1;																		// Bottom (top once Y is flipped)
+	planes[3] = row3 - row1;																		// Top
+	planes[4] = row3 + row2;																		// Near (-w <= z, which also holds for a zero to one depth range)
+	planes[5] = row3 - row2;																		// Far
+
+	for (size_t i = 0; i < 6; i++)
+	{
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+	}
+}
+
+bool isSphereOutsideFrustum(const glm::vec4 planes[6], glm::vec4 boundingSphere)
+{
+	for (size_t i = 0; i < 6; i++)
+	{
+		if (glm::dot(glm::vec3(planes[i]), glm::vec3(boundingSphere)) + planes[i].w < -boundingSphere.w)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool isMeshletBackFacing(const Meshlet& meshlet, glm::vec3 cameraPosition)
+{
+	// Every view direction into the bounding sphere must lie within the cone's complement around its axis
+	glm::vec3 toCenter = glm::vec3(meshlet.boundingSphere) - cameraPosition;
+
+	return glm::dot(toCenter, glm::vec3(meshlet.cone)) >= meshlet.cone.w * glm::length(toCenter) + meshlet.boundingSphere.w;
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "Utilities.h"
+
+// Small clusters of a mesh's triangles, each with bounds to cull it by before drawing
+// Meshlets are runs of the mesh's index buffer (its triangles regrouped so each cluster's are contiguous), drawn with indirect draws
+
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+struct Meshlet
+{
+	uint32_t firstIndex;																			// Within its mesh's indices
+	uint32_t indexCount;
+	glm::vec4 boundingSphere;																		// Center (xyz) and radius (w) in mesh space
+	glm::vec4 cone;																					// Mean triangle normal (xyz) and the sine of the widest angle from it (w, 1 if never back facing)
+};
+
+// Group a triangle list into meshlets of at most MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES triangles
+// Each meshlet grows across neighbouring triangles that face its way, and keeps its triangles in their earlier order
+// Reorders indices in place and returns the meshlets, whose ranges are relative to indices
+std::vector<Meshlet> buildMeshlets(uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount);
+
+// Planes (xyz inward normal, w distance) bounding what the given projection * view (* model) matrix can see, in that matrix's input space
+void calculateFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]);
+
+// Whether a bounding sphere lies wholly outside the frustum
+bool isSphereOutsideFrustum(const glm::vec4 planes[6], glm::vec4 boundingSphere);
+
+// Whether every triangle of a meshlet faces away from a camera at cameraPosition (in mesh space)
+bool isMeshletBackFacing(const Meshlet& meshlet, glm::vec3 cameraPosition);
\ No newline at end of file
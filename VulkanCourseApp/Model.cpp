@@ -1,13 +1,18 @@
 #include "Model.h"
 
+#include <limits>
+#include <algorithm>
+#include <unordered_map>
+
 Model::Model()
 {
-	model = glm::mat4(1.0f);
+	rootNode = SCENE_NO_PARENT;
 }
 
 Model::Model(std::vector<Mesh> newMeshList)
 {
-	meshList = newMeshList;
+	meshList = std::move(newMeshList);
+	rootNode = SCENE_NO_PARENT;
 }
 
 size_t Model::getMeshCount()
@@ -27,14 +32,14 @@ Mesh* Model::getMesh(size_t index)
 	}
 }
 
-void Model::setModel(glm::mat4 newModel)
+void Model::setRootNode(uint32_t newRootNode)
 {
-	model = newModel;
+	rootNode = newRootNode;
 }
 
-glm::mat4 Model::getModel()
+uint32_t Model::getRootNode()
 {
-	return model;
+	return rootNode;
 }
 
 std::vector<std::string> Model::LoadMaterials(const aiScene* scene)
@@ -69,33 +74,106 @@ std::vector<std::string> Model::LoadMaterials(const aiScene* scene)
 	return textureList;
 }
 
-std::vector<Mesh> Model::LoadNode(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, aiNode* node, const aiScene* scene, std::vector<int> materialToTexture)
+std::vector<bool> Model::CheckMaterialUVRanges(const ModelData& modelData)
 {
-	std::vector<Mesh> meshList;
+	// Materials start as in range and are cleared by any mesh sampling outside [0, 1] (which relies on the sampler repeating the texture)
+	std::vector<bool> uvsInRange(modelData.textureNames.size(), true);
+
+	// Allow UVs to sit slightly outside the edge, which an atlas tile's gutter still covers
+	const float tolerance = 0.01f;
 
-	for (size_t i = 0; i < node->mNumMeshes; i++)
+	for (const auto& meshData : modelData.meshes)
 	{
-		meshList.push_back(Model::LoadMesh(physicalDevice, logicalDevice, transferQueue, transferCommandPool, scene->mMeshes[node->mMeshes[i]], scene, materialToTexture));
+		const Vertex* vertices = modelData.vertices + meshData.firstVertex;
+
+		for (size_t i = 0; i < meshData.vertexCount && uvsInRange[meshData.materialIndex]; i++)
+		{
+			float u = vertices[i].texture.x;
+			float v = vertices[i].texture.y;
+
+			if (u < -tolerance || u > 1.0f + tolerance || v < -tolerance || v > 1.0f + tolerance)
+			{
+				uvsInRange[meshData.materialIndex] = false;
+			}
+		}
 	}
 
-	// Go through each node attached to this node and load it, then append their meshes to this node's mesh list
-	for (size_t i = 0; i < node->mNumChildren; i++)
+	return uvsInRange;
+}
+
+void Model::CalculateBoundingBox(const Vertex* vertices, size_t vertexCount, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+	boundsMin = glm::vec3(std::numeric_limits<float>::max());
+	boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+
+	for (size_t i = 0; i < vertexCount; i++)
 	{
-		std::vector<Mesh> newList = LoadNode(physicalDevice, logicalDevice, transferQueue, transferCommandPool, node->mChildren[i], scene, materialToTexture);
-		meshList.insert(meshList.end(), newList.begin(), newList.end());
+		boundsMin = glm::min(boundsMin, vertices[i].position);
+		boundsMax = glm::max(boundsMax, vertices[i].position);
 	}
+}
 
-	return meshList;
+glm::vec4 Model::CalculateBoundingSphere(const Vertex* vertices, size_t vertexCount)
+{
+	// Bounding sphere around the mesh's box, used to estimate its size on screen
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+	CalculateBoundingBox(vertices, vertexCount, boundsMin, boundsMax);
+
+	glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+	float radius = 0.0f;
+
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		radius = std::max(radius, glm::length(vertices[i].position - center));
+	}
+
+	return glm::vec4(center, radius);
 }
 
-Mesh Model::LoadMesh(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, aiMesh* mesh, const aiScene* scene, std::vector<int> materialToTexture)
+void Model::LoadNode(aiNode* node, const aiScene* scene, ModelData& modelData, std::vector<aiMesh*>& meshes)
 {
-	std::vector<Vertex> vertices;
-	std::vector<uint32_t> indices;
+	// Flatten the node hierarchy into its nodes and a (node, mesh) job per mesh, depth first with a node's meshes before its children's
+	std::vector<std::pair<aiNode*, uint32_t>> nodeStack = { { node, SCENE_NO_PARENT } };
 
-	// Resize vertex list to hold all vertices for mesh
-	vertices.resize(mesh->mNumVertices);
+	while (!nodeStack.empty())
+	{
+		aiNode* currentNode = nodeStack.back().first;
+		uint32_t parent = nodeStack.back().second;
+		nodeStack.pop_back();
+
+		// Assimp matrices are row major, GLM's are column major
+		const aiMatrix4x4& transform = currentNode->mTransformation;
+
+		NodeData nodeData;
+		nodeData.parent = parent;
+		nodeData.transform = glm::mat4(transform.a1, transform.b1, transform.c1, transform.d1,
+									   transform.a2, transform.b2, transform.c2, transform.d2,
+									   transform.a3, transform.b3, transform.c3, transform.d3,
+									   transform.a4, transform.b4, transform.c4, transform.d4);
+
+		uint32_t nodeIndex = static_cast<uint32_t>(modelData.nodes.size());
+		modelData.nodes.push_back(nodeData);
+
+		for (size_t i = 0; i < currentNode->mNumMeshes; i++)
+		{
+			MeshData meshData = {};
+			meshData.node = nodeIndex;
 
+			modelData.meshes.push_back(meshData);
+			meshes.push_back(scene->mMeshes[currentNode->mMeshes[i]]);
+		}
+
+		// Children are pushed last to first, so the first child is visited next
+		for (size_t i = currentNode->mNumChildren; i > 0; i--)
+		{
+			nodeStack.push_back({ currentNode->mChildren[i - 1], nodeIndex });
+		}
+	}
+}
+
+void Model::LoadMesh(const aiMesh* mesh, MeshData& meshData, Vertex* vertices, uint32_t* indices)
+{
 	// Go through each vertex and copy it across to vertices
 	for (size_t i = 0; i < mesh->mNumVertices; i++)
 	{
@@ -120,19 +198,356 @@ Mesh Model::LoadMesh(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, Vk
 	// Iterate over indices in triangle faces and copy across to indices
 	for (size_t i = 0; i < mesh->mNumFaces; i++)
 	{
+		const aiFace& face = mesh->mFaces[i];
+		indices = std::copy(face.mIndices, face.mIndices + face.mNumIndices, indices);
+	}
+
+	meshData.lodCount = 1;
+	meshData.lods[0] = { 0, meshData.indexCount, 0.0f };
+	meshData.firstMeshlet = 0;
+	meshData.meshletCount = 0;
+
+	// Box for culling, sphere for estimating size on screen
+	CalculateBoundingBox(vertices, meshData.vertexCount, meshData.boundsMin, meshData.boundsMax);
+	meshData.boundingSphere = CalculateBoundingSphere(vertices, meshData.vertexCount);
+}
+
+void Model::LoadModel(const aiScene* scene, ThreadPool& threadPool, ModelData& modelData)
+{
+	modelData.textureNames = LoadMaterials(scene);
+
+	modelData.nodes.clear();
+	modelData.meshes.clear();
+
+	std::vector<aiMesh*> meshes;
+	LoadNode(scene->mRootNode, scene, modelData, meshes);
+
+	// Count each mesh's indices on its own thread (faces need not be triangles)
+	threadPool.forEach(meshes.size(), [&](size_t i)
+	{
+		uint32_t indexCount = 0;
+		for (size_t j = 0; j < meshes[i]->mNumFaces; j++)
+		{
+			indexCount += meshes[i]->mFaces[j].mNumIndices;
+		}
+
+		modelData.meshes[i].indexCount = indexCount;
+	});
+
+	// Give every mesh its own range of the model's vertices and indices
+	size_t vertexCount = 0;
+	size_t indexCount = 0;
+
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		MeshData& meshData = modelData.meshes[i];
+		meshData.materialIndex = meshes[i]->mMaterialIndex;
+		meshData.firstVertex = static_cast<uint32_t>(vertexCount);
+		meshData.vertexCount = meshes[i]->mNumVertices;
+		meshData.firstIndex = static_cast<uint32_t>(indexCount);
+
+		vertexCount += meshData.vertexCount;
+		indexCount += meshData.indexCount;
+	}
+
+	// Storage is sized once (reusing whatever it already holds), so it never moves while meshes convert into it on their own threads
+	modelData.vertexStorage.resize(vertexCount);
+	modelData.indexStorage.resize(indexCount);
+	modelData.meshletStorage.clear();
+
+	threadPool.forEach(meshes.size(), [&](size_t i)
+	{
+		MeshData& meshData = modelData.meshes[i];
+		LoadMesh(meshes[i], meshData, modelData.vertexStorage.data() + meshData.firstVertex, modelData.indexStorage.data() + meshData.firstIndex);
+	});
+
+	modelData.vertices = modelData.vertexStorage.data();
+	modelData.indices = modelData.indexStorage.data();
+	modelData.meshlets = nullptr;
+
+	modelData.materialUVsInRange = CheckMaterialUVRanges(modelData);
+}
+
+void Model::MergeStaticMeshes(ModelData& modelData)
+{
+	// Each node's transform within the model (parents come first, so are complete before their children)
+	std::vector<glm::mat4> nodeTransforms(modelData.nodes.size());
+
+	for (size_t i = 0; i < modelData.nodes.size(); i++)
+	{
+		const NodeData& node = modelData.nodes[i];
+		nodeTransforms[i] = node.parent == SCENE_NO_PARENT ? node.transform : nodeTransforms[node.parent] * node.transform;
+	}
+
+	// Group meshes whose materials use the same texture file (so would be drawn with the same texture), in order of first use
+	std::vector<std::vector<size_t>> groups;
+	std::unordered_map<std::string, size_t> textureGroups;
+
+	for (size_t i = 0; i < modelData.meshes.size(); i++)
+	{
+		auto group = textureGroups.emplace(modelData.textureNames[modelData.meshes[i].materialIndex], groups.size());
+		if (group.second)
+		{
+			groups.emplace_back();
+		}
+
+		groups[group.first->second].push_back(i);
+	}
+
+	// Merge each group into one mesh, with its vertices transformed into model space so it no longer needs its nodes
+	std::vector<MeshData> mergedMeshes;
+	std::vector<Vertex> mergedVertices;
+	std::vector<uint32_t> mergedIndices;
+
+	mergedVertices.reserve(modelData.vertexStorage.size());
+	mergedIndices.reserve(modelData.indexStorage.size());
+
+	for (const auto& group : groups)
+	{
+		MeshData mergedMesh = {};
+		mergedMesh.node = 0;
+		mergedMesh.materialIndex = modelData.meshes[group[0]].materialIndex;
+		mergedMesh.firstVertex = static_cast<uint32_t>(mergedVertices.size());
+		mergedMesh.firstIndex = static_cast<uint32_t>(mergedIndices.size());
+
+		for (size_t meshIndex : group)
+		{
+			const MeshData& meshData = modelData.meshes[meshIndex];
+			const glm::mat4& transform = nodeTransforms[meshData.node];
+			uint32_t baseVertex = static_cast<uint32_t>(mergedVertices.size()) - mergedMesh.firstVertex;
+
+			for (uint32_t i = 0; i < meshData.vertexCount; i++)
+			{
+				Vertex vertex = modelData.vertexStorage[meshData.firstVertex + i];
+				vertex.position = glm::vec3(transform * glm::vec4(vertex.position, 1.0f));
+				mergedVertices.push_back(vertex);
+			}
+
+			for (uint32_t i = 0; i < meshData.indexCount; i++)
+			{
+				mergedIndices.push_back(baseVertex + modelData.indexStorage[meshData.firstIndex + i]);
+			}
+		}
+
+		mergedMesh.vertexCount = static_cast<uint32_t>(mergedVertices.size()) - mergedMesh.firstVertex;
+		mergedMesh.indexCount = static_cast<uint32_t>(mergedIndices.size()) - mergedMesh.firstIndex;
+		mergedMesh.lodCount = 1;
+		mergedMesh.lods[0] = { 0, mergedMesh.indexCount, 0.0f };
+		CalculateBoundingBox(mergedVertices.data() + mergedMesh.firstVertex, mergedMesh.vertexCount, mergedMesh.boundsMin, mergedMesh.boundsMax);
+		mergedMesh.boundingSphere = CalculateBoundingSphere(mergedVertices.data() + mergedMesh.firstVertex, mergedMesh.vertexCount);
+
+		mergedMeshes.push_back(mergedMesh);
+	}
+
+	// Every merged mesh hangs from a single identity node, moved as a whole by the model's root
+	modelData.nodes.assign(1, { SCENE_NO_PARENT, glm::mat4(1.0f) });
+	modelData.meshes = std::move(mergedMeshes);
+	modelData.vertexStorage = std::move(mergedVertices);
+	modelData.indexStorage = std::move(mergedIndices);
+	modelData.meshletStorage.clear();
+
+	modelData.vertices = modelData.vertexStorage.data();
+	modelData.indices = modelData.indexStorage.data();
+	modelData.meshlets = nullptr;
+
+	modelData.materialUVsInRange = CheckMaterialUVRanges(modelData);
+}
+
+void Model::GenerateMeshLods(ModelData& modelData, ThreadPool& threadPool)
+{
+	// Simplify each mesh on its own thread, every level straight from the full mesh so errors don't compound
+	std::vector<std::vector<uint32_t>> meshIndices(modelData.meshes.size());
+
+	threadPool.forEach(modelData.meshes.size(), [&](size_t i)
+	{
+		MeshData& meshData = modelData.meshes[i];
+		const Vertex* vertices = modelData.vertexStorage.data() + meshData.firstVertex;
+		const uint32_t* indices = modelData.indexStorage.data() + meshData.firstIndex + meshData.lods[0].firstIndex;
+		uint32_t fullIndexCount = meshData.lods[0].indexCount;
+
+		std::vector<uint32_t>& lodIndices = meshIndices[i];
+		lodIndices.assign(indices, indices + fullIndexCount);
+		meshData.lods[0] = { 0, fullIndexCount, 0.0f };
+		meshData.lodCount = 1;
+
+		float radius = meshData.boundingSphere.w;
+		std::vector<uint32_t> simplified(fullIndexCount);
+		size_t targetIndexCount = fullIndexCount;
+
+		for (uint32_t lod = 1; lod < MAX_MESH_LODS && radius > 0.0f; lod++)
+		{
+			targetIndexCount = static_cast<size_t>(targetIndexCount * MESH_LOD_REDUCTION) / 3 * 3;
+
+			float error;
+			size_t indexCount = simplifyMesh(simplified.data(), indices, fullIndexCount, vertices, meshData.vertexCount, targetIndexCount, MESH_LOD_MAX_ERROR * radius, &error);
+
+			// Stop once the error limit keeps a level from saving much over the one before
+			const MeshLod& previous = meshData.lods[lod - 1];
+			if (indexCount == 0 || indexCount > previous.indexCount * (1.0f + MESH_LOD_REDUCTION) / 2.0f)
+			{
+				break;
+			}
+
+			meshData.lods[lod] = { static_cast<uint32_t>(lodIndices.size()), static_cast<uint32_t>(indexCount), error / radius };
+			meshData.lodCount++;
+			lodIndices.insert(lodIndices.end(), simplified.begin(), simplified.begin() + indexCount);
+		}
+	});
+
+	// Lay the meshes' indices out again, each followed by its levels
+	modelData.indexStorage.clear();
+
+	for (size_t i = 0; i < modelData.meshes.size(); i++)
+	{
+		MeshData& meshData = modelData.meshes[i];
+		meshData.firstIndex = static_cast<uint32_t>(modelData.indexStorage.size());
+		meshData.indexCount = static_cast<uint32_t>(meshIndices[i].size());
+		modelData.indexStorage.insert(modelData.indexStorage.end(), meshIndices[i].begin(), meshIndices[i].end());
+	}
+
+	modelData.indices = modelData.indexStorage.data();
+}
+
+void Model::OptimizeMeshes(ModelData& modelData, ThreadPool& threadPool, VertexCacheStatistics& before, VertexCacheStatistics& after)
+{
+	// Meshes own separate ranges of the model's vertices and indices, so each can be optimised on its own thread
+	std::vector<VertexCacheStatistics> meshesBefore(modelData.meshes.size());
+	std::vector<VertexCacheStatistics> meshesAfter(modelData.meshes.size());
+
+	threadPool.forEach(modelData.meshes.size(), [&](size_t i)
+	{
+		const MeshData& meshData = modelData.meshes[i];
+		Vertex* vertices = modelData.vertexStorage.data() + meshData.firstVertex;
+		uint32_t* indices = modelData.indexStorage.data() + meshData.firstIndex;
+		const MeshLod& fullLod = meshData.lods[0];
 
-		aiFace face = mesh->mFaces[i];
-		for (size_t j = 0; j < face.mNumIndices; j++)
+		meshesBefore[i] = analyzeVertexCache(indices + fullLod.firstIndex, fullLod.indexCount, meshData.vertexCount);
+
+		// Each level is drawn on its own, so each gets its own triangle order
+		for (uint32_t lod = 0; lod < meshData.lodCount; lod++)
 		{
-			indices.push_back(face.mIndices[j]);
+			uint32_t* lodIndices = indices + meshData.lods[lod].firstIndex;
+			optimizeVertexCache(lodIndices, meshData.lods[lod].indexCount, meshData.vertexCount);
+			optimizeOverdraw(lodIndices, meshData.lods[lod].indexCount, vertices, meshData.vertexCount, MESH_OPTIMIZER_OVERDRAW_THRESHOLD);
 		}
+
+		// Vertices are shared by every level, so are ordered by first use across all of them (the full mesh coming first)
+		optimizeVertexFetch(vertices, meshData.vertexCount, indices, meshData.indexCount);
+
+		meshesAfter[i] = analyzeVertexCache(indices + fullLod.firstIndex, fullLod.indexCount, meshData.vertexCount);
+	});
+
+	for (size_t i = 0; i < modelData.meshes.size(); i++)
+	{
+		before.add(meshesBefore[i]);
+		after.add(meshesAfter[i]);
 	}
+}
 
-	// Crete new mesh with details and return
-	Mesh newMesh = Mesh(physicalDevice, logicalDevice, transferQueue, transferCommandPool, &vertices, &indices, materialToTexture[mesh->mMaterialIndex]);
+void Model::BuildMeshlets(ModelData& modelData, ThreadPool& threadPool)
+{
+	// Cluster every level of each mesh on its own thread, regrouping the level's triangles in place
+	std::vector<std::vector<Meshlet>> meshMeshlets(modelData.meshes.size());
 
-	return newMesh;
-	
+	threadPool.forEach(modelData.meshes.size(), [&](size_t i)
+	{
+		MeshData& meshData = modelData.meshes[i];
+		const Vertex* vertices = modelData.vertexStorage.data() + meshData.firstVertex;
+		uint32_t* indices = modelData.indexStorage.data() + meshData.firstIndex;
+
+		for (uint32_t lod = 0; lod < meshData.lodCount; lod++)
+		{
+			MeshLod& meshLod = meshData.lods[lod];
+			std::vector<Meshlet> lodMeshlets = buildMeshlets(indices + meshLod.firstIndex, meshLod.indexCount, vertices, meshData.vertexCount);
+
+			meshLod.firstMeshlet = static_cast<uint32_t>(meshMeshlets[i].size());
+			meshLod.meshletCount = static_cast<uint32_t>(lodMeshlets.size());
+
+			// Meshlet ranges are kept relative to the whole mesh's indices, like its levels
+			for (auto& meshlet : lodMeshlets)
+			{
+				meshlet.firstIndex += meshLod.firstIndex;
+				meshMeshlets[i].push_back(meshlet);
+			}
+		}
+	});
+
+	// Lay every mesh's meshlets out back to back
+	modelData.meshletStorage.clear();
+
+	for (size_t i = 0; i < modelData.meshes.size(); i++)
+	{
+		MeshData& meshData = modelData.meshes[i];
+		meshData.firstMeshlet = static_cast<uint32_t>(modelData.meshletStorage.size());
+		meshData.meshletCount = static_cast<uint32_t>(meshMeshlets[i].size());
+		modelData.meshletStorage.insert(modelData.meshletStorage.end(), meshMeshlets[i].begin(), meshMeshlets[i].end());
+	}
+
+	modelData.meshlets = modelData.meshletStorage.data();
+}
+
+std::vector<Mesh> Model::CreateMeshes(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, const ModelData& modelData, std::vector<int> materialToTexture, std::vector<glm::vec4> materialToUVTransform, bool compactVertices, bool indexTypeUint8)
+{
+	std::vector<Mesh> meshList;
+	std::vector<Vertex> remappedVertices;
+	std::vector<CompactVertex> quantizedVertices;
+
+	for (const auto& meshData : modelData.meshes)
+	{
+		const Vertex* vertices = modelData.vertices + meshData.firstVertex;
+		const uint32_t* indices = modelData.indices + meshData.firstIndex;
+
+		// Offset (xy) and scale (zw) placing the material's texture within its atlas, or identity for a standalone texture
+		// Only atlas textures need a remapped copy, everything else is staged straight from the model's data
+		glm::vec4 uvTransform = materialToUVTransform[meshData.materialIndex];
+
+		if (uvTransform != glm::vec4(0.0f, 0.0f, 1.0f, 1.0f))
+		{
+			remappedVertices.assign(vertices, vertices + meshData.vertexCount);
+
+			for (auto& vertex : remappedVertices)
+			{
+				vertex.texture = glm::vec2(uvTransform.x, uvTransform.y) + vertex.texture * glm::vec2(uvTransform.z, uvTransform.w);
+			}
+
+			vertices = remappedVertices.data();
+		}
+
+		// Create new mesh with details (quantized to the mesh's bounds if compact) and add it to the list
+		if (compactVertices)
+		{
+			VertexQuantization quantization = calculateVertexQuantization(vertices, meshData.vertexCount);
+			quantizedVertices.resize(meshData.vertexCount);
+			quantizeVertices(vertices, meshData.vertexCount, quantization, quantizedVertices.data());
+
+			meshList.push_back(Mesh(physicalDevice, logicalDevice, transferQueue, transferCommandPool, quantizedVertices.data(), meshData.vertexCount, indices, meshData.indexCount, materialToTexture[meshData.materialIndex], quantization, indexTypeUint8));
+		}
+
+		else
+		{
+			meshList.push_back(Mesh(physicalDevice, logicalDevice, transferQueue, transferCommandPool, vertices, meshData.vertexCount, indices, meshData.indexCount, materialToTexture[meshData.materialIndex], indexTypeUint8));
+		}
+
+		meshList.back().setTextureScale(std::max(uvTransform.z, uvTransform.w));
+		meshList.back().setBoundingSphere(meshData.boundingSphere);
+		meshList.back().setBoundingBox(meshData.boundsMin, meshData.boundsMax);
+		meshList.back().setLods(meshData.lods, meshData.lodCount);
+
+		// Coarsest level stands in for the mesh when it occludes others on the CPU
+		const MeshLod& coarsestLod = meshData.lods[meshData.lodCount - 1];
+		meshList.back().setOccluder(vertices, indices + coarsestLod.firstIndex, coarsestLod.indexCount);
+
+		// Full detail level answers ray casts, so picking hits what is drawn up close
+		const MeshLod& fullLod = meshData.lods[0];
+		meshList.back().buildTriangleBvh(vertices, indices + fullLod.firstIndex, fullLod.indexCount);
+
+		if (meshData.meshletCount > 0)
+		{
+			meshList.back().setMeshlets(modelData.meshlets + meshData.firstMeshlet, meshData.meshletCount);
+		}
+	}
+
+	return meshList;
 }
 
 void Model::destroyMeshModel()
@@ -1,10 +1,65 @@
 #pragma once
 #include <vector>
+#include <string>
 
 #include <glm/glm.hpp>
 #include <assimp/scene.h>
+#include <assimp/postprocess.h>
 
 #include "Mesh.h"
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Meshlet.h"
+#include "SceneGraph.h"
+#include "ThreadPool.h"
+
+// Post processing applied to every imported model (part of what the mesh cache stores, so changing it invalidates caches)
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices;
+
+// One node of an imported model's hierarchy (parents before children)
+struct NodeData
+{
+	uint32_t parent;																				// Within the model's nodes, SCENE_NO_PARENT for its root
+	glm::mat4 transform;																			// Relative to the parent
+};
+
+// One mesh of an imported model, as a range of its model's vertices and indices
+struct MeshData
+{
+	uint32_t node;																					// Node of the model's hierarchy placing the mesh
+	uint32_t materialIndex;
+	uint32_t firstVertex;
+	uint32_t vertexCount;
+	uint32_t firstIndex;
+	uint32_t indexCount;																			// Indices are relative to the mesh's first vertex
+	glm::vec4 boundingSphere;																		// Center (xyz) and radius (w) in mesh space
+	glm::vec3 boundsMin;																			// Box around the mesh in mesh space
+	glm::vec3 boundsMax;
+	uint32_t lodCount;
+	MeshLod lods[MAX_MESH_LODS];																	// Ranges within the mesh's indices, stored back to back, finest first
+	uint32_t firstMeshlet;																			// Range of the model's meshlets (every level's, each level's range in its MeshLod)
+	uint32_t meshletCount;
+};
+
+// Processed model ready to upload, either imported with Assimp or read from its mesh cache
+struct ModelData
+{
+	std::vector<std::string> textureNames;															// Diffuse texture file of each material (empty if none)
+	std::vector<bool> materialUVsInRange;															// Whether each material's UVs stay within [0, 1]
+	std::vector<NodeData> nodes;
+	std::vector<MeshData> meshes;
+
+	// Every mesh's vertices and indices back to back, pointing into the storage below or into the mapped cache file
+	const Vertex* vertices = nullptr;
+	const uint32_t* indices = nullptr;
+	const Meshlet* meshlets = nullptr;																// Null if meshlets weren't built
+
+	std::vector<Vertex> vertexStorage;
+	std::vector<uint32_t> indexStorage;
+	std::vector<Meshlet> meshletStorage;
+	MappedFile cacheFile;
+};
 
 class Model
 {
@@ -12,16 +67,30 @@ public:
 
 	Model();
 	Model(std::vector<Mesh> newMeshList);
+	Model(const Model&) = default;
+	Model(Model&&) = default;																		// Models are moved into the renderer's list rather than copied
+	Model& operator=(const Model&) = default;
+	Model& operator=(Model&&) = default;
 
 	size_t getMeshCount();
 	Mesh* getMesh(size_t index);
 
-	void setModel(glm::mat4 newModel);
-	glm::mat4 getModel();
+	// Scene node holding the whole model, whose transform places it in the world
+	void setRootNode(uint32_t newRootNode);
+	uint32_t getRootNode();
 
 	static std::vector<std::string> LoadMaterials(const aiScene* scene);
-	static std::vector<Mesh> LoadNode(VkPhysicalDevice, VkDevice newDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, aiNode* node, const aiScene* scene, std::vector<int> materialToTexture);
-	static Mesh LoadMesh(VkPhysicalDevice, VkDevice newDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, aiMesh* mesh, const aiScene* scene, std::vector<int> materialToTexture);
+	static std::vector<bool> CheckMaterialUVRanges(const ModelData& modelData);
+	static void CalculateBoundingBox(const Vertex* vertices, size_t vertexCount, glm::vec3& boundsMin, glm::vec3& boundsMax);
+	static glm::vec4 CalculateBoundingSphere(const Vertex* vertices, size_t vertexCount);
+	static void LoadNode(aiNode* node, const aiScene* scene, ModelData& modelData, std::vector<aiMesh*>& meshes);
+	static void LoadMesh(const aiMesh* mesh, MeshData& meshData, Vertex* vertices, uint32_t* indices);
+	static void LoadModel(const aiScene* scene, ThreadPool& threadPool, ModelData& modelData);
+	static void MergeStaticMeshes(ModelData& modelData);
+	static void GenerateMeshLods(ModelData& modelData, ThreadPool& threadPool);
+	static void OptimizeMeshes(ModelData& modelData, ThreadPool& threadPool, VertexCacheStatistics& before, VertexCacheStatistics& after);
+	static void BuildMeshlets(ModelData& modelData, ThreadPool& threadPool);
+	static std::vector<Mesh> CreateMeshes(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, const ModelData& modelData, std::vector<int> materialToTexture, std::vector<glm::vec4> materialToUVTransform, bool compactVertices, bool indexTypeUint8);
 
 	void destroyMeshModel();
 	~Model();
@@ -29,7 +98,7 @@ public:
 
 private:
 	std::vector<Mesh> meshList;
-	glm::mat4 model;
+	uint32_t rootNode;
 
 };
 
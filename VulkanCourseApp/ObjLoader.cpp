@@ -0,0 +1,602 @@
+#include "ObjLoader.h"
+
+#include <charconv>
+#include <cstring>
+#include <cctype>
+#include <fstream>
+#include <algorithm>
+#include <unordered_map>
+
+namespace
+{
+	const uint32_t OBJ_NO_TEXCOORD = 0xFFFFFFFF;
+	const uint64_t OBJ_EMPTY_SLOT = 0xFFFFFFFFFFFFFFFFull;
+	const size_t OBJ_CHUNKS_PER_THREAD = 4;																// Extra chunks even out uneven lines across threads
+	const size_t OBJ_MIN_CHUNK_SIZE = 64 * 1024;
+
+	struct ObjCorner
+	{
+		uint32_t position;
+		uint32_t texcoord;																			// OBJ_NO_TEXCOORD if the face gave none
+	};
+
+	// Faces following a group, object or material statement (or the start of a chunk)
+	struct ObjRun
+	{
+		bool startsGroup = false;
+		bool setsMaterial = false;
+		std::string material;
+		std::vector<ObjCorner> corners;																// Triangles, three corners each
+	};
+
+	struct ObjChunk
+	{
+		const char* begin;
+		const char* end;
+
+		size_t positionCount = 0;
+		size_t texcoordCount = 0;
+		size_t positionBase = 0;																	// Positions and texcoords in all earlier chunks
+		size_t texcoordBase = 0;
+
+		std::vector<std::string> libraries;
+		std::vector<ObjRun> runs;
+	};
+
+	struct ObjMesh
+	{
+		uint32_t materialIndex;
+		std::vector<const std::vector<ObjCorner>*> pieces;											// Runs making up the mesh, in order
+
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		glm::vec4 boundingSphere;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+	};
+
+	bool isSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	const char* skipSpaces(const char* p, const char* end)
+	{
+		while (p < end && isSpace(*p))
+		{
+			p++;
+		}
+
+		return p;
+	}
+
+	const char* skipToken(const char* p, const char* end)
+	{
+		while (p < end && !isSpace(*p))
+		{
+			p++;
+		}
+
+		return p;
+	}
+
+	const char* findLineEnd(const char* p, const char* end)
+	{
+		const void* newline = memchr(p, '\n', end - p);
+		return newline ? static_cast<const char*>(newline) : end;
+	}
+
+	// Start of the line after the one ending at lineEnd
+	const char* nextLine(const char* lineEnd, const char* end)
+	{
+		return lineEnd < end ? lineEnd + 1 : end;
+	}
+
+	bool isKeyword(const char* token, const char* tokenEnd, const char* keyword)
+	{
+		size_t length = strlen(keyword);
+		return (size_t)(tokenEnd - token) == length && memcmp(token, keyword, length) == 0;
+	}
+
+	// Rest of the line with surrounding whitespace removed
+	std::string readRestOfLine(const char* p, const char* lineEnd)
+	{
+		p = skipSpaces(p, lineEnd);
+
+		while (lineEnd > p && isSpace(lineEnd[-1]))
+		{
+			lineEnd--;
+		}
+
+		return std::string(p, lineEnd);
+	}
+
+	bool parseFloat(const char*& p, const char* end, float& value)
+	{
+		p = skipSpaces(p, end);
+
+		if (p < end && *p == '+')
+		{
+			p++;
+		}
+
+		std::from_chars_result result = std::from_chars(p, end, value);
+
+		// Values too small or large for a float are flushed to zero rather than rejected
+		if (result.ec == std::errc::result_out_of_range)
+		{
+			value = 0.0f;
+		}
+
+		else if (result.ec != std::errc())
+		{
+			return false;
+		}
+
+		p = result.ptr;
+		return true;
+	}
+
+	// OBJ indices start at 1, or count back from the latest element when negative
+	bool parseIndex(const char*& p, const char* end, size_t count, uint32_t& index)
+	{
+		long long value;
+		std::from_chars_result result = std::from_chars(p, end, value);
+
+		if (result.ec != std::errc() || value == 0)
+		{
+			return false;
+		}
+
+		long long resolved = value > 0 ? value - 1 : (long long)count + value;
+
+		if (resolved < 0 || resolved >= OBJ_NO_TEXCOORD)
+		{
+			return false;
+		}
+
+		p = result.ptr;
+		index = static_cast<uint32_t>(resolved);
+		return true;
+	}
+
+	// First pass, counting positions and texcoords so every chunk knows where its own begin
+	void countChunkVertices(ObjChunk& chunk)
+	{
+		const char* lineEnd;
+
+		for (const char* line = chunk.begin; line < chunk.end; line = nextLine(lineEnd, chunk.end))
+		{
+			lineEnd = findLineEnd(line, chunk.end);
+			const char* token = skipSpaces(line, lineEnd);
+			const char* tokenEnd = skipToken(token, lineEnd);
+
+			if (isKeyword(token, tokenEnd, "v"))
+			{
+				chunk.positionCount++;
+			}
+
+			else if (isKeyword(token, tokenEnd, "vt"))
+			{
+				chunk.texcoordCount++;
+			}
+		}
+	}
+
+	// Second pass, writing the chunk's positions and texcoords into place and collecting its faces
+	void parseChunk(ObjChunk& chunk, std::vector<glm::vec3>& positions, std::vector<glm::vec2>& texcoords, const std::string& fileName)
+	{
+		size_t positionIndex = chunk.positionBase;
+		size_t texcoordIndex = chunk.texcoordBase;
+
+		// Faces before the chunk's first statement continue whatever mesh the previous chunk ended in
+		chunk.runs.emplace_back();
+
+		std::vector<ObjCorner> polygon;
+
+		const char* lineEnd;
+
+		for (const char* line = chunk.begin; line < chunk.end; line = nextLine(lineEnd, chunk.end))
+		{
+			lineEnd = findLineEnd(line, chunk.end);
+			const char* token = skipSpaces(line, lineEnd);
+			const char* tokenEnd = skipToken(token, lineEnd);
+			const char* p = tokenEnd;
+
+			if (isKeyword(token, tokenEnd, "v"))
+			{
+				glm::vec3 position;
+
+				if (!parseFloat(p, lineEnd, position.x) || !parseFloat(p, lineEnd, position.y) || !parseFloat(p, lineEnd, position.z))
+				{
+					throw std::runtime_error("Failed to parse model vertex! (" + fileName + ")");
+				}
+
+				positions[positionIndex++] = position;
+			}
+
+			else if (isKeyword(token, tokenEnd, "vt"))
+			{
+				// V (and even U) may be left out, defaulting to 0
+				glm::vec2 texcoord = glm::vec2(0.0f);
+
+				if (parseFloat(p, lineEnd, texcoord.x))
+				{
+					parseFloat(p, lineEnd, texcoord.y);
+				}
+
+				texcoords[texcoordIndex++] = texcoord;
+			}
+
+			else if (isKeyword(token, tokenEnd, "f"))
+			{
+				polygon.clear();
+
+				for (p = skipSpaces(p, lineEnd); p < lineEnd; p = skipSpaces(p, lineEnd))
+				{
+					ObjCorner corner;
+					corner.texcoord = OBJ_NO_TEXCOORD;
+
+					// Corners are position, position/texcoord, position//normal or position/texcoord/normal
+					if (!parseIndex(p, lineEnd, positionIndex, corner.position))
+					{
+						throw std::runtime_error("Failed to parse model face! (" + fileName + ")");
+					}
+
+					if (p < lineEnd && *p == '/' && ++p < lineEnd && *p != '/' && !isSpace(*p) && !parseIndex(p, lineEnd, texcoordIndex, corner.texcoord))
+					{
+						throw std::runtime_error("Failed to parse model face! (" + fileName + ")");
+					}
+
+					// Normals are not used
+					p = skipToken(p, lineEnd);
+
+					polygon.push_back(corner);
+				}
+
+				// Triangulate as a fan around the first corner
+				std::vector<ObjCorner>& corners = chunk.runs.back().corners;
+
+				for (size_t i = 2; i < polygon.size(); i++)
+				{
+					corners.push_back(polygon[0]);
+					corners.push_back(polygon[i - 1]);
+					corners.push_back(polygon[i]);
+				}
+			}
+
+			else if (isKeyword(token, tokenEnd, "usemtl"))
+			{
+				ObjRun run;
+				run.setsMaterial = true;
+				run.material = readRestOfLine(p, lineEnd);
+
+				chunk.runs.push_back(std::move(run));
+			}
+
+			else if (isKeyword(token, tokenEnd, "g") || isKeyword(token, tokenEnd, "o"))
+			{
+				ObjRun run;
+				run.startsGroup = true;
+
+				chunk.runs.push_back(std::move(run));
+			}
+
+			else if (isKeyword(token, tokenEnd, "mtllib"))
+			{
+				for (p = skipSpaces(p, lineEnd); p < lineEnd; p = skipSpaces(p, lineEnd))
+				{
+					const char* nameEnd = skipToken(p, lineEnd);
+					chunk.libraries.push_back(std::string(p, nameEnd));
+					p = nameEnd;
+				}
+			}
+		}
+	}
+
+	// Read each material's diffuse texture file name from an MTL library
+	void loadObjMaterials(const std::string& fileName, std::vector<std::string>& materialNames, std::vector<std::string>& textureNames)
+	{
+		std::ifstream file(fileName);
+
+		// A missing library leaves its materials untextured, as Assimp does
+		if (!file.is_open())
+		{
+			return;
+		}
+
+		std::string line;
+		while (std::getline(file, line))
+		{
+			const char* lineEnd = line.data() + line.size();
+			const char* token = skipSpaces(line.data(), lineEnd);
+			const char* tokenEnd = skipToken(token, lineEnd);
+
+			if (isKeyword(token, tokenEnd, "newmtl"))
+			{
+				materialNames.push_back(readRestOfLine(tokenEnd, lineEnd));
+				textureNames.push_back("");
+			}
+
+			else if (isKeyword(token, tokenEnd, "map_Kd") && !textureNames.empty())
+			{
+				// Skip each texture option (such as "-s 1 1 1") to reach the file name
+				const char* p = skipSpaces(tokenEnd, lineEnd);
+				float value;
+
+				while (p < lineEnd && *p == '-')
+				{
+					p = skipSpaces(skipToken(p, lineEnd), lineEnd);
+
+					// Then its arguments, which are numbers or on/off
+					for (const char* argument = p; p < lineEnd; argument = p)
+					{
+						const char* argumentEnd = skipToken(p, lineEnd);
+
+						if (!isKeyword(p, argumentEnd, "on") && !isKeyword(p, argumentEnd, "off") && !(parseFloat(argument, lineEnd, value) && argument == argumentEnd))
+						{
+							break;
+						}
+
+						p = skipSpaces(argumentEnd, lineEnd);
+					}
+				}
+
+				// Cut off any directory information to only include the file name at the end
+				std::string path = readRestOfLine(p, lineEnd);
+				textureNames.back() = path.substr(path.find_last_of("\\/") + 1);
+			}
+		}
+	}
+
+	// Join identical corners into one vertex each, indexing them in face order
+	void buildObjMesh(ObjMesh& mesh, const std::vector<glm::vec3>& positions, const std::vector<glm::vec2>& texcoords, const std::string& fileName)
+	{
+		size_t cornerCount = 0;
+		for (const auto* piece : mesh.pieces)
+		{
+			cornerCount += piece->size();
+		}
+
+		// Open addressing table from (position, texcoord) to vertex index, kept at most half full
+		size_t tableSize = 2;
+		uint32_t tableBits = 1;
+
+		while (tableSize < cornerCount * 2)
+		{
+			tableSize *= 2;
+			tableBits++;
+		}
+
+		std::vector<uint64_t> keys(tableSize, OBJ_EMPTY_SLOT);
+		std::vector<uint32_t> values(tableSize);
+
+		mesh.indices.reserve(cornerCount);
+
+		for (const auto* piece : mesh.pieces)
+		{
+			for (const auto& corner : *piece)
+			{
+				if (corner.position >= positions.size() || (corner.texcoord != OBJ_NO_TEXCOORD && corner.texcoord >= texcoords.size()))
+				{
+					throw std::runtime_error("Failed to load model, face uses a missing vertex! (" + fileName + ")");
+				}
+
+				uint64_t key = ((uint64_t)corner.position << 32) | corner.texcoord;
+				size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ull) >> (64 - tableBits));
+
+				while (keys[slot] != key && keys[slot] != OBJ_EMPTY_SLOT)
+				{
+					slot = (slot + 1) & (tableSize - 1);
+				}
+
+				if (keys[slot] == OBJ_EMPTY_SLOT)
+				{
+					Vertex vertex;
+					vertex.position = positions[corner.position];
+					vertex.color = { 1.0f, 1.0f, 1.0f };
+
+					// Flip V to Vulkan's top left origin
+					if (corner.texcoord != OBJ_NO_TEXCOORD)
+					{
+						vertex.texture = { texcoords[corner.texcoord].x, 1.0f - texcoords[corner.texcoord].y };
+					}
+
+					else
+					{
+						vertex.texture = { 0.0f, 0.0f };
+					}
+
+					keys[slot] = key;
+					values[slot] = static_cast<uint32_t>(mesh.vertices.size());
+					mesh.vertices.push_back(vertex);
+				}
+
+				mesh.indices.push_back(values[slot]);
+			}
+		}
+
+		Model::CalculateBoundingBox(mesh.vertices.data(), mesh.vertices.size(), mesh.boundsMin, mesh.boundsMax);
+		mesh.boundingSphere = Model::CalculateBoundingSphere(mesh.vertices.data(), mesh.vertices.size());
+	}
+}
+
+void loadObjModel(const std::string& fileName, ThreadPool& threadPool, ModelData& modelData)
+{
+	MappedFile file;
+
+	if (!file.open(fileName))
+	{
+		throw std::runtime_error("Failed to load model! (" + fileName + ")");
+	}
+
+	const char* data = reinterpret_cast<const char*>(file.getData());
+	const char* dataEnd = data + file.getSize();
+
+	// Split the file into chunks of whole lines
+	size_t chunkCount = std::max<size_t>(1, std::min(threadPool.getThreadCount() * OBJ_CHUNKS_PER_THREAD, file.getSize() / OBJ_MIN_CHUNK_SIZE));
+	std::vector<ObjChunk> chunks;
+
+	for (const char* chunkBegin = data; chunkBegin < dataEnd; )
+	{
+		const char* chunkEnd = dataEnd;
+
+		if (chunks.size() + 1 < chunkCount)
+		{
+			chunkEnd = nextLine(findLineEnd(std::max(chunkBegin, data + file.getSize() * (chunks.size() + 1) / chunkCount), dataEnd), dataEnd);
+		}
+
+		ObjChunk chunk;
+		chunk.begin = chunkBegin;
+		chunk.end = chunkEnd;
+
+		chunks.push_back(std::move(chunk));
+		chunkBegin = chunkEnd;
+	}
+
+	// Count each chunk's positions and texcoords, then parse every chunk straight into the shared arrays
+	threadPool.forEach(chunks.size(), [&chunks](size_t i) { countChunkVertices(chunks[i]); });
+
+	size_t positionCount = 0;
+	size_t texcoordCount = 0;
+
+	for (auto& chunk : chunks)
+	{
+		chunk.positionBase = positionCount;
+		chunk.texcoordBase = texcoordCount;
+		positionCount += chunk.positionCount;
+		texcoordCount += chunk.texcoordCount;
+	}
+
+	std::vector<glm::vec3> positions(positionCount);
+	std::vector<glm::vec2> texcoords(texcoordCount);
+
+	threadPool.forEach(chunks.size(), [&](size_t i) { parseChunk(chunks[i], positions, texcoords, fileName); });
+
+	// Load the materials from every library named, found relative to the OBJ file
+	std::string directory = fileName.substr(0, fileName.find_last_of("\\/") + 1);
+	std::vector<std::string> materialNames;
+	std::vector<std::string> textureNames;
+
+	for (const auto& chunk : chunks)
+	{
+		for (const auto& library : chunk.libraries)
+		{
+			loadObjMaterials(directory + library, materialNames, textureNames);
+		}
+	}
+
+	std::unordered_map<std::string, uint32_t> materialIndices;
+	for (size_t i = 0; i < materialNames.size(); i++)
+	{
+		materialIndices.emplace(materialNames[i], static_cast<uint32_t>(i));
+	}
+
+	// Walk the runs in file order, starting a new mesh on each group or material change
+	// Faces with no material (or an unknown one) get an untextured material of their own
+	std::vector<ObjMesh> meshes;
+	int64_t currentMaterial = -1;
+	bool meshOpen = false;
+
+	for (auto& chunk : chunks)
+	{
+		for (auto& run : chunk.runs)
+		{
+			if (run.startsGroup)
+			{
+				meshOpen = false;
+			}
+
+			if (run.setsMaterial)
+			{
+				auto material = materialIndices.find(run.material);
+
+				if (material == materialIndices.end())
+				{
+					material = materialIndices.emplace(run.material, static_cast<uint32_t>(textureNames.size())).first;
+					textureNames.push_back("");
+				}
+
+				if (material->second != currentMaterial)
+				{
+					currentMaterial = material->second;
+					meshOpen = false;
+				}
+			}
+
+			if (run.corners.empty())
+			{
+				continue;
+			}
+
+			if (currentMaterial < 0)
+			{
+				currentMaterial = static_cast<int64_t>(textureNames.size());
+				textureNames.push_back("");
+			}
+
+			if (!meshOpen)
+			{
+				ObjMesh mesh;
+				mesh.materialIndex = static_cast<uint32_t>(currentMaterial);
+
+				meshes.push_back(std::move(mesh));
+				meshOpen = true;
+			}
+
+			meshes.back().pieces.push_back(&run.corners);
+		}
+	}
+
+	// Build each mesh's vertices and indices
+	threadPool.forEach(meshes.size(), [&](size_t i) { buildObjMesh(meshes[i], positions, texcoords, fileName); });
+
+	// Lay every mesh out back to back
+	modelData.textureNames = textureNames;
+	modelData.nodes.assign(1, { SCENE_NO_PARENT, glm::mat4(1.0f) });								// OBJ files have no hierarchy, every mesh hangs from one node
+	modelData.meshes.clear();
+	modelData.vertexStorage.clear();
+	modelData.indexStorage.clear();
+	modelData.meshletStorage.clear();
+
+	for (const auto& mesh : meshes)
+	{
+		MeshData meshData;
+		meshData.node = 0;
+		meshData.materialIndex = mesh.materialIndex;
+		meshData.firstVertex = static_cast<uint32_t>(modelData.vertexStorage.size());
+		meshData.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+		meshData.firstIndex = static_cast<uint32_t>(modelData.indexStorage.size());
+		meshData.indexCount = static_cast<uint32_t>(mesh.indices.size());
+		meshData.boundingSphere = mesh.boundingSphere;
+		meshData.boundsMin = mesh.boundsMin;
+		meshData.boundsMax = mesh.boundsMax;
+		meshData.lodCount = 1;
+		meshData.lods[0] = { 0, meshData.indexCount, 0.0f };
+		meshData.firstMeshlet = 0;
+		meshData.meshletCount = 0;
+
+		modelData.vertexStorage.insert(modelData.vertexStorage.end(), mesh.vertices.begin(), mesh.vertices.end());
+		modelData.indexStorage.insert(modelData.indexStorage.end(), mesh.indices.begin(), mesh.indices.end());
+		modelData.meshes.push_back(meshData);
+	}
+
+	modelData.vertices = modelData.vertexStorage.data();
+	modelData.indices = modelData.indexStorage.data();
+	modelData.meshlets = nullptr;
+
+	modelData.materialUVsInRange = Model::CheckMaterialUVRanges(modelData);
+}
+
+bool isObjFile(const std::string& fileName)
+{
+	if (fileName.size() < 4)
+	{
+		return false;
+	}
+
+	std::string extension = fileName.substr(fileName.size() - 4);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+
+	return extension == ".obj";
+}
\ No newline at end of file
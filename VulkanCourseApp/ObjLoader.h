@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+#include "Model.h"
+#include "ThreadPool.h"
+
+// Native Wavefront OBJ/MTL loader, used in place of Assimp for .obj files
+// The file is memory mapped and split into chunks parsed in parallel, then each mesh's vertices are deduplicated in parallel
+// Output matches importing with MODEL_IMPORT_FLAGS: polygons fan triangulated, V flipped and identical vertices joined
+// Meshes are split on each group, object and material change, in file order
+
+// Load an OBJ file (and the MTL libraries it names, relative to it) into modelData
+void loadObjModel(const std::string& fileName, ThreadPool& threadPool, ModelData& modelData);
+
+// Whether a model file should go through loadObjModel
+bool isObjFile(const std::string& fileName);
\ No newline at end of file
@@ -0,0 +1,481 @@
+#include "OcclusionBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef TRANSFORM_MATH_SSE
+#include <emmintrin.h>
+#endif
+
+const uint32_t OCCLUSION_TILES_PER_ROW = OCCLUSION_BUFFER_WIDTH / OCCLUSION_TILE_WIDTH;
+const uint32_t OCCLUSION_TILE_ROWS = OCCLUSION_BUFFER_HEIGHT / OCCLUSION_TILE_HEIGHT;
+const float OCCLUSION_SPAN_LIMIT = 1.0e30f;																// Beyond any pixel, bounding rows no edge limits
+
+// Edge of a triangle in pixel coordinates, a * x + b * y + c being at least zero on the triangle's side
+struct OcclusionEdge
+{
+	float a;
+	float b;
+	float c;
+};
+
+// First and last pixel column inside all three edges on each pixel row of a tile row (first past last where none are),
+// clamped to [firstColumn, lastColumn]. Pixels are sampled at their centers
+static void calculateRowSpans(const OcclusionEdge edges[3], uint32_t firstRow, int firstColumn, int lastColumn, int spanFirst[OCCLUSION_TILE_HEIGHT], int spanLast[OCCLUSION_TILE_HEIGHT])
+{
+#ifdef TRANSFORM_MATH_SSE
+	// A pixel row per lane
+	const __m128 zero = _mm_setzero_ps();
+	__m128 y = _mm_add_ps(_mm_set1_ps(static_cast<float>(firstRow) + 0.5f), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+	__m128 left = _mm_set1_ps(-OCCLUSION_SPAN_LIMIT);
+	__m128 right = _mm_set1_ps(OCCLUSION_SPAN_LIMIT);
+
+	for (size_t i = 0; i < 3; i++)
+	{
+		__m128 offset = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edges[i].b), y), _mm_set1_ps(edges[i].c));
+
+		// Edges leaning one way bound the row on the left, the other way on the right, and level edges exclude rows wholly
+		if (edges[i].a > 0.0f)
+		{
+			left = _mm_max_ps(left, _mm_div_ps(_mm_sub_ps(zero, offset), _mm_set1_ps(edges[i].a)));
+		}
+		else if (edges[i].a < 0.0f)
+		{
+			right = _mm_min_ps(right, _mm_div_ps(_mm_sub_ps(zero, offset), _mm_set1_ps(edges[i].a)));
+		}
+		else
+		{
+			__m128 outside = _mm_cmplt_ps(offset, zero);
+			left = _mm_or_ps(_mm_and_ps(outside, _mm_set1_ps(OCCLUSION_SPAN_LIMIT)), _mm_andnot_ps(outside, left));
+		}
+	}
+
+	// First column is ceil(left - 0.5), last is floor(right + 0.5) - 1, clamped first so the values stay small and positive for truncation to round
+	__m128 first = _mm_min_ps(_mm_max_ps(_mm_sub_ps(left, _mm_set1_ps(0.5f)), _mm_set1_ps(static_cast<float>(firstColumn))), _mm_set1_ps(static_cast<float>(lastColumn + 1)));
+	__m128i firstTruncated = _mm_cvttps_epi32(first);
+	firstTruncated = _mm_sub_epi32(firstTruncated, _mm_castps_si128(_mm_cmplt_ps(_mm_cvtepi32_ps(firstTruncated), first)));
+
+	__m128 last = _mm_min_ps(_mm_max_ps(_mm_add_ps(right, _mm_set1_ps(0.5f)), _mm_set1_ps(static_cast<float>(firstColumn))), _mm_set1_ps(static_cast<float>(lastColumn + 1)));
+	__m128i lastTruncated = _mm_sub_epi32(_mm_cvttps_epi32(last), _mm_set1_epi32(1));
+
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(spanFirst), firstTruncated);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(spanLast), lastTruncated);
+#else
+	for (uint32_t row = 0; row < OCCLUSION_TILE_HEIGHT; row++)
+	{
+		float y = static_cast<float>(firstRow + row) + 0.5f;
+		float left = -OCCLUSION_SPAN_LIMIT;
+		float right = OCCLUSION_SPAN_LIMIT;
+
+		for (size_t i = 0; i < 3; i++)
+		{
+			float offset = edges[i].b * y + edges[i].c;
+
+			if (edges[i].a > 0.0f)
+			{
+				left = std::max(left, -offset / edges[i].a);
+			}
+			else if (edges[i].a < 0.0f)
+			{
+				right = std::min(right, -offset / edges[i].a);
+			}
+			else if (offset < 0.0f)
+			{
+				left = OCCLUSION_SPAN_LIMIT;
+			}
+		}
+
+		spanFirst[row] = static_cast<int>(std::ceil(std::min(std::max(left - 0.5f, static_cast<float>(firstColumn)), static_cast<float>(lastColumn + 1))));
+		spanLast[row] = static_cast<int>(std::floor(std::min(std::max(right + 0.5f, static_cast<float>(firstColumn)), static_cast<float>(lastColumn + 1)))) - 1;
+	}
+#endif
+}
+
+// Row masks of the pixels within each row's span in the tile starting at column tileColumn, returning whether any are set
+static bool calculateTileCoverage(const int spanFirst[OCCLUSION_TILE_HEIGHT], const int spanLast[OCCLUSION_TILE_HEIGHT], int tileColumn, uint32_t coverage[OCCLUSION_TILE_HEIGHT])
+{
+	uint32_t covered = 0;
+
+	for (uint32_t row = 0; row < OCCLUSION_TILE_HEIGHT; row++)
+	{
+		int first = std::max(spanFirst[row] - tileColumn, 0);
+		int last = std::min(spanLast[row] - tileColumn, static_cast<int>(OCCLUSION_TILE_WIDTH) - 1);
+
+		coverage[row] = first > last ? 0 : (0xFFFFFFFFu >> (31 - (last - first))) << first;
+		covered |= coverage[row];
+	}
+
+	return covered != 0;
+}
+
+OcclusionBuffer::OcclusionBuffer()
+{
+	tiles.resize(OCCLUSION_TILES_PER_ROW * OCCLUSION_TILE_ROWS);
+	clear();
+}
+
+void OcclusionBuffer::clear()
+{
+	for (auto& tile : tiles)
+	{
+		std::fill(tile.coverage, tile.coverage + OCCLUSION_TILE_HEIGHT, 0u);
+		tile.workingDepth = 0.0f;
+		tile.farDepth = 1.0f;
+	}
+}
+
+void OcclusionBuffer::renderOccluder(const glm::mat4& modelViewProjection, const glm::vec3* positions, size_t positionCount, const uint32_t* indices, size_t indexCount)
+{
+	// Bring every vertex to pixel coordinates and depth once, as vertices are shared between triangles
+	const float halfWidth = OCCLUSION_BUFFER_WIDTH * 0.5f;
+	const float halfHeight = OCCLUSION_BUFFER_HEIGHT * 0.5f;
+
+	screenVertices.resize(positionCount);
+	size_t i = 0;
+
+#ifdef TRANSFORM_MATH_SSE
+	// Four vertices at a time, a component per register
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	for (; i + 4 <= positionCount; i += 4)
+	{
+		__m128 x = _mm_set_ps(positions[i + 3].x, positions[i + 2].x, positions[i + 1].x, positions[i].x);
+		__m128 y = _mm_set_ps(positions[i + 3].y, positions[i + 2].y, positions[i + 1].y, positions[i].y);
+		__m128 z = _mm_set_ps(positions[i + 3].z, positions[i + 2].z, positions[i + 1].z, positions[i].z);
+
+		__m128 clip[4];
+
+		for (int row = 0; row < 4; row++)
+		{
+			clip[row] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(modelViewProjection[0][row]), x), _mm_mul_ps(_mm_set1_ps(modelViewProjection[1][row]), y)),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(modelViewProjection[2][row]), z), _mm_set1_ps(modelViewProjection[3][row])));
+		}
+
+		// Behind the near plane (where w may be zero, so the division's result is never used)
+		__m128 inFront = _mm_and_ps(_mm_cmpge_ps(clip[2], zero), one);
+		__m128 inverseW = _mm_div_ps(one, clip[3]);
+
+		__m128 screenX = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(clip[0], inverseW), _mm_set1_ps(halfWidth)), _mm_set1_ps(halfWidth));
+		__m128 screenY = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(clip[1], inverseW), _mm_set1_ps(halfHeight)), _mm_set1_ps(halfHeight));
+		__m128 depth = _mm_mul_ps(clip[2], inverseW);
+
+		_MM_TRANSPOSE4_PS(screenX, screenY, depth, inFront);
+
+		_mm_storeu_ps(&screenVertices[i].x, screenX);
+		_mm_storeu_ps(&screenVertices[i + 1].x, screenY);
+		_mm_storeu_ps(&screenVertices[i + 2].x, depth);
+		_mm_storeu_ps(&screenVertices[i + 3].x, inFront);
+	}
+#endif
+
+	for (; i < positionCount; i++)
+	{
+		glm::vec4 clip = modelViewProjection * glm::vec4(positions[i], 1.0f);
+
+		if (clip.z < 0.0f)
+		{
+			screenVertices[i] = glm::vec4(0.0f);
+			continue;
+		}
+
+		screenVertices[i] = glm::vec4((clip.x / clip.w) * halfWidth + halfWidth, (clip.y / clip.w) * halfHeight + halfHeight, clip.z / clip.w, 1.0f);
+	}
+
+	// Triangles reaching behind the near plane would need clipping, so are left out (drawing less only hides less)
+	for (size_t j = 0; j + 3 <= indexCount; j += 3)
+	{
+		const glm::vec4& vertex0 = screenVertices[indices[j]];
+		const glm::vec4& vertex1 = screenVertices[indices[j + 1]];
+		const glm::vec4& vertex2 = screenVertices[indices[j + 2]];
+
+		if (vertex0.w == 0.0f || vertex1.w == 0.0f || vertex2.w == 0.0f)
+		{
+			continue;
+		}
+
+		renderTriangle(vertex0, vertex1, vertex2);
+	}
+}
+
+bool OcclusionBuffer::isBoxVisible(const glm::mat4& viewProjection, glm::vec3 boundsMin, glm::vec3 boundsMax) const
+{
+	// Screen rectangle around the box's corners, and the nearest depth of any of them
+	float minX, minY, maxX, maxY, nearestDepth;
+
+#ifdef TRANSFORM_MATH_SSE
+	// Four corners at a time, the near face then the far one
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	__m128 x = _mm_set_ps(boundsMax.x, boundsMin.x, boundsMax.x, boundsMin.x);
+	__m128 y = _mm_set_ps(boundsMax.y, boundsMax.y, boundsMin.y, boundsMin.y);
+	__m128 lowX = _mm_set1_ps(OCCLUSION_SPAN_LIMIT), lowY = lowX, lowDepth = lowX;
+	__m128 highX = _mm_set1_ps(-OCCLUSION_SPAN_LIMIT), highY = highX;
+
+	for (int face = 0; face < 2; face++)
+	{
+		__m128 z = _mm_set1_ps(face == 0 ? boundsMin.z : boundsMax.z);
+		__m128 clip[4];
+
+		for (int row = 0; row < 4; row++)
+		{
+			clip[row] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(viewProjection[0][row]), x), _mm_mul_ps(_mm_set1_ps(viewProjection[1][row]), y)),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(viewProjection[2][row]), z), _mm_set1_ps(viewProjection[3][row])));
+		}
+
+		// A corner behind the near plane leaves the box unbounded on screen
+		if (_mm_movemask_ps(_mm_cmplt_ps(clip[2], zero)))
+		{
+			return true;
+		}
+
+		__m128 inverseW = _mm_div_ps(one, clip[3]);
+		__m128 ndcX = _mm_mul_ps(clip[0], inverseW);
+		__m128 ndcY = _mm_mul_ps(clip[1], inverseW);
+
+		lowX = _mm_min_ps(lowX, ndcX);
+		highX = _mm_max_ps(highX, ndcX);
+		lowY = _mm_min_ps(lowY, ndcY);
+		highY = _mm_max_ps(highY, ndcY);
+		lowDepth = _mm_min_ps(lowDepth, _mm_mul_ps(clip[2], inverseW));
+	}
+
+	alignas(16) float lanes[5][4];
+	_mm_store_ps(lanes[0], lowX);
+	_mm_store_ps(lanes[1], lowY);
+	_mm_store_ps(lanes[2], highX);
+	_mm_store_ps(lanes[3], highY);
+	_mm_store_ps(lanes[4], lowDepth);
+
+	minX = std::min(std::min(lanes[0][0], lanes[0][1]), std::min(lanes[0][2], lanes[0][3]));
+	minY = std::min(std::min(lanes[1][0], lanes[1][1]), std::min(lanes[1][2], lanes[1][3]));
+	maxX = std::max(std::max(lanes[2][0], lanes[2][1]), std::max(lanes[2][2], lanes[2][3]));
+	maxY = std::max(std::max(lanes[3][0], lanes[3][1]), std::max(lanes[3][2], lanes[3][3]));
+	nearestDepth = std::min(std::min(lanes[4][0], lanes[4][1]), std::min(lanes[4][2], lanes[4][3]));
+#else
+	minX = minY = nearestDepth = OCCLUSION_SPAN_LIMIT;
+	maxX = maxY = -OCCLUSION_SPAN_LIMIT;
+
+	for (int corner = 0; corner < 8; corner++)
+	{
+		glm::vec3 position = glm::vec3(corner & 1 ? boundsMax.x : boundsMin.x, corner & 2 ? boundsMax.y : boundsMin.y, corner & 4 ? boundsMax.z : boundsMin.z);
+		glm::vec4 clip = viewProjection * glm::vec4(position, 1.0f);
+
+		if (clip.z < 0.0f)
+		{
+			return true;
+		}
+
+		minX = std::min(minX, clip.x / clip.w);
+		maxX = std::max(maxX, clip.x / clip.w);
+		minY = std::min(minY, clip.y / clip.w);
+		maxY = std::max(maxY, clip.y / clip.w);
+		nearestDepth = std::min(nearestDepth, clip.z / clip.w);
+	}
+#endif
+
+	// Every pixel the rectangle touches, clamped to the buffer (nothing left if it is off screen)
+	const float width = static_cast<float>(OCCLUSION_BUFFER_WIDTH);
+	const float height = static_cast<float>(OCCLUSION_BUFFER_HEIGHT);
+
+	int firstColumn = static_cast<int>(std::floor(std::min(std::max((minX * 0.5f + 0.5f) * width, 0.0f), width)));
+	int lastColumn = static_cast<int>(std::floor(std::min(std::max((maxX * 0.5f + 0.5f) * width, -1.0f), width - 1.0f)));
+	int firstRow = static_cast<int>(std::floor(std::min(std::max((minY * 0.5f + 0.5f) * height, 0.0f), height)));
+	int lastRow = static_cast<int>(std::floor(std::min(std::max((maxY * 0.5f + 0.5f) * height, -1.0f), height - 1.0f)));
+
+	if (firstColumn > lastColumn || firstRow > lastRow)
+	{
+		return false;
+	}
+
+	// Hidden only if, in every tile the rectangle touches, the box lies behind the whole tile or behind a working layer covering it there
+	for (int tileRow = firstRow / OCCLUSION_TILE_HEIGHT; tileRow <= lastRow / static_cast<int>(OCCLUSION_TILE_HEIGHT); tileRow++)
+	{
+		int spanFirst[OCCLUSION_TILE_HEIGHT];
+		int spanLast[OCCLUSION_TILE_HEIGHT];
+
+		for (uint32_t row = 0; row < OCCLUSION_TILE_HEIGHT; row++)
+		{
+			int pixelRow = tileRow * OCCLUSION_TILE_HEIGHT + row;
+			bool inside = pixelRow >= firstRow && pixelRow <= lastRow;
+
+			spanFirst[row] = firstColumn;
+			spanLast[row] = inside ? lastColumn : firstColumn - 1;
+		}
+
+		for (int tileColumn = firstColumn / OCCLUSION_TILE_WIDTH; tileColumn <= lastColumn / static_cast<int>(OCCLUSION_TILE_WIDTH); tileColumn++)
+		{
+			const Tile& tile = tiles[tileRow * OCCLUSION_TILES_PER_ROW + tileColumn];
+
+			if (nearestDepth > tile.farDepth)
+			{
+				continue;
+			}
+
+			if (nearestDepth > tile.workingDepth)
+			{
+				alignas(16) uint32_t coverage[OCCLUSION_TILE_HEIGHT];
+				calculateTileCoverage(spanFirst, spanLast, tileColumn * OCCLUSION_TILE_WIDTH, coverage);
+
+#ifdef TRANSFORM_MATH_SSE
+				__m128i uncovered = _mm_andnot_si128(_mm_load_si128(reinterpret_cast<const __m128i*>(tile.coverage)), _mm_load_si128(reinterpret_cast<const __m128i*>(coverage)));
+				bool hidden = _mm_movemask_epi8(_mm_cmpeq_epi32(uncovered, _mm_setzero_si128())) == 0xFFFF;
+#else
+				bool hidden = true;
+
+				for (uint32_t row = 0; row < OCCLUSION_TILE_HEIGHT; row++)
+				{
+					hidden = hidden && (coverage[row] & ~tile.coverage[row]) == 0;
+				}
+#endif
+
+				if (hidden)
+				{
+					continue;
+				}
+			}
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void OcclusionBuffer::renderTriangle(const glm::vec4& vertex0, const glm::vec4& vertex1, const glm::vec4& vertex2)
+{
+	// Pixels whose centers could be covered, clipped to the buffer
+	float minX = std::min(std::min(vertex0.x, vertex1.x), vertex2.x);
+	float maxX = std::max(std::max(vertex0.x, vertex1.x), vertex2.x);
+	float minY = std::min(std::min(vertex0.y, vertex1.y), vertex2.y);
+	float maxY = std::max(std::max(vertex0.y, vertex1.y), vertex2.y);
+
+	int firstColumn = static_cast<int>(std::ceil(std::min(std::max(minX - 0.5f, 0.0f), static_cast<float>(OCCLUSION_BUFFER_WIDTH))));
+	int lastColumn = static_cast<int>(std::floor(std::min(std::max(maxX - 0.5f, -1.0f), static_cast<float>(OCCLUSION_BUFFER_WIDTH - 1))));
+	int firstRow = static_cast<int>(std::ceil(std::min(std::max(minY - 0.5f, 0.0f), static_cast<float>(OCCLUSION_BUFFER_HEIGHT))));
+	int lastRow = static_cast<int>(std::floor(std::min(std::max(maxY - 0.5f, -1.0f), static_cast<float>(OCCLUSION_BUFFER_HEIGHT - 1))));
+
+	if (firstColumn > lastColumn || firstRow > lastRow)
+	{
+		return;
+	}
+
+	// Twice the signed area, zero (or near it) for triangles seen edge on, which cover nothing
+	float deltaX1 = vertex1.x - vertex0.x, deltaY1 = vertex1.y - vertex0.y, deltaDepth1 = vertex1.z - vertex0.z;
+	float deltaX2 = vertex2.x - vertex0.x, deltaY2 = vertex2.y - vertex0.y, deltaDepth2 = vertex2.z - vertex0.z;
+	float area = deltaX1 * deltaY2 - deltaX2 * deltaY1;
+
+	if (std::abs(area) < 1.0e-4f)
+	{
+		return;
+	}
+
+	// Edges facing inwards whichever way the triangle winds
+	float orientation = area > 0.0f ? 1.0f : -1.0f;
+	const glm::vec4* vertices[3] = { &vertex0, &vertex1, &vertex2 };
+	OcclusionEdge edges[3];
+
+	for (size_t i = 0; i < 3; i++)
+	{
+		const glm::vec4& start = *vertices[i];
+		const glm::vec4& end = *vertices[(i + 1) % 3];
+
+		edges[i].a = (start.y - end.y) * orientation;
+		edges[i].b = (end.x - start.x) * orientation;
+		edges[i].c = -(edges[i].a * start.x + edges[i].b * start.y);
+	}
+
+	// Plane of the triangle's depth over the screen, and the farthest depth of its corners bounding it
+	float depthX = (deltaDepth1 * deltaY2 - deltaDepth2 * deltaY1) / area;
+	float depthY = (deltaX1 * deltaDepth2 - deltaX2 * deltaDepth1) / area;
+	float depthConstant = vertex0.z - depthX * vertex0.x - depthY * vertex0.y;
+	float farthestDepth = std::max(std::max(vertex0.z, vertex1.z), vertex2.z);
+
+	for (int tileRow = firstRow / OCCLUSION_TILE_HEIGHT; tileRow <= lastRow / static_cast<int>(OCCLUSION_TILE_HEIGHT); tileRow++)
+	{
+		int spanFirst[OCCLUSION_TILE_HEIGHT];
+		int spanLast[OCCLUSION_TILE_HEIGHT];
+		calculateRowSpans(edges, tileRow * OCCLUSION_TILE_HEIGHT, firstColumn, lastColumn, spanFirst, spanLast);
+
+		// Rows past the triangle's own, where rounding could leave a sliver
+		for (uint32_t row = 0; row < OCCLUSION_TILE_HEIGHT; row++)
+		{
+			int pixelRow = tileRow * OCCLUSION_TILE_HEIGHT + row;
+
+			if (pixelRow < firstRow || pixelRow > lastRow)
+			{
+				spanLast[row] = spanFirst[row] - 1;
+			}
+		}
+
+		for (int tileColumn = firstColumn / OCCLUSION_TILE_WIDTH; tileColumn <= lastColumn / static_cast<int>(OCCLUSION_TILE_WIDTH); tileColumn++)
+		{
+			alignas(16) uint32_t coverage[OCCLUSION_TILE_HEIGHT];
+
+			if (!calculateTileCoverage(spanFirst, spanLast, tileColumn * OCCLUSION_TILE_WIDTH, coverage))
+			{
+				continue;
+			}
+
+			// The depth plane is largest over the tile's pixel centers at one of its corners
+			float cornerX = tileColumn * OCCLUSION_TILE_WIDTH + (depthX > 0.0f ? OCCLUSION_TILE_WIDTH - 0.5f : 0.5f);
+			float cornerY = tileRow * OCCLUSION_TILE_HEIGHT + (depthY > 0.0f ? OCCLUSION_TILE_HEIGHT - 0.5f : 0.5f);
+			float tileDepth = std::min(depthX * cornerX + depthY * cornerY + depthConstant, farthestDepth);
+
+			updateTile(tiles[tileRow * OCCLUSION_TILES_PER_ROW + tileColumn], coverage, tileDepth);
+		}
+	}
+}
+
+void OcclusionBuffer::updateTile(Tile& tile, const uint32_t coverage[OCCLUSION_TILE_HEIGHT], float depth)
+{
+	// Already hidden behind the whole tile, nothing more to hide
+	if (depth >= tile.farDepth)
+	{
+		return;
+	}
+
+#ifdef TRANSFORM_MATH_SSE
+	__m128i working = _mm_load_si128(reinterpret_cast<const __m128i*>(tile.coverage));
+	__m128i covered = _mm_load_si128(reinterpret_cast<const __m128i*>(coverage));
+	bool workingEmpty = _mm_movemask_epi8(_mm_cmpeq_epi32(working, _mm_setzero_si128())) == 0xFFFF;
+#else
+	bool workingEmpty = (tile.coverage[0] | tile.coverage[1] | tile.coverage[2] | tile.coverage[3]) == 0;
+#endif
+
+	// Merging a triangle far behind the working layer would push the layer's depth back further than it brings the far depth forward,
+	// so start the layer again from the triangle instead (forgetting coverage only hides less)
+	bool restart = workingEmpty || depth - tile.workingDepth > tile.farDepth - depth;
+
+#ifdef TRANSFORM_MATH_SSE
+	working = restart ? covered : _mm_or_si128(working, covered);
+	bool full = _mm_movemask_epi8(_mm_cmpeq_epi32(working, _mm_set1_epi32(-1))) == 0xFFFF;
+#else
+	bool full = true;
+
+	for (uint32_t row = 0; row < OCCLUSION_TILE_HEIGHT; row++)
+	{
+		tile.coverage[row] = restart ? coverage[row] : tile.coverage[row] | coverage[row];
+		full = full && tile.coverage[row] == 0xFFFFFFFFu;
+	}
+#endif
+
+	tile.workingDepth = restart ? depth : std::max(tile.workingDepth, depth);
+
+	// Once the working layer covers the whole tile its depth holds for every pixel, so becomes the far depth and the layer empties
+	if (full)
+	{
+		tile.farDepth = std::min(tile.farDepth, tile.workingDepth);
+		tile.workingDepth = 0.0f;
+
+#ifdef TRANSFORM_MATH_SSE
+		working = _mm_setzero_si128();
+#else
+		std::fill(tile.coverage, tile.coverage + OCCLUSION_TILE_HEIGHT, 0u);
+#endif
+	}
+
+#ifdef TRANSFORM_MATH_SSE
+	_mm_store_si128(reinterpret_cast<__m128i*>(tile.coverage), working);
+#endif
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "TransformMath.h"
+
+// Low resolution depth buffer for culling on the CPU: a few large occluders are rasterized into it, then instance boxes are tested against it
+// Rather than a depth per pixel, each tile keeps a coverage mask with two depths (masked occlusion): the farthest depth of the whole tile,
+// and the farthest depth of the pixels in its mask, the mask filling as triangles cover it. Both only ever overestimate what is stored,
+// so a box behind them is hidden. Tiles hold a 32 bit mask per row, a row per SIMD lane
+
+const uint32_t OCCLUSION_BUFFER_WIDTH = 256;														// Pixels, a multiple of OCCLUSION_TILE_WIDTH
+const uint32_t OCCLUSION_BUFFER_HEIGHT = 144;														// Pixels, a multiple of OCCLUSION_TILE_HEIGHT
+const uint32_t OCCLUSION_TILE_WIDTH = 32;															// A bit of each row mask per pixel
+const uint32_t OCCLUSION_TILE_HEIGHT = 4;
+
+class OcclusionBuffer
+{
+public:
+
+	OcclusionBuffer();
+
+	// Empty the buffer, hiding nothing
+	void clear();
+
+	// Rasterize a triangle list, placed in clip space (depth zero to one) by modelViewProjection. Triangles crossing the near plane are skipped
+	void renderOccluder(const glm::mat4& modelViewProjection, const glm::vec3* positions, size_t positionCount, const uint32_t* indices, size_t indexCount);
+
+	// Whether any part of a box could be in front of the occluders drawn (boxes crossing the near plane always are)
+	bool isBoxVisible(const glm::mat4& viewProjection, glm::vec3 boundsMin, glm::vec3 boundsMax) const;
+
+private:
+	struct Tile
+	{
+		alignas(16) uint32_t coverage[OCCLUSION_TILE_HEIGHT];										// Pixels of the working layer, bit x of row y
+		float workingDepth;																			// Farthest depth of the covered pixels
+		float farDepth;																				// Farthest depth of every pixel
+	};
+
+	std::vector<Tile> tiles;																		// Row by row
+	std::vector<glm::vec4> screenVertices;															// Pixel x and y, depth, and 1 if in front of the near plane (0 if not)
+
+	void renderTriangle(const glm::vec4& vertex0, const glm::vec4& vertex1, const glm::vec4& vertex2);
+	void updateTile(Tile& tile, const uint32_t coverage[OCCLUSION_TILE_HEIGHT], float depth);
+
+};
@@ -0,0 +1,170 @@
+#include "PipelineCache.h"
+#include "Utilities.h"
+
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+	const uint32_t PIPELINE_CACHE_MAGIC = 0x45504950;													// "PIPE" in a little endian file
+
+	struct PipelineCacheHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;
+		uint32_t padding;
+		uint8_t driverUUID[VK_UUID_SIZE];
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];													// Changes whenever the driver's cache format does
+		uint64_t dataSize;
+		uint64_t dataHash;																			// FNV-1a of the data, catching damaged files
+	};
+
+	// Header describing the device and driver in use, with no data yet
+	PipelineCacheHeader getDeviceHeader(VkPhysicalDevice physicalDevice)
+	{
+		VkPhysicalDeviceIDProperties idProperties = {};
+		idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+		VkPhysicalDeviceProperties2 deviceProperties2 = {};
+		deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		deviceProperties2.pNext = &idProperties;
+
+		vkGetPhysicalDeviceProperties2(physicalDevice, &deviceProperties2);
+
+		PipelineCacheHeader header = {};
+		header.magic = PIPELINE_CACHE_MAGIC;
+		header.version = PIPELINE_CACHE_VERSION;
+		header.vendorID = deviceProperties2.properties.vendorID;
+		header.deviceID = deviceProperties2.properties.deviceID;
+		header.driverVersion = deviceProperties2.properties.driverVersion;
+		memcpy(header.driverUUID, idProperties.driverUUID, VK_UUID_SIZE);
+		memcpy(header.pipelineCacheUUID, deviceProperties2.properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+		return header;
+	}
+
+	uint64_t hashData(const std::vector<char>& data)
+	{
+		uint64_t hash = 14695981039346656037ull;
+
+		for (char byte : data)
+		{
+			hash = (hash ^ static_cast<uint8_t>(byte)) * 1099511628211ull;
+		}
+
+		return hash;
+	}
+
+	// Saved data, if cacheFile holds some this device and driver wrote (empty if not)
+	std::vector<char> readCacheData(VkPhysicalDevice physicalDevice, const std::string& cacheFile)
+	{
+		std::ifstream file(cacheFile, std::ios::binary | std::ios::ate);
+
+		if (!file.is_open())
+		{
+			return {};
+		}
+
+		uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+		file.seekg(0);
+
+		PipelineCacheHeader header;
+
+		if (fileSize < sizeof(header) || !file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+		{
+			return {};
+		}
+
+		PipelineCacheHeader deviceHeader = getDeviceHeader(physicalDevice);
+
+		bool valid = header.magic == deviceHeader.magic && header.version == deviceHeader.version
+			&& header.vendorID == deviceHeader.vendorID && header.deviceID == deviceHeader.deviceID && header.driverVersion == deviceHeader.driverVersion
+			&& memcmp(header.driverUUID, deviceHeader.driverUUID, VK_UUID_SIZE) == 0 && memcmp(header.pipelineCacheUUID, deviceHeader.pipelineCacheUUID, VK_UUID_SIZE) == 0
+			&& header.dataSize == fileSize - sizeof(header);
+
+		if (!valid)
+		{
+			return {};
+		}
+
+		std::vector<char> data(static_cast<size_t>(header.dataSize));
+
+		if (!file.read(data.data(), data.size()) || hashData(data) != header.dataHash)
+		{
+			return {};
+		}
+
+		// The driver's own header leads its data, and must name the same device and cache format too
+		VkPipelineCacheHeaderVersionOne driverHeader;
+
+		if (data.size() < sizeof(driverHeader))
+		{
+			return {};
+		}
+
+		memcpy(&driverHeader, data.data(), sizeof(driverHeader));
+
+		valid = driverHeader.headerSize >= sizeof(driverHeader) && driverHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+			&& driverHeader.vendorID == deviceHeader.vendorID && driverHeader.deviceID == deviceHeader.deviceID
+			&& memcmp(driverHeader.pipelineCacheUUID, deviceHeader.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+
+		return valid ? data : std::vector<char>();
+	}
+}
+
+VkPipelineCache createPipelineCache(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, const std::string& cacheFile, bool& loaded)
+{
+	std::vector<char> data = readCacheData(physicalDevice, cacheFile);
+	loaded = !data.empty();
+
+	// Pipeline Cache creation information
+	VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
+	pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	pipelineCacheCreateInfo.initialDataSize = data.size();												// Nothing to start from if the saved cache is missing or unusable
+	pipelineCacheCreateInfo.pInitialData = data.data();
+
+	VkPipelineCache pipelineCache;
+	VkResult result = vkCreatePipelineCache(logicalDevice, &pipelineCacheCreateInfo, nullptr, &pipelineCache);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Pipeline Cache!");
+	}
+
+	return pipelineCache;
+}
+
+void savePipelineCache(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VkPipelineCache pipelineCache, const std::string& cacheFile)
+{
+	// Get the size of the cache's data, then the data itself
+	size_t dataSize = 0;
+
+	if (vkGetPipelineCacheData(logicalDevice, pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0)
+	{
+		return;
+	}
+
+	std::vector<char> data(dataSize);
+
+	if (vkGetPipelineCacheData(logicalDevice, pipelineCache, &dataSize, data.data()) != VK_SUCCESS)
+	{
+		return;
+	}
+
+	data.resize(dataSize);
+
+	PipelineCacheHeader header = getDeviceHeader(physicalDevice);
+	header.dataSize = data.size();
+	header.dataHash = hashData(data);
+
+	writeFileAtomically(cacheFile, [&](std::ofstream& file)
+	{
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(data.data(), data.size());
+	});
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <string>
+
+// Pipeline cache kept on disk between runs, so the driver can skip compiling pipelines it has compiled before
+// Layout: header (identifying the device and driver that wrote it, and the size and hash of the data), then the driver's cache data
+// Saved data is only handed back to the driver if it came from the same vendor, device, driver version, driver UUID and pipeline cache UUID,
+// and is whole, as drivers are not required to survive being given another driver's (or a damaged) cache
+
+const std::string PIPELINE_CACHE_FILE = "pipeline.cache";
+const uint32_t PIPELINE_CACHE_VERSION = 1;															// Increase whenever the header changes
+
+// Create a pipeline cache, starting from the data saved in cacheFile if it is usable (loaded says whether it was)
+VkPipelineCache createPipelineCache(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, const std::string& cacheFile, bool& loaded);
+
+// Write the cache's data out to cacheFile (failing silently, since the cache is only an optimisation)
+void savePipelineCache(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VkPipelineCache pipelineCache, const std::string& cacheFile);
@@ -0,0 +1,182 @@
+#include "RenderGraph.h"
+
+static bool isWrite(const RenderGraphAccess& access, bool image)
+{
+	return BarrierBatch::isWrite(access.accessMask) || (image && access.finalLayout != access.layout);
+}
+
+void RenderGraph::setSynchronization2(bool enabled)
+{
+	barriers.setSynchronization2(enabled);
+}
+
+RenderGraphResource RenderGraph::importImage(const std::string& name, VkImageAspectFlags aspectMask)
+{
+	Resource resource = {};
+	resource.name = name;
+	resource.image = true;
+	resource.aspectMask = aspectMask;
+
+	resources.push_back(resource);
+	return static_cast<RenderGraphResource>(resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::importBuffer(const std::string& name)
+{
+	Resource resource = {};
+	resource.name = name;
+
+	resources.push_back(resource);
+	return static_cast<RenderGraphResource>(resources.size() - 1);
+}
+
+void RenderGraph::setImportedImage(RenderGraphResource resource, VkImage image)
+{
+	resources[resource].vkImage = image;
+
+	if (!barriers.isTracked(image))
+	{
+		barriers.trackImage(image, resources[resource].aspectMask);
+	}
+}
+
+void RenderGraph::setImportedBuffer(RenderGraphResource resource, VkBuffer buffer)
+{
+	resources[resource].vkBuffer = buffer;
+
+	if (!barriers.isTracked(buffer))
+	{
+		barriers.trackBuffer(buffer);
+	}
+}
+
+uint32_t RenderGraph::addPass(const std::string& name, std::function<void(VkCommandBuffer)> record)
+{
+	Pass pass = {};
+	pass.name = name;
+	pass.record = std::move(record);
+
+	passes.push_back(pass);
+	return static_cast<uint32_t>(passes.size() - 1);
+}
+
+void RenderGraph::useImage(uint32_t pass, RenderGraphResource image, VkPipelineStageFlags2 stageMask, VkAccessFlags2 accessMask, VkImageLayout layout, VkImageLayout finalLayout)
+{
+	passes[pass].accesses.push_back({ image, stageMask, accessMask, layout, finalLayout });
+}
+
+void RenderGraph::useBuffer(uint32_t pass, RenderGraphResource buffer, VkPipelineStageFlags2 stageMask, VkAccessFlags2 accessMask)
+{
+	passes[pass].accesses.push_back({ buffer, stageMask, accessMask, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED });
+}
+
+void RenderGraph::setOutput(RenderGraphResource resource)
+{
+	resources[resource].output = true;
+}
+
+void RenderGraph::compile()
+{
+	cullPasses();
+}
+
+void RenderGraph::cullPasses()
+{
+	// Walking back from the last pass, a pass is needed if it writes something needed, and then so is everything it uses
+	std::vector<bool> needed(resources.size());
+
+	for (size_t i = 0; i < resources.size(); i++)
+	{
+		needed[i] = resources[i].output;
+	}
+
+	stats.passCount = 0;
+	stats.culledPassCount = 0;
+
+	for (size_t i = passes.size(); i-- > 0; )
+	{
+		Pass& pass = passes[i];
+		pass.culled = true;
+
+		for (const RenderGraphAccess& access : pass.accesses)
+		{
+			if (needed[access.resource] && isWrite(access, resources[access.resource].image))
+			{
+				pass.culled = false;
+			}
+		}
+
+		if (pass.culled)
+		{
+			stats.culledPassCount++;
+			continue;
+		}
+
+		for (const RenderGraphAccess& access : pass.accesses)
+		{
+			needed[access.resource] = true;
+		}
+
+		stats.passCount++;
+	}
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer)
+{
+	for (uint32_t i = 0; i < passes.size(); i++)
+	{
+		Pass& pass = passes[i];
+
+		if (pass.culled)
+		{
+			continue;
+		}
+
+		// Everything the pass waits for goes into one barrier, an image it discards kept in the layout it is in
+		for (const RenderGraphAccess& access : pass.accesses)
+		{
+			const Resource& resource = resources[access.resource];
+
+			if (resource.image)
+			{
+				VkImageLayout layout = access.layout != VK_IMAGE_LAYOUT_UNDEFINED ? access.layout : barriers.getLayout(resource.vkImage);
+				barriers.imageBarrier(resource.vkImage, access.stageMask, access.accessMask, layout);
+			}
+			else
+			{
+				barriers.bufferBarrier(resource.vkBuffer, access.stageMask, access.accessMask);
+			}
+		}
+
+		barriers.flush(commandBuffer);
+
+		pass.record(commandBuffer);
+
+		// Render passes leave their attachments in their final layouts
+		for (const RenderGraphAccess& access : pass.accesses)
+		{
+			const Resource& resource = resources[access.resource];
+
+			if (resource.image)
+			{
+				barriers.setImageLayout(resource.vkImage, access.finalLayout);
+			}
+		}
+	}
+}
+
+VkImage RenderGraph::getImage(RenderGraphResource resource)
+{
+	return resources[resource].vkImage;
+}
+
+RenderGraphStats RenderGraph::getStats()
+{
+	return stats;
+}
+
+void RenderGraph::destroy()
+{
+	resources.clear();
+	passes.clear();
+}
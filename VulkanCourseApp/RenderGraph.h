@@ -0,0 +1,93 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <cstdint>
+
+#include "BarrierBatch.h"
+
+// Frame described as passes recorded in order, each declaring the images and buffers it uses and how (stages, accesses, image layouts)
+// Compiling culls passes nothing kept depends on. Executing queues every access of a pass in a BarrierBatch and flushes it before
+// recording the pass, so the batch's tracked state (carried over between executions, per image and buffer) decides what it waits for
+// Render passes still handle their own attachments' transitions, a pass beginning one declares the layouts it starts and ends them in
+
+typedef uint32_t RenderGraphResource;
+
+// How a pass uses a resource, a write if accessMask has write bits or the image changes layout
+struct RenderGraphAccess
+{
+	RenderGraphResource resource;
+	VkPipelineStageFlags2 stageMask;
+	VkAccessFlags2 accessMask;
+	VkImageLayout layout;																			// Images need it by the start of the pass (UNDEFINED if the pass discards them)
+	VkImageLayout finalLayout;																		// And are left in it by the pass
+};
+
+struct RenderGraphStats
+{
+	uint32_t passCount;																				// Passes kept, recorded by execute
+	uint32_t culledPassCount;
+};
+
+class RenderGraph
+{
+public:
+
+	// Barriers are recorded with vkCmdPipelineBarrier2 where synchronization2 is enabled
+	void setSynchronization2(bool enabled);
+
+	// Images and buffers made outside the graph
+	RenderGraphResource importImage(const std::string& name, VkImageAspectFlags aspectMask);
+	RenderGraphResource importBuffer(const std::string& name);
+
+	// Image or buffer can change every frame (such as the swapchain image being drawn to), each keeping its own state from its first use
+	void setImportedImage(RenderGraphResource resource, VkImage image);
+	void setImportedBuffer(RenderGraphResource resource, VkBuffer buffer);
+
+	// Passes run in the order added
+	uint32_t addPass(const std::string& name, std::function<void(VkCommandBuffer)> record);
+	void useImage(uint32_t pass, RenderGraphResource image, VkPipelineStageFlags2 stageMask, VkAccessFlags2 accessMask, VkImageLayout layout, VkImageLayout finalLayout);
+	void useBuffer(uint32_t pass, RenderGraphResource buffer, VkPipelineStageFlags2 stageMask, VkAccessFlags2 accessMask);
+
+	// Resources the frame exists to produce: passes writing them are kept, along with every pass those depend on
+	void setOutput(RenderGraphResource resource);
+
+	void compile();
+	void execute(VkCommandBuffer commandBuffer);
+
+	VkImage getImage(RenderGraphResource resource);
+	RenderGraphStats getStats();
+
+	void destroy();
+
+private:
+	struct Resource
+	{
+		std::string name;
+		bool image;
+		bool output;
+		VkImageAspectFlags aspectMask;
+		VkImage vkImage;
+		VkBuffer vkBuffer;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		std::function<void(VkCommandBuffer)> record;
+		std::vector<RenderGraphAccess> accesses;
+		bool culled;
+	};
+
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	BarrierBatch barriers;
+	RenderGraphStats stats = {};
+
+	void cullPasses();
+
+};
@@ -0,0 +1,154 @@
+#include "SceneGraph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+uint32_t SceneGraph::addNode(uint32_t parent, glm::vec3 position, glm::quat rotation, glm::vec3 scale)
+{
+	uint32_t node = static_cast<uint32_t>(parents.size());
+
+	// Parents must come first for the update pass to reach them before their children
+	if (parent != SCENE_NO_PARENT && parent >= node)
+	{
+		throw std::runtime_error("Failed to add scene node, its parent does not exist!");
+	}
+
+	parents.push_back(parent);
+	localTransforms.resize(node + 1);
+	localTransforms.set(node, position, rotation, scale);
+	localMatrices.emplace_back(1.0f);
+	worldTransforms.emplace_back(1.0f);
+	moved.push_back(0);
+	dirty.push_back(0);
+	markMoved(node);
+
+	return node;
+}
+
+uint32_t SceneGraph::addNode(uint32_t parent, const glm::mat4& localTransform)
+{
+	glm::vec3 position, scale;
+	glm::quat rotation;
+	decomposeTransform(localTransform, position, rotation, scale);
+
+	return addNode(parent, position, rotation, scale);
+}
+
+uint32_t SceneGraph::getNodeCount() const
+{
+	return static_cast<uint32_t>(parents.size());
+}
+
+void SceneGraph::setLocalTransform(uint32_t node, glm::vec3 position, glm::quat rotation, glm::vec3 scale)
+{
+	localTransforms.set(node, position, rotation, scale);
+	markMoved(node);
+}
+
+void SceneGraph::setLocalTransform(uint32_t node, const glm::mat4& localTransform)
+{
+	glm::vec3 position, scale;
+	glm::quat rotation;
+	decomposeTransform(localTransform, position, rotation, scale);
+
+	setLocalTransform(node, position, rotation, scale);
+}
+
+glm::mat4 SceneGraph::getLocalTransform(uint32_t node) const
+{
+	glm::mat4 localTransform;
+	composeTransformMatrices(localTransforms, node, 1, &localTransform);
+
+	return localTransform;
+}
+
+const glm::mat4& SceneGraph::getWorldTransform(uint32_t node) const
+{
+	return worldTransforms[node];
+}
+
+const glm::mat4* SceneGraph::getWorldTransforms() const
+{
+	return worldTransforms.data();
+}
+
+void SceneGraph::markMoved(uint32_t node)
+{
+	moved[node] = 1;
+	dirty[node] = 1;
+	firstDirty = std::min(firstDirty, node);
+	lastDirty = std::max(lastDirty, node + 1);
+}
+
+void SceneGraph::updateWorldTransforms(uint32_t& firstChanged, uint32_t& lastChanged)
+{
+	firstChanged = 0;
+	lastChanged = 0;
+
+	if (firstDirty == SCENE_NO_PARENT)
+	{
+		return;
+	}
+
+	// Local matrices of moved nodes, composed a run of consecutive nodes at a time
+	for (uint32_t i = firstDirty; i < lastDirty; )
+	{
+		if (!moved[i])
+		{
+			i++;
+			continue;
+		}
+
+		uint32_t runEnd = i + 1;
+		while (runEnd < lastDirty && moved[runEnd])
+		{
+			runEnd++;
+		}
+
+		composeTransformMatrices(localTransforms, i, runEnd - i, localMatrices.data() + i);
+		std::fill(moved.begin() + i, moved.begin() + runEnd, 0);
+		i = runEnd;
+	}
+
+	// Parents are final by the time their children are reached, so dirtiness simply flows down the array
+	// Consecutive dirty siblings share their parent's matrix, so are multiplied by it as one batch
+	uint32_t nodeCount = getNodeCount();
+
+	for (uint32_t i = firstDirty; i < nodeCount; )
+	{
+		uint32_t parent = parents[i];
+
+		if (parent != SCENE_NO_PARENT && dirty[parent])
+		{
+			dirty[i] = 1;
+		}
+
+		if (!dirty[i])
+		{
+			i++;
+			continue;
+		}
+
+		if (parent == SCENE_NO_PARENT)
+		{
+			worldTransforms[i] = localMatrices[i];
+			lastChanged = ++i;
+			continue;
+		}
+
+		uint32_t runEnd = i + 1;
+		while (runEnd < nodeCount && parents[runEnd] == parent)
+		{
+			dirty[runEnd] = 1;
+			runEnd++;
+		}
+
+		multiplyMatrices(worldTransforms[parent], localMatrices.data() + i, worldTransforms.data() + i, runEnd - i);
+		lastChanged = i = runEnd;
+	}
+
+	firstChanged = firstDirty;
+	std::fill(dirty.begin() + firstDirty, dirty.begin() + lastChanged, 0);
+	firstDirty = SCENE_NO_PARENT;
+	lastDirty = 0;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "TransformMath.h"
+
+// Transform hierarchy of the scene: a root node per model, with the nodes it was imported with beneath it
+// Nodes are stored parents first with each property in its own array (structure of arrays), so world matrices are
+// brought up to date by one forward pass that only recomputes nodes under something that moved
+// Local transforms are kept as position, rotation and scale, turned into matrices a batch at a time by TransformMath
+
+const uint32_t SCENE_NO_PARENT = 0xFFFFFFFF;
+
+class SceneGraph
+{
+public:
+
+	// Add a node under parent (an existing node, or SCENE_NO_PARENT for a root) and return its index
+	uint32_t addNode(uint32_t parent, glm::vec3 position, glm::quat rotation, glm::vec3 scale);
+	uint32_t addNode(uint32_t parent, const glm::mat4& localTransform);								// Any shear in the matrix is lost
+	uint32_t getNodeCount() const;
+
+	void setLocalTransform(uint32_t node, glm::vec3 position, glm::quat rotation, glm::vec3 scale);
+	void setLocalTransform(uint32_t node, const glm::mat4& localTransform);							// Any shear in the matrix is lost
+	glm::mat4 getLocalTransform(uint32_t node) const;
+
+	// World matrices as of the last update, back to back in node order
+	const glm::mat4& getWorldTransform(uint32_t node) const;
+	const glm::mat4* getWorldTransforms() const;
+
+	// Recompute the world matrices of nodes moved (or added) since the last update, and everything beneath them
+	// Gives the range of nodes whose world matrices were rewritten ([firstChanged, lastChanged), empty if nothing moved)
+	void updateWorldTransforms(uint32_t& firstChanged, uint32_t& lastChanged);
+
+private:
+	std::vector<uint32_t> parents;
+	TransformArrays localTransforms;
+	std::vector<glm::mat4> localMatrices;															// Local transforms as matrices, as of the last update
+	std::vector<glm::mat4> worldTransforms;
+	std::vector<uint8_t> moved;																		// Local transform set since the last update
+	std::vector<uint8_t> dirty;																		// World matrix out of date (moved, or beneath a node that did)
+	uint32_t firstDirty = SCENE_NO_PARENT;															// Earliest moved node, where the update pass starts
+	uint32_t lastDirty = 0;																			// One past the last moved node
+
+	void markMoved(uint32_t node);
+
+};
@@ -2,4 +2,6 @@ C:\VulkanSDK\1.4.321.1\Bin\glslangValidator.exe -V shader.vert
 C:\VulkanSDK\1.4.321.1\Bin\glslangValidator.exe -V shader.frag
 C:\VulkanSDK\1.4.321.1\Bin\glslangValidator.exe -o second_vert.spv -V second.vert
 C:\VulkanSDK\1.4.321.1\Bin\glslangValidator.exe -o second_frag.spv -V second.frag
+C:\VulkanSDK\1.4.321.1\Bin\glslangValidator.exe -o depthPyramid.spv -V depthPyramid.comp
+C:\VulkanSDK\1.4.321.1\Bin\glslangValidator.exe -o occlusionCull.spv -V occlusionCull.comp
 pause
\ No newline at end of file
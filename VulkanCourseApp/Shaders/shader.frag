@@ -1,13 +1,21 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
-layout(location = 0) in vec3 fragmentColor;
-layout(location = 1) in vec2 fragmentTexture;
+layout(location = 0) in vec2 fragmentTexture;
 
-layout(set = 1, binding = 0) uniform sampler2D textureSampler;
+layout(set = 1, binding = 0) uniform sampler2D textureSamplers[];                                 // Bindless texture array
+
+layout(push_constant) uniform PushModel {
+    vec4 positionOffset;
+    vec4 positionScale;
+    vec4 textureTransform;
+    uint worldTransformIndex;
+    uint textureID;
+} pushModel;
 
 layout(location = 0) out vec4 outputColor;
 
 void main()
 {
-    outputColor = texture(textureSampler, fragmentTexture);
+    outputColor = texture(textureSamplers[pushModel.textureID], fragmentTexture);
 }
\ No newline at end of file
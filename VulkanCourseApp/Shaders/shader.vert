@@ -1,25 +1,33 @@
 #version 450
 
+// Positions and UVs are either floats or 16-bit UNORM in [0, 1], decoded by the position and texture transforms
 layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 color;
-layout(location = 2) in vec2 texture;
+layout(location = 1) in vec2 texture;
 
 layout(set = 0, binding = 0) uniform ViewProjection {
     mat4 projection;
     mat4 view;
 } viewProjection;
 
+// World matrix of every scene node, uploaded in one batch per frame
+layout(set = 0, binding = 1) readonly buffer WorldTransforms {
+    mat4 worldTransforms[];
+};
+
 layout(push_constant) uniform PushModel {
-    mat4 model;
+    vec4 positionOffset;
+    vec4 positionScale;
+    vec4 textureTransform;
+    uint worldTransformIndex;
+    uint textureID;
 } pushModel;
 
-layout(location = 0) out vec3 fragmentColor;
-layout(location = 1) out vec2 fragmentTexture;
+layout(location = 0) out vec2 fragmentTexture;
 
 void main()
 {
-    gl_Position = viewProjection.projection * viewProjection.view * pushModel.model * vec4(position, 1.0);
+    vec3 meshPosition = pushModel.positionOffset.xyz + position * pushModel.positionScale.xyz;
+    gl_Position = viewProjection.projection * viewProjection.view * worldTransforms[pushModel.worldTransformIndex] * vec4(meshPosition, 1.0);
 
-    fragmentColor = color;
-    fragmentTexture = texture;
+    fragmentTexture = pushModel.textureTransform.xy + texture * pushModel.textureTransform.zw;
 }
\ No newline at end of file
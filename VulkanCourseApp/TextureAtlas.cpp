@@ -0,0 +1,103 @@
+#include "TextureAtlas.h"
+
+#include <algorithm>
+#include <cstring>
+
+static uint32_t alignUp(uint32_t value, uint32_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+// Place tiles on shelves left to right, starting a new shelf below when a row is full
+// Returns the height used, tiles that would pass maxHeight are left unplaced
+static uint32_t placeTilesOnShelves(std::vector<AtlasTile>& tiles, const std::vector<size_t>& order, uint32_t atlasWidth, uint32_t maxHeight, uint32_t alignment, uint32_t gutter)
+{
+	uint32_t shelfX = 0;
+	uint32_t shelfY = 0;
+	uint32_t shelfHeight = 0;
+
+	for (size_t index : order)
+	{
+		AtlasTile& tile = tiles[index];
+		uint32_t footprintWidth = alignUp(tile.width + gutter * 2, alignment);
+		uint32_t footprintHeight = alignUp(tile.height + gutter * 2, alignment);
+
+		// Move down to a new shelf if this row is full
+		if (shelfX + footprintWidth > atlasWidth)
+		{
+			shelfX = 0;
+			shelfY += shelfHeight;
+			shelfHeight = 0;
+		}
+
+		if (footprintWidth > atlasWidth || shelfY + footprintHeight > maxHeight)
+		{
+			tile.placed = false;
+			continue;
+		}
+
+		tile.x = shelfX + gutter;
+		tile.y = shelfY + gutter;
+		tile.placed = true;
+
+		shelfX += footprintWidth;
+		shelfHeight = std::max(shelfHeight, footprintHeight);
+	}
+
+	return shelfY + shelfHeight;
+}
+
+void packAtlasTiles(std::vector<AtlasTile>& tiles, uint32_t maxSize, uint32_t alignment, uint32_t gutter, uint32_t& atlasWidth, uint32_t& atlasHeight)
+{
+	// Tallest first keeps shelves tightly filled
+	std::vector<size_t> order(tiles.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		order[i] = i;
+	}
+
+	std::sort(order.begin(), order.end(), [&tiles](size_t a, size_t b)
+	{
+		return tiles[a].height > tiles[b].height;
+	});
+
+	// Try each width and keep the one needing the least area with every tile placed
+	uint32_t bestWidth = 0;
+	uint64_t bestArea = UINT64_MAX;
+
+	for (uint32_t width = alignment; width <= maxSize; width *= 2)
+	{
+		uint32_t height = placeTilesOnShelves(tiles, order, width, UINT32_MAX, alignment, gutter);
+		bool allPlaced = std::all_of(tiles.begin(), tiles.end(), [](const AtlasTile& tile) { return tile.placed; });
+
+		if (allPlaced && height <= maxSize && (uint64_t)width * height < bestArea)
+		{
+			bestWidth = width;
+			bestArea = (uint64_t)width * height;
+		}
+	}
+
+	// Nothing holds them all, so the largest allowed atlas takes whatever fits
+	atlasWidth = bestWidth > 0 ? bestWidth : maxSize;
+	atlasHeight = std::max(placeTilesOnShelves(tiles, order, atlasWidth, maxSize, alignment, gutter), alignment);
+}
+
+void blitAtlasTile(uint8_t* atlas, uint32_t atlasWidth, const AtlasTile& tile, const uint8_t* pixels, uint32_t gutter)
+{
+	// Every row of the tile including gutter, with rows above and below the image repeating its first and last row
+	for (uint32_t row = 0; row < tile.height + gutter * 2; row++)
+	{
+		uint32_t sourceRow = std::min(row > gutter ? row - gutter : 0u, tile.height - 1);
+		const uint8_t* source = pixels + (size_t)sourceRow * tile.width * 4;
+		uint8_t* destination = atlas + ((size_t)(tile.y - gutter + row) * atlasWidth + (tile.x - gutter)) * 4;
+
+		// Left gutter, image row, right gutter
+		for (uint32_t i = 0; i < gutter; i++)
+		{
+			memcpy(destination + (size_t)i * 4, source, 4);
+			memcpy(destination + ((size_t)gutter + tile.width + i) * 4, source + ((size_t)tile.width - 1) * 4, 4);
+		}
+
+		memcpy(destination + (size_t)gutter * 4, source, (size_t)tile.width * 4);
+	}
+}
\ No newline at end of file
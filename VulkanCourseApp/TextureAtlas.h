@@ -0,0 +1,22 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+// Small texture packed into a shared atlas
+struct AtlasTile
+{
+	uint32_t width;																					// Size of the source image
+	uint32_t height;
+	uint32_t x = 0;																					// Position of the source image within the atlas (inside its gutter)
+	uint32_t y = 0;
+	bool placed = false;																			// False when the tile did not fit in the largest allowed atlas
+};
+
+// Shelf pack tiles into the smallest atlas (power of two width, both sides up to maxSize) that holds them all
+// Each tile is surrounded by a gutter and its footprint rounded up to the alignment, so box filtered mips do not mix neighbouring tiles
+// Tiles that still do not fit at maxSize x maxSize are left unplaced
+void packAtlasTiles(std::vector<AtlasTile>& tiles, uint32_t maxSize, uint32_t alignment, uint32_t gutter, uint32_t& atlasWidth, uint32_t& atlasHeight);
+
+// Copy an RGBA8 image into its tile of an RGBA8 atlas, extending its edge texels out into the gutter
+void blitAtlasTile(uint8_t* atlas, uint32_t atlasWidth, const AtlasTile& tile, const uint8_t* pixels, uint32_t gutter);
\ No newline at end of file
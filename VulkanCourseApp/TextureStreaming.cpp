@@ -0,0 +1,147 @@
+#include "TextureStreaming.h"
+#include "ImageProcessing.h"
+
+#include <algorithm>
+#include <cmath>
+
+uint32_t calculateMipLevelCount(uint32_t width, uint32_t height)
+{
+	uint32_t levels = 1;
+	uint32_t size = std::max(width, height);
+
+	while (size > 1)
+	{
+		size /= 2;
+		levels++;
+	}
+
+	return levels;
+}
+
+uint32_t getTextureQualityMaxSize(TextureQuality quality)
+{
+	switch (quality)
+	{
+	case TextureQuality::Low:
+		return 512;
+	case TextureQuality::Medium:
+		return 1024;
+	default:
+		return 4096;
+	}
+}
+
+void initializeMipChain(StreamedTexture& texture, uint32_t width, uint32_t height, uint32_t channels, uint32_t maxLevelCount, uint32_t tailSize)
+{
+	uint32_t levelCount = std::min(calculateMipLevelCount(width, height), maxLevelCount);
+	texture.mipLevels.resize(levelCount);
+	texture.channels = channels;
+
+	// Lay out every level back to back, finest first
+	VkDeviceSize totalSize = 0;
+	for (uint32_t i = 0; i < levelCount; i++)
+	{
+		texture.mipLevels[i].width = std::max(1u, width >> i);
+		texture.mipLevels[i].height = std::max(1u, height >> i);
+		texture.mipLevels[i].offset = totalSize;
+		texture.mipLevels[i].size = (VkDeviceSize)texture.mipLevels[i].width * texture.mipLevels[i].height * channels;
+
+		totalSize += texture.mipLevels[i].size;
+	}
+
+	texture.tailMip = selectTailMipLevel(texture, tailSize);
+	texture.pixels.resize(static_cast<size_t>(texture.mipLevels[texture.tailMip].offset));
+}
+
+void buildMipChain(StreamedTexture& texture, const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t maxSize, uint32_t maxLevelCount, uint32_t tailSize, const std::function<uint8_t*(VkDeviceSize)>& allocateTail)
+{
+	// Halve the image until it fits the quality tier's size cap
+	std::vector<uint8_t> downsized;
+
+	while (std::max(width, height) > maxSize)
+	{
+		std::vector<uint8_t> halved((size_t)std::max(1u, width / 2) * std::max(1u, height / 2) * 4);
+		downsampleBox2x2(pixels, width, height, halved.data());
+
+		downsized.swap(halved);
+		pixels = downsized.data();
+		width = std::max(1u, width / 2);
+		height = std::max(1u, height / 2);
+		maxLevelCount = std::max(1u, maxLevelCount - 1);
+	}
+
+	// Store only the channels in use, swizzling them back out to RGBA when sampled
+	uint32_t channels = countUsedChannels(pixels, (size_t)width * height);
+	initializeMipChain(texture, width, height, channels, maxLevelCount, tailSize);
+
+	// Levels above the tail live in the CPU pixels, the tail in its own memory (offsets stay those of one contiguous chain)
+	uint8_t* tail = allocateTail(getMipChainSize(texture, texture.tailMip));
+	VkDeviceSize tailOffset = texture.mipLevels[texture.tailMip].offset;
+
+	auto levelData = [&](size_t level)
+	{
+		return level < texture.tailMip ? texture.pixels.data() + texture.mipLevels[level].offset : tail + (texture.mipLevels[level].offset - tailOffset);
+	};
+
+	switch (channels)
+	{
+	case 1:
+		texture.format = VK_FORMAT_R8_UNORM;
+		texture.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_ONE };
+		break;
+	case 2:
+		texture.format = VK_FORMAT_R8G8_UNORM;
+		texture.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G };
+		break;
+	default:
+		texture.format = VK_FORMAT_R8G8B8A8_UNORM;
+		texture.components = {};
+		break;
+	}
+
+	reduceChannels(pixels, (size_t)width * height, channels, levelData(0));
+
+	// Box filter each following level from the one before it, kept as RGBA so colour is averaged in linear space, then store its channels
+	std::vector<uint8_t> previousLevel;
+	std::vector<uint8_t> nextLevel;
+
+	for (size_t i = 1; i < texture.mipLevels.size(); i++)
+	{
+		const MipLevel& previous = texture.mipLevels[i - 1];
+		const MipLevel& level = texture.mipLevels[i];
+
+		nextLevel.resize((size_t)level.width * level.height * 4);
+		downsampleBox2x2(i == 1 ? pixels : previousLevel.data(), previous.width, previous.height, nextLevel.data());
+		reduceChannels(nextLevel.data(), (size_t)level.width * level.height, channels, levelData(i));
+
+		previousLevel.swap(nextLevel);
+	}
+}
+
+VkDeviceSize getMipChainSize(const StreamedTexture& texture, uint32_t fromMip)
+{
+	const MipLevel& coarsest = texture.mipLevels.back();
+	return coarsest.offset + coarsest.size - texture.mipLevels[fromMip].offset;
+}
+
+uint32_t selectTailMipLevel(const StreamedTexture& texture, uint32_t maxSize)
+{
+	for (uint32_t i = 0; i < texture.mipLevels.size(); i++)
+	{
+		if (std::max(texture.mipLevels[i].width, texture.mipLevels[i].height) <= maxSize)
+		{
+			return i;
+		}
+	}
+
+	return static_cast<uint32_t>(texture.mipLevels.size() - 1);
+}
+
+uint32_t selectMipLevel(const StreamedTexture& texture, float screenPixels, float textureScale)
+{
+	// Each level halves the texels, so the needed level is how many halvings still leave one texel per pixel
+	float largestDimension = (float)std::max(texture.mipLevels[0].width, texture.mipLevels[0].height) * textureScale;
+	float level = std::floor(std::log2(largestDimension / std::max(screenPixels, 1.0f)));
+
+	return static_cast<uint32_t>(std::min(std::max(level, 0.0f), (float)(texture.mipLevels.size() - 1)));
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+// Global texture quality, capping the size textures are kept at after loading
+enum class TextureQuality
+{
+	Low,																							// 512 texels
+	Medium,																							// 1024 texels
+	High																							// 4096 texels (largest size every Vulkan device supports)
+};
+
+struct MipLevel
+{
+	uint32_t width;
+	uint32_t height;
+	VkDeviceSize offset;																			// Byte offset of level within the mip chain pixels
+	VkDeviceSize size;																				// Byte size of level
+};
+
+// Texture whose finer mip levels are made resident on demand
+// The GPU image only holds levels [residentMip, mipLevels.size()), so view level 0 is always the finest resident level
+struct StreamedTexture
+{
+	std::vector<uint8_t> pixels;																	// CPU copy of the levels finer than the tail, finest first and contiguous
+	std::vector<MipLevel> mipLevels;
+
+	uint32_t channels = 4;																			// Bytes per texel, only the channels the image actually uses
+	VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;														// R8 (grey), R8G8 (grey + alpha) or R8G8B8A8
+	VkComponentMapping components = {};																// Swizzle so reduced formats still read as RGBA in the shader
+
+	uint32_t tailMip = 0;																			// Coarsest levels from here down always stay resident
+	uint32_t residentMip = 0;																		// Finest level currently on the GPU
+	uint32_t requestedMip = 0;																		// Finest level needed by the current frame's draws
+	uint64_t lastUsedFrame = 0;
+
+	VkImage image = VK_NULL_HANDLE;
+	VkDeviceMemory imageMemory = VK_NULL_HANDLE;
+	VkImageView imageView = VK_NULL_HANDLE;
+	uint32_t descriptorIndex = 0;																	// Element of the bindless texture array
+};
+
+// Old image of a texture kept alive until no frame in flight can still sample it
+struct RetiredTexture
+{
+	VkImage image;
+	VkDeviceMemory imageMemory;
+	VkImageView imageView;
+	uint32_t descriptorIndex;
+	uint64_t retiredFrame;
+};
+
+// Load-time upload of a texture's tail, whose levels are filtered straight into the mapped staging buffer by the decoding worker
+struct TextureTailUpload
+{
+	VkBuffer stagingBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory stagingBufferMemory = VK_NULL_HANDLE;
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	VkFence fence = VK_NULL_HANDLE;																	// Signalled once the copies have finished, so the staging buffer can go
+};
+
+uint32_t calculateMipLevelCount(uint32_t width, uint32_t height);
+
+uint32_t getTextureQualityMaxSize(TextureQuality quality);
+
+// Lay out the mip chain for a texture of the given size and channel count, stopping after maxLevelCount levels
+// Picks the tail (coarsest levels at or below tailSize) and allocates CPU pixels for only the levels above it
+void initializeMipChain(StreamedTexture& texture, uint32_t width, uint32_t height, uint32_t channels, uint32_t maxLevelCount, uint32_t tailSize);
+
+// Build a texture's mip chain from decoded RGBA8 pixels
+// Halves the image until it fits maxSize, then stores it with only the channels it uses, box filtering each coarser level in linear space
+// maxLevelCount counts from the decoded size, so the halvings to fit maxSize use up levels too (an atlas's gutter shrinks with them)
+// The tail is filtered straight into the memory allocateTail returns for its byte size (mapped staging), never into the CPU pixels
+void buildMipChain(StreamedTexture& texture, const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t maxSize, uint32_t maxLevelCount, uint32_t tailSize, const std::function<uint8_t*(VkDeviceSize)>& allocateTail);
+
+// Byte size of all levels from the given level down to the coarsest
+VkDeviceSize getMipChainSize(const StreamedTexture& texture, uint32_t fromMip);
+
+// Coarsest level whose size is at or below maxSize, used as the always-resident tail
+uint32_t selectTailMipLevel(const StreamedTexture& texture, uint32_t maxSize);
+
+// Finest level needed to cover a surface spanning the given number of pixels on screen
+// textureScale is the share of the texture the surface is mapped to (its tile's share of an atlas), one for the whole texture
+uint32_t selectMipLevel(const StreamedTexture& texture, float screenPixels, float textureScale);
\ No newline at end of file
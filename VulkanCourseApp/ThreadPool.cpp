@@ -0,0 +1,266 @@
+#include "ThreadPool.h"
+
+// Pool and queue of the worker running on this thread (none on threads outside every pool)
+static thread_local ThreadPool* currentPool = nullptr;
+static thread_local size_t currentWorker = 0;
+
+bool JobCounter::isDone() const
+{
+	return pendingJobs == 0;
+}
+
+ThreadPool::ThreadPool() : ThreadPool(std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 1)
+{
+
+}
+
+ThreadPool::ThreadPool(size_t threadCount)
+{
+	// Always keep at least one worker so submitted tasks make progress
+	if (threadCount == 0)
+	{
+		threadCount = 1;
+	}
+
+	for (size_t i = 0; i < threadCount; i++)
+	{
+		queues.push_back(std::make_unique<WorkerQueue>());
+	}
+
+	for (size_t i = 0; i < threadCount; i++)
+	{
+		workers.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+}
+
+void ThreadPool::run(std::function<void()> job, JobCounter* counter, JobCounter* dependency)
+{
+	if (counter)
+	{
+		counter->pendingJobs++;
+	}
+
+	// Park the job on its dependency until that finishes (checked under its lock, so the last job finishing either sees it parked or it sees none left)
+	if (dependency)
+	{
+		std::lock_guard<std::mutex> lock(dependency->waitingMutex);
+
+		if (dependency->pendingJobs > 0)
+		{
+			dependency->waitingJobs.emplace_back(std::move(job), counter);
+			return;
+		}
+	}
+
+	push({ std::move(job), counter });
+}
+
+void ThreadPool::wait(JobCounter& counter)
+{
+	size_t workerIndex = currentPool == this ? currentWorker : workers.size();
+
+	while (counter.pendingJobs > 0)
+	{
+		Job job;
+
+		if (findJob(workerIndex, job))
+		{
+			execute(job);
+			continue;
+		}
+
+		// Remaining jobs are running on other threads, so sleep until they finish or more jobs are queued to help with
+		// (counted before checking, like a sleeping worker, so the last job either sees this thread waiting or this sees it done)
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		waitingThreadCount++;
+		waitCondition.wait(lock, [this, &counter]() { return counter.pendingJobs == 0 || queuedJobCount > 0; });
+		waitingThreadCount--;
+	}
+
+	// Taking the lock waits out the last job's release of it, after which the counter is free to go out of scope
+	std::exception_ptr error;
+
+	{
+		std::lock_guard<std::mutex> lock(counter.waitingMutex);
+		std::swap(error, counter.error);
+	}
+
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+}
+
+void ThreadPool::push(Job job)
+{
+	// Workers queue onto their own deque, everyone else spreads jobs across them
+	size_t queueIndex = currentPool == this ? currentWorker : nextQueue++ % queues.size();
+
+	// Counted before it can be taken, so the count never drops below the jobs queued
+	queuedJobCount++;
+
+	{
+		std::lock_guard<std::mutex> lock(queues[queueIndex]->mutex);
+		queues[queueIndex]->jobs.push_back(std::move(job));
+	}
+
+	// Only wake a worker if one is asleep: a worker going to sleep counts itself before checking for jobs, so either it sees this job or this sees it
+	// (taking the sleep lock then means it has either seen the new count or is already waiting to be notified)
+	// Threads in wait are woken the same way, to help with the new job
+	bool wakeWorker = sleepingWorkerCount > 0;
+	bool wakeWaiters = waitingThreadCount > 0;
+
+	if (wakeWorker || wakeWaiters)
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+
+		if (wakeWorker)
+		{
+			sleepCondition.notify_one();
+		}
+
+		if (wakeWaiters)
+		{
+			waitCondition.notify_all();
+		}
+	}
+}
+
+bool ThreadPool::findJob(size_t workerIndex, Job& job)
+{
+	// Newest job of our own first
+	if (workerIndex < queues.size())
+	{
+		WorkerQueue& queue = *queues[workerIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (!queue.jobs.empty())
+		{
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+			queuedJobCount--;
+			return true;
+		}
+	}
+
+	// Then the oldest of someone else's, starting from the next queue along so thieves spread out
+	for (size_t i = 1; i <= queues.size(); i++)
+	{
+		WorkerQueue& queue = *queues[(workerIndex + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (!queue.jobs.empty())
+		{
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+			queuedJobCount--;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::execute(Job& job)
+{
+	std::exception_ptr error;
+
+	try
+	{
+		job.task();
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+
+	if (!job.counter)
+	{
+		return;
+	}
+
+	// Count the job done and take any jobs that were waiting on the counter to reach zero
+	std::vector<std::pair<std::function<void()>, JobCounter*>> releasedJobs;
+	bool counterDone = false;
+
+	{
+		std::lock_guard<std::mutex> lock(job.counter->waitingMutex);
+
+		if (error && !job.counter->error)
+		{
+			job.counter->error = error;
+		}
+
+		if (--job.counter->pendingJobs == 0)
+		{
+			std::swap(releasedJobs, job.counter->waitingJobs);
+			counterDone = true;
+		}
+	}
+
+	for (auto& releasedJob : releasedJobs)
+	{
+		push({ std::move(releasedJob.first), releasedJob.second });
+	}
+
+	// Wake threads waiting on the counter (the counter may already be gone, so only pool state is touched from here)
+	if (counterDone && waitingThreadCount > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+
+		waitCondition.notify_all();
+	}
+}
+
+void ThreadPool::workerLoop(size_t workerIndex)
+{
+	currentPool = this;
+	currentWorker = workerIndex;
+
+	while (true)
+	{
+		Job job;
+
+		if (findJob(workerIndex, job))
+		{
+			execute(job);
+			continue;
+		}
+
+		// Sleep until there is work to do or the pool is shutting down
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepingWorkerCount++;
+		sleepCondition.wait(lock, [this]() { return stopping || queuedJobCount > 0; });
+		sleepingWorkerCount--;
+
+		// Finish remaining jobs before exiting
+		if (stopping && queuedJobCount == 0)
+		{
+			return;
+		}
+	}
+}
+
+size_t ThreadPool::getThreadCount()
+{
+	return workers.size();
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+
+	sleepCondition.notify_all();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
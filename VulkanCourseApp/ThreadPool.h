@@ -0,0 +1,116 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <exception>
+#include <atomic>
+
+// Work-stealing job system: each worker keeps its own deque, running the newest of its jobs first (the data they touch is still in cache)
+// while idle workers steal the oldest jobs from the others. Jobs can count themselves against a JobCounter, which other jobs can depend on
+// and any thread can wait on, running queued jobs itself until the counter reaches zero (so the main thread joins in rather than blocking)
+
+// Jobs outstanding against it, and the jobs waiting for them to finish
+class JobCounter
+{
+public:
+
+	bool isDone() const;
+
+private:
+	friend class ThreadPool;
+
+	std::atomic<size_t> pendingJobs{ 0 };
+	std::mutex waitingMutex;																		// Guards waitingJobs and error
+	std::vector<std::pair<std::function<void()>, JobCounter*>> waitingJobs;							// Jobs and their counters, queued once pendingJobs reaches zero
+	std::exception_ptr error;																		// First exception thrown by a job counted against it
+
+};
+
+class ThreadPool
+{
+public:
+
+	ThreadPool();
+	ThreadPool(size_t threadCount);
+
+	// Queue a job counted against counter (if any), not started until dependency (if any) has no jobs left
+	// An exception thrown by the job is rethrown by wait on its counter (and lost without one)
+	void run(std::function<void()> job, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+
+	// Run queued jobs on the calling thread until counter has no jobs left, then rethrow the first exception any of them threw
+	// Sleeps while its last jobs run on other threads, waking to help whenever more are queued
+	// Safe from a worker too, as it keeps working rather than blocking on jobs queued behind itself
+	void wait(JobCounter& counter);
+
+	// Queue a task for the workers and get a future for its result (exceptions are rethrown by future.get())
+	template<typename Task>
+	auto submit(Task task) -> std::future<decltype(task())>
+	{
+		using ResultType = decltype(task());
+
+		// Package task so its result can be collected through the returned future
+		auto packagedTask = std::make_shared<std::packaged_task<ResultType()>>(std::move(task));
+		std::future<ResultType> result = packagedTask->get_future();
+
+		run([packagedTask]() { (*packagedTask)(); });
+
+		return result;
+	}
+
+	// Run task(i) for each i in [0, count) across the workers and the calling thread, waiting for all of them before rethrowing the first exception
+	template<typename Task>
+	void forEach(size_t count, Task task)
+	{
+		JobCounter counter;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			run([&task, i]() { task(i); }, &counter);
+		}
+
+		wait(counter);
+	}
+
+	size_t getThreadCount();
+
+	~ThreadPool();
+
+private:
+
+	struct Job
+	{
+		std::function<void()> task;
+		JobCounter* counter;
+	};
+
+	// Pushed and popped at the back by its worker, stolen from the front by everyone else
+	struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<WorkerQueue>> queues;												// One per worker
+	std::atomic<size_t> queuedJobCount{ 0 };														// Jobs in any queue, which idle workers sleep until there are
+	std::atomic<size_t> nextQueue{ 0 };																// Queue the next job from outside the pool goes to, round robin
+	std::atomic<size_t> sleepingWorkerCount{ 0 };													// Workers waiting on sleepCondition, which pushing a job only has to notify if any
+	std::atomic<size_t> waitingThreadCount{ 0 };													// Threads in wait sleeping on waitCondition, notified by new jobs and finished counters
+
+	std::mutex sleepMutex;
+	std::condition_variable sleepCondition;
+	std::condition_variable waitCondition;
+	bool stopping = false;
+
+	void push(Job job);
+	bool findJob(size_t workerIndex, Job& job);
+	void execute(Job& job);
+	void workerLoop(size_t workerIndex);
+
+};
@@ -0,0 +1,218 @@
+#include "TransformMath.h"
+
+#ifdef TRANSFORM_MATH_SSE
+#include <emmintrin.h>
+#endif
+
+size_t TransformArrays::size() const
+{
+	return positionX.size();
+}
+
+void TransformArrays::resize(size_t count)
+{
+	for (auto* component : { &positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ, &rotationW, &scaleX, &scaleY, &scaleZ })
+	{
+		component->resize(count);
+	}
+}
+
+void TransformArrays::set(size_t index, glm::vec3 position, glm::quat rotation, glm::vec3 scale)
+{
+	positionX[index] = position.x;
+	positionY[index] = position.y;
+	positionZ[index] = position.z;
+	rotationX[index] = rotation.x;
+	rotationY[index] = rotation.y;
+	rotationZ[index] = rotation.z;
+	rotationW[index] = rotation.w;
+	scaleX[index] = scale.x;
+	scaleY[index] = scale.y;
+	scaleZ[index] = scale.z;
+}
+
+glm::vec3 TransformArrays::getPosition(size_t index) const
+{
+	return glm::vec3(positionX[index], positionY[index], positionZ[index]);
+}
+
+glm::quat TransformArrays::getRotation(size_t index) const
+{
+	return glm::quat(rotationW[index], rotationX[index], rotationY[index], rotationZ[index]);
+}
+
+glm::vec3 TransformArrays::getScale(size_t index) const
+{
+	return glm::vec3(scaleX[index], scaleY[index], scaleZ[index]);
+}
+
+void decomposeTransform(const glm::mat4& matrix, glm::vec3& position, glm::quat& rotation, glm::vec3& scale)
+{
+	position = glm::vec3(matrix[3]);
+
+	glm::vec3 axes[3] = { glm::vec3(matrix[0]), glm::vec3(matrix[1]), glm::vec3(matrix[2]) };
+	scale = glm::vec3(glm::length(axes[0]), glm::length(axes[1]), glm::length(axes[2]));
+
+	// A mirrored matrix keeps a proper rotation by flipping one axis into the scale
+	if (glm::dot(glm::cross(axes[0], axes[1]), axes[2]) < 0.0f)
+	{
+		scale.x = -scale.x;
+	}
+
+	glm::mat3 rotationMatrix(1.0f);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (scale[axis] != 0.0f)
+		{
+			rotationMatrix[axis] = axes[axis] / scale[axis];
+		}
+	}
+
+	rotation = glm::normalize(glm::quat_cast(rotationMatrix));
+}
+
+namespace
+{
+	void composeTransformMatrix(const TransformArrays& transforms, size_t index, glm::mat4& matrix)
+	{
+		glm::mat3 rotation = glm::mat3_cast(transforms.getRotation(index));
+		glm::vec3 scale = transforms.getScale(index);
+
+		matrix[0] = glm::vec4(rotation[0] * scale.x, 0.0f);
+		matrix[1] = glm::vec4(rotation[1] * scale.y, 0.0f);
+		matrix[2] = glm::vec4(rotation[2] * scale.z, 0.0f);
+		matrix[3] = glm::vec4(transforms.getPosition(index), 1.0f);
+	}
+}
+
+void composeTransformMatrices(const TransformArrays& transforms, size_t first, size_t count, glm::mat4* matrices)
+{
+	size_t i = 0;
+
+#ifdef TRANSFORM_MATH_SSE
+	// Four transforms per iteration, each lane of a register holding one transform's value of the same element
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 zero = _mm_setzero_ps();
+
+	for (; i + 4 <= count; i += 4)
+	{
+		size_t index = first + i;
+
+		__m128 x = _mm_loadu_ps(&transforms.rotationX[index]);
+		__m128 y = _mm_loadu_ps(&transforms.rotationY[index]);
+		__m128 z = _mm_loadu_ps(&transforms.rotationZ[index]);
+		__m128 w = _mm_loadu_ps(&transforms.rotationW[index]);
+		__m128 scaleX = _mm_loadu_ps(&transforms.scaleX[index]);
+		__m128 scaleY = _mm_loadu_ps(&transforms.scaleY[index]);
+		__m128 scaleZ = _mm_loadu_ps(&transforms.scaleZ[index]);
+
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+		// Rotation matrix of each quaternion (as glm::mat3_cast), columns scaled
+		__m128 columns[4][4];
+		columns[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), scaleX);
+		columns[0][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), scaleX);
+		columns[0][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), scaleX);
+		columns[0][3] = zero;
+		columns[1][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), scaleY);
+		columns[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), scaleY);
+		columns[1][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), scaleY);
+		columns[1][3] = zero;
+		columns[2][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), scaleZ);
+		columns[2][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), scaleZ);
+		columns[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), scaleZ);
+		columns[2][3] = zero;
+		columns[3][0] = _mm_loadu_ps(&transforms.positionX[index]);
+		columns[3][1] = _mm_loadu_ps(&transforms.positionY[index]);
+		columns[3][2] = _mm_loadu_ps(&transforms.positionZ[index]);
+		columns[3][3] = one;
+
+		// Transpose each column's registers so every transform's column lands in one register, then store
+		for (int column = 0; column < 4; column++)
+		{
+			_MM_TRANSPOSE4_PS(columns[column][0], columns[column][1], columns[column][2], columns[column][3]);
+
+			for (int lane = 0; lane < 4; lane++)
+			{
+				_mm_storeu_ps(&matrices[i + lane][column][0], columns[column][lane]);
+			}
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		composeTransformMatrix(transforms, first + i, matrices[i]);
+	}
+}
+
+void multiplyMatrix(const glm::mat4& left, const glm::mat4& right, glm::mat4& result)
+{
+#ifdef TRANSFORM_MATH_SSE
+	// Each result column is the left matrix's columns weighted by the right column's elements
+	__m128 leftColumns[4];
+	for (int column = 0; column < 4; column++)
+	{
+		leftColumns[column] = _mm_loadu_ps(&left[column][0]);
+	}
+
+	__m128 resultColumns[4];
+	for (int column = 0; column < 4; column++)
+	{
+		__m128 rightColumn = _mm_loadu_ps(&right[column][0]);
+
+		__m128 sum = _mm_mul_ps(leftColumns[0], _mm_shuffle_ps(rightColumn, rightColumn, _MM_SHUFFLE(0, 0, 0, 0)));
+		sum = _mm_add_ps(sum, _mm_mul_ps(leftColumns[1], _mm_shuffle_ps(rightColumn, rightColumn, _MM_SHUFFLE(1, 1, 1, 1))));
+		sum = _mm_add_ps(sum, _mm_mul_ps(leftColumns[2], _mm_shuffle_ps(rightColumn, rightColumn, _MM_SHUFFLE(2, 2, 2, 2))));
+		sum = _mm_add_ps(sum, _mm_mul_ps(leftColumns[3], _mm_shuffle_ps(rightColumn, rightColumn, _MM_SHUFFLE(3, 3, 3, 3))));
+		resultColumns[column] = sum;
+	}
+
+	for (int column = 0; column < 4; column++)
+	{
+		_mm_storeu_ps(&result[column][0], resultColumns[column]);
+	}
+#else
+	result = left * right;
+#endif
+}
+
+void multiplyMatrices(const glm::mat4& left, const glm::mat4* rights, glm::mat4* results, size_t count)
+{
+#ifdef TRANSFORM_MATH_SSE
+	// The shared left matrix stays in registers across the whole batch
+	__m128 leftColumns[4];
+	for (int column = 0; column < 4; column++)
+	{
+		leftColumns[column] = _mm_loadu_ps(&left[column][0]);
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		__m128 resultColumns[4];
+		for (int column = 0; column < 4; column++)
+		{
+			__m128 rightColumn = _mm_loadu_ps(&rights[i][column][0]);
+
+			__m128 sum = _mm_mul_ps(leftColumns[0], _mm_shuffle_ps(rightColumn, rightColumn, _MM_SHUFFLE(0, 0, 0, 0)));
+			sum = _mm_add_ps(sum, _mm_mul_ps(leftColumns[1], _mm_shuffle_ps(rightColumn, rightColumn, _MM_SHUFFLE(1, 1, 1, 1))));
+			sum = _mm_add_ps(sum, _mm_mul_ps(leftColumns[2], _mm_shuffle_ps(rightColumn, rightColumn, _MM_SHUFFLE(2, 2, 2, 2))));
+			sum = _mm_add_ps(sum, _mm_mul_ps(leftColumns[3], _mm_shuffle_ps(rightColumn, rightColumn, _MM_SHUFFLE(3, 3, 3, 3))));
+			resultColumns[column] = sum;
+		}
+
+		for (int column = 0; column < 4; column++)
+		{
+			_mm_storeu_ps(&results[i][column][0], resultColumns[column]);
+		}
+	}
+#else
+	for (size_t i = 0; i < count; i++)
+	{
+		results[i] = left * rights[i];
+	}
+#endif
+}
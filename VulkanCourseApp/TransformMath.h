@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Batched transform math for many objects at once, four at a time in SSE registers where available (GLM otherwise)
+// Transforms are kept as separate arrays per component (structure of arrays), so a batch loads straight into SIMD lanes
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_MATH_SSE
+#endif
+
+// Position, rotation and scale of many transforms, one array per component
+struct TransformArrays
+{
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> rotationX, rotationY, rotationZ, rotationW;									// Unit quaternions
+	std::vector<float> scaleX, scaleY, scaleZ;
+
+	size_t size() const;
+	void resize(size_t count);
+
+	void set(size_t index, glm::vec3 position, glm::quat rotation, glm::vec3 scale);
+	glm::vec3 getPosition(size_t index) const;
+	glm::quat getRotation(size_t index) const;
+	glm::vec3 getScale(size_t index) const;
+};
+
+// Split an affine matrix into position, rotation and scale (any shear is lost)
+void decomposeTransform(const glm::mat4& matrix, glm::vec3& position, glm::quat& rotation, glm::vec3& scale);
+
+// Matrices (translation * rotation * scale) of transforms [first, first + count)
+void composeTransformMatrices(const TransformArrays& transforms, size_t first, size_t count, glm::mat4* matrices);
+
+// result = left * right (result may alias either)
+void multiplyMatrix(const glm::mat4& left, const glm::mat4& right, glm::mat4& result);
+
+// results[i] = left * rights[i] for count matrices (results may alias rights)
+void multiplyMatrices(const glm::mat4& left, const glm::mat4* rights, glm::mat4* results, size_t count);
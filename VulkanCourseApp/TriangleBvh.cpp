@@ -0,0 +1,420 @@
+#include "TriangleBvh.h"
+
+#include <algorithm>
+#include <limits>
+
+#ifdef TRANSFORM_MATH_SSE
+#include <emmintrin.h>
+#endif
+
+// Half the surface area of a box, which the heuristic only compares
+static float calculateSurfaceArea(glm::vec3 boundsMin, glm::vec3 boundsMax)
+{
+	glm::vec3 size = boundsMax - boundsMin;
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+bool intersectRayBox(glm::vec3 origin, glm::vec3 inverseDirection, glm::vec3 boundsMin, glm::vec3 boundsMax, float maxDistance, float& entryDistance)
+{
+	// Distances to the box's pair of planes along each axis (slabs): the ray is inside once it has entered every slab, until it leaves one
+#ifdef TRANSFORM_MATH_SSE
+	// An axis per lane, the fourth holding the range [0, maxDistance] the ray is limited to
+	__m128 originLanes = _mm_set_ps(0.0f, origin.z, origin.y, origin.x);
+	__m128 inverseLanes = _mm_set_ps(1.0f, inverseDirection.z, inverseDirection.y, inverseDirection.x);
+	__m128 distance0 = _mm_mul_ps(_mm_sub_ps(_mm_set_ps(0.0f, boundsMin.z, boundsMin.y, boundsMin.x), originLanes), inverseLanes);
+	__m128 distance1 = _mm_mul_ps(_mm_sub_ps(_mm_set_ps(maxDistance, boundsMax.z, boundsMax.y, boundsMax.x), originLanes), inverseLanes);
+	__m128 entry = _mm_min_ps(distance0, distance1);
+	__m128 exit = _mm_max_ps(distance0, distance1);
+
+	// Latest entry and earliest exit across the lanes
+	entry = _mm_max_ps(entry, _mm_shuffle_ps(entry, entry, _MM_SHUFFLE(2, 3, 0, 1)));
+	entry = _mm_max_ps(entry, _mm_shuffle_ps(entry, entry, _MM_SHUFFLE(1, 0, 3, 2)));
+	exit = _mm_min_ps(exit, _mm_shuffle_ps(exit, exit, _MM_SHUFFLE(2, 3, 0, 1)));
+	exit = _mm_min_ps(exit, _mm_shuffle_ps(exit, exit, _MM_SHUFFLE(1, 0, 3, 2)));
+
+	entryDistance = _mm_cvtss_f32(entry);
+	return entryDistance <= _mm_cvtss_f32(exit);
+#else
+	glm::vec3 distance0 = (boundsMin - origin) * inverseDirection;
+	glm::vec3 distance1 = (boundsMax - origin) * inverseDirection;
+	glm::vec3 entry = glm::min(distance0, distance1);
+	glm::vec3 exit = glm::max(distance0, distance1);
+
+	entryDistance = std::max(std::max(entry.x, entry.y), std::max(entry.z, 0.0f));
+	return entryDistance <= std::min(std::min(exit.x, exit.y), std::min(exit.z, maxDistance));
+#endif
+}
+
+void TriangleBvh::build(const glm::vec3* positions, size_t positionStride, const uint32_t* indices, size_t indexCount)
+{
+	nodes.clear();
+	packets.clear();
+	triangleCount = indexCount / 3;
+
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	const uint8_t* positionBytes = reinterpret_cast<const uint8_t*>(positions);
+	auto getPosition = [&](uint32_t index) -> const glm::vec3&
+	{
+		return *reinterpret_cast<const glm::vec3*>(positionBytes + index * positionStride);
+	};
+
+	// Box and center of each triangle, the centers deciding which side of a split a triangle goes
+	std::vector<glm::vec3> triangleMin(triangleCount);
+	std::vector<glm::vec3> triangleMax(triangleCount);
+	std::vector<glm::vec3> centers(triangleCount);
+	std::vector<uint32_t> triangleOrder(triangleCount);
+
+	for (size_t i = 0; i < triangleCount; i++)
+	{
+		const glm::vec3& position0 = getPosition(indices[i * 3]);
+		const glm::vec3& position1 = getPosition(indices[i * 3 + 1]);
+		const glm::vec3& position2 = getPosition(indices[i * 3 + 2]);
+
+		triangleMin[i] = glm::min(position0, glm::min(position1, position2));
+		triangleMax[i] = glm::max(position0, glm::max(position1, position2));
+		centers[i] = (triangleMin[i] + triangleMax[i]) * 0.5f;
+		triangleOrder[i] = static_cast<uint32_t>(i);
+	}
+
+	// Range of triangleOrder (first, count) and depth of each node, while building
+	std::vector<glm::uvec3> nodeRanges;
+
+	nodes.reserve(triangleCount / 2 + 1);
+	nodeRanges.reserve(triangleCount / 2 + 1);
+	nodes.push_back({ glm::vec3(0.0f), 0, glm::vec3(0.0f), 0 });
+	nodeRanges.push_back(glm::uvec3(0, static_cast<uint32_t>(triangleCount), 0));
+
+	// Bound each queued node by its triangles, then make it a leaf or queue its two halves (nodeRanges growing alongside nodes)
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		uint32_t first = nodeRanges[i].x;
+		uint32_t count = nodeRanges[i].y;
+		uint32_t depth = nodeRanges[i].z;
+
+		glm::vec3 boundsMin(std::numeric_limits<float>::max());
+		glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+		glm::vec3 centerMin(std::numeric_limits<float>::max());
+		glm::vec3 centerMax(-std::numeric_limits<float>::max());
+
+		for (uint32_t j = first; j < first + count; j++)
+		{
+			uint32_t triangle = triangleOrder[j];
+			boundsMin = glm::min(boundsMin, triangleMin[triangle]);
+			boundsMax = glm::max(boundsMax, triangleMax[triangle]);
+			centerMin = glm::min(centerMin, centers[triangle]);
+			centerMax = glm::max(centerMax, centers[triangle]);
+		}
+
+		nodes[i].boundsMin = boundsMin;
+		nodes[i].boundsMax = boundsMax;
+
+		// Few enough for a leaf, stored as a vertex and two edges per triangle
+		if (count <= TRIANGLE_BVH_LEAF_SIZE)
+		{
+			TrianglePacket packet = {};
+
+			for (uint32_t lane = 0; lane < TRIANGLE_BVH_LEAF_SIZE; lane++)
+			{
+				if (lane >= count)
+				{
+					packet.triangle[lane] = UINT32_MAX;
+					continue;
+				}
+
+				uint32_t triangle = triangleOrder[first + lane];
+				const glm::vec3& position0 = getPosition(indices[triangle * 3]);
+				glm::vec3 edge1 = getPosition(indices[triangle * 3 + 1]) - position0;
+				glm::vec3 edge2 = getPosition(indices[triangle * 3 + 2]) - position0;
+
+				packet.vertexX[lane] = position0.x;
+				packet.vertexY[lane] = position0.y;
+				packet.vertexZ[lane] = position0.z;
+				packet.edge1X[lane] = edge1.x;
+				packet.edge1Y[lane] = edge1.y;
+				packet.edge1Z[lane] = edge1.z;
+				packet.edge2X[lane] = edge2.x;
+				packet.edge2Y[lane] = edge2.y;
+				packet.edge2Z[lane] = edge2.z;
+				packet.triangle[lane] = triangle;
+			}
+
+			nodes[i].packet = static_cast<uint32_t>(packets.size());
+			packets.push_back(packet);
+			continue;
+		}
+
+		// Bin the centers along each axis and try the split between every pair of neighbouring bins, keeping the one
+		// with the least cost: the surface area of each side (how likely a ray is to enter it) times the triangles in it
+		int bestAxis = -1;
+		uint32_t bestSplit = 0;
+		float bestCost = std::numeric_limits<float>::max();
+		glm::vec3 centerExtent = centerMax - centerMin;
+
+		auto getBin = [&](uint32_t triangle, int axis)
+		{
+			float bin = (centers[triangle][axis] - centerMin[axis]) * (TRIANGLE_BVH_SAH_BINS / centerExtent[axis]);
+			return std::min(static_cast<uint32_t>(bin), TRIANGLE_BVH_SAH_BINS - 1);
+		};
+
+		for (int axis = 0; depth < TRIANGLE_BVH_SAH_DEPTH && axis < 3; axis++)
+		{
+			if (centerExtent[axis] <= 0.0f)
+			{
+				continue;
+			}
+
+			glm::vec3 binMin[TRIANGLE_BVH_SAH_BINS];
+			glm::vec3 binMax[TRIANGLE_BVH_SAH_BINS];
+			uint32_t binCounts[TRIANGLE_BVH_SAH_BINS] = {};
+
+			for (uint32_t bin = 0; bin < TRIANGLE_BVH_SAH_BINS; bin++)
+			{
+				binMin[bin] = glm::vec3(std::numeric_limits<float>::max());
+				binMax[bin] = glm::vec3(-std::numeric_limits<float>::max());
+			}
+
+			for (uint32_t j = first; j < first + count; j++)
+			{
+				uint32_t triangle = triangleOrder[j];
+				uint32_t bin = getBin(triangle, axis);
+
+				binMin[bin] = glm::min(binMin[bin], triangleMin[triangle]);
+				binMax[bin] = glm::max(binMax[bin], triangleMax[triangle]);
+				binCounts[bin]++;
+			}
+
+			// Cost of the right side of each split, swept from the right, then both sides swept from the left
+			float rightCosts[TRIANGLE_BVH_SAH_BINS];
+			glm::vec3 sideMin(std::numeric_limits<float>::max());
+			glm::vec3 sideMax(-std::numeric_limits<float>::max());
+			uint32_t sideCount = 0;
+
+			for (uint32_t bin = TRIANGLE_BVH_SAH_BINS - 1; bin > 0; bin--)
+			{
+				sideMin = glm::min(sideMin, binMin[bin]);
+				sideMax = glm::max(sideMax, binMax[bin]);
+				sideCount += binCounts[bin];
+				rightCosts[bin] = sideCount > 0 ? calculateSurfaceArea(sideMin, sideMax) * sideCount : 0.0f;
+			}
+
+			sideMin = glm::vec3(std::numeric_limits<float>::max());
+			sideMax = glm::vec3(-std::numeric_limits<float>::max());
+			sideCount = 0;
+
+			for (uint32_t bin = 0; bin < TRIANGLE_BVH_SAH_BINS - 1; bin++)
+			{
+				sideMin = glm::min(sideMin, binMin[bin]);
+				sideMax = glm::max(sideMax, binMax[bin]);
+				sideCount += binCounts[bin];
+
+				// Both sides need triangles
+				if (sideCount == 0 || sideCount == count)
+				{
+					continue;
+				}
+
+				float cost = calculateSurfaceArea(sideMin, sideMax) * sideCount + rightCosts[bin + 1];
+
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = bin;
+				}
+			}
+		}
+
+		// Centers all in one place (or the tree too deep), any split is as good as another, so halve the node
+		uint32_t half = count / 2;
+
+		if (bestAxis >= 0)
+		{
+			auto middle = std::partition(triangleOrder.begin() + first, triangleOrder.begin() + first + count, [&](uint32_t triangle)
+			{
+				return getBin(triangle, bestAxis) <= bestSplit;
+			});
+
+			half = static_cast<uint32_t>(middle - (triangleOrder.begin() + first));
+		}
+
+		nodes[i].firstChild = static_cast<uint32_t>(nodes.size());
+		nodes.push_back({ glm::vec3(0.0f), 0, glm::vec3(0.0f), 0 });
+		nodes.push_back({ glm::vec3(0.0f), 0, glm::vec3(0.0f), 0 });
+		nodeRanges.push_back(glm::uvec3(first, half, depth + 1));
+		nodeRanges.push_back(glm::uvec3(first + half, count - half, depth + 1));
+	}
+}
+
+bool TriangleBvh::raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance, TriangleHit& hit) const
+{
+	if (nodes.empty())
+	{
+		return false;
+	}
+
+	glm::vec3 inverseDirection = 1.0f / direction;
+	float nearestDistance = maxDistance;
+	bool found = false;
+
+	// Nodes still to visit, with the distance the ray enters them (skipped if a nearer hit has since been found)
+	struct StackEntry
+	{
+		uint32_t node;
+		float entryDistance;
+	};
+
+	StackEntry stack[TRIANGLE_BVH_SAH_DEPTH * 2];
+	size_t stackSize = 0;
+
+	float rootEntryDistance;
+
+	if (!intersectRayBox(origin, inverseDirection, nodes[0].boundsMin, nodes[0].boundsMax, nearestDistance, rootEntryDistance))
+	{
+		return false;
+	}
+
+	stack[stackSize++] = { 0, rootEntryDistance };
+
+	while (stackSize > 0)
+	{
+		StackEntry entry = stack[--stackSize];
+
+		if (entry.entryDistance > nearestDistance)
+		{
+			continue;
+		}
+
+		const Node& node = nodes[entry.node];
+
+		if (node.firstChild == 0)
+		{
+			float distance;
+			int lane = intersectPacket(packets[node.packet], origin, direction, nearestDistance, distance);
+
+			if (lane >= 0)
+			{
+				nearestDistance = distance;
+				hit.distance = distance;
+				hit.triangle = packets[node.packet].triangle[lane];
+				found = true;
+			}
+
+			continue;
+		}
+
+		// Visit the nearer child first, so a hit within it can skip the other
+		float entryDistance0, entryDistance1;
+		bool enters0 = intersectRayBox(origin, inverseDirection, nodes[node.firstChild].boundsMin, nodes[node.firstChild].boundsMax, nearestDistance, entryDistance0);
+		bool enters1 = intersectRayBox(origin, inverseDirection, nodes[node.firstChild + 1].boundsMin, nodes[node.firstChild + 1].boundsMax, nearestDistance, entryDistance1);
+
+		if (enters0 && enters1 && entryDistance1 < entryDistance0)
+		{
+			stack[stackSize++] = { node.firstChild, entryDistance0 };
+			stack[stackSize++] = { node.firstChild + 1, entryDistance1 };
+			continue;
+		}
+
+		if (enters1)
+		{
+			stack[stackSize++] = { node.firstChild + 1, entryDistance1 };
+		}
+
+		if (enters0)
+		{
+			stack[stackSize++] = { node.firstChild, entryDistance0 };
+		}
+	}
+
+	return found;
+}
+
+size_t TriangleBvh::getTriangleCount() const
+{
+	return triangleCount;
+}
+
+int TriangleBvh::intersectPacket(const TrianglePacket& packet, glm::vec3 origin, glm::vec3 direction, float maxDistance, float& distance)
+{
+	// Moller-Trumbore: solve origin + distance * direction = vertex + u * edge1 + v * edge2 by Cramer's rule, a hit being
+	// in front (distance > 0) and inside the triangle (u, v >= 0 and u + v <= 1). Triangles parallel to the ray have no determinant
+	alignas(16) float distances[TRIANGLE_BVH_LEAF_SIZE];
+	int hits = 0;
+
+#ifdef TRANSFORM_MATH_SSE
+	__m128 directionX = _mm_set1_ps(direction.x), directionY = _mm_set1_ps(direction.y), directionZ = _mm_set1_ps(direction.z);
+	__m128 edge1X = _mm_load_ps(packet.edge1X), edge1Y = _mm_load_ps(packet.edge1Y), edge1Z = _mm_load_ps(packet.edge1Z);
+	__m128 edge2X = _mm_load_ps(packet.edge2X), edge2Y = _mm_load_ps(packet.edge2Y), edge2Z = _mm_load_ps(packet.edge2Z);
+
+	__m128 pX = _mm_sub_ps(_mm_mul_ps(directionY, edge2Z), _mm_mul_ps(directionZ, edge2Y));
+	__m128 pY = _mm_sub_ps(_mm_mul_ps(directionZ, edge2X), _mm_mul_ps(directionX, edge2Z));
+	__m128 pZ = _mm_sub_ps(_mm_mul_ps(directionX, edge2Y), _mm_mul_ps(directionY, edge2X));
+	__m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge1X, pX), _mm_mul_ps(edge1Y, pY)), _mm_mul_ps(edge1Z, pZ));
+	__m128 inverseDeterminant = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+
+	__m128 tX = _mm_sub_ps(_mm_set1_ps(origin.x), _mm_load_ps(packet.vertexX));
+	__m128 tY = _mm_sub_ps(_mm_set1_ps(origin.y), _mm_load_ps(packet.vertexY));
+	__m128 tZ = _mm_sub_ps(_mm_set1_ps(origin.z), _mm_load_ps(packet.vertexZ));
+	__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tX, pX), _mm_mul_ps(tY, pY)), _mm_mul_ps(tZ, pZ)), inverseDeterminant);
+
+	__m128 qX = _mm_sub_ps(_mm_mul_ps(tY, edge1Z), _mm_mul_ps(tZ, edge1Y));
+	__m128 qY = _mm_sub_ps(_mm_mul_ps(tZ, edge1X), _mm_mul_ps(tX, edge1Z));
+	__m128 qZ = _mm_sub_ps(_mm_mul_ps(tX, edge1Y), _mm_mul_ps(tY, edge1X));
+	__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(directionX, qX), _mm_mul_ps(directionY, qY)), _mm_mul_ps(directionZ, qZ)), inverseDeterminant);
+	__m128 hitDistance = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edge2X, qX), _mm_mul_ps(edge2Y, qY)), _mm_mul_ps(edge2Z, qZ)), inverseDeterminant);
+
+	// Comparisons with NaN (no determinant) fail, so those lanes miss
+	__m128 zero = _mm_setzero_ps();
+	__m128 hitMask = _mm_and_ps(_mm_cmpneq_ps(determinant, zero), _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero)));
+	hitMask = _mm_and_ps(hitMask, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+	hitMask = _mm_and_ps(hitMask, _mm_and_ps(_mm_cmpgt_ps(hitDistance, zero), _mm_cmplt_ps(hitDistance, _mm_set1_ps(maxDistance))));
+
+	hits = _mm_movemask_ps(hitMask);
+	_mm_store_ps(distances, hitDistance);
+#else
+	for (uint32_t lane = 0; lane < TRIANGLE_BVH_LEAF_SIZE; lane++)
+	{
+		glm::vec3 edge1(packet.edge1X[lane], packet.edge1Y[lane], packet.edge1Z[lane]);
+		glm::vec3 edge2(packet.edge2X[lane], packet.edge2Y[lane], packet.edge2Z[lane]);
+		glm::vec3 p = glm::cross(direction, edge2);
+		float determinant = glm::dot(edge1, p);
+
+		if (determinant == 0.0f)
+		{
+			continue;
+		}
+
+		float inverseDeterminant = 1.0f / determinant;
+		glm::vec3 t = origin - glm::vec3(packet.vertexX[lane], packet.vertexY[lane], packet.vertexZ[lane]);
+		float u = glm::dot(t, p) * inverseDeterminant;
+		glm::vec3 q = glm::cross(t, edge1);
+		float v = glm::dot(direction, q) * inverseDeterminant;
+		distances[lane] = glm::dot(edge2, q) * inverseDeterminant;
+
+		if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && distances[lane] > 0.0f && distances[lane] < maxDistance)
+		{
+			hits |= 1 << lane;
+		}
+	}
+#endif
+
+	int nearestLane = -1;
+
+	for (uint32_t lane = 0; lane < TRIANGLE_BVH_LEAF_SIZE; lane++)
+	{
+		if (((hits >> lane) & 1) && (nearestLane < 0 || distances[lane] < distances[nearestLane]))
+		{
+			nearestLane = static_cast<int>(lane);
+		}
+	}
+
+	if (nearestLane >= 0)
+	{
+		distance = distances[nearestLane];
+	}
+
+	return nearestLane;
+}
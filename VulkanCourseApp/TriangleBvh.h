@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "TransformMath.h"
+
+// Bounding volume hierarchy over the triangles of one mesh, in mesh space, for ray casts (picking) on the CPU
+// Built once when the mesh loads by binned surface area heuristic, which places splits where rays are least likely to have to visit both sides
+// Each leaf holds at most four triangles, stored with each component in its own array so a ray tests all of them at once
+
+const uint32_t TRIANGLE_BVH_LEAF_SIZE = 4;															// Triangles a leaf holds, one per SIMD lane
+const uint32_t TRIANGLE_BVH_SAH_BINS = 16;															// Candidate splits per axis are the edges between bins
+const uint32_t TRIANGLE_BVH_SAH_DEPTH = 64;															// Deeper nodes are halved instead, bounding the tree's depth (and a ray cast's stack)
+
+// Nearest triangle a ray hits
+struct TriangleHit
+{
+	float distance;																					// Along the ray, in units of its direction
+	uint32_t triangle;																				// Indices 3 * triangle to 3 * triangle + 2 of those the tree was built from
+};
+
+// Whether a ray enters a box before maxDistance, and where (from 0 if it starts inside)
+// inverseDirection is 1 / direction per component (infinite for a zero component)
+bool intersectRayBox(glm::vec3 origin, glm::vec3 inverseDirection, glm::vec3 boundsMin, glm::vec3 boundsMax, float maxDistance, float& entryDistance);
+
+class TriangleBvh
+{
+public:
+
+	// Build the tree over indexCount / 3 triangles, each position positionStride bytes after the last
+	void build(const glm::vec3* positions, size_t positionStride, const uint32_t* indices, size_t indexCount);
+
+	// Nearest triangle hit in front of the origin and before maxDistance (either side of a triangle counts); false if none
+	bool raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance, TriangleHit& hit) const;
+
+	size_t getTriangleCount() const;
+
+private:
+	// 32 bytes, each bound padded out by an index, so a ray tests a pair of siblings from 64 contiguous bytes
+	struct Node
+	{
+		glm::vec3 boundsMin;
+		uint32_t firstChild;																		// Pair of siblings a ray tests together, nearer first (0 for a leaf)
+		glm::vec3 boundsMax;
+		uint32_t packet;																			// Within packets, if a leaf
+	};
+
+	// Up to four triangles as a vertex and the two edges leaving it (unused lanes have no area, so nothing hits them)
+	struct TrianglePacket
+	{
+		alignas(16) float vertexX[TRIANGLE_BVH_LEAF_SIZE];
+		alignas(16) float vertexY[TRIANGLE_BVH_LEAF_SIZE];
+		alignas(16) float vertexZ[TRIANGLE_BVH_LEAF_SIZE];
+		alignas(16) float edge1X[TRIANGLE_BVH_LEAF_SIZE];
+		alignas(16) float edge1Y[TRIANGLE_BVH_LEAF_SIZE];
+		alignas(16) float edge1Z[TRIANGLE_BVH_LEAF_SIZE];
+		alignas(16) float edge2X[TRIANGLE_BVH_LEAF_SIZE];
+		alignas(16) float edge2Y[TRIANGLE_BVH_LEAF_SIZE];
+		alignas(16) float edge2Z[TRIANGLE_BVH_LEAF_SIZE];
+		uint32_t triangle[TRIANGLE_BVH_LEAF_SIZE];
+	};
+
+	std::vector<Node> nodes;																		// Root first, where every ray cast starts
+	std::vector<TrianglePacket> packets;
+	size_t triangleCount = 0;
+
+	// Nearest lane of a packet hit before maxDistance, or -1
+	static int intersectPacket(const TrianglePacket& packet, glm::vec3 origin, glm::vec3 direction, float maxDistance, float& distance);
+
+};
@@ -1,10 +1,42 @@
 #pragma once
 
 #include <fstream>
+#include <functional>
+#include <cstdio>
 #include <glm/glm.hpp>
 
 const int MAX_FRAME_DRAWS = 3;
-const int MAX_OBJECTS = 20;
+const int MAX_TEXTURES = 1024;
+const int MAX_SCENE_NODES = 4096;																				// World matrices the per-frame transform buffer holds
+
+// Texture Streaming
+const uint32_t TEXTURE_STREAMING_TAIL_SIZE = 64;																// Largest mip level that is always resident
+const uint32_t TEXTURE_STREAMING_UPLOADS_PER_FRAME = 2;															// Finer mip uploads allowed each frame
+const uint32_t TEXTURE_STREAMING_EVICTIONS_PER_FRAME = 4;														// Drops to coarser levels allowed each frame
+const VkDeviceSize TEXTURE_STREAMING_BUDGET = 256ull * 1024 * 1024;												// Default device memory budget for textures
+const VkDeviceSize TEXTURE_STREAMING_STAGING_SIZE = 64ull * 1024 * 1024;										// Staging ring the frames in flight upload finer mips through
+
+// Texture Atlas
+const uint32_t TEXTURE_ATLAS_MAX_TILE_SIZE = 512;																// Largest texture packed into a model's atlas
+const uint32_t TEXTURE_ATLAS_MAX_SIZE = 4096;																	// Largest atlas width or height
+const uint32_t TEXTURE_ATLAS_TILE_ALIGNMENT = 16;																// Tiles stay separate for the first 4 mip levels
+const uint32_t TEXTURE_ATLAS_GUTTER = 8;																		// Edge texels repeated around each tile for filtering
+
+// Level of Detail
+const uint32_t MAX_MESH_LODS = 4;																				// Full detail plus up to 3 simplified levels
+const float MESH_LOD_REDUCTION = 0.5f;																			// Triangles kept by each level relative to the one before
+const float MESH_LOD_MAX_ERROR = 0.05f;																			// Largest simplification error, relative to the mesh's bounding radius
+const float MESH_LOD_PIXEL_ERROR = 1.0f;																		// Largest simplification error allowed on screen, in pixels
+const float MESH_LOD_HYSTERESIS = 0.25f;																		// Margin below the pixel error needed before moving to a coarser level
+
+// Occlusion Culling
+const uint32_t OCCLUSION_CULL_GROUP_SIZE = 64;																	// Threads per workgroup of occlusionCull.comp
+const uint32_t DEPTH_PYRAMID_GROUP_SIZE = 8;																	// Width and height of depthPyramid.comp's workgroups
+
+// Software Occlusion Culling
+const size_t SOFTWARE_OCCLUSION_MAX_OCCLUDERS = 16;																// Meshes drawn into the occlusion buffer each frame, the largest on screen
+const float SOFTWARE_OCCLUSION_MIN_OCCLUDER_SIZE = 0.05f;														// Smallest bounding radius over distance from the camera for a mesh to occlude others
+const size_t SOFTWARE_OCCLUSION_BATCH_SIZE = 64;																// Instances a worker tests against the occlusion buffer at a time
 
 const std::vector<const char*> deviceExtensions = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
@@ -18,11 +50,19 @@ struct Vertex
 
 };
 
+// Quantized vertex uploaded when compact vertices are enabled (12 bytes instead of 32, and no constant color)
+struct CompactVertex
+{
+	uint16_t position[4];																											// XYZ as 16-bit UNORM within the mesh's bounds (W is padding)
+	uint16_t texture[2];																											// UV as 16-bit UNORM within the mesh's UV bounds
+};
+
 // Indices (locations) of Queue Families (if they exist)
 struct QueueFamilyIndices
 {
 	int graphicsFamily = -1;																										// Location of Graphics Queue Family
 	int presentationFamily = -1;																									// Location of Presentation Queue Family
+	bool graphicsCompute = false;																									// Whether the Graphics Queue Family also supports compute
 
 
 	// Check if queue families are valid
@@ -45,6 +85,50 @@ struct SwapchainImage
 	VkImageView imageView;
 };
 
+// Indirect command's bounds, tested by the occlusion cull pass (matches occlusionCull.comp)
+struct OcclusionCullDraw
+{
+	glm::vec4 boundingSphere;																					// Center (xyz) and radius (w) in mesh space
+	uint32_t node;																								// Scene node placing the mesh
+	uint32_t visibilitySlot;																					// Element of the visibility buffer remembering the result
+	uint32_t padding[2];
+};
+
+struct OcclusionCullConstants
+{
+	glm::mat4 view;
+	glm::vec4 projection;																						// Elements [0][0], [1][1], [2][2] and [3][2] of the projection
+	glm::vec2 pyramidSize;
+	uint32_t drawCount;
+	uint32_t latePass;																							// Test against the pyramid (1) or take last frame's visibility (0)
+};
+
+struct DepthPyramidConstants
+{
+	glm::ivec2 inputSize;
+	glm::ivec2 outputSize;
+};
+
+struct CullingStats
+{
+	uint32_t meshCount;																							// Meshes in the scene
+	uint32_t frustumCulledCount;																				// Meshes skipped for lying outside the view frustum
+	uint32_t occluderCount;																						// Meshes drawn into the software occlusion buffer
+	uint32_t occlusionCulledCount;																				// Meshes in the frustum found hidden behind them
+	float occluderMilliseconds;																					// Time spent drawing the occluders
+	float occludeeMilliseconds;																					// Time spent testing instances against them
+};
+
+// Nearest mesh a ray cast found
+struct RaycastHit
+{
+	int modelId;																								// As returned by createModel
+	uint32_t mesh;																								// Within the model
+	uint32_t triangle;																							// Within the mesh's full detail level (its indices 3 * triangle to 3 * triangle + 2)
+	float distance;																								// Along the ray, in units of its direction
+	glm::vec3 position;																							// World space
+};
+
 static std::vector<char> readFile(const std::string& filename)
 {
 	// Open stream from given file
@@ -74,6 +158,35 @@ static std::vector<char> readFile(const std::string& filename)
 	return fileBuffer;
 }
 
+// Write a file through a temporary one renamed over it, so an interrupted write never leaves a damaged file behind (failures are dropped)
+static void writeFileAtomically(const std::string& filename, const std::function<void(std::ofstream&)>& write)
+{
+	std::string temporaryFile = filename + ".tmp";
+	std::ofstream file(temporaryFile, std::ios::binary | std::ios::trunc);
+
+	if (!file.is_open())
+	{
+		return;
+	}
+
+	write(file);
+	file.close();
+
+	if (!file)
+	{
+		std::remove(temporaryFile.c_str());
+		return;
+	}
+
+	// Replace any old file (rename will not overwrite on Windows)
+	std::remove(filename.c_str());
+
+	if (std::rename(temporaryFile.c_str(), filename.c_str()) != 0)
+	{
+		std::remove(temporaryFile.c_str());
+	}
+}
+
 static uint32_t findMemoryTypeIndex(VkPhysicalDevice physicalDevice, uint32_t allowedTypes, VkMemoryPropertyFlags properties)
 {
 	// Get properties of physical device memory
@@ -192,82 +305,4 @@ static void copyBuffer(VkDevice logicalDevice, VkQueue transferQueue, VkCommandP
 	endCommandBuffer(logicalDevice, transferCommandPool, transferQueue, transferCommandBuffer);
 
 	
-}
-
-static void copyImageBuffer(VkDevice logicalDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, VkBuffer srcBuffer, VkImage image, uint32_t width, uint32_t height)
-{
-	// Create buffer
-	VkCommandBuffer transferCommandBuffer = beginCommandBuffer(logicalDevice, transferCommandPool);
-
-	VkBufferImageCopy imageRegion = {};
-	imageRegion.bufferOffset = 0;																									// Offset into data
-	imageRegion.bufferRowLength = 0;																								// Row length of data to calculate data spacing
-	imageRegion.bufferImageHeight = 0;																								// Image height to calculate data spacing
-	imageRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;															// Which aspect of image to copy
-	imageRegion.imageSubresource.mipLevel = 0;																						// Which mipmap texture levels to copy across
-	imageRegion.imageSubresource.baseArrayLayer = 0;																				// Starting array layer (if array)
-	imageRegion.imageSubresource.layerCount = 1;																					// Number of layers to copy starting at baseArrayLayer
-	imageRegion.imageOffset = { 0, 0, 0 };																							// Offset into image (as opposed to raw data in bufferOffset)
-	imageRegion.imageExtent = { width, height, 1 };																					// Size of region to copy as (x,y,z) values
-
-	// Copy buffer to given image
-	vkCmdCopyBufferToImage(transferCommandBuffer, srcBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageRegion);
-
-	// End and submit the command buffer
-	endCommandBuffer(logicalDevice, transferCommandPool, transferQueue, transferCommandBuffer);
-
-}
-
-static void transitionImageLayout(VkDevice logicalDevice, VkQueue queue, VkCommandPool commandPool, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout)
-{
-	// Create buffer
-	VkCommandBuffer commandBuffer = beginCommandBuffer(logicalDevice, commandPool);
-
-	// Create image memory pipeline barrier
-	VkImageMemoryBarrier imageMemoryBarrier = {};
-	imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	imageMemoryBarrier.image = image;																								// Image being accessed and modified
-	imageMemoryBarrier.oldLayout = oldLayout;																						// Layout to transition from
-	imageMemoryBarrier.newLayout = newLayout;																						// Layout to transition to
-	imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;																// Queue family to transition from
-	imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;																// Queue family to transition to
-	imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;														// Aspect of image being altered
-	imageMemoryBarrier.subresourceRange.baseMipLevel = 0;																			// First mip level to start alterations on
-	imageMemoryBarrier.subresourceRange.levelCount = 1;																				// Number of mipmap levels to alter starting from base mip level
-	imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;																			// First layer to start alterations on
-	imageMemoryBarrier.subresourceRange.layerCount = 1;																				// Number of layers to alter starting from base array layer
-	
-	VkPipelineStageFlags srcStage;
-	VkPipelineStageFlags dstStage;
-
-	// If transitioning from new image to image ready to receive data:
-	if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
-	{
-		srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-
-		imageMemoryBarrier.srcAccessMask = 0;																						// Memory access stage transition must happen after:
-		imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;															// Memory access stage transition must happen before:
-	}
-
-	// If transitioning from transfer destination to shader readable:
-	else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-	{
-		srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-
-		imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-	}
-
-	vkCmdPipelineBarrier(commandBuffer,
-						 srcStage, dstStage,																						// Pipeline stages (match to src and dst AccessMasks)
-						 0,																											// Dependency flags
-						 0, nullptr,																								// Memory barrier count + data
-						 0, nullptr,																								// Buffer memory barrier count + data
-						 1, &imageMemoryBarrier																						// Image memory barrier count + data
-	);
-
-	// End and submit the command buffer
-	endCommandBuffer(logicalDevice, commandPool, queue, commandBuffer);
 }
\ No newline at end of file
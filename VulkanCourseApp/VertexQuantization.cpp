@@ -0,0 +1,68 @@
+#include "VertexQuantization.h"
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+namespace
+{
+	// Nearest 16-bit UNORM step to value within [offset, offset + scale] (a flat axis always stores 0)
+	uint16_t quantizeUnorm16(float value, float offset, float scale)
+	{
+		if (scale <= 0.0f)
+		{
+			return 0;
+		}
+
+		float normalized = std::min(std::max((value - offset) / scale, 0.0f), 1.0f);
+		return static_cast<uint16_t>(std::lround(normalized * 65535.0f));
+	}
+}
+
+VertexQuantization calculateVertexQuantization(const Vertex* vertices, size_t vertexCount)
+{
+	VertexQuantization quantization;
+
+	if (vertexCount == 0)
+	{
+		return quantization;
+	}
+
+	glm::vec3 positionMin = glm::vec3(std::numeric_limits<float>::max());
+	glm::vec3 positionMax = glm::vec3(-std::numeric_limits<float>::max());
+	glm::vec2 textureMin = glm::vec2(std::numeric_limits<float>::max());
+	glm::vec2 textureMax = glm::vec2(-std::numeric_limits<float>::max());
+
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		positionMin = glm::min(positionMin, vertices[i].position);
+		positionMax = glm::max(positionMax, vertices[i].position);
+		textureMin = glm::min(textureMin, vertices[i].texture);
+		textureMax = glm::max(textureMax, vertices[i].texture);
+	}
+
+	quantization.positionOffset = positionMin;
+	quantization.positionScale = positionMax - positionMin;
+	quantization.textureOffset = textureMin;
+	quantization.textureScale = textureMax - textureMin;
+
+	return quantization;
+}
+
+void quantizeVertices(const Vertex* vertices, size_t vertexCount, const VertexQuantization& quantization, CompactVertex* compactVertices)
+{
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			compactVertices[i].position[axis] = quantizeUnorm16(vertices[i].position[axis], quantization.positionOffset[axis], quantization.positionScale[axis]);
+		}
+
+		compactVertices[i].position[3] = 0;
+
+		for (int axis = 0; axis < 2; axis++)
+		{
+			compactVertices[i].texture[axis] = quantizeUnorm16(vertices[i].texture[axis], quantization.textureOffset[axis], quantization.textureScale[axis]);
+		}
+	}
+}
\ No newline at end of file
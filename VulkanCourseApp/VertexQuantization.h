@@ -0,0 +1,22 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include "Utilities.h"
+
+// Mapping from a compact vertex's 16-bit UNORM values (read by the GPU as [0, 1]) back to mesh space, as offset + value * scale
+struct VertexQuantization
+{
+	glm::vec3 positionOffset = glm::vec3(0.0f);
+	glm::vec3 positionScale = glm::vec3(1.0f);
+	glm::vec2 textureOffset = glm::vec2(0.0f);
+	glm::vec2 textureScale = glm::vec2(1.0f);
+};
+
+// Quantization spanning the vertices' position and UV bounds
+VertexQuantization calculateVertexQuantization(const Vertex* vertices, size_t vertexCount);
+
+void quantizeVertices(const Vertex* vertices, size_t vertexCount, const VertexQuantization& quantization, CompactVertex* compactVertices);
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "VulkanRenderer.h"
 #include "CommonValues.h"
 #include <iostream>
+#include <chrono>
 
 VulkanRenderer::VulkanRenderer()
 {
@@ -30,10 +31,19 @@ int VulkanRenderer::init(GLFWwindow* newWindow)
 		createRenderPass();
 		createDescriptorSetLayout();
 		createPushConstantRange();
+
+		// Pipelines compile much faster once the driver has its cache from an earlier run to start from
+		bool pipelineCacheLoaded = false;
+		pipelineCache = createPipelineCache(mainDevice.physicalDevice, mainDevice.logicalDevice, PIPELINE_CACHE_FILE, pipelineCacheLoaded);
+
+		auto pipelineStart = std::chrono::steady_clock::now();
 		createGraphicsPipeline();
+		std::chrono::duration<float, std::milli> pipelineTime = std::chrono::steady_clock::now() - pipelineStart;
+
 		createFramebuffers();
 		createCommandPool();
 		createCommandBuffers();
+		createTextureStreaming();
 		createTextureSampler();
 		createUniformBuffers();
 		createDescriptorPool();
@@ -41,6 +51,19 @@ int VulkanRenderer::init(GLFWwindow* newWindow)
 		createInputDescriptorSets();
 		createSynchronization();
 
+		if (occlusionCulling)
+		{
+			pipelineStart = std::chrono::steady_clock::now();
+			createOcclusionCullPipelines();
+			pipelineTime += std::chrono::steady_clock::now() - pipelineStart;
+
+			createDepthPyramid();
+		}
+
+		printf("Created pipelines in %.1f ms (%s)\n", pipelineTime.count(), pipelineCacheLoaded ? "from the saved pipeline cache" : "no usable pipeline cache saved");
+
+		createRenderGraph();
+
 		viewProjection.projection = glm::perspective(glm::radians(45.0f), (float)swapchainExtent.width / (float)swapchainExtent.height, 0.1f, 100.0f);
 		viewProjection.view = glm::lookAt(glm::vec3(10.0f, 0.0f, 20.0f), glm::vec3(0.0f, 0.0f, -2.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 
@@ -69,7 +92,150 @@ void VulkanRenderer::updateModel(int modelId, glm::mat4 newModel)
 		return;
 	}
 
-	modelList[modelId].setModel(newModel);
+	sceneGraph.setLocalTransform(modelList[modelId].getRootNode(), newModel);
+}
+
+void VulkanRenderer::updateModel(int modelId, glm::vec3 position, glm::quat rotation, glm::vec3 scale)
+{
+	if (modelId >= modelList.size())
+	{
+		return;
+	}
+
+	sceneGraph.setLocalTransform(modelList[modelId].getRootNode(), position, rotation, scale);
+}
+
+void VulkanRenderer::setTextureQuality(TextureQuality quality)
+{
+	// Applies to textures loaded from now on
+	textureMaxSize = getTextureQualityMaxSize(quality);
+}
+
+void VulkanRenderer::setTextureStreamingBudget(VkDeviceSize newBudget)
+{
+	// Takes effect on the next draw, which evicts down to the new budget if needed
+	textureStreamingBudget = newBudget;
+}
+
+void VulkanRenderer::setCompactVertices(bool enabled)
+{
+	// Must be chosen before init, as it sets the graphics pipeline's vertex layout
+	compactVertices = enabled;
+}
+
+void VulkanRenderer::setMeshOptimization(bool enabled)
+{
+	// Applies to models loaded from now on (a cache written with the other setting is reimported)
+	meshOptimization = enabled;
+}
+
+void VulkanRenderer::setMeshLods(bool enabled)
+{
+	// Applies to models loaded from now on (a cache written with the other setting is reimported)
+	meshLods = enabled;
+}
+
+void VulkanRenderer::setMeshletClustering(bool enabled)
+{
+	// Applies to models loaded from now on (a cache written with the other setting is reimported)
+	meshletClustering = enabled;
+}
+
+void VulkanRenderer::setOcclusionCulling(bool enabled)
+{
+	// Must be chosen before init, as it sets the render passes and the depth buffer's usage
+	occlusionCulling = enabled;
+}
+
+void VulkanRenderer::setSoftwareOcclusionCulling(bool enabled)
+{
+	// Takes effect from the next frame
+	softwareOcclusionCulling = enabled;
+}
+
+CullingStats VulkanRenderer::getCullingStats()
+{
+	return cullingStats;
+}
+
+bool VulkanRenderer::raycast(glm::vec3 origin, glm::vec3 direction, RaycastHit& hit)
+{
+	// Models may have moved (or been added) since the last frame drawn
+	updateInstanceBounds();
+
+	// Meshes the ray enters the world space box of are searched through their own trees in mesh space
+	// (an affine transform keeps distances along the ray, so hits in different meshes compare directly)
+	glm::vec3 inverseDirection = 1.0f / direction;
+	float nearestDistance = std::numeric_limits<float>::max();
+	bool found = false;
+	uint32_t instance = 0;
+
+	for (size_t i = 0; i < modelList.size(); i++)
+	{
+		for (size_t j = 0; j < modelList[i].getMeshCount(); j++, instance++)
+		{
+			float entryDistance;
+
+			if (!intersectRayBox(origin, inverseDirection, instanceBoundsMin[instance], instanceBoundsMax[instance], nearestDistance, entryDistance))
+			{
+				continue;
+			}
+
+			Mesh* mesh = modelList[i].getMesh(j);
+			glm::mat4 meshFromWorld = glm::inverse(sceneGraph.getWorldTransform(mesh->getNode()));
+			glm::vec3 meshOrigin = glm::vec3(meshFromWorld * glm::vec4(origin, 1.0f));
+			glm::vec3 meshDirection = glm::vec3(meshFromWorld * glm::vec4(direction, 0.0f));
+
+			TriangleHit triangleHit;
+
+			if (mesh->getTriangleBvh().raycast(meshOrigin, meshDirection, nearestDistance, triangleHit))
+			{
+				nearestDistance = triangleHit.distance;
+				hit.modelId = static_cast<int>(i);
+				hit.mesh = static_cast<uint32_t>(j);
+				hit.triangle = triangleHit.triangle;
+				found = true;
+			}
+		}
+	}
+
+	if (found)
+	{
+		hit.distance = nearestDistance;
+		hit.position = origin + direction * nearestDistance;
+	}
+
+	return found;
+}
+
+bool VulkanRenderer::pick(float screenX, float screenY, RaycastHit& hit)
+{
+	// Cursor positions are in screen coordinates, which high DPI displays scale down from the framebuffer's pixels
+	int windowWidth;
+	int windowHeight;
+	int framebufferWidth;
+	int framebufferHeight;
+	glfwGetWindowSize(window, &windowWidth, &windowHeight);
+	glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+
+	// Minimized window has nothing under the cursor
+	if (windowWidth == 0 || windowHeight == 0)
+	{
+		return false;
+	}
+
+	glm::vec2 pixelPosition = glm::vec2(screenX * framebufferWidth / windowWidth, screenY * framebufferHeight / windowHeight);
+
+	// Cast from the point on the near plane to the one on the far plane (the projection's flipped y already matches the image's rows)
+	glm::vec2 clipPosition = pixelPosition / glm::vec2(swapchainExtent.width, swapchainExtent.height) * 2.0f - 1.0f;
+	glm::mat4 inverseViewProjection = glm::inverse(viewProjection.projection * viewProjection.view);
+	glm::vec4 nearPosition = inverseViewProjection * glm::vec4(clipPosition, 0.0f, 1.0f);
+	glm::vec4 farPosition = inverseViewProjection * glm::vec4(clipPosition, 1.0f, 1.0f);
+
+	glm::vec3 origin = glm::vec3(nearPosition) / nearPosition.w;
+	glm::vec3 direction = glm::normalize(glm::vec3(farPosition) / farPosition.w - origin);
+
+	return raycast(origin, direction, hit);
 }
 
 void VulkanRenderer::draw()
@@ -88,6 +254,14 @@ void VulkanRenderer::draw()
 	uint32_t imageIndex;
 	vkAcquireNextImageKHR(mainDevice.logicalDevice, swapchain, std::numeric_limits<uint64_t>::max(), imageAvailable[currentFrame], VK_NULL_HANDLE, &imageIndex);
 
+	// Free texture images replaced by streaming, then stream mips for what this frame will draw
+	destroyRetiredTextures(false);
+	updateWorldTransforms(imageIndex);
+	updateFrustumCulling();
+	updateSoftwareOcclusionCulling();
+	updateTextureStreaming();
+	updateMeshLods();
+
 	recordCommands(imageIndex);
 	updateUniformBuffers(imageIndex);
 
@@ -102,9 +276,15 @@ void VulkanRenderer::draw()
 		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
 	};
 
+	// Texture streaming copies go first, so this frame's draws sample the mips they upload
+	VkCommandBuffer frameCommandBuffers[] = {
+		textureStreamingCommandBuffers[currentFrame],
+		commandBuffers[imageIndex]
+	};
+
 	submitInfo.pWaitDstStageMask = waitStages;															// Stages to check semaphores at
-	submitInfo.commandBufferCount = 1;																	// Number of command buffers to submit
-	submitInfo.pCommandBuffers = &commandBuffers[imageIndex];											// Command buffer to submit
+	submitInfo.commandBufferCount = 2;																	// Number of command buffers to submit
+	submitInfo.pCommandBuffers = frameCommandBuffers;													// Command buffers to submit
 	submitInfo.signalSemaphoreCount = 1;																// Number of semaphores to signal
 	submitInfo.pSignalSemaphores = &renderFinished[currentFrame];										// Semaphores to signal when command buffer finishes
 
@@ -135,6 +315,7 @@ void VulkanRenderer::draw()
 
 	// Get next frame
 	currentFrame = (currentFrame + 1) % MAX_FRAME_DRAWS;
+	frameNumber++;
 
 }
 
@@ -309,7 +490,111 @@ bool VulkanRenderer::checkDeviceSuitable(VkPhysicalDevice device)
 		swapchainValid = !SwapchainDetails.presentationModes.empty() && !SwapchainDetails.formats.empty();
 	}
 
-	return indices.isValid() && extensionsSupported && swapchainValid && deviceFeatures.samplerAnisotropy;
+	return indices.isValid() && extensionsSupported && swapchainValid && deviceFeatures.samplerAnisotropy && checkDescriptorIndexingSupport(device);
+}
+
+bool VulkanRenderer::checkDescriptorIndexingSupport(VkPhysicalDevice device)
+{
+	// Descriptor indexing is core from Vulkan 1.2 onwards
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+	if (deviceProperties.apiVersion < VK_API_VERSION_1_2)
+	{
+		return false;
+	}
+
+	// Query the descriptor indexing features needed by the bindless texture array
+	VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+	vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+	VkPhysicalDeviceFeatures2 deviceFeatures2 = {};
+	deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	deviceFeatures2.pNext = &vulkan12Features;
+
+	vkGetPhysicalDeviceFeatures2(device, &deviceFeatures2);
+
+	bool featuresSupported = vulkan12Features.runtimeDescriptorArray														// Unsized sampler2D[] in the fragment shader
+							&& vulkan12Features.descriptorBindingPartiallyBound												// Unused array elements may stay unwritten
+							&& vulkan12Features.descriptorBindingSampledImageUpdateAfterBind								// Textures can be added while the set is bound
+							&& vulkan12Features.descriptorBindingUpdateUnusedWhilePending;									// Streamed textures can be swapped while frames are in flight
+
+	// Query the limits on how many textures can live in one update-after-bind set
+	VkPhysicalDeviceVulkan12Properties vulkan12Properties = {};
+	vulkan12Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+	VkPhysicalDeviceProperties2 deviceProperties2 = {};
+	deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	deviceProperties2.pNext = &vulkan12Properties;
+
+	vkGetPhysicalDeviceProperties2(device, &deviceProperties2);
+
+	bool limitsSupported = vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSamplers >= MAX_TEXTURES
+						&& vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSampledImages >= MAX_TEXTURES
+						&& vulkan12Properties.maxDescriptorSetUpdateAfterBindSamplers >= MAX_TEXTURES
+						&& vulkan12Properties.maxDescriptorSetUpdateAfterBindSampledImages >= MAX_TEXTURES;
+
+	return featuresSupported && limitsSupported;
+}
+
+bool VulkanRenderer::checkIndexTypeUint8Support(VkPhysicalDevice device)
+{
+	// 8-bit indices are optional, so check for the extension rather than requiring it in deviceExtensions
+	uint32_t extensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> extensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
+
+	bool hasExtension = false;
+	for (const auto& extension : extensions)
+	{
+		if (strcmp(VK_EXT_INDEX_TYPE_UINT8_EXTENSION_NAME, extension.extensionName) == 0)
+		{
+			hasExtension = true;
+			break;
+		}
+	}
+
+	if (!hasExtension)
+	{
+		return false;
+	}
+
+	// The extension must also expose the feature itself
+	VkPhysicalDeviceIndexTypeUint8FeaturesEXT indexTypeUint8Features = {};
+	indexTypeUint8Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_INDEX_TYPE_UINT8_FEATURES_EXT;
+
+	VkPhysicalDeviceFeatures2 deviceFeatures2 = {};
+	deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	deviceFeatures2.pNext = &indexTypeUint8Features;
+
+	vkGetPhysicalDeviceFeatures2(device, &deviceFeatures2);
+
+	return indexTypeUint8Features.indexTypeUint8 == VK_TRUE;
+}
+
+bool VulkanRenderer::checkSynchronization2Support(VkPhysicalDevice device)
+{
+	// Synchronization2 is core from Vulkan 1.3 onwards, but still a feature to enable
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+	if (deviceProperties.apiVersion < VK_API_VERSION_1_3)
+	{
+		return false;
+	}
+
+	VkPhysicalDeviceVulkan13Features vulkan13Features = {};
+	vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+
+	VkPhysicalDeviceFeatures2 deviceFeatures2 = {};
+	deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	deviceFeatures2.pNext = &vulkan13Features;
+
+	vkGetPhysicalDeviceFeatures2(device, &deviceFeatures2);
+
+	return vulkan13Features.synchronization2 == VK_TRUE;
 }
 
 void VulkanRenderer::createSurface()
@@ -408,7 +693,7 @@ void VulkanRenderer::createSwapchain()
 		swapchainImage.image = image;
 
 		// Create image view and add to swapchain image list
-		swapchainImage.imageView = createImageView(image, swapchainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+		swapchainImage.imageView = createImageView(image, swapchainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
 		swapchainImages.push_back(swapchainImage);
 	}
 }
@@ -498,7 +783,8 @@ void VulkanRenderer::createRenderPass()
 	// Subpass Dependencies
 
 	// Need to determine when layout transitions occur using subpass dependencies
-	std::array<VkSubpassDependency, 3> subpassDependencies;
+	std::array<VkSubpassDependency, 4> subpassDependencies;
+	uint32_t dependencyCount = 3;
 
 	// Conversion from VK_IMAGE_LAYOUT_UNDEFINED to VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
 	// Transition must happen after...
@@ -534,6 +820,36 @@ void VulkanRenderer::createRenderPass()
 	subpassDependencies[2].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
 	subpassDependencies[2].dependencyFlags = 0;
 
+	// Occlusion culling draws the scene in two render passes, the early one's color and depth carried on by this one. Both have the same
+	// subpasses and dependencies, so the pipelines and framebuffers made for this pass suit the early one too
+	if (occlusionCulling)
+	{
+		// The depth pyramid samples the depth buffer before this pass writes it again
+		subpassDependencies[0].srcStageMask |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		subpassDependencies[0].dstStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		subpassDependencies[0].dstAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+		// Depth written by subpass 1 is kept, so order its writes too
+		subpassDependencies[1].srcStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		subpassDependencies[1].srcAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+		// Color and depth left by the early pass, made visible to the depth pyramid and the pass carrying them on
+		subpassDependencies[3].srcSubpass = 1;
+		subpassDependencies[3].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		subpassDependencies[3].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		subpassDependencies[3].dstSubpass = VK_SUBPASS_EXTERNAL;
+		subpassDependencies[3].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		subpassDependencies[3].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		subpassDependencies[3].dependencyFlags = 0;
+		dependencyCount = 4;
+
+		// Carry on from the early pass's color and depth rather than clearing them
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	}
+
 	std::array<VkAttachmentDescription, 3> renderPassAttachments = { swapchainColorAttachment, colorAttachment, depthAttachment };
 
 	// Create info for render pass
@@ -543,7 +859,7 @@ void VulkanRenderer::createRenderPass()
 	renderPassCreateInfo.pAttachments = renderPassAttachments.data();
 	renderPassCreateInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
 	renderPassCreateInfo.pSubpasses = subpasses.data();
-	renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(subpassDependencies.size());
+	renderPassCreateInfo.dependencyCount = dependencyCount;
 	renderPassCreateInfo.pDependencies = subpassDependencies.data();
 
 	VkResult result = vkCreateRenderPass(mainDevice.logicalDevice, &renderPassCreateInfo, nullptr, &renderPass);
@@ -553,6 +869,33 @@ void VulkanRenderer::createRenderPass()
 		throw std::runtime_error("Failed to create a Render Pass!");
 	}
 
+	if (!occlusionCulling)
+	{
+		return;
+	}
+
+	// Early pass clears and keeps color and depth (depth left ready to sample for the pyramid), and leaves the swapchain image alone
+	renderPassAttachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	renderPassAttachments[0].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	renderPassAttachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	renderPassAttachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	renderPassAttachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	renderPassAttachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	renderPassAttachments[1].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	renderPassAttachments[2].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	renderPassAttachments[2].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	renderPassAttachments[2].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	renderPassAttachments[2].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	result = vkCreateRenderPass(mainDevice.logicalDevice, &renderPassCreateInfo, nullptr, &earlyRenderPass);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create the early Render Pass!");
+	}
+
 }
 
 void VulkanRenderer::createDescriptorSetLayout()
@@ -565,7 +908,15 @@ void VulkanRenderer::createDescriptorSetLayout()
 	viewProjectionLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;								// Shader stage to bind to
 	viewProjectionLayoutBinding.pImmutableSamplers = nullptr;											// Can make sampler immutable (for textures)
 
-	std::vector<VkDescriptorSetLayoutBinding> layoutBindings = { viewProjectionLayoutBinding };
+	// World transforms descriptor set layout binding
+	VkDescriptorSetLayoutBinding worldTransformLayoutBinding = {};
+	worldTransformLayoutBinding.binding = 1;
+	worldTransformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	worldTransformLayoutBinding.descriptorCount = 1;
+	worldTransformLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	worldTransformLayoutBinding.pImmutableSamplers = nullptr;
+
+	std::vector<VkDescriptorSetLayoutBinding> layoutBindings = { viewProjectionLayoutBinding, worldTransformLayoutBinding };
 
 	// View projection descriptor set layout create info
 	VkDescriptorSetLayoutCreateInfo viewProjectionLayoutCreateInfo = {};
@@ -581,17 +932,28 @@ void VulkanRenderer::createDescriptorSetLayout()
 		throw std::runtime_error("Failed to create View Projection Descriptor Set Layout!");
 	}
 
-	// Texture sampler descriptor set layout binding
+	// Texture sampler descriptor set layout binding (one large array indexed per draw)
 	VkDescriptorSetLayoutBinding textureSamplerLayoutBinding = {};
 	textureSamplerLayoutBinding.binding = 0;
 	textureSamplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	textureSamplerLayoutBinding.descriptorCount = 1;
+	textureSamplerLayoutBinding.descriptorCount = MAX_TEXTURES;
 	textureSamplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 	textureSamplerLayoutBinding.pImmutableSamplers = nullptr;
 
+	// Array elements may be left unwritten, and new textures may be written while the set is bound by in-flight frames
+	// (streaming writes elements those frames do not read, then frees the old ones once they have finished)
+	VkDescriptorBindingFlags textureSamplerBindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo textureSamplerBindingFlagsCreateInfo = {};
+	textureSamplerBindingFlagsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	textureSamplerBindingFlagsCreateInfo.bindingCount = 1;
+	textureSamplerBindingFlagsCreateInfo.pBindingFlags = &textureSamplerBindingFlags;
+
 	// Texture sampler descriptor set layout create info
 	VkDescriptorSetLayoutCreateInfo textureSamplerLayoutCreateInfo = {};
 	textureSamplerLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	textureSamplerLayoutCreateInfo.pNext = &textureSamplerBindingFlagsCreateInfo;
+	textureSamplerLayoutCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
 	textureSamplerLayoutCreateInfo.bindingCount = 1;
 	textureSamplerLayoutCreateInfo.pBindings = &textureSamplerLayoutBinding;
 
@@ -639,9 +1001,9 @@ void VulkanRenderer::createDescriptorSetLayout()
 void VulkanRenderer::createPushConstantRange()
 {
 	// Define push constant values
-	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;											// Shader stage push constant will go to
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;			// Shader stages push constant will go to
 	pushConstantRange.offset = 0;																		// Offset into given data to pass to push constant
-	pushConstantRange.size = sizeof(ModelTransformationMatrix);											// Size of data being passed
+	pushConstantRange.size = sizeof(PushModel);															// Size of data being passed
 }
 
 void VulkanRenderer::createGraphicsPipeline()
@@ -675,31 +1037,26 @@ void VulkanRenderer::createGraphicsPipeline()
 	// How the data for a single vertex (position, color, texture coordinates, normals) is as a whole
 	VkVertexInputBindingDescription bindingDescription = {};
 	bindingDescription.binding = 0;																		// Can bind multiple streams of data
-	bindingDescription.stride = sizeof(Vertex);															// Size of a single vertex object
+	bindingDescription.stride = compactVertices ? sizeof(CompactVertex) : sizeof(Vertex);				// Size of a single vertex object
 	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;											// How to move between data after each vertex
 																										// VK_VERTEX_INPUT_RATE_VERTEX: Move on to the next vertex
 																										// VK_VERTEX_INPUT_RATE_INSTANCE: Move to a vertex for the next instance
 
 	// How the data for an attribute is defined within a vertex
-	std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions;
+	// Compact vertices are 16-bit UNORM, which the GPU expands to [0, 1] floats for the shader to rescale
+	std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions;
 
 	// Position Attribute
 	attributeDescriptions[0].binding = 0;																// Which binding the data is at (should be same as above)
 	attributeDescriptions[0].location = 0;																// Which location the data is at (should be same as above)
-	attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;										// Format the data will take (also helps define size of data)
-	attributeDescriptions[0].offset = offsetof(Vertex, position);										// Where the attribute is defined in the data for a single vertex
-
-	// Color Attribute
-	attributeDescriptions[1].binding = 0;																
-	attributeDescriptions[1].location = 1;																
-	attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;										
-	attributeDescriptions[1].offset = offsetof(Vertex, color);			
+	attributeDescriptions[0].format = compactVertices ? VK_FORMAT_R16G16B16A16_UNORM : VK_FORMAT_R32G32B32_SFLOAT;	// Format the data will take (also helps define size of data)
+	attributeDescriptions[0].offset = compactVertices ? offsetof(CompactVertex, position) : offsetof(Vertex, position);	// Where the attribute is defined in the data for a single vertex
 
 	// Texture Attribute
-	attributeDescriptions[2].binding = 0;
-	attributeDescriptions[2].location = 2;
-	attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-	attributeDescriptions[2].offset = offsetof(Vertex, texture);
+	attributeDescriptions[1].binding = 0;
+	attributeDescriptions[1].location = 1;
+	attributeDescriptions[1].format = compactVertices ? VK_FORMAT_R16G16_UNORM : VK_FORMAT_R32G32_SFLOAT;
+	attributeDescriptions[1].offset = compactVertices ? offsetof(CompactVertex, texture) : offsetof(Vertex, texture);
 
 	// -- Pipeline Creation Information --
 	// Vertex Input
@@ -834,7 +1191,7 @@ void VulkanRenderer::createGraphicsPipeline()
 	graphicsPipelineCreateInfo.basePipelineIndex = -1;													// Index of pipeline being created to derive from (if creating multiple pipelines at once)
 
 	// Create Graphics Pipeline
-	result = vkCreateGraphicsPipelines(mainDevice.logicalDevice, VK_NULL_HANDLE, 1, &graphicsPipelineCreateInfo, nullptr, &graphicsPipeline);
+	result = vkCreateGraphicsPipelines(mainDevice.logicalDevice, pipelineCache, 1, &graphicsPipelineCreateInfo, nullptr, &graphicsPipeline);
 
 	if (result != VK_SUCCESS)
 	{
@@ -893,7 +1250,7 @@ void VulkanRenderer::createGraphicsPipeline()
 	graphicsPipelineCreateInfo.subpass = 1;																// Use second subpass
 
 
-	result = vkCreateGraphicsPipelines(mainDevice.logicalDevice, VK_NULL_HANDLE, 1, &graphicsPipelineCreateInfo, nullptr, &secondPipeline);
+	result = vkCreateGraphicsPipelines(mainDevice.logicalDevice, pipelineCache, 1, &graphicsPipelineCreateInfo, nullptr, &secondPipeline);
 
 	if (result != VK_SUCCESS)
 	{
@@ -924,10 +1281,10 @@ void VulkanRenderer::createColorBufferImage()
 	for (size_t i = 0; i < swapchainImages.size(); i++)
 	{
 		// Create color buffer image
-		colorBufferImage[i] = createImage(swapchainExtent.width, swapchainExtent.height, colorBufferFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &colorBufferImageMemory[i]);
+		colorBufferImage[i] = createImage(swapchainExtent.width, swapchainExtent.height, 1, colorBufferFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &colorBufferImageMemory[i]);
 
 		// Create color buffer image view
-		colorBufferImageView[i] = createImageView(colorBufferImage[i], colorBufferFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+		colorBufferImageView[i] = createImageView(colorBufferImage[i], colorBufferFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
 	}
 }
 
@@ -941,16 +1298,26 @@ void VulkanRenderer::createDepthBufferImage()
 	// Specify desired formats in order of highest to lowest preference
 	std::vector<VkFormat> formats = { VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D32_SFLOAT, VK_FORMAT_D24_UNORM_S8_UINT };
 
+	// Occlusion culling also samples the depth buffer, to build the depth pyramid from it
+	VkFormatFeatureFlags depthFeatures = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	VkImageUsageFlags depthUsage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+
+	if (occlusionCulling)
+	{
+		depthFeatures |= VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+		depthUsage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+	}
+
 	// Get supported format for depth attachment
-	depthBufferFormat = chooseSupportedFormat(formats, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+	depthBufferFormat = chooseSupportedFormat(formats, VK_IMAGE_TILING_OPTIMAL, depthFeatures);
 
 	for (size_t i = 0; i < swapchainImages.size(); i++)
 	{
 		// Create depth buffer image
-		depthBufferImage[i] = createImage(swapchainExtent.width, swapchainExtent.height, depthBufferFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &depthBufferImageMemory[i]);
+		depthBufferImage[i] = createImage(swapchainExtent.width, swapchainExtent.height, 1, depthBufferFormat, VK_IMAGE_TILING_OPTIMAL, depthUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &depthBufferImageMemory[i]);
 
 		// Create depth buffer image view
-		depthBufferImageView[i] = createImageView(depthBufferImage[i], depthBufferFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+		depthBufferImageView[i] = createImageView(depthBufferImage[i], depthBufferFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
 	}
 }
 
@@ -1027,6 +1394,32 @@ void VulkanRenderer::createCommandBuffers()
 
 }
 
+void VulkanRenderer::createTextureStreaming()
+{
+	// One command buffer per frame in flight records that frame's texture residency changes
+	textureStreamingCommandBuffers.resize(MAX_FRAME_DRAWS);
+
+	VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+	commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	commandBufferAllocateInfo.commandPool = graphicsCommandPool;
+	commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	commandBufferAllocateInfo.commandBufferCount = MAX_FRAME_DRAWS;
+
+	VkResult result = vkAllocateCommandBuffers(mainDevice.logicalDevice, &commandBufferAllocateInfo, textureStreamingCommandBuffers.data());
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate Command Buffers!");
+	}
+
+	// Staging ring the frames in flight share, kept mapped so streamed mips are copied straight in
+	createBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, TEXTURE_STREAMING_STAGING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &textureStagingBuffer, &textureStagingBufferMemory);
+
+	void* data;
+	vkMapMemory(mainDevice.logicalDevice, textureStagingBufferMemory, 0, TEXTURE_STREAMING_STAGING_SIZE, 0, &data);
+	textureStagingData = static_cast<uint8_t*>(data);
+}
+
 void VulkanRenderer::createTextureSampler()
 {
 	// Sampler Creation Info
@@ -1042,7 +1435,7 @@ void VulkanRenderer::createTextureSampler()
 	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;										// Mipmap interpolation mode
 	samplerCreateInfo.mipLodBias = 0.0f;																// Level of detail bias for mip level
 	samplerCreateInfo.minLod = 0.0f;																	// Minimum level of detail to pick mip level
-	samplerCreateInfo.maxLod = 0.0f;																	// Maximum level of detail to pick mip level
+	samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;														// Maximum level of detail to pick mip level (streamed images only hold resident levels)
 	samplerCreateInfo.anisotropyEnable = VK_TRUE;														// Enable Anisotropy
 	samplerCreateInfo.maxAnisotropy = 16;																// Anisotropic filtering sample level
 	
@@ -1096,88 +1489,544 @@ void VulkanRenderer::createUniformBuffers()
 	{
 		createBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, viewProjectionBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &viewProjectionUniformBuffer[i], &viewProjectionUniformBufferMemory[i]);
 	}
+
+	// World transform buffers, one per image, kept mapped so each frame only copies the matrices that changed
+	VkDeviceSize worldTransformBufferSize = MAX_SCENE_NODES * sizeof(glm::mat4);
+
+	worldTransformBuffer.resize(swapchainImages.size());
+	worldTransformBufferMemory.resize(swapchainImages.size());
+	worldTransformData.resize(swapchainImages.size());
+	worldTransformPendingRanges.assign(swapchainImages.size(), glm::uvec2(0));
+
+	for (size_t i = 0; i < swapchainImages.size(); i++)
+	{
+		createBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, worldTransformBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &worldTransformBuffer[i], &worldTransformBufferMemory[i]);
+
+		void* data;
+		vkMapMemory(mainDevice.logicalDevice, worldTransformBufferMemory[i], 0, worldTransformBufferSize, 0, &data);
+		worldTransformData[i] = static_cast<glm::mat4*>(data);
+	}
 }
 
-void VulkanRenderer::createDescriptorPool()
+void VulkanRenderer::createIndirectDrawBuffers()
 {
-	// View Projection Pool
-	VkDescriptorPoolSize viewProjectionPoolSize = {};
-	viewProjectionPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	viewProjectionPoolSize.descriptorCount = static_cast<uint32_t>(viewProjectionUniformBuffer.size());
+	// Give each mesh instance a visibility slot per meshlet (one if it wasn't clustered), in the order recordCommands walks them
+	instanceVisibilitySlots.clear();
+	size_t slotCount = 0;
 
+	for (auto& model : modelList)
+	{
+		for (size_t i = 0; i < model.getMeshCount(); i++)
+		{
+			instanceVisibilitySlots.push_back(static_cast<uint32_t>(slotCount));
+			slotCount += std::max<size_t>(model.getMesh(i)->getMeshletCount(), 1);
+		}
+	}
 
-	std::vector<VkDescriptorPoolSize> descriptorPoolSizes = { viewProjectionPoolSize };
+	// Room for a command per slot, more than any frame can draw (twice over with occlusion culling, a copy for each pass)
+	size_t commandCount = occlusionCulling ? slotCount * 2 : slotCount;
 
-	// Descriptor pool create info
-	VkDescriptorPoolCreateInfo poolCreateInfo = {};
-	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	poolCreateInfo.maxSets = static_cast<uint32_t>(swapchainImages.size());								// Maximum number of descriptor sets
-	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(descriptorPoolSizes.size());					// Amount of pool sizes being passed
-	poolCreateInfo.pPoolSizes = descriptorPoolSizes.data();												// Pool Sizes to create pool with
+	if (commandCount <= indirectDrawCapacity)
+	{
+		return;
+	}
 
-	// Create descriptor pool
-	VkResult result = vkCreateDescriptorPool(mainDevice.logicalDevice, &poolCreateInfo, nullptr, &viewProjectionDescriptorPool);
+	// Buffers may still be read by frames in flight, so wait before replacing them
+	vkDeviceWaitIdle(mainDevice.logicalDevice);
 
-	if (result != VK_SUCCESS)
-	{	
-		throw std::runtime_error("Failed to create Descriptor Pool!");
+	for (size_t i = 0; i < indirectDrawBuffer.size(); i++)
+	{
+		vkUnmapMemory(mainDevice.logicalDevice, indirectDrawBufferMemory[i]);
+		vkDestroyBuffer(mainDevice.logicalDevice, indirectDrawBuffer[i], nullptr);
+		vkFreeMemory(mainDevice.logicalDevice, indirectDrawBufferMemory[i], nullptr);
 	}
 
+	for (size_t i = 0; i < occlusionDrawBuffer.size(); i++)
+	{
+		vkUnmapMemory(mainDevice.logicalDevice, occlusionDrawBufferMemory[i]);
+		vkDestroyBuffer(mainDevice.logicalDevice, occlusionDrawBuffer[i], nullptr);
+		vkFreeMemory(mainDevice.logicalDevice, occlusionDrawBufferMemory[i], nullptr);
+	}
 
-	// Texture Sampler Pool
-	VkDescriptorPoolSize textureSamplerPoolSize = {};
-	textureSamplerPoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	textureSamplerPoolSize.descriptorCount = MAX_OBJECTS;
-
-	// Texture sampler pool create info
-	VkDescriptorPoolCreateInfo textureSamplerPoolCreateInfo = {};
-	textureSamplerPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	textureSamplerPoolCreateInfo.maxSets = MAX_OBJECTS;
-	textureSamplerPoolCreateInfo.poolSizeCount = 1;
-	textureSamplerPoolCreateInfo.pPoolSizes = &textureSamplerPoolSize;
+	if (visibilityBuffer != VK_NULL_HANDLE)
+	{
+		vkDestroyBuffer(mainDevice.logicalDevice, visibilityBuffer, nullptr);
+		vkFreeMemory(mainDevice.logicalDevice, visibilityBufferMemory, nullptr);
+	}
 
-	result = vkCreateDescriptorPool(mainDevice.logicalDevice, &textureSamplerPoolCreateInfo, nullptr, &textureSamplerDescriptorPool);
+	// One indirect buffer for each image and command buffer, written by the CPU as it records (and by the cull pass with occlusion culling)
+	VkDeviceSize indirectDrawBufferSize = commandCount * sizeof(VkDrawIndexedIndirectCommand);
+	VkBufferUsageFlags indirectDrawBufferUsage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
 
-	if (result != VK_SUCCESS)
+	if (occlusionCulling)
 	{
-		throw std::runtime_error("Failed to create Texture Sampler Descriptor Pool!");
+		indirectDrawBufferUsage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
 	}
 
-	// Color Attachment Pool
-	VkDescriptorPoolSize colorInputPoolSize = {};
-	colorInputPoolSize.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
-	colorInputPoolSize.descriptorCount = static_cast<uint32_t>(colorBufferImageView.size());
+	indirectDrawBuffer.resize(swapchainImages.size());
+	indirectDrawBufferMemory.resize(swapchainImages.size());
+	indirectDrawCommands.resize(swapchainImages.size());
 
-	// Depth Attachment Pool
-	VkDescriptorPoolSize depthInputPoolSize = {};
-	depthInputPoolSize.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
-	depthInputPoolSize.descriptorCount = static_cast<uint32_t>(depthBufferImageView.size());
+	for (size_t i = 0; i < swapchainImages.size(); i++)
+	{
+		createBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, indirectDrawBufferSize, indirectDrawBufferUsage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &indirectDrawBuffer[i], &indirectDrawBufferMemory[i]);
 
-	std::array<VkDescriptorPoolSize, 2> inputAttachmentPoolSizes = { colorInputPoolSize, depthInputPoolSize };
+		void* data;
+		vkMapMemory(mainDevice.logicalDevice, indirectDrawBufferMemory[i], 0, indirectDrawBufferSize, 0, &data);
+		indirectDrawCommands[i] = static_cast<VkDrawIndexedIndirectCommand*>(data);
+	}
 
-	// Input attachment pool create info
-	VkDescriptorPoolCreateInfo inputAttachmentPoolCreateInfo = {};
-	inputAttachmentPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	inputAttachmentPoolCreateInfo.maxSets = swapchainImages.size();
-	inputAttachmentPoolCreateInfo.poolSizeCount = static_cast<uint32_t>(inputAttachmentPoolSizes.size());
-	inputAttachmentPoolCreateInfo.pPoolSizes = inputAttachmentPoolSizes.data();
+	indirectDrawCapacity = commandCount;
+	visibilitySlotCount = slotCount;
 
-	result = vkCreateDescriptorPool(mainDevice.logicalDevice, &inputAttachmentPoolCreateInfo, nullptr, &inputAttachmentDescriptorPool);
+	if (!occlusionCulling)
+	{
+		return;
+	}
 
-	if (result != VK_SUCCESS)
+	// Bounds of each command, one buffer per image like the commands themselves
+	VkDeviceSize occlusionDrawBufferSize = slotCount * sizeof(OcclusionCullDraw);
+
+	occlusionDrawBuffer.resize(swapchainImages.size());
+	occlusionDrawBufferMemory.resize(swapchainImages.size());
+	occlusionDraws.resize(swapchainImages.size());
+
+	for (size_t i = 0; i < swapchainImages.size(); i++)
 	{
-		throw std::runtime_error("Failed to create Input Attachment Descriptor Pool!");
+		createBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, occlusionDrawBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &occlusionDrawBuffer[i], &occlusionDrawBufferMemory[i]);
+
+		void* data;
+		vkMapMemory(mainDevice.logicalDevice, occlusionDrawBufferMemory[i], 0, occlusionDrawBufferSize, 0, &data);
+		occlusionDraws[i] = static_cast<OcclusionCullDraw*>(data);
 	}
+
+	// Visibility carries from one frame to the next whichever image draws it, so there's one buffer, starting with everything visible
+	VkDeviceSize visibilityBufferSize = slotCount * sizeof(uint32_t);
+
+	createBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, visibilityBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &visibilityBuffer, &visibilityBufferMemory);
+
+	void* data;
+	vkMapMemory(mainDevice.logicalDevice, visibilityBufferMemory, 0, visibilityBufferSize, 0, &data);
+	std::fill_n(static_cast<uint32_t*>(data), slotCount, 1u);
+	vkUnmapMemory(mainDevice.logicalDevice, visibilityBufferMemory);
+
+	updateOcclusionCullDescriptorSets();
 }
 
-void VulkanRenderer::createDescriptorSets()
+void VulkanRenderer::createDepthPyramid()
 {
-	// Resize descriptor set list --- 1 for every buffer
-	viewProjectionDescriptorSets.resize(swapchainImages.size());
+	// Largest power of two at or below the swapchain extent in each direction, so every level halves the last exactly
+	depthPyramidExtent = { 1, 1 };
 
-	std::vector<VkDescriptorSetLayout> setLayouts(swapchainImages.size(), viewProjectionDescriptorSetLayout);
+	while (depthPyramidExtent.width * 2 <= swapchainExtent.width)
+	{
+		depthPyramidExtent.width *= 2;
+	}
 
-	// Descriptor set allocation info
+	while (depthPyramidExtent.height * 2 <= swapchainExtent.height)
+	{
+		depthPyramidExtent.height *= 2;
+	}
+
+	// Levels down to a single texel
+	depthPyramidLevelCount = 0;
+
+	while ((std::max(depthPyramidExtent.width, depthPyramidExtent.height) >> depthPyramidLevelCount) > 0)
+	{
+		depthPyramidLevelCount++;
+	}
+
+	// Written a level at a time by the reduction, then sampled by the cull pass
+	depthPyramidImage = createImage(depthPyramidExtent.width, depthPyramidExtent.height, depthPyramidLevelCount, VK_FORMAT_R32_SFLOAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &depthPyramidImageMemory);
+	depthPyramidImageView = createImageView(depthPyramidImage, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, depthPyramidLevelCount);
+
+	depthPyramidLevelViews.resize(depthPyramidLevelCount);
+
+	for (uint32_t i = 0; i < depthPyramidLevelCount; i++)
+	{
+		depthPyramidLevelViews[i] = createImageView(depthPyramidImage, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 1, {}, i);
+	}
+
+	// Texels are only fetched, never filtered
+	VkSamplerCreateInfo samplerCreateInfo = {};
+	samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+	samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+	samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerCreateInfo.minLod = 0.0f;
+	samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+	VkResult result = vkCreateSampler(mainDevice.logicalDevice, &samplerCreateInfo, nullptr, &depthPyramidSampler);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create Depth Pyramid Sampler!");
+	}
+
+	// A reduction set per level for each image, as level 0 reads that image's depth buffer
+	depthPyramidDescriptorSets.resize(swapchainImages.size() * depthPyramidLevelCount);
+
+	std::vector<VkDescriptorSetLayout> setLayouts(depthPyramidDescriptorSets.size(), depthPyramidDescriptorSetLayout);
+
+	VkDescriptorSetAllocateInfo depthPyramidSetAllocateInfo = {};
+	depthPyramidSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	depthPyramidSetAllocateInfo.descriptorPool = occlusionCullingDescriptorPool;
+	depthPyramidSetAllocateInfo.descriptorSetCount = static_cast<uint32_t>(setLayouts.size());
+	depthPyramidSetAllocateInfo.pSetLayouts = setLayouts.data();
+
+	result = vkAllocateDescriptorSets(mainDevice.logicalDevice, &depthPyramidSetAllocateInfo, depthPyramidDescriptorSets.data());
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate Depth Pyramid Descriptor Sets!");
+	}
+
+	for (size_t i = 0; i < swapchainImages.size(); i++)
+	{
+		for (uint32_t j = 0; j < depthPyramidLevelCount; j++)
+		{
+			VkDescriptorSet descriptorSet = depthPyramidDescriptorSets[i * depthPyramidLevelCount + j];
+
+			// Level above (or the depth buffer, as the early pass left it)
+			VkDescriptorImageInfo inputInfo = {};
+			inputInfo.sampler = depthPyramidSampler;
+			inputInfo.imageView = j == 0 ? depthBufferImageView[i] : depthPyramidLevelViews[j - 1];
+			inputInfo.imageLayout = j == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+			VkWriteDescriptorSet inputWrite = {};
+			inputWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			inputWrite.dstSet = descriptorSet;
+			inputWrite.dstBinding = 0;
+			inputWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			inputWrite.descriptorCount = 1;
+			inputWrite.pImageInfo = &inputInfo;
+
+			// Level being written
+			VkDescriptorImageInfo outputInfo = {};
+			outputInfo.imageView = depthPyramidLevelViews[j];
+			outputInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+			VkWriteDescriptorSet outputWrite = {};
+			outputWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			outputWrite.dstSet = descriptorSet;
+			outputWrite.dstBinding = 1;
+			outputWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			outputWrite.descriptorCount = 1;
+			outputWrite.pImageInfo = &outputInfo;
+
+			std::array<VkWriteDescriptorSet, 2> writeDescriptorSets = { inputWrite, outputWrite };
+			vkUpdateDescriptorSets(mainDevice.logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
+	}
+
+	// Cull pass sets, one per image, reading the whole pyramid (their buffers are written as the buffers are created)
+	occlusionCullDescriptorSets.resize(swapchainImages.size());
+	setLayouts.assign(swapchainImages.size(), occlusionCullDescriptorSetLayout);
+
+	VkDescriptorSetAllocateInfo occlusionCullSetAllocateInfo = {};
+	occlusionCullSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	occlusionCullSetAllocateInfo.descriptorPool = occlusionCullingDescriptorPool;
+	occlusionCullSetAllocateInfo.descriptorSetCount = static_cast<uint32_t>(setLayouts.size());
+	occlusionCullSetAllocateInfo.pSetLayouts = setLayouts.data();
+
+	result = vkAllocateDescriptorSets(mainDevice.logicalDevice, &occlusionCullSetAllocateInfo, occlusionCullDescriptorSets.data());
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate Occlusion Cull Descriptor Sets!");
+	}
+
+	for (size_t i = 0; i < swapchainImages.size(); i++)
+	{
+		VkDescriptorImageInfo depthPyramidInfo = {};
+		depthPyramidInfo.sampler = depthPyramidSampler;
+		depthPyramidInfo.imageView = depthPyramidImageView;
+		depthPyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		VkWriteDescriptorSet depthPyramidWrite = {};
+		depthPyramidWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		depthPyramidWrite.dstSet = occlusionCullDescriptorSets[i];
+		depthPyramidWrite.dstBinding = 4;
+		depthPyramidWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		depthPyramidWrite.descriptorCount = 1;
+		depthPyramidWrite.pImageInfo = &depthPyramidInfo;
+
+		vkUpdateDescriptorSets(mainDevice.logicalDevice, 1, &depthPyramidWrite, 0, nullptr);
+	}
+}
+
+void VulkanRenderer::createOcclusionCullPipelines()
+{
+	// Depth Pyramid Layout (the level above, and the level being written)
+	std::array<VkDescriptorSetLayoutBinding, 2> depthPyramidBindings = {};
+	depthPyramidBindings[0].binding = 0;
+	depthPyramidBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	depthPyramidBindings[0].descriptorCount = 1;
+	depthPyramidBindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	depthPyramidBindings[1].binding = 1;
+	depthPyramidBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	depthPyramidBindings[1].descriptorCount = 1;
+	depthPyramidBindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo depthPyramidLayoutCreateInfo = {};
+	depthPyramidLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	depthPyramidLayoutCreateInfo.bindingCount = static_cast<uint32_t>(depthPyramidBindings.size());
+	depthPyramidLayoutCreateInfo.pBindings = depthPyramidBindings.data();
+
+	VkResult result = vkCreateDescriptorSetLayout(mainDevice.logicalDevice, &depthPyramidLayoutCreateInfo, nullptr, &depthPyramidDescriptorSetLayout);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create Depth Pyramid Descriptor Set Layout!");
+	}
+
+	// Occlusion Cull Layout (commands, their bounds, visibility, world transforms and the pyramid, matching occlusionCull.comp)
+	std::array<VkDescriptorSetLayoutBinding, 5> occlusionCullBindings = {};
+
+	for (uint32_t i = 0; i < occlusionCullBindings.size(); i++)
+	{
+		occlusionCullBindings[i].binding = i;
+		occlusionCullBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		occlusionCullBindings[i].descriptorCount = 1;
+		occlusionCullBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	occlusionCullBindings[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+	VkDescriptorSetLayoutCreateInfo occlusionCullLayoutCreateInfo = {};
+	occlusionCullLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	occlusionCullLayoutCreateInfo.bindingCount = static_cast<uint32_t>(occlusionCullBindings.size());
+	occlusionCullLayoutCreateInfo.pBindings = occlusionCullBindings.data();
+
+	result = vkCreateDescriptorSetLayout(mainDevice.logicalDevice, &occlusionCullLayoutCreateInfo, nullptr, &occlusionCullDescriptorSetLayout);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create Occlusion Cull Descriptor Set Layout!");
+	}
+
+	// Pool for both passes' sets: a reduction set per pyramid level and a cull set, for each image. The pyramid's level count isn't
+	// known until it is created, so size for the most levels any image extent could need
+	uint32_t maxLevelCount = 32;
+	uint32_t imageCount = static_cast<uint32_t>(swapchainImages.size());
+
+	std::array<VkDescriptorPoolSize, 3> poolSizes = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[0].descriptorCount = imageCount * (maxLevelCount + 1);
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[1].descriptorCount = imageCount * maxLevelCount;
+	poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[2].descriptorCount = imageCount * 4;
+
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.maxSets = imageCount * (maxLevelCount + 1);
+	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolCreateInfo.pPoolSizes = poolSizes.data();
+
+	result = vkCreateDescriptorPool(mainDevice.logicalDevice, &poolCreateInfo, nullptr, &occlusionCullingDescriptorPool);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create Occlusion Culling Descriptor Pool!");
+	}
+
+	// Pipeline layouts, the sizes and the cull parameters given as push constants
+	VkPushConstantRange depthPyramidPushRange = {};
+	depthPyramidPushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	depthPyramidPushRange.offset = 0;
+	depthPyramidPushRange.size = sizeof(DepthPyramidConstants);
+
+	VkPipelineLayoutCreateInfo depthPyramidPipelineLayoutCreateInfo = {};
+	depthPyramidPipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	depthPyramidPipelineLayoutCreateInfo.setLayoutCount = 1;
+	depthPyramidPipelineLayoutCreateInfo.pSetLayouts = &depthPyramidDescriptorSetLayout;
+	depthPyramidPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	depthPyramidPipelineLayoutCreateInfo.pPushConstantRanges = &depthPyramidPushRange;
+
+	result = vkCreatePipelineLayout(mainDevice.logicalDevice, &depthPyramidPipelineLayoutCreateInfo, nullptr, &depthPyramidPipelineLayout);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create Depth Pyramid Pipeline Layout!");
+	}
+
+	VkPushConstantRange occlusionCullPushRange = {};
+	occlusionCullPushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	occlusionCullPushRange.offset = 0;
+	occlusionCullPushRange.size = sizeof(OcclusionCullConstants);
+
+	VkPipelineLayoutCreateInfo occlusionCullPipelineLayoutCreateInfo = {};
+	occlusionCullPipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	occlusionCullPipelineLayoutCreateInfo.setLayoutCount = 1;
+	occlusionCullPipelineLayoutCreateInfo.pSetLayouts = &occlusionCullDescriptorSetLayout;
+	occlusionCullPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	occlusionCullPipelineLayoutCreateInfo.pPushConstantRanges = &occlusionCullPushRange;
+
+	result = vkCreatePipelineLayout(mainDevice.logicalDevice, &occlusionCullPipelineLayoutCreateInfo, nullptr, &occlusionCullPipelineLayout);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create Occlusion Cull Pipeline Layout!");
+	}
+
+	// Compute pipelines
+	auto depthPyramidShaderCode = readFile("Shaders/depthPyramid.spv");
+	auto occlusionCullShaderCode = readFile("Shaders/occlusionCull.spv");
+
+	VkShaderModule depthPyramidShaderModule = createShaderModule(depthPyramidShaderCode);
+	VkShaderModule occlusionCullShaderModule = createShaderModule(occlusionCullShaderCode);
+
+	std::array<VkComputePipelineCreateInfo, 2> pipelineCreateInfos = {};
+
+	for (auto& pipelineCreateInfo : pipelineCreateInfos)
+	{
+		pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineCreateInfo.stage.pName = "main";
+	}
+
+	pipelineCreateInfos[0].stage.module = depthPyramidShaderModule;
+	pipelineCreateInfos[0].layout = depthPyramidPipelineLayout;
+	pipelineCreateInfos[1].stage.module = occlusionCullShaderModule;
+	pipelineCreateInfos[1].layout = occlusionCullPipelineLayout;
+
+	std::array<VkPipeline, 2> pipelines;
+	result = vkCreateComputePipelines(mainDevice.logicalDevice, pipelineCache, static_cast<uint32_t>(pipelineCreateInfos.size()), pipelineCreateInfos.data(), nullptr, pipelines.data());
+
+	// Destroy shader modules, no longer needed after pipelines are created
+	vkDestroyShaderModule(mainDevice.logicalDevice, occlusionCullShaderModule, nullptr);
+	vkDestroyShaderModule(mainDevice.logicalDevice, depthPyramidShaderModule, nullptr);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create Occlusion Culling Pipelines!");
+	}
+
+	depthPyramidPipeline = pipelines[0];
+	occlusionCullPipeline = pipelines[1];
+}
+
+void VulkanRenderer::updateOcclusionCullDescriptorSets()
+{
+	// Point each image's cull set at its commands, their bounds, the shared visibility and its world transforms
+	for (size_t i = 0; i < occlusionCullDescriptorSets.size(); i++)
+	{
+		std::array<VkDescriptorBufferInfo, 4> bufferInfos = {};
+		bufferInfos[0].buffer = indirectDrawBuffer[i];
+		bufferInfos[1].buffer = occlusionDrawBuffer[i];
+		bufferInfos[2].buffer = visibilityBuffer;
+		bufferInfos[3].buffer = worldTransformBuffer[i];
+
+		std::array<VkWriteDescriptorSet, 4> writeDescriptorSets = {};
+
+		for (uint32_t j = 0; j < bufferInfos.size(); j++)
+		{
+			bufferInfos[j].offset = 0;
+			bufferInfos[j].range = VK_WHOLE_SIZE;
+
+			writeDescriptorSets[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writeDescriptorSets[j].dstSet = occlusionCullDescriptorSets[i];
+			writeDescriptorSets[j].dstBinding = j;
+			writeDescriptorSets[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writeDescriptorSets[j].descriptorCount = 1;
+			writeDescriptorSets[j].pBufferInfo = &bufferInfos[j];
+		}
+
+		vkUpdateDescriptorSets(mainDevice.logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+}
+
+void VulkanRenderer::createDescriptorPool()
+{
+	// View Projection Pool
+	VkDescriptorPoolSize viewProjectionPoolSize = {};
+	viewProjectionPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	viewProjectionPoolSize.descriptorCount = static_cast<uint32_t>(viewProjectionUniformBuffer.size());
+
+
+	// World Transforms Pool
+	VkDescriptorPoolSize worldTransformPoolSize = {};
+	worldTransformPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	worldTransformPoolSize.descriptorCount = static_cast<uint32_t>(worldTransformBuffer.size());
+
+	std::vector<VkDescriptorPoolSize> descriptorPoolSizes = { viewProjectionPoolSize, worldTransformPoolSize };
+
+	// Descriptor pool create info
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.maxSets = static_cast<uint32_t>(swapchainImages.size());								// Maximum number of descriptor sets
+	poolCreateInfo.poolSizeCount = static_cast<uint32_t>(descriptorPoolSizes.size());					// Amount of pool sizes being passed
+	poolCreateInfo.pPoolSizes = descriptorPoolSizes.data();												// Pool Sizes to create pool with
+
+	// Create descriptor pool
+	VkResult result = vkCreateDescriptorPool(mainDevice.logicalDevice, &poolCreateInfo, nullptr, &viewProjectionDescriptorPool);
+
+	if (result != VK_SUCCESS)
+	{	
+		throw std::runtime_error("Failed to create Descriptor Pool!");
+	}
+
+
+	// Texture Sampler Pool (a single set holding the whole texture array)
+	VkDescriptorPoolSize textureSamplerPoolSize = {};
+	textureSamplerPoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	textureSamplerPoolSize.descriptorCount = MAX_TEXTURES;
+
+	// Texture sampler pool create info
+	VkDescriptorPoolCreateInfo textureSamplerPoolCreateInfo = {};
+	textureSamplerPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	textureSamplerPoolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;				// Required for sets using an update-after-bind layout
+	textureSamplerPoolCreateInfo.maxSets = 1;
+	textureSamplerPoolCreateInfo.poolSizeCount = 1;
+	textureSamplerPoolCreateInfo.pPoolSizes = &textureSamplerPoolSize;
+
+	result = vkCreateDescriptorPool(mainDevice.logicalDevice, &textureSamplerPoolCreateInfo, nullptr, &textureSamplerDescriptorPool);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create Texture Sampler Descriptor Pool!");
+	}
+
+	// Color Attachment Pool
+	VkDescriptorPoolSize colorInputPoolSize = {};
+	colorInputPoolSize.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+	colorInputPoolSize.descriptorCount = static_cast<uint32_t>(colorBufferImageView.size());
+
+	// Depth Attachment Pool
+	VkDescriptorPoolSize depthInputPoolSize = {};
+	depthInputPoolSize.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+	depthInputPoolSize.descriptorCount = static_cast<uint32_t>(depthBufferImageView.size());
+
+	std::array<VkDescriptorPoolSize, 2> inputAttachmentPoolSizes = { colorInputPoolSize, depthInputPoolSize };
+
+	// Input attachment pool create info
+	VkDescriptorPoolCreateInfo inputAttachmentPoolCreateInfo = {};
+	inputAttachmentPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	inputAttachmentPoolCreateInfo.maxSets = swapchainImages.size();
+	inputAttachmentPoolCreateInfo.poolSizeCount = static_cast<uint32_t>(inputAttachmentPoolSizes.size());
+	inputAttachmentPoolCreateInfo.pPoolSizes = inputAttachmentPoolSizes.data();
+
+	result = vkCreateDescriptorPool(mainDevice.logicalDevice, &inputAttachmentPoolCreateInfo, nullptr, &inputAttachmentDescriptorPool);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create Input Attachment Descriptor Pool!");
+	}
+}
+
+void VulkanRenderer::createDescriptorSets()
+{
+	// Resize descriptor set list --- 1 for every buffer
+	viewProjectionDescriptorSets.resize(swapchainImages.size());
+
+	std::vector<VkDescriptorSetLayout> setLayouts(swapchainImages.size(), viewProjectionDescriptorSetLayout);
+
+	// Descriptor set allocation info
 	VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {};
 	descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 	descriptorSetAllocateInfo.descriptorPool = viewProjectionDescriptorPool;											// Pool to allocate descriptor set from
@@ -1211,12 +2060,42 @@ void VulkanRenderer::createDescriptorSets()
 		viewProjectionSetWrite.descriptorCount = 1;														// Amount of descriptors to update
 		viewProjectionSetWrite.pBufferInfo = &viewProjectionBufferInfo;									// Information about buffer data to bind
 
+		// World transforms buffer, the whole of it
+		VkDescriptorBufferInfo worldTransformBufferInfo = {};
+		worldTransformBufferInfo.buffer = worldTransformBuffer[i];
+		worldTransformBufferInfo.offset = 0;
+		worldTransformBufferInfo.range = VK_WHOLE_SIZE;
+
+		VkWriteDescriptorSet worldTransformSetWrite = {};
+		worldTransformSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		worldTransformSetWrite.dstSet = viewProjectionDescriptorSets[i];
+		worldTransformSetWrite.dstBinding = 1;
+		worldTransformSetWrite.dstArrayElement = 0;
+		worldTransformSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		worldTransformSetWrite.descriptorCount = 1;
+		worldTransformSetWrite.pBufferInfo = &worldTransformBufferInfo;
+
 		// List of descriptor set writes
-		std::vector<VkWriteDescriptorSet> writeDescriptorSets = { viewProjectionSetWrite };
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = { viewProjectionSetWrite, worldTransformSetWrite };
 
 		// Update descriptor sets with new buffer/binding info
 		vkUpdateDescriptorSets(mainDevice.logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 	}
+
+	// Texture Descriptor Set Allocation Info (elements are written as textures are created)
+	VkDescriptorSetAllocateInfo textureDescriptorSetAllocateInfo = {};
+	textureDescriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	textureDescriptorSetAllocateInfo.descriptorPool = textureSamplerDescriptorPool;
+	textureDescriptorSetAllocateInfo.descriptorSetCount = 1;
+	textureDescriptorSetAllocateInfo.pSetLayouts = &textureSamplerDescriptorSetLayout;
+
+	// Allocate texture descriptor set
+	result = vkAllocateDescriptorSets(mainDevice.logicalDevice, &textureDescriptorSetAllocateInfo, &textureSamplerDescriptorSet);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate Texture Descriptor Set!");
+	}
 }
 
 void VulkanRenderer::createInputDescriptorSets()
@@ -1289,6 +2168,71 @@ void VulkanRenderer::createInputDescriptorSets()
 
 }
 
+void VulkanRenderer::createRenderGraph()
+{
+	// Attachments and buffers are made (one per swapchain image) outside the graph, the images drawn to set each frame
+	VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+
+	if (depthBufferFormat == VK_FORMAT_D32_SFLOAT_S8_UINT || depthBufferFormat == VK_FORMAT_D24_UNORM_S8_UINT)
+	{
+		depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+	}
+
+	swapchainResource = renderGraph.importImage("Swapchain", VK_IMAGE_ASPECT_COLOR_BIT);
+	colorBufferResource = renderGraph.importImage("Color Buffer", VK_IMAGE_ASPECT_COLOR_BIT);
+	depthBufferResource = renderGraph.importImage("Depth Buffer", depthAspect);
+	indirectDrawResource = renderGraph.importBuffer("Indirect Draws");
+
+	// Render passes transition their own attachments, so each pass declares the layouts its render pass starts and leaves them in
+	if (occlusionCulling)
+	{
+		depthPyramidResource = renderGraph.importImage("Depth Pyramid", VK_IMAGE_ASPECT_COLOR_BIT);
+		visibilityResource = renderGraph.importBuffer("Visibility");
+		renderGraph.setImportedImage(depthPyramidResource, depthPyramidImage);
+		renderGraph.setImportedBuffer(visibilityResource, visibilityBuffer);
+
+		// Switch on the draws visible last frame
+		uint32_t earlyCullPass = renderGraph.addPass("Early Occlusion Cull", [this](VkCommandBuffer) { recordOcclusionCull(frameImageIndex, frameCommandCount, false); });
+		renderGraph.useBuffer(earlyCullPass, visibilityResource, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+		renderGraph.useBuffer(earlyCullPass, indirectDrawResource, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT);
+
+		// Draw them, keeping their depth to sample
+		uint32_t earlyScenePass = renderGraph.addPass("Early Scene", [this](VkCommandBuffer) { recordScene(frameImageIndex, true); });
+		renderGraph.useBuffer(earlyScenePass, indirectDrawResource, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+		renderGraph.useImage(earlyScenePass, swapchainResource, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+		renderGraph.useImage(earlyScenePass, colorBufferResource, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+		renderGraph.useImage(earlyScenePass, depthBufferResource, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+		// Reduce their depth (the pyramid is rebuilt from scratch, but kept in GENERAL rather than discarded each frame)
+		uint32_t depthPyramidPass = renderGraph.addPass("Depth Pyramid", [this](VkCommandBuffer) { recordDepthPyramid(frameImageIndex); });
+		renderGraph.useImage(depthPyramidPass, depthBufferResource, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		renderGraph.useImage(depthPyramidPass, depthPyramidResource, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL);
+
+		// Test everything against it, switching on the newly revealed draws
+		uint32_t lateCullPass = renderGraph.addPass("Late Occlusion Cull", [this](VkCommandBuffer) { recordOcclusionCull(frameImageIndex, frameCommandCount, true); });
+		renderGraph.useImage(lateCullPass, depthPyramidResource, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL);
+		renderGraph.useBuffer(lateCullPass, visibilityResource, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+		renderGraph.useBuffer(lateCullPass, indirectDrawResource, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+	}
+
+	// Draw the scene (carrying on from the early pass with occlusion culling) and compose it into the swapchain image
+	VkImageLayout colorLayout = occlusionCulling ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+	VkImageLayout depthLayout = occlusionCulling ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+
+	uint32_t scenePass = renderGraph.addPass("Scene", [this](VkCommandBuffer) { recordScene(frameImageIndex, false); });
+	renderGraph.useBuffer(scenePass, indirectDrawResource, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+	renderGraph.useImage(scenePass, swapchainResource, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+	renderGraph.useImage(scenePass, colorBufferResource, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+		VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_INPUT_ATTACHMENT_READ_BIT, colorLayout, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	renderGraph.useImage(scenePass, depthBufferResource, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+		VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_INPUT_ATTACHMENT_READ_BIT, depthLayout, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+
+	// The frame exists to present, anything not leading to it is culled
+	renderGraph.setOutput(swapchainResource);
+	renderGraph.compile();
+}
+
 void VulkanRenderer::updateUniformBuffers(uint32_t imageIndex)
 {
 	// Copy View Projection Data
@@ -1299,50 +2243,397 @@ void VulkanRenderer::updateUniformBuffers(uint32_t imageIndex)
 
 }
 
-stbi_uc* VulkanRenderer::loadTextureFile(std::string fileName, int& width, int& height, VkDeviceSize& imageSize)
+void VulkanRenderer::updateInstanceBounds()
 {
-	// Number of channels the image uses
-	int channels;
+	// Bring world matrices up to date, and note the nodes changed against every image's buffer (each holds its own copy)
+	uint32_t firstChanged;
+	uint32_t lastChanged;
+	sceneGraph.updateWorldTransforms(firstChanged, lastChanged);
 
-	// Load pixel data for image
-	std::string fileLocation = "Textures/" + fileName;
-	stbi_uc* image = stbi_load(fileLocation.c_str(), &width, &height, &channels, STBI_rgb_alpha);
-
-	if (!image)
+	if (firstChanged < lastChanged)
 	{
-		throw std::runtime_error("Failed to load a Texture File! (" + fileName + ")");
+		for (auto& pendingRange : worldTransformPendingRanges)
+		{
+			pendingRange = pendingRange.x < pendingRange.y ? glm::uvec2(std::min(pendingRange.x, firstChanged), std::max(pendingRange.y, lastChanged)) : glm::uvec2(firstChanged, lastChanged);
+		}
 	}
 
-	// Calculate image size using data
-	imageSize = width * height * 4;
+	// Bring the world space boxes of instances whose nodes moved up to date (all of them after a rebuild)
+	uint32_t instance = 0;
+	bool boundsChanged = false;
 
-	return image;
-}
+	for (size_t i = 0; i < modelList.size(); i++)
+	{
+		for (size_t j = 0; j < modelList[i].getMeshCount(); j++, instance++)
+		{
+			Mesh* mesh = modelList[i].getMesh(j);
+			uint32_t node = mesh->getNode();
 
-VkImage VulkanRenderer::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags, VkMemoryPropertyFlags propertyFlags, VkDeviceMemory* imageMemory)
-{
-	// Create image (header/metadata information)
-	VkImageCreateInfo imageCreateInfo = {};
-	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;														// Type of image
-	imageCreateInfo.extent.width = width;																// Width of image extent
-	imageCreateInfo.extent.height = height;																// Height of image extent
-	imageCreateInfo.extent.depth = 1;																	// Depth of image (1 = no 3D aspect)
-	imageCreateInfo.mipLevels = 1;																		// Number of mipmap levels (level of detail)
-	imageCreateInfo.arrayLayers = 1;																	// Number of levels in image array
-	imageCreateInfo.format = format;																	// Format type of image
-	imageCreateInfo.tiling = tiling;																	// How image data should be "tiled" (arranged for optimal memory layout)
-	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;											// Layout of image data on creation
-	imageCreateInfo.usage = useFlags;																	// Bit flags defining what image will be used for
-	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;													// Number of samples for multi-sampling
-	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;											// Whether image can be shared between queues
+			if (!cullingBvhStale && (node < firstChanged || node >= lastChanged))
+			{
+				continue;
+			}
 
-	VkImage image;
-	VkResult result = vkCreateImage(mainDevice.logicalDevice, &imageCreateInfo, nullptr, &image);
+			transformBoundingBox(sceneGraph.getWorldTransform(node), mesh->getBoundsMin(), mesh->getBoundsMax(), instanceBoundsMin[instance], instanceBoundsMax[instance]);
+			boundsChanged = true;
+		}
+	}
 
-	if (result != VK_SUCCESS)
+	// New instances need a new tree, moved ones only new boxes up the tree they're in
+	if (cullingBvhStale)
 	{
-		throw std::runtime_error("Failed to create an Image!");
+		cullingBvh.build(instanceBoundsMin.data(), instanceBoundsMax.data(), instanceBoundsMin.size());
+		cullingBvhStale = false;
+	}
+	else if (boundsChanged)
+	{
+		cullingBvh.refit(instanceBoundsMin.data(), instanceBoundsMax.data());
+	}
+}
+
+void VulkanRenderer::updateWorldTransforms(uint32_t imageIndex)
+{
+	updateInstanceBounds();
+
+	// Copy everything this image has missed in one batch
+	glm::uvec2& pendingRange = worldTransformPendingRanges[imageIndex];
+
+	if (pendingRange.x < pendingRange.y)
+	{
+		memcpy(worldTransformData[imageIndex] + pendingRange.x, sceneGraph.getWorldTransforms() + pendingRange.x, (pendingRange.y - pendingRange.x) * sizeof(glm::mat4));
+		pendingRange = glm::uvec2(0);
+	}
+
+	// Every node's model-view and model-view-projection matrix for this frame's culling and level selection, each set as one batch
+	uint32_t nodeCount = sceneGraph.getNodeCount();
+	nodeModelViews.resize(nodeCount);
+	nodeModelViewProjections.resize(nodeCount);
+	multiplyMatrices(viewProjection.view, sceneGraph.getWorldTransforms(), nodeModelViews.data(), nodeCount);
+	multiplyMatrices(viewProjection.projection, nodeModelViews.data(), nodeModelViewProjections.data(), nodeCount);
+}
+
+void VulkanRenderer::updateTextureStreaming()
+{
+	// This frame's fence has been waited on, so the staging its last submit read from can be reused
+	textureStagingUsed -= textureStagingFrameBytes[currentFrame];
+	textureStagingFrameBytes[currentFrame] = 0;
+
+	if (textureStagingUsed == 0)
+	{
+		textureStagingHead = 0;
+	}
+
+	// Residency changes are recorded here and submitted ahead of the frame's own commands
+	VkCommandBufferBeginInfo commandBufferBeginInfo = {};
+	commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	VkResult result = vkBeginCommandBuffer(textureStreamingCommandBuffers[currentFrame], &commandBufferBeginInfo);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to start recording a Command Buffer!");
+	}
+
+	// Start every texture at its coarsest level, then let each mesh using it ask for finer ones
+	for (auto& texture : textures)
+	{
+		texture.requestedMip = static_cast<uint32_t>(texture.mipLevels.size() - 1);
+	}
+
+	// Screen pixels covered by one unit of size at a view distance of one unit
+	float pixelsPerUnit = std::abs(viewProjection.projection[1][1]) * swapchainExtent.height * 0.5f;
+
+	for (size_t i = 0; i < modelList.size(); i++)
+	{
+		for (size_t j = 0; j < modelList[i].getMeshCount(); j++)
+		{
+			Mesh* mesh = modelList[i].getMesh(j);
+			glm::vec4 boundingSphere = mesh->getBoundingSphere();
+			const glm::mat4& modelView = nodeModelViews[mesh->getNode()];
+
+			// Largest axis scale of the mesh's node, so the bounding sphere still encloses the mesh after transformation
+			float scale = std::sqrt(std::max(glm::dot(modelView[0], modelView[0]), std::max(glm::dot(modelView[1], modelView[1]), glm::dot(modelView[2], modelView[2]))));
+
+			glm::vec3 center = glm::vec3(modelView * glm::vec4(glm::vec3(boundingSphere), 1.0f));
+			float radius = boundingSphere.w * scale;
+			float distance = -center.z;																	// Camera looks down -Z in view space
+
+			// Wholly behind the camera, nothing to sample
+			if (distance < -radius)
+			{
+				continue;
+			}
+
+			// Projected diameter of the bounding sphere, assumed to span the mesh's part of its texture once (camera inside the sphere needs full detail)
+			float screenPixels = distance > radius ? 2.0f * radius / distance * pixelsPerUnit : std::numeric_limits<float>::max();
+
+			StreamedTexture& texture = textures[mesh->getTextureID()];
+			texture.requestedMip = std::min(texture.requestedMip, selectMipLevel(texture, screenPixels, mesh->getTextureScale()));
+			texture.lastUsedFrame = frameNumber;
+		}
+	}
+
+	// Textures wanting finer levels than they hold, most starved first
+	std::vector<size_t> upgrades;
+
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		if (textures[i].requestedMip < textures[i].residentMip)
+		{
+			upgrades.push_back(i);
+		}
+	}
+
+	std::sort(upgrades.begin(), upgrades.end(), [this](size_t a, size_t b)
+	{
+		return textures[a].residentMip - textures[a].requestedMip > textures[b].residentMip - textures[b].requestedMip;
+	});
+
+	// Limit uploads and evictions per frame so streaming never stalls a frame for long
+	size_t uploadCount = std::min(upgrades.size(), static_cast<size_t>(TEXTURE_STREAMING_UPLOADS_PER_FRAME));
+	uint32_t evictionsLeft = TEXTURE_STREAMING_EVICTIONS_PER_FRAME;
+
+	for (size_t i = 0; i < uploadCount; i++)
+	{
+		StreamedTexture& texture = textures[upgrades[i]];
+		VkDeviceSize residentBytes = getMipChainSize(texture, texture.residentMip);
+		VkDeviceSize requestedBytes = getMipChainSize(texture, texture.requestedMip);
+
+		// Make room by dropping detail nothing on screen needs
+		if (textureResidentBytes + requestedBytes - residentBytes > textureStreamingBudget)
+		{
+			evictTextures(textureResidentBytes + requestedBytes - residentBytes - textureStreamingBudget, evictionsLeft);
+		}
+
+		// Take the finest requested level that fits in the budget left and in the staging ring
+		for (uint32_t baseMip = texture.requestedMip; baseMip < texture.residentMip; baseMip++)
+		{
+			if (textureResidentBytes + getMipChainSize(texture, baseMip) - residentBytes <= textureStreamingBudget && streamTextureMips(upgrades[i], baseMip))
+			{
+				break;
+			}
+		}
+	}
+
+	// Budget may have been lowered since the textures were streamed in
+	if (textureResidentBytes > textureStreamingBudget)
+	{
+		evictTextures(textureResidentBytes - textureStreamingBudget, evictionsLeft);
+	}
+
+	result = vkEndCommandBuffer(textureStreamingCommandBuffers[currentFrame]);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to stop recording a Command Buffer!");
+	}
+}
+
+void VulkanRenderer::updateMeshLods()
+{
+	// Screen pixels covered by one unit of size at a view distance of one unit
+	float pixelsPerUnit = std::abs(viewProjection.projection[1][1]) * swapchainExtent.height * 0.5f;
+
+	for (size_t i = 0; i < modelList.size(); i++)
+	{
+		for (size_t j = 0; j < modelList[i].getMeshCount(); j++)
+		{
+			Mesh* mesh = modelList[i].getMesh(j);
+			glm::vec4 boundingSphere = mesh->getBoundingSphere();
+			const glm::mat4& modelView = nodeModelViews[mesh->getNode()];
+
+			// Largest axis scale of the mesh's node, so the bounding sphere still encloses the mesh after transformation
+			float scale = std::sqrt(std::max(glm::dot(modelView[0], modelView[0]), std::max(glm::dot(modelView[1], modelView[1]), glm::dot(modelView[2], modelView[2]))));
+
+			glm::vec3 center = glm::vec3(modelView * glm::vec4(glm::vec3(boundingSphere), 1.0f));
+			float radius = boundingSphere.w * scale;
+			float distance = -center.z;																	// Camera looks down -Z in view space
+
+			// Wholly behind the camera, keep whatever level it had
+			if (distance < -radius)
+			{
+				continue;
+			}
+
+			// Projected radius of the bounding sphere (camera inside the sphere needs full detail)
+			float screenRadius = distance > radius ? radius / distance * pixelsPerUnit : std::numeric_limits<float>::max();
+			mesh->selectLod(screenRadius);
+		}
+	}
+}
+
+void VulkanRenderer::updateFrustumCulling()
+{
+	// Planes of the whole view frustum in world space, as the boxes are
+	glm::vec4 frustumPlanes[6];
+	calculateFrustumPlanes(viewProjection.projection * viewProjection.view, frustumPlanes);
+
+	CullingFrustum frustum;
+	prepareCullingFrustum(frustumPlanes, frustum);
+
+	size_t visibleCount = cullingBvh.cull(frustum, instanceBoundsMin.data(), instanceBoundsMax.data(), instanceVisibility);
+
+	cullingStats.meshCount = static_cast<uint32_t>(instanceVisibility.size());
+	cullingStats.frustumCulledCount = static_cast<uint32_t>(instanceVisibility.size() - visibleCount);
+}
+
+void VulkanRenderer::updateSoftwareOcclusionCulling()
+{
+	cullingStats.occluderCount = 0;
+	cullingStats.occlusionCulledCount = 0;
+	cullingStats.occluderMilliseconds = 0.0f;
+	cullingStats.occludeeMilliseconds = 0.0f;
+
+	if (!softwareOcclusionCulling)
+	{
+		return;
+	}
+
+	auto occluderStart = std::chrono::steady_clock::now();
+
+	// Rank the meshes in view by how much of the screen they could cover, their box's bounding radius over its distance from the camera
+	// (meshes around the camera count as filling it, their triangles crossing the near plane are skipped when drawn)
+	glm::vec3 cameraPosition = glm::vec3(glm::inverse(viewProjection.view)[3]);
+	std::vector<std::pair<float, Mesh*>> occluders;
+	uint32_t instance = 0;
+
+	for (size_t i = 0; i < modelList.size(); i++)
+	{
+		for (size_t j = 0; j < modelList[i].getMeshCount(); j++, instance++)
+		{
+			Mesh* mesh = modelList[i].getMesh(j);
+
+			if (!instanceVisibility[instance] || mesh->getOccluderIndices().empty())
+			{
+				continue;
+			}
+
+			glm::vec3 center = (instanceBoundsMin[instance] + instanceBoundsMax[instance]) * 0.5f;
+			float radius = glm::length(instanceBoundsMax[instance] - instanceBoundsMin[instance]) * 0.5f;
+			float size = radius / std::max(glm::length(center - cameraPosition), radius);
+
+			if (size >= SOFTWARE_OCCLUSION_MIN_OCCLUDER_SIZE)
+			{
+				occluders.push_back({ size, mesh });
+			}
+		}
+	}
+
+	size_t occluderCount = std::min(occluders.size(), SOFTWARE_OCCLUSION_MAX_OCCLUDERS);
+	std::partial_sort(occluders.begin(), occluders.begin() + occluderCount, occluders.end(),
+		[](const std::pair<float, Mesh*>& a, const std::pair<float, Mesh*>& b) { return a.first > b.first; });
+
+	// Draw the largest into the occlusion buffer, each placed by its node's matrix for this frame
+	occlusionBuffer.clear();
+
+	for (size_t i = 0; i < occluderCount; i++)
+	{
+		Mesh* mesh = occluders[i].second;
+		const std::vector<glm::vec3>& positions = mesh->getOccluderPositions();
+		const std::vector<uint32_t>& indices = mesh->getOccluderIndices();
+
+		occlusionBuffer.renderOccluder(nodeModelViewProjections[mesh->getNode()], positions.data(), positions.size(), indices.data(), indices.size());
+	}
+
+	auto occludeeStart = std::chrono::steady_clock::now();
+
+	// Workers test the instances still in view against it a batch each, hiding those behind the occluders
+	// (occluders pass their own test, as their boxes contain them)
+	size_t batchCount = occluderCount > 0 ? (instanceVisibility.size() + SOFTWARE_OCCLUSION_BATCH_SIZE - 1) / SOFTWARE_OCCLUSION_BATCH_SIZE : 0;
+	std::vector<uint32_t> batchCulledCounts(batchCount, 0);
+	glm::mat4 cullViewProjection = viewProjection.projection * viewProjection.view;
+
+	threadPool.forEach(batchCount, [&](size_t batch)
+	{
+		size_t first = batch * SOFTWARE_OCCLUSION_BATCH_SIZE;
+		size_t last = std::min(first + SOFTWARE_OCCLUSION_BATCH_SIZE, instanceVisibility.size());
+
+		for (size_t i = first; i < last; i++)
+		{
+			if (instanceVisibility[i] && !occlusionBuffer.isBoxVisible(cullViewProjection, instanceBoundsMin[i], instanceBoundsMax[i]))
+			{
+				instanceVisibility[i] = 0;
+				batchCulledCounts[batch]++;
+			}
+		}
+	});
+
+	auto occludeeEnd = std::chrono::steady_clock::now();
+
+	cullingStats.occluderCount = static_cast<uint32_t>(occluderCount);
+
+	for (uint32_t culledCount : batchCulledCounts)
+	{
+		cullingStats.occlusionCulledCount += culledCount;
+	}
+
+	cullingStats.occluderMilliseconds = std::chrono::duration<float, std::milli>(occludeeStart - occluderStart).count();
+	cullingStats.occludeeMilliseconds = std::chrono::duration<float, std::milli>(occludeeEnd - occludeeStart).count();
+}
+
+stbi_uc* VulkanRenderer::loadTextureFile(std::string fileName, int& width, int& height, VkDeviceSize& imageSize)
+{
+	// Number of channels the image uses
+	int channels;
+
+	// Check the file's channel count first, so 3-channel images decode as RGB and take the SIMD expansion below instead of stb's scalar path
+	// (other layouts are rare and let stb convert them to RGBA directly)
+	std::string fileLocation = "Textures/" + fileName;
+	bool expandRGB = stbi_info(fileLocation.c_str(), &width, &height, &channels) && channels == STBI_rgb;
+
+	// Load pixel data for image
+	stbi_uc* image = stbi_load(fileLocation.c_str(), &width, &height, &channels, expandRGB ? STBI_rgb : STBI_rgb_alpha);
+
+	if (image && expandRGB)
+	{
+		// Allocated with malloc to match the free() stbi_image_free uses
+		stbi_uc* rgbImage = image;
+		image = static_cast<stbi_uc*>(malloc(static_cast<size_t>(width) * height * 4));
+
+		if (image)
+		{
+			expandRGBToRGBA(rgbImage, image, static_cast<size_t>(width) * height);
+		}
+
+		stbi_image_free(rgbImage);
+	}
+
+	if (!image)
+	{
+		throw std::runtime_error("Failed to load a Texture File! (" + fileName + ")");
+	}
+
+	// Calculate image size using data
+	imageSize = width * height * 4;
+
+	return image;
+}
+
+VkImage VulkanRenderer::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags, VkMemoryPropertyFlags propertyFlags, VkDeviceMemory* imageMemory)
+{
+	// Create image (header/metadata information)
+	VkImageCreateInfo imageCreateInfo = {};
+	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;														// Type of image
+	imageCreateInfo.extent.width = width;																// Width of image extent
+	imageCreateInfo.extent.height = height;																// Height of image extent
+	imageCreateInfo.extent.depth = 1;																	// Depth of image (1 = no 3D aspect)
+	imageCreateInfo.mipLevels = mipLevels;																// Number of mipmap levels (level of detail)
+	imageCreateInfo.arrayLayers = 1;																	// Number of levels in image array
+	imageCreateInfo.format = format;																	// Format type of image
+	imageCreateInfo.tiling = tiling;																	// How image data should be "tiled" (arranged for optimal memory layout)
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;											// Layout of image data on creation
+	imageCreateInfo.usage = useFlags;																	// Bit flags defining what image will be used for
+	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;													// Number of samples for multi-sampling
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;											// Whether image can be shared between queues
+
+	VkImage image;
+	VkResult result = vkCreateImage(mainDevice.logicalDevice, &imageCreateInfo, nullptr, &image);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create an Image!");
 	}
 
 	// Create memory for image
@@ -1367,22 +2658,19 @@ VkImage VulkanRenderer::createImage(uint32_t width, uint32_t height, VkFormat fo
 	return image;
 }
 
-VkImageView VulkanRenderer::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
+VkImageView VulkanRenderer::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels, VkComponentMapping components, uint32_t baseMipLevel)
 {
 	VkImageViewCreateInfo viewCreateInfo = {};
 	viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	viewCreateInfo.image = image;																		// Image to create view for
 	viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;													// Type of image
 	viewCreateInfo.format = format;																		// Format of image data
-	viewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;										// Allows remapping of rgba components to other rgba components
-	viewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-	viewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-	viewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+	viewCreateInfo.components = components;																// Allows remapping of rgba components to other rgba components
 
 	// Subresources allow the view to view only a part of an image
 	viewCreateInfo.subresourceRange.aspectMask = aspectFlags;											// Which aspect of the image to view
-	viewCreateInfo.subresourceRange.baseMipLevel = 0;													// Start mipmap level to view from
-	viewCreateInfo.subresourceRange.levelCount = 1;														// Number of mipmap levels to view
+	viewCreateInfo.subresourceRange.baseMipLevel = baseMipLevel;										// Start mipmap level to view from
+	viewCreateInfo.subresourceRange.levelCount = mipLevels;												// Number of mipmap levels to view
 	viewCreateInfo.subresourceRange.baseArrayLayer = 0;													// Start array level to view from
 	viewCreateInfo.subresourceRange.layerCount = 1;														// Number of array levels to view
 
@@ -1414,157 +2702,734 @@ VkShaderModule VulkanRenderer::createShaderModule(const std::vector<char>& code)
 		throw std::runtime_error("Failed to create Shader Module!");
 	}
 
-	return shaderModule;
+	return shaderModule;
+}
+
+int VulkanRenderer::createTexture(std::string fileName)
+{
+	// Single texture goes through the same path as a batch
+	return createTextures({ fileName })[0];
+}
+
+std::vector<int> VulkanRenderer::createTextures(const std::vector<std::string>& fileNames)
+{
+	// New textures are appended, so workers can keep pointers to them while this thread uploads
+	size_t firstTexture = textures.size();
+	textures.resize(firstTexture + fileNames.size());
+
+	std::vector<std::future<void>> decodes(fileNames.size());
+	std::vector<TextureTailUpload> uploads(fileNames.size());
+	std::vector<int> textureIDs(fileNames.size());
+
+	// Decode and build each mip chain on a worker thread, its tail straight into staging (format and size are only known once the pixels have been seen)
+	for (size_t i = 0; i < fileNames.size(); i++)
+	{
+		StreamedTexture* texture = &textures[firstTexture + i];
+		TextureTailUpload* upload = &uploads[i];
+		std::string fileName = fileNames[i];
+		uint32_t maxSize = textureMaxSize;
+
+		decodes[i] = threadPool.submit([this, texture, upload, fileName, maxSize]()
+		{
+			int width;
+			int height;
+			VkDeviceSize imageSize;
+
+			stbi_uc* imageData = loadTextureFile(fileName, width, height, imageSize);
+
+			try
+			{
+				buildMipChain(*texture, imageData, static_cast<uint32_t>(width), static_cast<uint32_t>(height), maxSize, UINT32_MAX, TEXTURE_STREAMING_TAIL_SIZE, [this, upload](VkDeviceSize tailSize)
+				{
+					return createTextureTailStaging(tailSize, *upload);
+				});
+			}
+
+			catch (...)
+			{
+				stbi_image_free(imageData);
+				throw;
+			}
+
+			stbi_image_free(imageData);
+		});
+	}
+
+	try
+	{
+		// Upload each texture's mip tail as soon as its decode has finished, while later ones are still decoding
+		for (size_t i = 0; i < fileNames.size(); i++)
+		{
+			decodes[i].get();
+
+			// Only the small tail is uploaded up front, finer levels are streamed in once something on screen needs them
+			submitTextureTail(firstTexture + i, uploads[i]);
+
+			textureIDs[i] = static_cast<int>(firstTexture + i);
+		}
+
+		finishTextureTailUploads(uploads);
+	}
+
+	catch (...)
+	{
+		// Workers may still be writing texture pixels, so wait for them before dropping any texture
+		for (auto& decode : decodes)
+		{
+			if (decode.valid())
+			{
+				decode.wait();
+			}
+		}
+
+		finishTextureTailUploads(uploads);
+
+		// Drop textures that never made it to the GPU (uploaded ones stay, their images are already owned by the list)
+		size_t uploadedCount = 0;
+		while (uploadedCount < fileNames.size() && textures[firstTexture + uploadedCount].image != VK_NULL_HANDLE)
+		{
+			uploadedCount++;
+		}
+
+		textures.resize(firstTexture + uploadedCount);
+
+		throw;
+	}
+
+	return textureIDs;
+}
+
+int VulkanRenderer::createTextureAtlas(const std::vector<std::string>& fileNames, const std::vector<AtlasTile>& tiles, uint32_t atlasWidth, uint32_t atlasHeight)
+{
+	std::vector<uint8_t> atlasPixels((size_t)atlasWidth * atlasHeight * 4, 0);
+	std::vector<std::future<void>> decodes(fileNames.size());
+
+	// Decode each texture on a worker thread straight into its own tile (tiles never overlap, so workers never share texels)
+	for (size_t i = 0; i < fileNames.size(); i++)
+	{
+		const AtlasTile* tile = &tiles[i];
+		std::string fileName = fileNames[i];
+		uint8_t* atlas = atlasPixels.data();
+
+		decodes[i] = threadPool.submit([this, tile, fileName, atlas, atlasWidth]()
+		{
+			int width;
+			int height;
+			VkDeviceSize imageSize;
+
+			stbi_uc* imageData = loadTextureFile(fileName, width, height, imageSize);
+
+			if ((uint32_t)width != tile->width || (uint32_t)height != tile->height)
+			{
+				stbi_image_free(imageData);
+				throw std::runtime_error("Texture File changed size while loading! (" + fileName + ")");
+			}
+
+			blitAtlasTile(atlas, atlasWidth, *tile, imageData, TEXTURE_ATLAS_GUTTER);
+			stbi_image_free(imageData);
+		});
+	}
+
+	// Wait for every decode before the atlas pixels go away, then report the first failure
+	std::exception_ptr error;
+
+	for (auto& decode : decodes)
+	{
+		try
+		{
+			decode.get();
+		}
+
+		catch (...)
+		{
+			if (!error)
+			{
+				error = std::current_exception();
+			}
+		}
+	}
+
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+
+	// Below the level where the gutter shrinks to a single texel, filtering would mix neighbouring tiles, so the chain stops there
+	return createTextureFromPixels(atlasPixels.data(), atlasWidth, atlasHeight, calculateMipLevelCount(TEXTURE_ATLAS_GUTTER, TEXTURE_ATLAS_GUTTER));
+}
+
+int VulkanRenderer::createTextureFromPixels(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t maxLevelCount)
+{
+	// Build the CPU mip chain and make its tail resident, same as a texture loaded from file
+	textures.emplace_back();
+	size_t textureIndex = textures.size() - 1;
+
+	std::vector<TextureTailUpload> uploads(1);
+
+	buildMipChain(textures[textureIndex], pixels, width, height, textureMaxSize, maxLevelCount, TEXTURE_STREAMING_TAIL_SIZE, [this, &uploads](VkDeviceSize tailSize)
+	{
+		return createTextureTailStaging(tailSize, uploads[0]);
+	});
+
+	submitTextureTail(textureIndex, uploads[0]);
+	finishTextureTailUploads(uploads);
+
+	return static_cast<int>(textureIndex);
+}
+
+void VulkanRenderer::recordTextureMips(size_t textureIndex, uint32_t baseMip, VkCommandBuffer commandBuffer, VkBuffer stagingBuffer, VkDeviceSize stagingOffset)
+{
+	// Levels finer than the resident ones come from the staging buffer (packed from stagingOffset the same way as the CPU mip chain), the rest from the old image
+	StreamedTexture& texture = textures[textureIndex];
+	const MipLevel& baseLevel = texture.mipLevels[baseMip];
+	uint32_t levelCount = static_cast<uint32_t>(texture.mipLevels.size()) - baseMip;
+	uint32_t stagedCount = texture.image == VK_NULL_HANDLE ? levelCount : (texture.residentMip > baseMip ? texture.residentMip - baseMip : 0);
+
+	// Create image holding only the resident levels, so its first level acts as the texture's minimum LOD (and can be copied from by the next change)
+	VkDeviceMemory imageMemory;
+	VkImage image = createImage(baseLevel.width, baseLevel.height, levelCount, texture.format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &imageMemory);
+	textureBarriers.trackImage(image, VK_IMAGE_ASPECT_COLOR_BIT);
+
+	// Transition image to be DST for copy operations, and the old image to be their SRC
+	textureBarriers.imageBarrier(image, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+	if (stagedCount < levelCount)
+	{
+		textureBarriers.imageBarrier(texture.image, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+	}
+
+	textureBarriers.flush(commandBuffer);
+
+	// One copy region per staged level
+	if (stagedCount > 0)
+	{
+		std::vector<VkBufferImageCopy> imageRegions(stagedCount);
+
+		for (uint32_t i = 0; i < stagedCount; i++)
+		{
+			const MipLevel& level = texture.mipLevels[baseMip + i];
+
+			imageRegions[i].bufferOffset = stagingOffset + level.offset - baseLevel.offset;				// Offset into data
+			imageRegions[i].bufferRowLength = 0;														// Row length of data to calculate data spacing
+			imageRegions[i].bufferImageHeight = 0;														// Image height to calculate data spacing
+			imageRegions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;					// Which aspect of image to copy
+			imageRegions[i].imageSubresource.mipLevel = i;												// Mipmap level to copy
+			imageRegions[i].imageSubresource.baseArrayLayer = 0;										// Starting array layer (if array)
+			imageRegions[i].imageSubresource.layerCount = 1;											// Number of layers to copy starting at baseArrayLayer
+			imageRegions[i].imageOffset = { 0, 0, 0 };													// Offset into image (as opposed to raw data in bufferOffset)
+			imageRegions[i].imageExtent = { level.width, level.height, 1 };								// Size of region to copy as (x, y, z) values
+		}
+
+		// Copy image data
+		vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(imageRegions.size()), imageRegions.data());
+	}
+
+	// One copy region per level the old image already holds
+	if (stagedCount < levelCount)
+	{
+		std::vector<VkImageCopy> imageRegions(levelCount - stagedCount);
+
+		for (uint32_t i = 0; i < imageRegions.size(); i++)
+		{
+			uint32_t mip = baseMip + stagedCount + i;
+			const MipLevel& level = texture.mipLevels[mip];
+
+			// Each image starts at its own resident level, so the same mip sits at a different index in each
+			imageRegions[i].srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip - texture.residentMip, 0, 1 };
+			imageRegions[i].srcOffset = { 0, 0, 0 };
+			imageRegions[i].dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip - baseMip, 0, 1 };
+			imageRegions[i].dstOffset = { 0, 0, 0 };
+			imageRegions[i].extent = { level.width, level.height, 1 };
+		}
+
+		vkCmdCopyImage(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(imageRegions.size()), imageRegions.data());
+	}
+
+	// Transition image to be shader readable for shader usage
+	textureBarriers.imageBarrier(image, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	textureBarriers.flush(commandBuffer);
+
+	// Create image view and descriptor for the new image
+	VkImageView imageView = createImageView(image, texture.format, VK_IMAGE_ASPECT_COLOR_BIT, levelCount, texture.components);
+	uint32_t descriptorIndex = static_cast<uint32_t>(createTextureDescriptor(imageView));
+
+	// Frames still in flight may sample the old image through its old descriptor, so retire both rather than destroying them
+	if (texture.image != VK_NULL_HANDLE)
+	{
+		retiredTextures.push_back({ texture.image, texture.imageMemory, texture.imageView, texture.descriptorIndex, frameNumber });
+		textureResidentBytes -= getMipChainSize(texture, texture.residentMip);
+	}
+
+	texture.image = image;
+	texture.imageMemory = imageMemory;
+	texture.imageView = imageView;
+	texture.descriptorIndex = descriptorIndex;
+	texture.residentMip = baseMip;
+
+	textureResidentBytes += getMipChainSize(texture, baseMip);
+}
+
+uint8_t* VulkanRenderer::createTextureTailStaging(VkDeviceSize size, TextureTailUpload& upload)
+{
+	// Called from the decoding workers, which filter the tail straight into the mapping
+	createBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &upload.stagingBuffer, &upload.stagingBufferMemory);
+
+	void* data;
+	vkMapMemory(mainDevice.logicalDevice, upload.stagingBufferMemory, 0, size, 0, &data);
+
+	return static_cast<uint8_t*>(data);
+}
+
+void VulkanRenderer::submitTextureTail(size_t textureIndex, TextureTailUpload& upload)
+{
+	// Each tail is submitted on its own without waiting, so its copies run while later textures are still decoding
+	VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+	commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	commandBufferAllocateInfo.commandPool = graphicsCommandPool;
+	commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	commandBufferAllocateInfo.commandBufferCount = 1;
+
+	VkResult result = vkAllocateCommandBuffers(mainDevice.logicalDevice, &commandBufferAllocateInfo, &upload.commandBuffer);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate Command Buffers!");
+	}
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkBeginCommandBuffer(upload.commandBuffer, &beginInfo);
+	recordTextureMips(textureIndex, textures[textureIndex].tailMip, upload.commandBuffer, upload.stagingBuffer, 0);
+	vkEndCommandBuffer(upload.commandBuffer);
+
+	VkFenceCreateInfo fenceCreateInfo = {};
+	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	if (vkCreateFence(mainDevice.logicalDevice, &fenceCreateInfo, nullptr, &upload.fence) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create a Fence!");
+	}
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &upload.commandBuffer;
+
+	result = vkQueueSubmit(graphicsQueue, 1, &submitInfo, upload.fence);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to submit Command Buffer to Queue!");
+	}
+}
+
+void VulkanRenderer::finishTextureTailUploads(std::vector<TextureTailUpload>& uploads)
+{
+	// Staging buffers can only go once the copies reading them have finished (uploads never submitted are just freed)
+	for (auto& upload : uploads)
+	{
+		if (upload.fence != VK_NULL_HANDLE)
+		{
+			vkWaitForFences(mainDevice.logicalDevice, 1, &upload.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+			vkDestroyFence(mainDevice.logicalDevice, upload.fence, nullptr);
+		}
+
+		if (upload.commandBuffer != VK_NULL_HANDLE)
+		{
+			vkFreeCommandBuffers(mainDevice.logicalDevice, graphicsCommandPool, 1, &upload.commandBuffer);
+		}
+
+		vkDestroyBuffer(mainDevice.logicalDevice, upload.stagingBuffer, nullptr);
+		vkFreeMemory(mainDevice.logicalDevice, upload.stagingBufferMemory, nullptr);
+
+		upload = {};
+	}
+}
+
+bool VulkanRenderer::streamTextureMips(size_t textureIndex, uint32_t baseMip)
+{
+	// Only levels finer than the resident ones are staged from the CPU, the rest are copied from the old image on the GPU
+	StreamedTexture& texture = textures[textureIndex];
+	VkDeviceSize stagingSize = getMipChainSize(texture, baseMip) - getMipChainSize(texture, texture.residentMip);
+	VkDeviceSize stagingOffset;
+
+	if (!allocateTextureStaging(stagingSize, stagingOffset))
+	{
+		return false;
+	}
+
+	memcpy(textureStagingData + stagingOffset, texture.pixels.data() + texture.mipLevels[baseMip].offset, static_cast<size_t>(stagingSize));
+	recordTextureMips(textureIndex, baseMip, textureStreamingCommandBuffers[currentFrame], textureStagingBuffer, stagingOffset);
+
+	return true;
+}
+
+bool VulkanRenderer::allocateTextureStaging(VkDeviceSize size, VkDeviceSize& offset)
+{
+	// Align every region for any texel size, and wrap to the start of the ring rather than split a region across its end
+	VkDeviceSize start = (textureStagingHead + 15) & ~VkDeviceSize(15);
+
+	if (start + size > TEXTURE_STREAMING_STAGING_SIZE)
+	{
+		start = 0;
+	}
+
+	// Skipped bytes stay in use until this frame's are released, so frames free the ring in the order they filled it
+	VkDeviceSize allocatedSize = (start >= textureStagingHead ? start - textureStagingHead : TEXTURE_STREAMING_STAGING_SIZE - textureStagingHead) + size;
+
+	if (textureStagingUsed + allocatedSize > TEXTURE_STREAMING_STAGING_SIZE)
+	{
+		return false;
+	}
+
+	offset = start;
+	textureStagingHead = start + size;
+	textureStagingUsed += allocatedSize;
+	textureStagingFrameBytes[currentFrame] += allocatedSize;
+
+	return true;
+}
+
+VkDeviceSize VulkanRenderer::evictTextures(VkDeviceSize bytesNeeded, uint32_t& evictionsLeft)
+{
+	// Textures holding finer levels than this frame needs (never dropping below the tail), least recently used first
+	std::vector<size_t> candidates;
+
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		if (std::min(textures[i].requestedMip, textures[i].tailMip) > textures[i].residentMip)
+		{
+			candidates.push_back(i);
+		}
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [this](size_t a, size_t b)
+	{
+		return textures[a].lastUsedFrame < textures[b].lastUsedFrame;
+	});
+
+	VkDeviceSize bytesFreed = 0;
+
+	for (size_t i = 0; i < candidates.size() && bytesFreed < bytesNeeded && evictionsLeft > 0; i++)
+	{
+		StreamedTexture& texture = textures[candidates[i]];
+		VkDeviceSize residentBytes = getMipChainSize(texture, texture.residentMip);
+
+		// Coarser levels are all resident already, so they are copied on the GPU without staging
+		recordTextureMips(candidates[i], std::min(texture.requestedMip, texture.tailMip), textureStreamingCommandBuffers[currentFrame], VK_NULL_HANDLE, 0);
+		evictionsLeft--;
+
+		bytesFreed += residentBytes - getMipChainSize(texture, texture.residentMip);
+	}
+
+	return bytesFreed;
+}
+
+void VulkanRenderer::destroyRetiredTextures(bool force)
+{
+	// Once MAX_FRAME_DRAWS more frames have been waited on, no frame recorded before retirement can still be sampling the image
+	for (size_t i = 0; i < retiredTextures.size();)
+	{
+		const RetiredTexture& retired = retiredTextures[i];
+
+		if (!force && frameNumber < retired.retiredFrame + MAX_FRAME_DRAWS)
+		{
+			i++;
+			continue;
+		}
+
+		vkDestroyImageView(mainDevice.logicalDevice, retired.imageView, nullptr);
+		vkDestroyImage(mainDevice.logicalDevice, retired.image, nullptr);
+		textureBarriers.forgetImage(retired.image);
+		vkFreeMemory(mainDevice.logicalDevice, retired.imageMemory, nullptr);
+
+		// Descriptor element is no longer read by any pending frame, so it can be handed out again
+		freeTextureDescriptors.push_back(retired.descriptorIndex);
+
+		retiredTextures.erase(retiredTextures.begin() + i);
+	}
+}
+
+int VulkanRenderer::createTextureDescriptor(VkImageView textureImage)
+{
+	// Reuse an element released by a retired texture before taking a new one
+	uint32_t descriptorIndex;
+
+	if (!freeTextureDescriptors.empty())
+	{
+		descriptorIndex = freeTextureDescriptors.back();
+		freeTextureDescriptors.pop_back();
+	}
+
+	else
+	{
+		if (textureDescriptorCount >= MAX_TEXTURES)
+		{
+			throw std::runtime_error("Failed to create Texture Descriptor, texture array is full!");
+		}
+
+		descriptorIndex = textureDescriptorCount++;
+	}
+
+	// Texture image info
+	VkDescriptorImageInfo textureImageInfo = {};
+	textureImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;							// Image layout when in use
+	textureImageInfo.imageView = textureImage;															// Image to bind to set
+	textureImageInfo.sampler = textureSampler;															// Sampler to use for set
+
+	// Texture descriptor write info
+	VkWriteDescriptorSet textureDescriptorWrite = {};
+	textureDescriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	textureDescriptorWrite.dstSet = textureSamplerDescriptorSet;
+	textureDescriptorWrite.dstBinding = 0;
+	textureDescriptorWrite.dstArrayElement = descriptorIndex;											// Free element of the texture array
+	textureDescriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	textureDescriptorWrite.descriptorCount = 1;
+	textureDescriptorWrite.pImageInfo = &textureImageInfo;
+
+	// Update texture array element
+	vkUpdateDescriptorSets(mainDevice.logicalDevice, 1, &textureDescriptorWrite, 0, nullptr);
+
+	// Return index of written texture array element
+	return descriptorIndex;
 }
 
-int VulkanRenderer::createTextureImage(std::string fileName)
+int VulkanRenderer::createModel(std::string modelFile, bool packTextures, bool staticModel)
 {
-	// Load image file
-	int width;
-	int height;
-	VkDeviceSize imageSize;
+	// Map the processed model from its cache, or import the model scene and cache it for next time
+	ModelData modelData;
+	std::string cacheFile = modelFile + MESH_CACHE_EXTENSION;
+	uint32_t meshProcessing = (meshOptimization ? MESH_PROCESSING_OPTIMIZE : 0) | (meshLods ? MESH_PROCESSING_LODS : 0) | (meshletClustering ? MESH_PROCESSING_MESHLETS : 0) | (staticModel ? MESH_PROCESSING_STATIC_BATCH : 0);
 
-	stbi_uc* imageData = loadTextureFile(fileName, width, height, imageSize);
+	if (!readMeshCache(cacheFile, modelFile, meshProcessing, modelData))
+	{
+		// OBJ files have a native parser, far faster than Assimp's on large files
+		if (isObjFile(modelFile))
+		{
+			loadObjModel(modelFile, threadPool, modelData);
+		}
 
-	// Create staging buffer to hold data, ready to copy to device
-	VkBuffer imageStagingBuffer;
-	VkDeviceMemory imageStagingBufferMemory;
+		else
+		{
+			Assimp::Importer importer;
+			const aiScene* scene = importer.ReadFile(modelFile, MODEL_IMPORT_FLAGS);
 
-	createBuffer(mainDevice.physicalDevice, mainDevice.logicalDevice, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &imageStagingBuffer, &imageStagingBufferMemory);
+			if (!scene)
+			{
+				throw std::runtime_error("Failed to load model! (" + modelFile + ")");
+			}
 
-	// Copy image data into staging buffer
-	void* data;
-	vkMapMemory(mainDevice.logicalDevice, imageStagingBufferMemory, 0, imageSize, 0, &data);
-	memcpy(data, imageData, static_cast<size_t>(imageSize));
-	vkUnmapMemory(mainDevice.logicalDevice, imageStagingBufferMemory);
+			Model::LoadModel(scene, threadPool, modelData);
+		}
 
-	// Free original image data
-	stbi_image_free(imageData);
+		// A static model's parts never move apart, so meshes sharing a texture can become one mesh drawn once (before any processing, so it covers the merged meshes)
+		if (staticModel)
+		{
+			Model::MergeStaticMeshes(modelData);
+		}
 
-	// Create image to hold final texture
-	VkImage textureImage;
-	VkDeviceMemory textureImageMemory;
+		// Simplify each mesh into its levels of detail, before optimising so every level gets reordered too
+		if (meshLods)
+		{
+			Model::GenerateMeshLods(modelData, threadPool);
+		}
 
-	textureImage = createImage(width, height, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &textureImageMemory);
+		// Reorder each mesh for the vertex cache, overdraw and vertex fetch, once, before it is cached
+		if (meshOptimization)
+		{
+			VertexCacheStatistics before;
+			VertexCacheStatistics after;
+			Model::OptimizeMeshes(modelData, threadPool, before, after);
 
-	// Transition image to be DST OPTIMAL for copy operation
-	transitionImageLayout(mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, textureImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+			printf("Optimized %s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", modelFile.c_str(), before.getACMR(), after.getACMR(), before.getATVR(), after.getATVR());
+		}
 
-	// Copy data to image
-	copyImageBuffer(mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, imageStagingBuffer, textureImage, width, height);
+		// Cluster every level into meshlets last, as clustering regroups the optimised triangle order
+		if (meshletClustering)
+		{
+			Model::BuildMeshlets(modelData, threadPool);
+		}
 
-	// Transition image to be readable for shader usage
-	transitionImageLayout(mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		writeMeshCache(cacheFile, modelFile, meshProcessing, modelData);
+	}
 
-	// Add texture data to vector for reference
-	textureImages.push_back(textureImage);
-	this->textureImageMemory.push_back(textureImageMemory);
+	// Get vector of all materials with 1:1 ID placement
+	const std::vector<std::string>& textureNames = modelData.textureNames;
 
-	// Destroy staging buffers and free memory
-	vkDestroyBuffer(mainDevice.logicalDevice, imageStagingBuffer, nullptr);
-	vkFreeMemory(mainDevice.logicalDevice, imageStagingBufferMemory, nullptr);
+	// Conversion from the materials list IDs to texture IDs, and where within that texture each material's image sits
+	std::vector<int> materialToTexture(textureNames.size());
+	std::vector<glm::vec4> materialToUVTransform(textureNames.size(), glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
 
-	// Return the index of new texture image
-	return textureImages.size() - 1;
-}
+	// Collect each distinct texture file once, so materials sharing a file share a texture
+	std::vector<std::string> uniqueTextureNames;
+	std::vector<int> materialToUniqueTexture(textureNames.size(), -1);
 
-int VulkanRenderer::createTexture(std::string fileName)
-{
-	// Create texture image and get location in array
-	int textureImageLocation = createTextureImage(fileName);
+	for (size_t i = 0; i < textureNames.size(); i++)
+	{
+		// If material had no texture, leave it unmapped
+		if (textureNames[i].empty())
+		{
+			continue;
+		}
 
-	// Create image view and add to list
-	VkImageView imageView = createImageView(textureImages[textureImageLocation], VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
-	textureImageViews.push_back(imageView);
+		auto existing = std::find(uniqueTextureNames.begin(), uniqueTextureNames.end(), textureNames[i]);
+		materialToUniqueTexture[i] = static_cast<int>(existing - uniqueTextureNames.begin());
 
-	// Create texture descriptor
-	int textureDescriptorLocation = createTextureDescriptor(imageView);
+		if (existing == uniqueTextureNames.end())
+		{
+			uniqueTextureNames.push_back(textureNames[i]);
+		}
+	}
 
-	// Return location of descriptor set with texture
-	return textureDescriptorLocation;
-}
+	std::vector<int> textureIDs(uniqueTextureNames.size());
+	std::vector<glm::vec4> textureUVTransforms(uniqueTextureNames.size(), glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+	std::vector<bool> packedTextures(uniqueTextureNames.size(), false);
 
-int VulkanRenderer::createTextureDescriptor(VkImageView textureImage)
-{
-	VkDescriptorSet textureDescriptorSet;
+	if (packTextures)
+	{
+		// A texture can only move into an atlas if none of its materials rely on the sampler repeating it
+		const std::vector<bool>& materialUVsInRange = modelData.materialUVsInRange;
+		std::vector<bool> textureUVsInRange(uniqueTextureNames.size(), true);
 
-	// Texture Descriptor Set Allocation Info
-	VkDescriptorSetAllocateInfo textureDescriptorSetAllocateInfo = {};
-	textureDescriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	textureDescriptorSetAllocateInfo.descriptorPool = textureSamplerDescriptorPool;
-	textureDescriptorSetAllocateInfo.descriptorSetCount = 1;
-	textureDescriptorSetAllocateInfo.pSetLayouts = &textureSamplerDescriptorSetLayout;
+		for (size_t i = 0; i < textureNames.size(); i++)
+		{
+			if (materialToUniqueTexture[i] >= 0 && !materialUVsInRange[i])
+			{
+				textureUVsInRange[materialToUniqueTexture[i]] = false;
+			}
+		}
 
-	// Allocate texture descriptor sets
-	VkResult result = vkAllocateDescriptorSets(mainDevice.logicalDevice, &textureDescriptorSetAllocateInfo, &textureDescriptorSet);
+		// Gather the small ones as atlas tiles
+		std::vector<size_t> tileTextures;
+		std::vector<AtlasTile> tiles;
 
-	// Texture image info
-	VkDescriptorImageInfo textureImageInfo = {};
-	textureImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;							// Image layout when in use
-	textureImageInfo.imageView = textureImage;															// Image to bind to set
-	textureImageInfo.sampler = textureSampler;															// Sampler to use for set
+		for (size_t i = 0; i < uniqueTextureNames.size(); i++)
+		{
+			std::string fileLocation = "Textures/" + uniqueTextureNames[i];
+			int width;
+			int height;
+			int channels;
 
-	// Texture descriptor write info
-	VkWriteDescriptorSet textureDescriptorWrite = {};
-	textureDescriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	textureDescriptorWrite.dstSet = textureDescriptorSet;
-	textureDescriptorWrite.dstBinding = 0;
-	textureDescriptorWrite.dstArrayElement = 0;
-	textureDescriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	textureDescriptorWrite.descriptorCount = 1;
-	textureDescriptorWrite.pImageInfo = &textureImageInfo;
+			if (!textureUVsInRange[i] || !stbi_info(fileLocation.c_str(), &width, &height, &channels) || (uint32_t)std::max(width, height) > TEXTURE_ATLAS_MAX_TILE_SIZE)
+			{
+				continue;
+			}
 
-	// Update new texture descriptor set
-	vkUpdateDescriptorSets(mainDevice.logicalDevice, 1, &textureDescriptorWrite, 0, nullptr);
+			AtlasTile tile;
+			tile.width = static_cast<uint32_t>(width);
+			tile.height = static_cast<uint32_t>(height);
 
-	// Add descriptor set to list
-	textureSamplerDescriptorSets.push_back(textureDescriptorSet);
+			tiles.push_back(tile);
+			tileTextures.push_back(i);
+		}
 
-	// Return index of latest descriptor set
-	return textureSamplerDescriptorSets.size() - 1;
-}
+		// Packing a single texture gains nothing
+		if (tiles.size() > 1)
+		{
+			uint32_t atlasWidth;
+			uint32_t atlasHeight;
+			packAtlasTiles(tiles, TEXTURE_ATLAS_MAX_SIZE, TEXTURE_ATLAS_TILE_ALIGNMENT, TEXTURE_ATLAS_GUTTER, atlasWidth, atlasHeight);
 
-int VulkanRenderer::createModel(std::string modelFile)
-{
-	// Import model scene
-	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(modelFile, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices);
+			// Tiles that did not fit stay standalone textures
+			std::vector<std::string> atlasNames;
+			std::vector<AtlasTile> atlasTiles;
+
+			for (size_t i = 0; i < tiles.size(); i++)
+			{
+				if (tiles[i].placed)
+				{
+					atlasNames.push_back(uniqueTextureNames[tileTextures[i]]);
+					atlasTiles.push_back(tiles[i]);
+				}
+			}
+
+			int atlasID = createTextureAtlas(atlasNames, atlasTiles, atlasWidth, atlasHeight);
+
+			for (size_t i = 0; i < tiles.size(); i++)
+			{
+				if (tiles[i].placed)
+				{
+					size_t texture = tileTextures[i];
+
+					textureIDs[texture] = atlasID;
+					textureUVTransforms[texture] = glm::vec4((float)tiles[i].x / atlasWidth, (float)tiles[i].y / atlasHeight, (float)tiles[i].width / atlasWidth, (float)tiles[i].height / atlasHeight);
+					packedTextures[texture] = true;
+				}
+			}
+		}
+	}
+
+	// Decode all remaining textures in parallel and upload them
+	std::vector<std::string> standaloneNames;
+	std::vector<size_t> standaloneTextures;
 
-	if (!scene)
+	for (size_t i = 0; i < uniqueTextureNames.size(); i++)
 	{
-		throw std::runtime_error("Failed to load model! (" + modelFile + ")");
+		if (!packedTextures[i])
+		{
+			standaloneNames.push_back(uniqueTextureNames[i]);
+			standaloneTextures.push_back(i);
+		}
 	}
 
-	// Get vector of all materials with 1:1 ID placement
-	std::vector<std::string> textureNames = Model::LoadMaterials(scene);
+	std::vector<int> standaloneIDs = createTextures(standaloneNames);
 
-	// Conversion from the materials list IDs to Descriptor Array IDs
-	std::vector<int> materialToTexture(textureNames.size());
+	for (size_t i = 0; i < standaloneTextures.size(); i++)
+	{
+		textureIDs[standaloneTextures[i]] = standaloneIDs[i];
+	}
 
-	// Create textures for each item in textureNames
 	for (size_t i = 0; i < textureNames.size(); i++)
 	{
-
 		// If material had no texture, set a 0 to indicate no texture present
-		if (textureNames[i].empty())
+		// Otherwise set value to index of newly created texture (and its place in an atlas, if packed)
+		if (materialToUniqueTexture[i] < 0)
 		{
 			materialToTexture[i] = 0;
+			continue;
 		}
 
-		// Set value to index of newly created texture
-		else
-		{
-			materialToTexture[i] = createTexture(textureNames[i]);
-		}
+		materialToTexture[i] = textureIDs[materialToUniqueTexture[i]];
+		materialToUVTransform[i] = textureUVTransforms[materialToUniqueTexture[i]];
 	}
 
 	// Load in all meshes
-	std::vector<Mesh> models = Model::LoadNode(mainDevice.physicalDevice, mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, scene->mRootNode, scene, materialToTexture);
+	std::vector<Mesh> models = Model::CreateMeshes(mainDevice.physicalDevice, mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, modelData, materialToTexture, materialToUVTransform, compactVertices, indexTypeUint8);
+
+	// Add the model's node hierarchy to the scene graph under a root node of its own, which updateModel moves
+	if (sceneGraph.getNodeCount() + modelData.nodes.size() + 1 > MAX_SCENE_NODES)
+	{
+		throw std::runtime_error("Failed to add model to the scene, too many nodes! (" + modelFile + ")");
+	}
+
+	uint32_t rootNode = sceneGraph.addNode(SCENE_NO_PARENT, glm::mat4(1.0f));
+	uint32_t firstNode = sceneGraph.getNodeCount();
+
+	for (const auto& node : modelData.nodes)
+	{
+		sceneGraph.addNode(node.parent == SCENE_NO_PARENT ? rootNode : firstNode + node.parent, node.transform);
+	}
+
+	for (size_t i = 0; i < models.size(); i++)
+	{
+		models[i].setNode(firstNode + modelData.meshes[i].node);
+	}
+
+	// Create model and move it (and its meshes) into the list
+	Model model = Model(std::move(models));
+	model.setRootNode(rootNode);
 
-	// Create model and add to list
-	Model model = Model(models);
+	modelList.push_back(std::move(model));
 
-	modelList.push_back(model);
+	// Give each new mesh a culling box, placed (and the tree rebuilt around it) before the next frame is culled
+	instanceBoundsMin.resize(instanceBoundsMin.size() + modelList.back().getMeshCount());
+	instanceBoundsMax.resize(instanceBoundsMax.size() + modelList.back().getMeshCount());
+	cullingBvhStale = true;
+
+	// Make room for the new model's meshlets in the indirect draw buffers
+	createIndirectDrawBuffers();
 
 	return modelList.size() - 1;
 
@@ -1576,10 +3441,42 @@ void VulkanRenderer::recordCommands(uint32_t currentImage)
 	VkCommandBufferBeginInfo commandBufferBeginInfo = {};
 	commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
+	// Start recording commands to the command buffer
+	VkResult result = vkBeginCommandBuffer(commandBuffers[currentImage], &commandBufferBeginInfo);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to start recording a Command Buffer!");
+	}
+
+	// Choose this frame's draws and write their indirect commands
+	frameImageIndex = currentImage;
+	frameCommandCount = collectDraws(currentImage);
+
+	// Record the frame's passes, each after the barriers it needs, into this image's attachments
+	renderGraph.setImportedImage(swapchainResource, swapchainImages[currentImage].image);
+	renderGraph.setImportedImage(colorBufferResource, colorBufferImage[currentImage]);
+	renderGraph.setImportedImage(depthBufferResource, depthBufferImage[currentImage]);
+	renderGraph.setImportedBuffer(indirectDrawResource, indirectDrawBuffer[currentImage]);
+
+	renderGraph.execute(commandBuffers[currentImage]);
+
+	// Stop recording to command buffer
+	result = vkEndCommandBuffer(commandBuffers[currentImage]);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to stop recording a Command Buffer!");
+	}
+
+}
+
+void VulkanRenderer::recordScene(uint32_t currentImage, bool earlyPass)
+{
 	// Information about how to begin a render pass (only needed for graphical applications)
 	VkRenderPassBeginInfo renderPassBeginInfo = {};
 	renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	renderPassBeginInfo.renderPass = renderPass;														// Render pass to begin
+	renderPassBeginInfo.renderPass = earlyPass ? earlyRenderPass : renderPass;							// Render pass to begin
 	renderPassBeginInfo.renderArea.offset = { 0, 0 };													// Start point of render pass in pixels
 	renderPassBeginInfo.renderArea.extent = swapchainExtent;											// Size of region to run render pass on (starting at offset)
 
@@ -1593,13 +3490,8 @@ void VulkanRenderer::recordCommands(uint32_t currentImage)
 
 	renderPassBeginInfo.framebuffer = swapchainFramebuffers[currentImage];
 
-	// Start recording commands to the command buffer
-	VkResult result = vkBeginCommandBuffer(commandBuffers[currentImage], &commandBufferBeginInfo);
-
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to start recording a Command Buffer!");
-	}
+	// Package descriptor sets for binding (the texture array is shared by every draw, so bind once)
+	std::array<VkDescriptorSet, 2> descriptorSetsToBind = { viewProjectionDescriptorSets[currentImage], textureSamplerDescriptorSet };
 
 	// Begin Render Pass
 	vkCmdBeginRenderPass(commandBuffers[currentImage], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
@@ -1607,52 +3499,237 @@ void VulkanRenderer::recordCommands(uint32_t currentImage)
 	// Bind Pipeline to be used in render pass
 	vkCmdBindPipeline(commandBuffers[currentImage], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
 
+	// Bind descriptor sets
+	vkCmdBindDescriptorSets(commandBuffers[currentImage], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, static_cast<uint32_t>(descriptorSetsToBind.size()), descriptorSetsToBind.data(), 0, nullptr);
+
+	// Occlusion culling draws what was visible last frame in the early pass, then only the late copy of the commands (those newly visible)
+	recordDraws(currentImage, occlusionCulling && !earlyPass ? frameCommandCount : 0);
+
+	// Start second subpass
+	vkCmdNextSubpass(commandBuffers[currentImage], VK_SUBPASS_CONTENTS_INLINE);
+
+	// Nothing to compose yet in the early pass, the main pass's second subpass does it
+	if (!earlyPass)
+	{
+		vkCmdBindPipeline(commandBuffers[currentImage], VK_PIPELINE_BIND_POINT_GRAPHICS, secondPipeline);
+
+		vkCmdBindDescriptorSets(commandBuffers[currentImage], VK_PIPELINE_BIND_POINT_GRAPHICS, secondPipelineLayout, 0, 1, &inputAttachmentDescriptorSets[currentImage], 0, nullptr);
+
+		vkCmdDraw(commandBuffers[currentImage], 3, 1, 0, 0);
+	}
+
+	// End Render Pass
+	vkCmdEndRenderPass(commandBuffers[currentImage]);
+}
+
+uint32_t VulkanRenderer::collectDraws(uint32_t currentImage)
+{
+	// Note each visible mesh's draw, writing indirect commands (and with occlusion culling their bounds) for it, and return how many
+	meshDraws.clear();
+
+	VkDrawIndexedIndirectCommand* drawCommands = indirectDrawCommands.empty() ? nullptr : indirectDrawCommands[currentImage];
+	OcclusionCullDraw* cullDraws = occlusionCulling && !occlusionDraws.empty() ? occlusionDraws[currentImage] : nullptr;
+	uint32_t commandCount = 0;
+	uint32_t instance = 0;
+
 	for (size_t i = 0; i < modelList.size(); i++)
 	{
-		Model currentModel = modelList[i];
-		glm::mat4 model = currentModel.getModel();
-		vkCmdPushConstants(commandBuffers[currentImage], pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &model);
+		Model& currentModel = modelList[i];
 
-		for (size_t j = 0; j < currentModel.getMeshCount(); j++)
+		for (size_t j = 0; j < currentModel.getMeshCount(); j++, instance++)
 		{
-			VkBuffer vertexBuffers[] = { currentModel.getMesh(j)->getVertexBuffer() };									// Buffers to bind
-			VkDeviceSize offsets[] = { 0 };																				// Offsets into buffers being bound
+			// Outside the view frustum, nothing to record
+			if (!instanceVisibility[instance])
+			{
+				continue;
+			}
+
+			// Level of detail chosen for this frame, skipped entirely if all of its meshlets are culled
+			Mesh* mesh = currentModel.getMesh(j);
+			MeshLod lod = mesh->getLod(mesh->getCurrentLod());
+			uint32_t node = mesh->getNode();
 
-			vkCmdBindVertexBuffers(commandBuffers[currentImage], 0, 1, vertexBuffers, offsets);							// Command to bind vertex buffer before drawing with them
-			vkCmdBindIndexBuffer(commandBuffers[currentImage], currentModel.getMesh(j)->getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);	// Command to bind index buffer before drawing with them
+			MeshDraw meshDraw = { mesh, lod, commandCount, 0 };
 
-			// Package descriptor sets for binding
-			int textureID = currentModel.getMesh(j)->getTextureID();
-			std::array<VkDescriptorSet, 2> descriptorSetsToBind = { viewProjectionDescriptorSets[currentImage], textureSamplerDescriptorSets[textureID] };
+			if (lod.meshletCount > 0)
+			{
+				// Meshlet bounds are in mesh space, so cull against the frustum and camera brought into that space
+				glm::vec4 frustumPlanes[6];
+				calculateFrustumPlanes(nodeModelViewProjections[node], frustumPlanes);
+				glm::vec3 cameraPosition = glm::vec3(glm::inverse(nodeModelViews[node])[3]);
+
+				meshDraw.commandCount = cullMeshlets(mesh, lod, frustumPlanes, cameraPosition, drawCommands + commandCount, cullDraws ? cullDraws + commandCount : nullptr, instanceVisibilitySlots[instance]);
+
+				if (meshDraw.commandCount == 0)
+				{
+					continue;
+				}
+			}
 
-			// Bind descriptor sets
-			vkCmdBindDescriptorSets(commandBuffers[currentImage], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, static_cast<uint32_t>(descriptorSetsToBind.size()), descriptorSetsToBind.data(), 0, nullptr);
+			else if (occlusionCulling)
+			{
+				// Whole level drawn through a command too, so the cull pass can switch it off
+				VkDrawIndexedIndirectCommand& drawCommand = drawCommands[commandCount];
+				drawCommand.indexCount = lod.indexCount;
+				drawCommand.instanceCount = 1;
+				drawCommand.firstIndex = lod.firstIndex;
+				drawCommand.vertexOffset = 0;
+				drawCommand.firstInstance = 0;
+
+				cullDraws[commandCount].boundingSphere = mesh->getBoundingSphere();
+				cullDraws[commandCount].node = node;
+				cullDraws[commandCount].visibilitySlot = instanceVisibilitySlots[instance];
+
+				meshDraw.commandCount = 1;
+			}
 
-			// Execute pipeline
-			vkCmdDrawIndexed(commandBuffers[currentImage], currentModel.getMesh(j)->getIndexCount(), 1, 0, 0, 0);
+			commandCount += meshDraw.commandCount;
+			meshDraws.push_back(meshDraw);
 		}
 	}
 
-	// Start second subpass
-	vkCmdNextSubpass(commandBuffers[currentImage], VK_SUBPASS_CONTENTS_INLINE);
+	// Second copy of the commands, for the late pass to switch on what the early pass didn't draw
+	if (occlusionCulling && commandCount > 0)
+	{
+		std::copy_n(drawCommands, commandCount, drawCommands + commandCount);
+	}
+
+	return commandCount;
+}
 
-	vkCmdBindPipeline(commandBuffers[currentImage], VK_PIPELINE_BIND_POINT_GRAPHICS, secondPipeline);
+void VulkanRenderer::recordDraws(uint32_t currentImage, uint32_t commandOffset)
+{
+	// Draw each of the frame's meshes, from the commands starting at commandOffset
+	for (const MeshDraw& meshDraw : meshDraws)
+	{
+		Mesh* mesh = meshDraw.mesh;
 
-	vkCmdBindDescriptorSets(commandBuffers[currentImage], VK_PIPELINE_BIND_POINT_GRAPHICS, secondPipelineLayout, 0, 1, &inputAttachmentDescriptorSets[currentImage], 0, nullptr);
+		VkBuffer vertexBuffers[] = { mesh->getVertexBuffer() };											// Buffers to bind
+		VkDeviceSize offsets[] = { 0 };																	// Offsets into buffers being bound
 
-	vkCmdDraw(commandBuffers[currentImage], 3, 1, 0, 0);
+		vkCmdBindVertexBuffers(commandBuffers[currentImage], 0, 1, vertexBuffers, offsets);				// Command to bind vertex buffer before drawing with them
+		vkCmdBindIndexBuffer(commandBuffers[currentImage], mesh->getIndexBuffer(), 0, mesh->getIndexType());	// Command to bind index buffer before drawing with them
 
-	// End Render Pass
-	vkCmdEndRenderPass(commandBuffers[currentImage]);
+		// Decode the mesh's vertices, and select its texture from the bindless array (its element changes as mips stream in and out)
+		VertexQuantization quantization = mesh->getVertexQuantization();
 
-	// Stop recording to command buffer
-	result = vkEndCommandBuffer(commandBuffers[currentImage]);
+		PushModel pushModel;
+		pushModel.positionOffset = glm::vec4(quantization.positionOffset, 0.0f);
+		pushModel.positionScale = glm::vec4(quantization.positionScale, 0.0f);
+		pushModel.textureTransform = glm::vec4(quantization.textureOffset, quantization.textureScale);
+		pushModel.worldTransformIndex = mesh->getNode();
+		pushModel.textureID = textures[mesh->getTextureID()].descriptorIndex;
 
-	if (result != VK_SUCCESS)
+		vkCmdPushConstants(commandBuffers[currentImage], pipelineLayout, pushConstantRange.stageFlags, 0, sizeof(PushModel), &pushModel);
+
+		// Execute pipeline, drawing the surviving meshlets, or the whole level if it wasn't clustered (nor needs a command to cull it)
+		if (meshDraw.commandCount > 0)
+		{
+			VkDeviceSize drawBufferOffset = (commandOffset + meshDraw.firstCommand) * sizeof(VkDrawIndexedIndirectCommand);
+
+			if (multiDrawIndirect)
+			{
+				vkCmdDrawIndexedIndirect(commandBuffers[currentImage], indirectDrawBuffer[currentImage], drawBufferOffset, meshDraw.commandCount, sizeof(VkDrawIndexedIndirectCommand));
+			}
+
+			else
+			{
+				for (uint32_t k = 0; k < meshDraw.commandCount; k++)
+				{
+					vkCmdDrawIndexedIndirect(commandBuffers[currentImage], indirectDrawBuffer[currentImage], drawBufferOffset + k * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+				}
+			}
+		}
+
+		else
+		{
+			vkCmdDrawIndexed(commandBuffers[currentImage], meshDraw.lod.indexCount, 1, meshDraw.lod.firstIndex, 0, 0);
+		}
+	}
+}
+
+void VulkanRenderer::recordDepthPyramid(uint32_t currentImage)
+{
+	// The render graph has the pyramid in GENERAL, and the depth written, by the time this is recorded
+	vkCmdBindPipeline(commandBuffers[currentImage], VK_PIPELINE_BIND_POINT_COMPUTE, depthPyramidPipeline);
+
+	// Each level keeps the farthest depth of the level above, so must wait for it to be written
+	VkMemoryBarrier levelBarrier = {};
+	levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	glm::ivec2 inputSize = glm::ivec2(swapchainExtent.width, swapchainExtent.height);
+
+	for (uint32_t i = 0; i < depthPyramidLevelCount; i++)
 	{
-		throw std::runtime_error("Failed to stop recording a Command Buffer!");
+		DepthPyramidConstants constants;
+		constants.inputSize = inputSize;
+		constants.outputSize = glm::max(glm::ivec2(depthPyramidExtent.width >> i, depthPyramidExtent.height >> i), glm::ivec2(1));
+
+		vkCmdBindDescriptorSets(commandBuffers[currentImage], VK_PIPELINE_BIND_POINT_COMPUTE, depthPyramidPipelineLayout, 0, 1, &depthPyramidDescriptorSets[currentImage * depthPyramidLevelCount + i], 0, nullptr);
+		vkCmdPushConstants(commandBuffers[currentImage], depthPyramidPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DepthPyramidConstants), &constants);
+		vkCmdDispatch(commandBuffers[currentImage], (constants.outputSize.x + DEPTH_PYRAMID_GROUP_SIZE - 1) / DEPTH_PYRAMID_GROUP_SIZE, (constants.outputSize.y + DEPTH_PYRAMID_GROUP_SIZE - 1) / DEPTH_PYRAMID_GROUP_SIZE, 1);
+
+		vkCmdPipelineBarrier(commandBuffers[currentImage], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &levelBarrier, 0, nullptr, 0, nullptr);
+
+		inputSize = constants.outputSize;
+	}
+}
+
+void VulkanRenderer::recordOcclusionCull(uint32_t currentImage, uint32_t drawCount, bool latePass)
+{
+	if (drawCount == 0)
+	{
+		return;
+	}
+
+	// Waiting on earlier passes writing visibility, the pyramid and the commands (including the last frame's) is left to the render graph
+	OcclusionCullConstants constants;
+	constants.view = viewProjection.view;
+	constants.projection = glm::vec4(viewProjection.projection[0][0], viewProjection.projection[1][1], viewProjection.projection[2][2], viewProjection.projection[3][2]);
+	constants.pyramidSize = glm::vec2(depthPyramidExtent.width, depthPyramidExtent.height);
+	constants.drawCount = drawCount;
+	constants.latePass = latePass ? 1 : 0;
+
+	vkCmdBindPipeline(commandBuffers[currentImage], VK_PIPELINE_BIND_POINT_COMPUTE, occlusionCullPipeline);
+	vkCmdBindDescriptorSets(commandBuffers[currentImage], VK_PIPELINE_BIND_POINT_COMPUTE, occlusionCullPipelineLayout, 0, 1, &occlusionCullDescriptorSets[currentImage], 0, nullptr);
+	vkCmdPushConstants(commandBuffers[currentImage], occlusionCullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(OcclusionCullConstants), &constants);
+	vkCmdDispatch(commandBuffers[currentImage], (drawCount + OCCLUSION_CULL_GROUP_SIZE - 1) / OCCLUSION_CULL_GROUP_SIZE, 1, 1);
+}
+
+uint32_t VulkanRenderer::cullMeshlets(Mesh* mesh, const MeshLod& lod, const glm::vec4 frustumPlanes[6], glm::vec3 cameraPosition, VkDrawIndexedIndirectCommand* drawCommands, OcclusionCullDraw* cullDraws, uint32_t firstSlot)
+{
+	// Write a draw for each of the level's meshlets inside the frustum and facing the camera, returning how many
+	// (and with cullDraws, each draw's bounds and the visibility slot of its meshlet, for the occlusion cull pass)
+	uint32_t drawCount = 0;
+
+	for (uint32_t i = 0; i < lod.meshletCount; i++)
+	{
+		const Meshlet* meshlet = mesh->getMeshlet(lod.firstMeshlet + i);
+
+		if (isSphereOutsideFrustum(frustumPlanes, meshlet->boundingSphere) || isMeshletBackFacing(*meshlet, cameraPosition))
+		{
+			continue;
+		}
+
+		if (cullDraws != nullptr)
+		{
+			OcclusionCullDraw& cullDraw = cullDraws[drawCount];
+			cullDraw.boundingSphere = meshlet->boundingSphere;
+			cullDraw.node = mesh->getNode();
+			cullDraw.visibilitySlot = firstSlot + lod.firstMeshlet + i;
+		}
+
+		VkDrawIndexedIndirectCommand& drawCommand = drawCommands[drawCount++];
+		drawCommand.indexCount = meshlet->indexCount;
+		drawCommand.instanceCount = 1;
+		drawCommand.firstIndex = meshlet->firstIndex;
+		drawCommand.vertexOffset = 0;
+		drawCommand.firstInstance = 0;
 	}
 
+	return drawCount;
 }
 
 void VulkanRenderer::getPhysicalDevice()
@@ -1720,14 +3797,68 @@ void VulkanRenderer::createLogicalDevice()
 	deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());				// Number of Queue Create Infos
 	deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();										// List of queue create infos to create required queues
-	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());			// Number of enabled logical device extensions
-	deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();									// List of enabled logical device extensions
+
+	// Required extensions, plus 8-bit index buffers where the device supports them
+	std::vector<const char*> enabledExtensions = deviceExtensions;
+	indexTypeUint8 = checkIndexTypeUint8Support(mainDevice.physicalDevice);
+	if (indexTypeUint8)
+	{
+		enabledExtensions.push_back(VK_EXT_INDEX_TYPE_UINT8_EXTENSION_NAME);
+	}
+
+	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());			// Number of enabled logical device extensions
+	deviceCreateInfo.ppEnabledExtensionNames = enabledExtensions.data();								// List of enabled logical device extensions
+
+	// Vulkan 1.2 Features the Logical Device will be using (descriptor indexing for bindless textures)
+	VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+	vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	vulkan12Features.runtimeDescriptorArray = VK_TRUE;
+	vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+	vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	vulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+
+	// 8-bit index buffer feature, only chained in when the extension is enabled
+	VkPhysicalDeviceIndexTypeUint8FeaturesEXT indexTypeUint8Features = {};
+	indexTypeUint8Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_INDEX_TYPE_UINT8_FEATURES_EXT;
+	indexTypeUint8Features.indexTypeUint8 = VK_TRUE;
+	if (indexTypeUint8)
+	{
+		vulkan12Features.pNext = &indexTypeUint8Features;
+	}
+
+	// Synchronization2 is optional, barrier batches falling back to vkCmdPipelineBarrier without it
+	synchronization2 = checkSynchronization2Support(mainDevice.physicalDevice);
+
+	VkPhysicalDeviceVulkan13Features vulkan13Features = {};
+	vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+	vulkan13Features.synchronization2 = VK_TRUE;
+	if (synchronization2)
+	{
+		vulkan13Features.pNext = vulkan12Features.pNext;
+		vulkan12Features.pNext = &vulkan13Features;
+	}
+
+	// GPU occlusion culling needs compute on the graphics queue, falling back to drawing everything in view without it
+	if (occlusionCulling && !indices.graphicsCompute)
+	{
+		occlusionCulling = false;
+		printf("GPU occlusion culling disabled: the graphics queue family does not support compute\n");
+	}
+
+	// Drawing many meshlets per indirect call is optional, falling back to one call per meshlet
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(mainDevice.physicalDevice, &supportedFeatures);
+	multiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
 
 	// Physical Device Features the Logical Device will be using
-	VkPhysicalDeviceFeatures deviceFeatures = {};
-	deviceFeatures.samplerAnisotropy = VK_TRUE;															// Enable anisotropic filtering feature flag
+	VkPhysicalDeviceFeatures2 deviceFeatures2 = {};
+	deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	deviceFeatures2.pNext = &vulkan12Features;
+	deviceFeatures2.features.samplerAnisotropy = VK_TRUE;												// Enable anisotropic filtering feature flag
+	deviceFeatures2.features.multiDrawIndirect = multiDrawIndirect ? VK_TRUE : VK_FALSE;				// Enable drawing many indirect commands per call where supported
 
-	deviceCreateInfo.pEnabledFeatures = &deviceFeatures;												// Physical Device features that the Logical Device will use
+	deviceCreateInfo.pNext = &deviceFeatures2;															// Physical Device features that the Logical Device will use
+	deviceCreateInfo.pEnabledFeatures = nullptr;														// Must be null when features are passed through pNext
 
 	// Create the logical device for the given physical device
 	VkResult result = vkCreateDevice(mainDevice.physicalDevice, &deviceCreateInfo, nullptr, &mainDevice.logicalDevice);
@@ -1742,6 +3873,9 @@ void VulkanRenderer::createLogicalDevice()
 	vkGetDeviceQueue(mainDevice.logicalDevice, indices.graphicsFamily, 0, &graphicsQueue);
 	vkGetDeviceQueue(mainDevice.logicalDevice, indices.presentationFamily, 0, &presentationQueue);
 
+	textureBarriers.setSynchronization2(synchronization2);
+	renderGraph.setSynchronization2(synchronization2);
+
 }
 
 QueueFamilyIndices VulkanRenderer::getQueueFamilies(VkPhysicalDevice device)
@@ -1761,9 +3895,11 @@ QueueFamilyIndices VulkanRenderer::getQueueFamilies(VkPhysicalDevice device)
 	{
 		// First check if queue family has at least 1 queue in that family (could have no queues)
 		// Queue can be multiple types defined through bitfield. Bitwise AND with VK_QUEUE_*_BIT to check if contains required queue family.
-		if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+		// Prefer a graphics family that also supports compute, as GPU occlusion culling records its dispatches on the graphics queue
+		if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT && (indices.graphicsFamily < 0 || !indices.graphicsCompute))
 		{
 			indices.graphicsFamily = i;				// If queue family is valid, then get index
+			indices.graphicsCompute = (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
 		}
 
 		// Check if Queue Family supports presentation
@@ -1776,8 +3912,8 @@ QueueFamilyIndices VulkanRenderer::getQueueFamilies(VkPhysicalDevice device)
 			indices.presentationFamily = i;
 		}
 
-		// Stop searching for validity after finding required queue family.
-		if (indices.isValid())
+		// Stop searching for validity after finding required queue family (and a graphics family that supports compute).
+		if (indices.isValid() && indices.graphicsCompute)
 		{
 			break;
 		}
@@ -1926,13 +4062,20 @@ void VulkanRenderer::cleanup()
 
 	vkDestroySampler(mainDevice.logicalDevice, textureSampler, nullptr);
 
-	for (size_t i = 0; i < textureImages.size(); i++)
+	destroyRetiredTextures(true);
+
+	for (size_t i = 0; i < textures.size(); i++)
 	{
-		vkDestroyImageView(mainDevice.logicalDevice, textureImageViews[i], nullptr);
-		vkDestroyImage(mainDevice.logicalDevice, textureImages[i], nullptr);
-		vkFreeMemory(mainDevice.logicalDevice, textureImageMemory[i], nullptr);
+		vkDestroyImageView(mainDevice.logicalDevice, textures[i].imageView, nullptr);
+		vkDestroyImage(mainDevice.logicalDevice, textures[i].image, nullptr);
+		vkFreeMemory(mainDevice.logicalDevice, textures[i].imageMemory, nullptr);
 	}
 
+	vkDestroyBuffer(mainDevice.logicalDevice, textureStagingBuffer, nullptr);
+	vkFreeMemory(mainDevice.logicalDevice, textureStagingBufferMemory, nullptr);
+
+	renderGraph.destroy();
+
 	for (size_t i = 0; i < depthBufferImage.size(); i++)
 	{
 		vkDestroyImageView(mainDevice.logicalDevice, depthBufferImageView[i], nullptr);
@@ -1956,6 +4099,56 @@ void VulkanRenderer::cleanup()
 		vkFreeMemory(mainDevice.logicalDevice, viewProjectionUniformBufferMemory[i], nullptr);
 	}
 
+	for (size_t i = 0; i < worldTransformBuffer.size(); i++)
+	{
+		vkUnmapMemory(mainDevice.logicalDevice, worldTransformBufferMemory[i]);
+		vkDestroyBuffer(mainDevice.logicalDevice, worldTransformBuffer[i], nullptr);
+		vkFreeMemory(mainDevice.logicalDevice, worldTransformBufferMemory[i], nullptr);
+	}
+
+	for (size_t i = 0; i < indirectDrawBuffer.size(); i++)
+	{
+		vkUnmapMemory(mainDevice.logicalDevice, indirectDrawBufferMemory[i]);
+		vkDestroyBuffer(mainDevice.logicalDevice, indirectDrawBuffer[i], nullptr);
+		vkFreeMemory(mainDevice.logicalDevice, indirectDrawBufferMemory[i], nullptr);
+	}
+
+	for (size_t i = 0; i < occlusionDrawBuffer.size(); i++)
+	{
+		vkUnmapMemory(mainDevice.logicalDevice, occlusionDrawBufferMemory[i]);
+		vkDestroyBuffer(mainDevice.logicalDevice, occlusionDrawBuffer[i], nullptr);
+		vkFreeMemory(mainDevice.logicalDevice, occlusionDrawBufferMemory[i], nullptr);
+	}
+
+	if (visibilityBuffer != VK_NULL_HANDLE)
+	{
+		vkDestroyBuffer(mainDevice.logicalDevice, visibilityBuffer, nullptr);
+		vkFreeMemory(mainDevice.logicalDevice, visibilityBufferMemory, nullptr);
+	}
+
+	if (occlusionCulling)
+	{
+		vkDestroyPipeline(mainDevice.logicalDevice, occlusionCullPipeline, nullptr);
+		vkDestroyPipelineLayout(mainDevice.logicalDevice, occlusionCullPipelineLayout, nullptr);
+		vkDestroyPipeline(mainDevice.logicalDevice, depthPyramidPipeline, nullptr);
+		vkDestroyPipelineLayout(mainDevice.logicalDevice, depthPyramidPipelineLayout, nullptr);
+
+		vkDestroyDescriptorPool(mainDevice.logicalDevice, occlusionCullingDescriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(mainDevice.logicalDevice, occlusionCullDescriptorSetLayout, nullptr);
+		vkDestroyDescriptorSetLayout(mainDevice.logicalDevice, depthPyramidDescriptorSetLayout, nullptr);
+
+		vkDestroySampler(mainDevice.logicalDevice, depthPyramidSampler, nullptr);
+
+		for (auto levelView : depthPyramidLevelViews)
+		{
+			vkDestroyImageView(mainDevice.logicalDevice, levelView, nullptr);
+		}
+
+		vkDestroyImageView(mainDevice.logicalDevice, depthPyramidImageView, nullptr);
+		vkDestroyImage(mainDevice.logicalDevice, depthPyramidImage, nullptr);
+		vkFreeMemory(mainDevice.logicalDevice, depthPyramidImageMemory, nullptr);
+	}
+
 	for (size_t i = 0; i < MAX_FRAME_DRAWS; i++)
 	{
 
@@ -1973,6 +4166,13 @@ void VulkanRenderer::cleanup()
 		vkDestroyFramebuffer(mainDevice.logicalDevice, framebuffer, nullptr);
 	}
 
+	// Keep what the driver compiled for the next run
+	if (pipelineCache != VK_NULL_HANDLE)
+	{
+		savePipelineCache(mainDevice.physicalDevice, mainDevice.logicalDevice, pipelineCache, PIPELINE_CACHE_FILE);
+		vkDestroyPipelineCache(mainDevice.logicalDevice, pipelineCache, nullptr);
+	}
+
 	vkDestroyPipeline(mainDevice.logicalDevice, secondPipeline, nullptr);
 	vkDestroyPipelineLayout(mainDevice.logicalDevice, secondPipelineLayout, nullptr);
 
@@ -1981,6 +4181,11 @@ void VulkanRenderer::cleanup()
 
 	vkDestroyRenderPass(mainDevice.logicalDevice, renderPass, nullptr);
 
+	if (occlusionCulling)
+	{
+		vkDestroyRenderPass(mainDevice.logicalDevice, earlyRenderPass, nullptr);
+	}
+
 	for (auto image : swapchainImages)
 	{
 		vkDestroyImageView(mainDevice.logicalDevice, image.imageView, nullptr);
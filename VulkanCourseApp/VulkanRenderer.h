@@ -4,6 +4,7 @@
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -18,6 +19,17 @@
 #include "VulkanValidation.h"
 #include "Mesh.h"
 #include "Model.h"
+#include "MeshCache.h"
+#include "ObjLoader.h"
+#include "ThreadPool.h"
+#include "TextureStreaming.h"
+#include "TextureAtlas.h"
+#include "ImageProcessing.h"
+#include "InstanceBvh.h"
+#include "OcclusionBuffer.h"
+#include "RenderGraph.h"
+#include "BarrierBatch.h"
+#include "PipelineCache.h"
 
 #include "Utilities.h"
 #include "stb_image.h"
@@ -30,8 +42,27 @@ public:
 
 	int init(GLFWwindow* newWindow);
 
-	int createModel(std::string modelFile);
+	int createModel(std::string modelFile, bool packTextures = false, bool staticModel = false);
 	void updateModel(int modelId, glm::mat4 newModel);
+	void updateModel(int modelId, glm::vec3 position, glm::quat rotation, glm::vec3 scale);
+
+	void setTextureQuality(TextureQuality quality);
+	void setTextureStreamingBudget(VkDeviceSize newBudget);
+	void setCompactVertices(bool enabled);
+	void setMeshOptimization(bool enabled);
+	void setMeshLods(bool enabled);
+	void setMeshletClustering(bool enabled);
+	void setOcclusionCulling(bool enabled);
+	void setSoftwareOcclusionCulling(bool enabled);
+
+	// Meshes drawn and culled in the last frame
+	CullingStats getCullingStats();
+
+	// Nearest mesh a world space ray hits, as currently placed (false if none)
+	bool raycast(glm::vec3 origin, glm::vec3 direction, RaycastHit& hit);
+
+	// Nearest mesh under a point of the window, in screen coordinates from its top left (as glfwGetCursorPos reports them)
+	bool pick(float screenX, float screenY, RaycastHit& hit);
 
 	void draw();
 	void cleanup();
@@ -41,9 +72,31 @@ public:
 private:
 	GLFWwindow* window;
 	int currentFrame = 0;
+	uint64_t frameNumber = 0;																				// Total frames drawn, used to age streamed textures
 
 	// Scene Objects
 	std::vector<Model> modelList;
+	SceneGraph sceneGraph;
+	std::vector<glm::mat4> nodeModelViews;																	// View * world matrix of every scene node, this frame
+	std::vector<glm::mat4> nodeModelViewProjections;														// Projection * view * world matrix of every scene node, this frame
+
+	// Frustum Culling (every mesh of every model is an instance, in model then mesh order)
+	InstanceBvh cullingBvh;
+	std::vector<glm::vec3> instanceBoundsMin;																// World space box of each instance
+	std::vector<glm::vec3> instanceBoundsMax;
+	std::vector<uint8_t> instanceVisibility;																// Whether each instance is in view this frame
+	bool cullingBvhStale = false;																			// Instances were added since the last build
+	CullingStats cullingStats = {};
+	OcclusionBuffer occlusionBuffer;																		// Occluders drawn on the CPU this frame
+	bool meshOptimization = true;																			// Reorder meshes for the GPU when loading them
+	bool meshLods = true;																					// Generate simplified levels of detail when loading meshes
+	bool meshletClustering = true;																			// Split meshes into meshlets culled one by one when drawing
+	bool compactVertices = true;																			// Upload quantized CompactVertex instead of Vertex
+	bool indexTypeUint8 = false;																			// VK_EXT_index_type_uint8 enabled, meshes under 257 vertices use 8-bit indices
+	bool synchronization2 = false;																			// Vulkan 1.3 synchronization2 enabled, batched barriers are recorded with vkCmdPipelineBarrier2
+	bool multiDrawIndirect = false;																			// multiDrawIndirect enabled, a mesh's meshlets are drawn by one indirect call
+	bool occlusionCulling = false;																			// Test draws against a depth pyramid on the GPU before drawing them
+	bool softwareOcclusionCulling = false;																	// Also test instances in view against the largest ones on screen on the CPU
 
 	// Scene Settings
 	struct ViewProjection
@@ -95,18 +148,93 @@ private:
 	std::vector<VkBuffer> viewProjectionUniformBuffer;
 	std::vector<VkDeviceMemory> viewProjectionUniformBufferMemory;
 
+	// World Transforms (every scene node's world matrix, in a storage buffer per image)
+	std::vector<VkBuffer> worldTransformBuffer;
+	std::vector<VkDeviceMemory> worldTransformBufferMemory;
+	std::vector<glm::mat4*> worldTransformData;																// Persistently mapped
+	std::vector<glm::uvec2> worldTransformPendingRanges;													// Nodes changed since each image's buffer was last written ([x, y))
+
+	// Indirect Draws (the meshlets surviving culling, written each frame)
+	std::vector<VkBuffer> indirectDrawBuffer;
+	std::vector<VkDeviceMemory> indirectDrawBufferMemory;
+	std::vector<VkDrawIndexedIndirectCommand*> indirectDrawCommands;										// Persistently mapped
+	size_t indirectDrawCapacity = 0;																		// Commands each buffer holds
+
+	// Draws recorded this frame, replayed by each pass drawing the scene
+	struct MeshDraw
+	{
+		Mesh* mesh;
+		MeshLod lod;
+		uint32_t firstCommand;																				// Range of indirect commands (none to draw the whole level directly)
+		uint32_t commandCount;
+	};
+	std::vector<MeshDraw> meshDraws;
+
+	// Occlusion Culling (draws visible last frame are drawn first, their depth reduced into a pyramid, then everything is tested
+	// against it and the newly revealed draws drawn too, the indirect buffers holding a copy of every command for each pass)
+	VkRenderPass earlyRenderPass;																			// Compatible with renderPass, but keeps its depth for the pyramid
+	VkImage depthPyramidImage;
+	VkDeviceMemory depthPyramidImageMemory;
+	VkImageView depthPyramidImageView;																		// Every level, read by the cull pass
+	std::vector<VkImageView> depthPyramidLevelViews;														// One level each, written by the reduction
+	VkExtent2D depthPyramidExtent;																			// Power of two at or below the swapchain extent
+	uint32_t depthPyramidLevelCount;
+	VkSampler depthPyramidSampler;
+	VkDescriptorPool occlusionCullingDescriptorPool;
+	VkDescriptorSetLayout depthPyramidDescriptorSetLayout;
+	std::vector<VkDescriptorSet> depthPyramidDescriptorSets;												// A set per level for each image (level 0 reads that image's depth)
+	VkPipelineLayout depthPyramidPipelineLayout;
+	VkPipeline depthPyramidPipeline;
+	VkDescriptorSetLayout occlusionCullDescriptorSetLayout;
+	std::vector<VkDescriptorSet> occlusionCullDescriptorSets;												// One per image
+	VkPipelineLayout occlusionCullPipelineLayout;
+	VkPipeline occlusionCullPipeline;
+	std::vector<VkBuffer> occlusionDrawBuffer;																// Bounds of each indirect command, one buffer per image
+	std::vector<VkDeviceMemory> occlusionDrawBufferMemory;
+	std::vector<OcclusionCullDraw*> occlusionDraws;															// Persistently mapped
+	VkBuffer visibilityBuffer = VK_NULL_HANDLE;																// Whether each draw slot was visible last frame, shared by every image
+	VkDeviceMemory visibilityBufferMemory = VK_NULL_HANDLE;
+	std::vector<uint32_t> instanceVisibilitySlots;															// First slot of each instance (then one per meshlet)
+	size_t visibilitySlotCount = 0;
+
+	// Render Graph (the frame's passes and what each uses, recorded by recordCommands)
+	RenderGraph renderGraph;
+	RenderGraphResource swapchainResource;
+	RenderGraphResource colorBufferResource;
+	RenderGraphResource depthBufferResource;
+	RenderGraphResource depthPyramidResource;
+	RenderGraphResource indirectDrawResource;
+	RenderGraphResource visibilityResource;
+	uint32_t frameImageIndex = 0;																			// Image the passes are recording for
+	uint32_t frameCommandCount = 0;																			// Indirect commands collected for it (each pass's copy)
+
 	// Textures
-	std::vector<VkImage> textureImages;
-	std::vector<VkDeviceMemory> textureImageMemory;
-	std::vector<VkImageView> textureImageViews;
+	std::vector<StreamedTexture> textures;
+	std::vector<RetiredTexture> retiredTextures;
+	VkDeviceSize textureResidentBytes = 0;																	// Device memory used by resident mip levels
+	VkDeviceSize textureStreamingBudget = TEXTURE_STREAMING_BUDGET;
+	uint32_t textureMaxSize = getTextureQualityMaxSize(TextureQuality::High);								// Textures are halved on load until they fit
+	BarrierBatch textureBarriers;																			// Layouts of texture images, whose uploads record their transitions through it
+
+	// Texture Streaming
+	std::vector<VkCommandBuffer> textureStreamingCommandBuffers;											// One per frame in flight
+	VkBuffer textureStagingBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory textureStagingBufferMemory = VK_NULL_HANDLE;
+	uint8_t* textureStagingData = nullptr;																	// Persistently mapped
+	VkDeviceSize textureStagingHead = 0;																	// Where the next staged mips go
+	VkDeviceSize textureStagingUsed = 0;																	// Bytes still read by frames in flight (wrapping included)
+	VkDeviceSize textureStagingFrameBytes[MAX_FRAME_DRAWS] = {};											// Bytes each frame in flight staged, released once its fence is waited on
 
 	// Texture Sampler
 	VkSampler textureSampler;
 	VkDescriptorSetLayout textureSamplerDescriptorSetLayout;
 	VkDescriptorPool textureSamplerDescriptorPool;
-	std::vector<VkDescriptorSet> textureSamplerDescriptorSets;
+	VkDescriptorSet textureSamplerDescriptorSet;															// Single bindless set holding every texture
+	uint32_t textureDescriptorCount = 0;																	// Number of array elements written so far
+	std::vector<uint32_t> freeTextureDescriptors;															// Array elements released by retired textures
 
 	// Pipeline
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;															// Loaded from PIPELINE_CACHE_FILE at startup, saved back at shutdown
 	VkPipeline graphicsPipeline;
 	VkPipelineLayout pipelineLayout;
 
@@ -131,6 +259,9 @@ private:
 	// Validation Layer Handler
 	VulkanValidation vulkanValidation;
 
+	// Worker threads for asset loading
+	ThreadPool threadPool;
+
 	// Create Functions
 	void createInstance();
 	void createLogicalDevice();
@@ -149,26 +280,56 @@ private:
 	void createSynchronization();
 
 	void createUniformBuffers();
+	void createIndirectDrawBuffers();
+	void createDepthPyramid();
+	void createOcclusionCullPipelines();
+	void updateOcclusionCullDescriptorSets();
 	void createDescriptorPool();
 	void createDescriptorSets();
 	void createInputDescriptorSets();
+	void createRenderGraph();
 
-	VkImage createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags, VkMemoryPropertyFlags propertyFlags, VkDeviceMemory* imageMemory);
-	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
+	VkImage createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags, VkMemoryPropertyFlags propertyFlags, VkDeviceMemory* imageMemory);
+	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels, VkComponentMapping components = {}, uint32_t baseMipLevel = 0);
 	VkShaderModule createShaderModule(const std::vector<char>& code);
 
-	int createTextureImage(std::string fileName);
 	int createTexture(std::string fileName);
+	std::vector<int> createTextures(const std::vector<std::string>& fileNames);
+	int createTextureAtlas(const std::vector<std::string>& fileNames, const std::vector<AtlasTile>& tiles, uint32_t atlasWidth, uint32_t atlasHeight);
+	int createTextureFromPixels(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t maxLevelCount);
 	int createTextureDescriptor(VkImageView textureImage);
 
 	// Update Functions
 	void updateUniformBuffers(uint32_t imageIndex);
+	void updateInstanceBounds();
+	void updateWorldTransforms(uint32_t imageIndex);
+	void updateTextureStreaming();
+	void updateMeshLods();
+	void updateFrustumCulling();
+	void updateSoftwareOcclusionCulling();
+
+	// Texture Streaming Functions
+	void createTextureStreaming();
+	void recordTextureMips(size_t textureIndex, uint32_t baseMip, VkCommandBuffer commandBuffer, VkBuffer stagingBuffer, VkDeviceSize stagingOffset);
+	uint8_t* createTextureTailStaging(VkDeviceSize size, TextureTailUpload& upload);
+	void submitTextureTail(size_t textureIndex, TextureTailUpload& upload);
+	void finishTextureTailUploads(std::vector<TextureTailUpload>& uploads);
+	bool streamTextureMips(size_t textureIndex, uint32_t baseMip);
+	bool allocateTextureStaging(VkDeviceSize size, VkDeviceSize& offset);
+	VkDeviceSize evictTextures(VkDeviceSize bytesNeeded, uint32_t& evictionsLeft);
+	void destroyRetiredTextures(bool force);
 
 	// Load Functions
 	stbi_uc* loadTextureFile(std::string fileName, int& width, int& height, VkDeviceSize& imageSize);
 
 	// Record Functions
 	void recordCommands(uint32_t currentImage);
+	uint32_t collectDraws(uint32_t currentImage);
+	void recordScene(uint32_t currentImage, bool earlyPass);
+	void recordDraws(uint32_t currentImage, uint32_t commandOffset);
+	void recordDepthPyramid(uint32_t currentImage);
+	void recordOcclusionCull(uint32_t currentImage, uint32_t drawCount, bool latePass);
+	uint32_t cullMeshlets(Mesh* mesh, const MeshLod& lod, const glm::vec4 frustumPlanes[6], glm::vec3 cameraPosition, VkDrawIndexedIndirectCommand* drawCommands, OcclusionCullDraw* cullDraws, uint32_t firstSlot);
 
 	// Get Functions
 	void getPhysicalDevice();
@@ -178,6 +339,9 @@ private:
 	// Checker Functions
 	bool checkInstanceExtensionSupport(std::vector<const char*>* checkExtensions);
 	bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+	bool checkDescriptorIndexingSupport(VkPhysicalDevice device);
+	bool checkIndexTypeUint8Support(VkPhysicalDevice device);
+	bool checkSynchronization2Support(VkPhysicalDevice device);
 	bool checkDeviceSuitable(VkPhysicalDevice device);
 
 	// Choose Functions